@@ -25,6 +25,9 @@
 #include <source/level/LevelViewer.h>
 #include <source/level/bounds/Bounds.h>
 #include <source/level/bounds/BoundsManager.h>
+#include <source/level/lighting/DynamicLightManager.h>
+#include <source/level/nav/PathfindingService.h>
+#include <source/level/objects/base/CrowdMover.h>
 #include <source/level/objects/base/ObjectCommand.h>
 #include <source/level/objects/components/ICmpActivatable.h>
 #include <source/level/objects/components/ICmpModelRender.h>
@@ -36,6 +39,17 @@
 #include <source/level/physics/PhysicsSystem.h>
 namespace bf = boost::filesystem;
 
+namespace {
+
+//#################### CONSTANTS ####################
+enum
+{
+	DYNAMIC_LIGHTING_BUDGET = 2000,		// the maximum time to spend relighting dynamic lights each frame (in microseconds)
+	PATHFINDING_BUDGET = 1000			// the maximum time to spend finding paths each frame (in microseconds)
+};
+
+}
+
 namespace hesp {
 
 //#################### CONSTRUCTORS ####################
@@ -88,6 +102,12 @@ GameState_Ptr GameState_Level::update(int milliseconds, InputState& input)
 	// Broadcast an elapsed time message so that time-sensitive components can update themselves.
 	m_level->object_manager()->broadcast_message(Message_CPtr(new MsgTimeElapsed(milliseconds)));
 
+	// Relight any dynamic lights which were added, moved or removed during this update.
+	m_level->dynamic_light_manager()->update(DYNAMIC_LIGHTING_BUDGET);
+
+	// Find paths for any path requests made by the yokes (results are picked up by the yokes next frame).
+	m_level->object_manager()->pathfinding_service()->update(PATHFINDING_BUDGET);
+
 	return GameState_Ptr();
 }
 
@@ -239,11 +259,18 @@ void GameState_Level::do_yokes(int milliseconds, InputState& input)
 		std::copy(commands.begin(), commands.end(), std::back_inserter(cmdQueue));
 	}
 
-	// Step 2:	Execute the object commands.
+	// Step 2:	Execute the object commands. Movement commands are queued with the crowd mover so that the objects can
+	//			be moved as a batch: the batch is flushed before executing any other command which might depend on the
+	//			positions of the queued objects, and once all of the commands have been handled.
+	const CrowdMover_Ptr& crowdMover = objectManager->crowd_mover();
 	for(std::list<ObjectCommand_Ptr>::const_iterator it=cmdQueue.begin(), iend=cmdQueue.end(); it!=iend; ++it)
 	{
+		if((*it)->attempt_batching(objectManager)) continue;
+
+		if((*it)->depends_on_movement()) crowdMover->flush(objectManager, m_level->onion_polygons(), m_level->onion_tree(), m_level->nav_manager(), milliseconds);
 		(*it)->execute(objectManager, m_level->onion_polygons(), m_level->onion_tree(), m_level->nav_manager(), milliseconds);
 	}
+	crowdMover->flush(objectManager, m_level->onion_polygons(), m_level->onion_tree(), m_level->nav_manager(), milliseconds);
 }
 
 void GameState_Level::grab_input()
@@ -0,0 +1,79 @@
+/***
+ * hesperus: PalettedImageLoader.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "PalettedImageLoader.h"
+
+#include <climits>
+#include <vector>
+
+#include <source/exceptions/Exception.h>
+#include "PixelTypes.h"
+#include "SimpleImage.h"
+
+namespace hesp {
+
+//#################### PUBLIC METHODS ####################
+/**
+Loads a 24-bit image stored in palettised form from a std::istream.
+
+@param is			The std::istream from which to load the image
+@return				An Image24_Ptr holding the representation of the image
+@throws Exception	If the image data is invalid or incomplete
+*/
+Image24_Ptr PalettedImageLoader::load_streamed_image24(std::istream& is)
+{
+	const int MAX_PALETTE_SIZE = 256;
+
+	// TODO: There may be endian issues with this if we ever port to another platform.
+	int width, height, paletteSize;
+	is.read(reinterpret_cast<char*>(&width), sizeof(int));
+	is.read(reinterpret_cast<char*>(&height), sizeof(int));
+	is.read(reinterpret_cast<char*>(&paletteSize), sizeof(int));
+	if(!is || width <= 0 || height <= 0 || width > INT_MAX / height) throw Exception("Bad paletted image dimensions");
+	if(paletteSize <= 0 || paletteSize > MAX_PALETTE_SIZE) throw Exception("Bad paletted image palette size");
+
+	// Note:	The palette is padded out to its maximum size, so that every index decodes to a pixel.
+	std::vector<unsigned char> paletteData(paletteSize * 3);
+	is.read(reinterpret_cast<char*>(&paletteData[0]), paletteData.size());
+	Pixel24 palette[MAX_PALETTE_SIZE];
+	for(int j=0; j<paletteSize; ++j) palette[j] = Pixel24(paletteData[j*3], paletteData[j*3+1], paletteData[j*3+2]);
+
+	// Note:	A run packet stores up to 128 pixels in 2 bytes, and a literal packet stores up to 128 pixels in one byte
+	//			more than that, so the size of the data for a valid image is bounded in both directions.
+	int pixelCount = width * height;
+	int packedSize;
+	is.read(reinterpret_cast<char*>(&packedSize), sizeof(int));
+	if(!is || packedSize <= 0 || pixelCount / 64 > packedSize || packedSize - pixelCount > pixelCount / 128 + 1) throw Exception("Bad paletted image data size");
+
+	std::vector<unsigned char> packedIndices(packedSize);
+	is.read(reinterpret_cast<char*>(&packedIndices[0]), packedSize);
+	if(!is) throw Exception("Unexpected EOF whilst reading paletted image data");
+
+	// Expand the run-length encoded palette indices (see PalettedImageSaver::pack_bits).
+	shared_array<Pixel24> pixels(new Pixel24[pixelCount]);
+	int pos = 0;
+	for(int i=0; i<packedSize;)
+	{
+		int header = packedIndices[i++];
+		if(header < 128)
+		{
+			int count = header + 1;
+			if(count > packedSize - i || count > pixelCount - pos) throw Exception("Bad paletted image data");
+			for(int k=0; k<count; ++k) pixels[pos++] = palette[packedIndices[i++]];
+		}
+		else if(header > 128)
+		{
+			int count = 257 - header;
+			if(i == packedSize || count > pixelCount - pos) throw Exception("Bad paletted image data");
+			const Pixel24& p = palette[packedIndices[i++]];
+			for(int k=0; k<count; ++k) pixels[pos++] = p;
+		}
+	}
+	if(pos != pixelCount) throw Exception("Bad paletted image data");
+
+	return Image24_Ptr(new SimpleImage24(pixels, width, height));
+}
+
+}
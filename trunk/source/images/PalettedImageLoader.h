@@ -0,0 +1,29 @@
+/***
+ * hesperus: PalettedImageLoader.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_PALETTEDIMAGELOADER
+#define H_HESP_PALETTEDIMAGELOADER
+
+#include <istream>
+
+#include "Image.h"
+
+namespace hesp {
+
+/**
+This class provides loading functions for images stored in palettised form (see
+PalettedImageSaver). Decoding involves no decompression beyond expanding the runs of
+palette indices, which makes it much faster than decoding a PNG.
+*/
+class PalettedImageLoader
+{
+	//#################### PUBLIC METHODS ####################
+public:
+	static Image24_Ptr load_streamed_image24(std::istream& is);
+};
+
+}
+
+#endif
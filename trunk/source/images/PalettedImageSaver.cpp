@@ -0,0 +1,259 @@
+/***
+ * hesperus: PalettedImageSaver.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "PalettedImageSaver.h"
+
+#include <algorithm>
+#include <climits>
+#include <ostream>
+
+#include "PixelTypes.h"
+
+namespace {
+
+//#################### CONSTANTS ####################
+const int MAX_PALETTE_SIZE = 256;
+
+//#################### LOCAL METHODS ####################
+int channel(int colour, int axis)
+{
+	return (colour >> (16 - 8*axis)) & 0xff;
+}
+
+int pack_colour(const hesp::Pixel24& p)
+{
+	return (p.r() << 16) | (p.g() << 8) | p.b();
+}
+
+//#################### LOCAL CLASSES ####################
+/**
+A box in colour space, containing the distinct colours [begin,end) of the array being partitioned by median cut.
+*/
+struct ColourBox
+{
+	int begin, end;
+	int axis;		// the colour channel along which the box is longest
+	int extent;		// the extent of the box along that channel
+
+	ColourBox(const std::vector<std::pair<int,int> >& colourCounts, int begin_, int end_)
+	:	begin(begin_), end(end_), axis(0), extent(-1)
+	{
+		for(int k=0; k<3; ++k)
+		{
+			int lo = 255, hi = 0;
+			for(int i=begin; i<end; ++i)
+			{
+				int c = channel(colourCounts[i].first, k);
+				lo = std::min(lo, c);
+				hi = std::max(hi, c);
+			}
+			if(hi - lo > extent)
+			{
+				axis = k;
+				extent = hi - lo;
+			}
+		}
+	}
+};
+
+struct ChannelPred
+{
+	int axis;
+
+	explicit ChannelPred(int axis_) : axis(axis_) {}
+
+	bool operator()(const std::pair<int,int>& lhs, const std::pair<int,int>& rhs) const
+	{
+		int l = channel(lhs.first, axis), r = channel(rhs.first, axis);
+		if(l != r) return l < r;
+		return lhs.first < rhs.first;
+	}
+};
+
+}
+
+namespace hesp {
+
+//#################### PUBLIC METHODS ####################
+/**
+Saves a 24-bit image to a std::ostream in palettised form.
+
+@param os		The std::ostream to which to save the image
+@param image	An Image24_CPtr holding the representation of the image
+*/
+void PalettedImageSaver::save_streamed_image24(std::ostream& os, const Image24_CPtr& image)
+{
+	int width = image->width(), height = image->height();
+	int pixelCount = width * height;
+
+	// Count how many times each distinct colour is used.
+	std::vector<int> colours(pixelCount);
+	for(int i=0; i<pixelCount; ++i) colours[i] = pack_colour((*image)(i));
+
+	std::vector<int> sortedColours(colours);
+	std::sort(sortedColours.begin(), sortedColours.end());
+
+	std::vector<std::pair<int,int> > colourCounts;
+	for(int i=0; i<pixelCount; ++i)
+	{
+		if(colourCounts.empty() || colourCounts.back().first != sortedColours[i]) colourCounts.push_back(std::make_pair(sortedColours[i], 0));
+		++colourCounts.back().second;
+	}
+
+	// Choose the palette, and find the nearest palette entry to each distinct colour.
+	std::vector<int> palette = choose_palette(colourCounts);
+	int paletteSize = static_cast<int>(palette.size());
+
+	int colourCount = static_cast<int>(colourCounts.size());
+	std::vector<unsigned char> colourIndices(colourCount);
+	for(int i=0; i<colourCount; ++i)
+	{
+		int bestDistance = INT_MAX;
+		for(int j=0; j<paletteSize; ++j)
+		{
+			int distance = 0;
+			for(int k=0; k<3; ++k)
+			{
+				int d = channel(colourCounts[i].first, k) - channel(palette[j], k);
+				distance += d*d;
+			}
+			if(distance < bestDistance)
+			{
+				bestDistance = distance;
+				colourIndices[i] = static_cast<unsigned char>(j);
+			}
+		}
+	}
+
+	// Replace each pixel with its palette index, and run-length encode the result.
+	std::vector<unsigned char> indices(pixelCount);
+	for(int i=0; i<pixelCount; ++i)
+	{
+		std::vector<std::pair<int,int> >::const_iterator it = std::lower_bound(colourCounts.begin(), colourCounts.end(), std::make_pair(colours[i], 0));
+		indices[i] = colourIndices[it - colourCounts.begin()];
+	}
+
+	std::vector<unsigned char> packedIndices;
+	pack_bits(indices, packedIndices);
+	int packedSize = static_cast<int>(packedIndices.size());
+
+	std::vector<unsigned char> paletteData(paletteSize * 3);
+	for(int j=0; j<paletteSize; ++j)
+	{
+		for(int k=0; k<3; ++k) paletteData[j*3+k] = static_cast<unsigned char>(channel(palette[j], k));
+	}
+
+	// TODO: There may be endian issues with this if we ever port to another platform.
+	os.write(reinterpret_cast<char*>(&width), sizeof(int));
+	os.write(reinterpret_cast<char*>(&height), sizeof(int));
+	os.write(reinterpret_cast<char*>(&paletteSize), sizeof(int));
+	os.write(reinterpret_cast<char*>(&paletteData[0]), paletteData.size());
+	os.write(reinterpret_cast<char*>(&packedSize), sizeof(int));
+	os.write(reinterpret_cast<char*>(&packedIndices[0]), packedIndices.size());
+}
+
+//#################### PRIVATE METHODS ####################
+/**
+Chooses the palette for an image. If the image has no more distinct colours than will fit
+in a palette, the palette consists of exactly those colours. Otherwise, the colours are
+partitioned by median cut (repeatedly splitting the box of colours which is longest along
+any channel, at the median pixel along that channel), and each palette entry is the mean
+of the pixels in one of the boxes.
+
+@param colourCounts		The distinct colours in the image (sorted), each paired with the number of pixels which use it
+@return					The palette
+*/
+std::vector<int> PalettedImageSaver::choose_palette(const std::vector<std::pair<int,int> >& colourCounts)
+{
+	int colourCount = static_cast<int>(colourCounts.size());
+	std::vector<int> palette;
+
+	if(colourCount <= MAX_PALETTE_SIZE)
+	{
+		for(int i=0; i<colourCount; ++i) palette.push_back(colourCounts[i].first);
+		return palette;
+	}
+
+	std::vector<std::pair<int,int> > boxColours(colourCounts);
+	std::vector<ColourBox> boxes(1, ColourBox(boxColours, 0, colourCount));
+	while(static_cast<int>(boxes.size()) < MAX_PALETTE_SIZE)
+	{
+		// Find the longest box (there must be one with more than one colour, since there are more colours than boxes).
+		int longest = 0;
+		for(int i=1, size=static_cast<int>(boxes.size()); i<size; ++i)
+		{
+			if(boxes[i].extent > boxes[longest].extent) longest = i;
+		}
+
+		// Split it at the median pixel along its longest channel.
+		ColourBox box = boxes[longest];
+		std::sort(boxColours.begin() + box.begin, boxColours.begin() + box.end, ChannelPred(box.axis));
+
+		int boxPixelCount = 0;
+		for(int i=box.begin; i<box.end; ++i) boxPixelCount += boxColours[i].second;
+
+		int split = box.begin + 1, pixelsBelow = boxColours[box.begin].second;
+		while(split < box.end - 1 && pixelsBelow * 2 < boxPixelCount)
+		{
+			pixelsBelow += boxColours[split].second;
+			++split;
+		}
+
+		boxes[longest] = ColourBox(boxColours, box.begin, split);
+		boxes.push_back(ColourBox(boxColours, split, box.end));
+	}
+
+	for(size_t i=0, size=boxes.size(); i<size; ++i)
+	{
+		double sums[3] = {0,0,0};
+		int boxPixelCount = 0;
+		for(int j=boxes[i].begin; j<boxes[i].end; ++j)
+		{
+			for(int k=0; k<3; ++k) sums[k] += channel(boxColours[j].first, k) * boxColours[j].second;
+			boxPixelCount += boxColours[j].second;
+		}
+
+		int colour = 0;
+		for(int k=0; k<3; ++k) colour = (colour << 8) | static_cast<int>(sums[k] / boxPixelCount + 0.5);
+		palette.push_back(colour);
+	}
+	return palette;
+}
+
+/**
+Run-length encodes an array of bytes using the PackBits scheme. Each packet starts with a header byte h:
+if h < 128, the next h+1 bytes are stored literally; if h > 128, the next byte is repeated 257-h times.
+
+@param input	The bytes to encode
+@param output	Used to return the encoded bytes to the caller
+*/
+void PalettedImageSaver::pack_bits(const std::vector<unsigned char>& input, std::vector<unsigned char>& output)
+{
+	const size_t MAX_PACKET_LENGTH = 128;
+
+	size_t i = 0, n = input.size();
+	while(i < n)
+	{
+		size_t runLength = 1;
+		while(i + runLength < n && runLength < MAX_PACKET_LENGTH && input[i+runLength] == input[i]) ++runLength;
+
+		if(runLength >= 3)
+		{
+			output.push_back(static_cast<unsigned char>(257 - runLength));
+			output.push_back(input[i]);
+			i += runLength;
+		}
+		else
+		{
+			// Store bytes literally until the next run of at least three identical bytes (or until the packet is full).
+			size_t start = i;
+			while(i < n && i - start < MAX_PACKET_LENGTH && !(i + 2 < n && input[i] == input[i+1] && input[i] == input[i+2])) ++i;
+			output.push_back(static_cast<unsigned char>(i - start - 1));
+			output.insert(output.end(), input.begin() + start, input.begin() + i);
+		}
+	}
+}
+
+}
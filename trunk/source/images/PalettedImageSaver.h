@@ -0,0 +1,41 @@
+/***
+ * hesperus: PalettedImageSaver.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_PALETTEDIMAGESAVER
+#define H_HESP_PALETTEDIMAGESAVER
+
+#include <iosfwd>
+#include <vector>
+
+#include "Image.h"
+
+namespace hesp {
+
+/**
+This class provides saving functions for images stored in a compact palettised form: the image
+width and height, a palette of up to 256 colours, and then the palette index of each pixel (in
+row-major order), run-length encoded using the PackBits scheme. Lightmaps tend to contain large
+flat areas, which the run-length encoding compresses well, and decoding them involves nothing
+more than a table lookup per pixel.
+
+An image with at most 256 distinct colours is stored exactly. The palette for any other image
+is chosen by median cut, and each pixel is then stored as its nearest palette colour, so the
+format is lossy for such images.
+*/
+class PalettedImageSaver
+{
+	//#################### PUBLIC METHODS ####################
+public:
+	static void save_streamed_image24(std::ostream& os, const Image24_CPtr& image);
+
+	//#################### PRIVATE METHODS ####################
+private:
+	static std::vector<int> choose_palette(const std::vector<std::pair<int,int> >& colourCounts);
+	static void pack_bits(const std::vector<unsigned char>& input, std::vector<unsigned char>& output);
+};
+
+}
+
+#endif
@@ -5,8 +5,19 @@
 
 #include "LevelFile.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <utility>
+
+#include <boost/cstdint.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 namespace bf = boost::filesystem;
+namespace bi = boost::interprocess;
 
 #include <source/io/files/DefinitionsFile.h>
 #include <source/io/sections/DefinitionsSpecifierSection.h>
@@ -19,9 +30,11 @@ namespace bf = boost::filesystem;
 #include <source/io/sections/SpriteNamesSection.h>
 #include <source/io/sections/TreeSection.h>
 #include <source/io/sections/VisSection.h>
+#include <source/io/util/BinaryIO.h>
 #include <source/io/util/DirectoryFinder.h>
 #include <source/level/LitGeometryRenderer.h>
 #include <source/level/UnlitGeometryRenderer.h>
+#include <source/level/lighting/DynamicLightManager.h>
 #include <source/level/models/ModelManager.h>
 #include <source/level/objects/components/ICmpModelRender.h>
 
@@ -29,7 +42,7 @@ namespace hesp {
 
 //#################### LOADING METHODS ####################
 /**
-Loads a level from the specified file.
+Loads a level from the specified file (which may be in either text or binary form).
 
 @param filename	The name of the level file
 @return			The level
@@ -42,12 +55,36 @@ Level_Ptr LevelFile::load(const std::string& filename)
 	std::string fileType;
 	if(!std::getline(is, fileType)) throw Exception("Unexpected EOF whilst trying to read file type");
 
-	if(fileType == "HBSPL") return load_lit(is);
+	if(fileType == "HBSPB")
+	{
+		is.close();
+		return load_binary(filename);
+	}
+	else if(fileType == "HBSPL") return load_lit(is);
 	else if(fileType == "HBSPU") return load_unlit(is);
 	else throw Exception(filename + " is not a valid level file");
 }
 
 //#################### SAVING METHODS ####################
+/**
+Converts a text level file to a binary one.
+
+@param inputFilename	The name of the text level file
+@param outputFilename	The name of the binary level file to write
+*/
+void LevelFile::convert_to_binary(const std::string& inputFilename, const std::string& outputFilename)
+{
+	std::ifstream is(inputFilename.c_str(), std::ios_base::binary);
+	if(is.fail()) throw Exception("Could not open " + inputFilename + " for reading");
+
+	std::string fileType;
+	if(!std::getline(is, fileType)) throw Exception("Unexpected EOF whilst trying to read file type");
+
+	if(fileType == "HBSPL") convert_to_binary_sub<TexturedLitPolygon>(is, true, outputFilename);
+	else if(fileType == "HBSPU") convert_to_binary_sub<TexturedPolygon>(is, false, outputFilename);
+	else throw Exception(inputFilename + " is not a valid text level file");
+}
+
 /**
 Saves all the relevant pieces of information to the specified level file.
 
@@ -56,25 +93,37 @@ Saves all the relevant pieces of information to the specified level file.
 @param tree						The BSP tree for the level
 @param portals					The portals for the level
 @param leafVis					The leaf visibility table for the level
-@param lightmaps				The lightmaps for the level
+@param lightmaps				The lightmaps (atlas pages) for the level
+@param lightmapIndices			The index of the lightmap for each level polygon
 @param onionPolygons			The polygons for the onion tree
 @param onionTree				The onion tree for the level
 @param onionPortals				The onion portals for the level
 @param navManager				The navigation manager containing the navigation datasets for the level
 @param definitionsFilename		The name of the definitions file for the level
 @param objectManager			The object manager containing the objects for the level
+@param binary					Whether to save the level in binary form rather than text form
 */
 void LevelFile::save_lit(const std::string& filename,
 						 const std::vector<TexturedLitPolygon_Ptr>& polygons, const BSPTree_CPtr& tree,
 						 const std::vector<Portal_Ptr>& portals,
 						 const LeafVisTable_CPtr& leafVis,
-						 const std::vector<Image24_Ptr>& lightmaps,
+						 const std::vector<Image24_Ptr>& lightmaps, const std::vector<int>& lightmapIndices,
 						 const std::vector<CollisionPolygon_Ptr>& onionPolygons, const OnionTree_CPtr& onionTree,
 						 const std::vector<OnionPortal_Ptr>& onionPortals,
 						 const NavManager_CPtr& navManager,
 						 const std::string& definitionsFilename,
-						 const ObjectManager_Ptr& objectManager)
+						 const ObjectManager_Ptr& objectManager,
+						 bool binary)
 {
+	if(binary)
+	{
+		std::ostringstream objectsData;
+		save_objects(objectsData, definitionsFilename, objectManager);
+		save_binary(filename, polygons, tree, portals, CompressedLeafVisTable::compress(*leafVis), &lightmaps, &lightmapIndices,
+					onionPolygons, onionTree, onionPortals, navManager, objectsData.str());
+		return;
+	}
+
 	std::ofstream os(filename.c_str(), std::ios_base::binary);
 	if(os.fail()) throw Exception("Could not open " + filename + " for writing");
 
@@ -83,15 +132,12 @@ void LevelFile::save_lit(const std::string& filename,
 	TreeSection::save(os, tree);
 	PolygonsSection::save(os, "Portals", portals);
 	VisSection::save(os, leafVis);
-	LightmapsSection::save(os, lightmaps);
+	LightmapsSection::save(os, lightmaps, lightmapIndices);
 	PolygonsSection::save(os, "OnionPolygons", onionPolygons);
 	OnionTreeSection::save(os, onionTree);
 	PolygonsSection::save(os, "OnionPortals", onionPortals);
 	NavSection::save(os, navManager);
-	DefinitionsSpecifierSection::save(os, definitionsFilename);
-	ModelNamesSection().save(os, objectManager->model_manager());
-	SpriteNamesSection().save(os, objectManager->sprite_manager());
-	ObjectsSection::save(os, objectManager);
+	save_objects(os, definitionsFilename, objectManager);
 }
 
 /**
@@ -108,6 +154,7 @@ Saves all the relevant pieces of information to the specified level file.
 @param navManager				The navigation manager containing the navigation datasets for the level
 @param definitionsFilename		The name of the definitions file for the level
 @param objectManager			The object manager containing the objects for the level
+@param binary					Whether to save the level in binary form rather than text form
 */
 void LevelFile::save_unlit(const std::string& filename,
 						   const std::vector<TexturedPolygon_Ptr>& polygons, const BSPTree_CPtr& tree,
@@ -117,8 +164,18 @@ void LevelFile::save_unlit(const std::string& filename,
 						   const std::vector<OnionPortal_Ptr>& onionPortals,
 						   const NavManager_CPtr& navManager,
 						   const std::string& definitionsFilename,
-						   const ObjectManager_Ptr& objectManager)
+						   const ObjectManager_Ptr& objectManager,
+						   bool binary)
 {
+	if(binary)
+	{
+		std::ostringstream objectsData;
+		save_objects(objectsData, definitionsFilename, objectManager);
+		save_binary(filename, polygons, tree, portals, CompressedLeafVisTable::compress(*leafVis), NULL, NULL,
+					onionPolygons, onionTree, onionPortals, navManager, objectsData.str());
+		return;
+	}
+
 	std::ofstream os(filename.c_str(), std::ios_base::binary);
 	if(os.fail()) throw Exception("Could not open " + filename + " for writing");
 
@@ -131,13 +188,110 @@ void LevelFile::save_unlit(const std::string& filename,
 	OnionTreeSection::save(os, onionTree);
 	PolygonsSection::save(os, "OnionPortals", onionPortals);
 	NavSection::save(os, navManager);
-	DefinitionsSpecifierSection::save(os, definitionsFilename);
-	ModelNamesSection().save(os, objectManager->model_manager());
-	SpriteNamesSection().save(os, objectManager->sprite_manager());
-	ObjectsSection::save(os, objectManager);
+	save_objects(os, definitionsFilename, objectManager);
 }
 
 //#################### LOADING SUPPORT METHODS ####################
+/**
+Looks up a section of a binary level file.
+
+@param sections		The sections of the file, indexed by name
+@param name			The name of the section
+@return				A reader for the section
+@throws Exception	If the file has no section with the specified name
+*/
+BinaryReader& LevelFile::binary_section(std::map<std::string,BinaryReader>& sections, const std::string& name)
+{
+	std::map<std::string,BinaryReader>::iterator it = sections.find(name);
+	if(it == sections.end()) throw Exception("The binary level file has no " + name + " section");
+	return it->second;
+}
+
+/**
+Loads a binary level from the specified file. The file is memory-mapped, and each
+section is read directly from the mapping.
+
+@param filename		The name of the level file
+@return				The level
+@throws Exception	If the file is not a valid binary level file
+*/
+Level_Ptr LevelFile::load_binary(const std::string& filename)
+try
+{
+	bi::file_mapping mapping(filename.c_str(), bi::read_only);
+	bi::mapped_region region(mapping, bi::read_only);
+	const char *base = static_cast<const char*>(region.get_address());
+	const char *end = base + region.get_size();
+
+	// Read the header.
+	BinaryReader header(base, end, "binary level header");
+	const char *magic = header.read_array<char>(8);
+	if(std::memcmp(magic, "HBSPB\n", 6) != 0) throw Exception(filename + " is not a valid binary level file");
+	if(header.read<boost::uint32_t>() != BINARY_BYTE_ORDER_MARK) throw Exception(filename + " was written on a machine with a different byte order");
+	if(header.read<boost::uint32_t>() != BINARY_VERSION) throw Exception(filename + " has an unsupported binary level file version");
+	int sectionCount = header.read<int>();
+	header.read<boost::uint32_t>();
+
+	// Read the table of contents.
+	std::map<std::string,BinaryReader> sections;
+	for(int i=0; i<sectionCount; ++i)
+	{
+		const char *nameChars = header.read_array<char>(BINARY_SECTION_NAME_LENGTH);
+		std::string name(nameChars, std::find(nameChars, nameChars + BINARY_SECTION_NAME_LENGTH, '\0'));
+		boost::uint64_t offset = header.read<boost::uint64_t>();
+		boost::uint64_t size = header.read<boost::uint64_t>();
+
+		boost::uint64_t fileSize = static_cast<boost::uint64_t>(end - base);
+		if(offset % BinaryReader::ALIGNMENT != 0 || offset > fileSize || size > fileSize - offset)
+		{
+			throw Exception("Bad table of contents entry for the " + name + " section of " + filename);
+		}
+
+		const char *sectionBegin = base + static_cast<size_t>(offset);
+		sections.insert(std::make_pair(name, BinaryReader(sectionBegin, sectionBegin + static_cast<size_t>(size), name + " section")));
+	}
+
+	// Load the level data. Lit levels are distinguished from unlit ones by the presence of a Lightmaps section.
+	BSPTree_Ptr tree = TreeSection::load_binary(binary_section(sections, "BSPTree"));
+	CompressedLeafVisTable_Ptr leafVis = VisSection::load_binary(binary_section(sections, "Vis"));
+
+	GeometryRenderer_Ptr geomRenderer;
+	DynamicLightManager_Ptr dynamicLightManager;
+	if(sections.find("Lightmaps") != sections.end())
+	{
+		std::vector<TexturedLitPolygon_Ptr> polygons;
+		PolygonsSection::load_binary(binary_section(sections, "Polygons"), polygons);
+		std::istringstream lightmapsData(binary_section(sections, "Lightmaps").read_string());
+		std::vector<int> lightmapIndices;
+		std::vector<Image24_Ptr> lightmaps = LightmapsSection::load(lightmapsData, lightmapIndices);
+		geomRenderer.reset(new LitGeometryRenderer(polygons, lightmaps, lightmapIndices));
+		dynamicLightManager.reset(new DynamicLightManager(polygons, tree, leafVis));
+	}
+	else
+	{
+		std::vector<TexturedPolygon_Ptr> polygons;
+		PolygonsSection::load_binary(binary_section(sections, "Polygons"), polygons);
+		geomRenderer.reset(new UnlitGeometryRenderer(polygons));
+		dynamicLightManager.reset(new DynamicLightManager(polygons, tree, leafVis));
+	}
+
+	std::vector<Portal_Ptr> portals;
+	PolygonsSection::load_binary(binary_section(sections, "Portals"), portals);
+	std::vector<CollisionPolygon_Ptr> onionPolygons;
+	PolygonsSection::load_binary(binary_section(sections, "OnionPolygons"), onionPolygons);
+	OnionTree_Ptr onionTree = OnionTreeSection::load_binary(binary_section(sections, "OnionTree"));
+	std::vector<OnionPortal_Ptr> onionPortals;
+	PolygonsSection::load_binary(binary_section(sections, "OnionPortals"), onionPortals);
+	NavManager_Ptr navManager = NavSection::load_binary(binary_section(sections, "Nav"));
+
+	std::istringstream objectsData(binary_section(sections, "Objects").read_string());
+	ObjectManager_Ptr objectManager = load_objects(objectsData);
+
+	// Construct and return the level.
+	return Level_Ptr(new Level(geomRenderer, tree, portals, leafVis, onionPolygons, onionTree, onionPortals, navManager, objectManager, dynamicLightManager));
+}
+catch(bi::interprocess_exception& e) { throw Exception("Could not map " + filename + " for reading: " + e.what()); }
+
 /**
 Loads a lit level from the specified std::istream.
 
@@ -149,27 +303,42 @@ Level_Ptr LevelFile::load_lit(std::istream& is)
 	std::vector<TexturedLitPolygon_Ptr> polygons;
 	BSPTree_Ptr tree;
 	std::vector<Portal_Ptr> portals;
-	LeafVisTable_Ptr leafVis;
+	CompressedLeafVisTable_Ptr leafVis;
 	std::vector<CollisionPolygon_Ptr> onionPolygons;
 	OnionTree_Ptr onionTree;
 	std::vector<OnionPortal_Ptr> onionPortals;
 	NavManager_Ptr navManager;
-	std::string definitionsFilename;
-	ModelManager_Ptr modelManager;
-	SpriteManager_Ptr spriteManager;
 	ObjectManager_Ptr objectManager;
 
 	// Load the level data.
 	PolygonsSection::load(is, "Polygons", polygons);
 	tree = TreeSection::load(is);
 	PolygonsSection::load(is, "Portals", portals);
-	leafVis = VisSection::load(is);
-	std::vector<Image24_Ptr> lightmaps = LightmapsSection::load(is);
+	leafVis = VisSection::load_compressed(is);
+	std::vector<int> lightmapIndices;
+	std::vector<Image24_Ptr> lightmaps = LightmapsSection::load(is, lightmapIndices);
 	PolygonsSection::load(is, "OnionPolygons", onionPolygons);
 	onionTree = OnionTreeSection::load(is);
 	PolygonsSection::load(is, "OnionPortals", onionPortals);
 	navManager = NavSection::load(is);
-	definitionsFilename = DefinitionsSpecifierSection::load(is);
+	objectManager = load_objects(is);
+
+	// Construct and return the level.
+	GeometryRenderer_Ptr geomRenderer(new LitGeometryRenderer(polygons, lightmaps, lightmapIndices));
+	DynamicLightManager_Ptr dynamicLightManager(new DynamicLightManager(polygons, tree, leafVis));
+	return Level_Ptr(new Level(geomRenderer, tree, portals, leafVis, onionPolygons, onionTree, onionPortals, navManager, objectManager, dynamicLightManager));
+}
+
+/**
+Loads the definitions specifier, model names, sprite names and objects sections of a level,
+together with the definitions file to which the level refers.
+
+@param is	The std::istream
+@return		The object manager containing the objects for the level
+*/
+ObjectManager_Ptr LevelFile::load_objects(std::istream& is)
+{
+	std::string definitionsFilename = DefinitionsSpecifierSection::load(is);
 
 	bf::path settingsDir = determine_settings_directory();
 	BoundsManager_Ptr boundsManager;
@@ -177,17 +346,13 @@ Level_Ptr LevelFile::load_lit(std::istream& is)
 	std::map<std::string,ObjectSpecification> archetypes;
 	DefinitionsFile::load((settingsDir / definitionsFilename).file_string(), boundsManager, componentPropertyTypes, archetypes);
 
-	modelManager = ModelNamesSection().load(is);
+	ModelManager_Ptr modelManager = ModelNamesSection().load(is);
 	modelManager->load_all();
 
-	spriteManager = SpriteNamesSection().load(is);
+	SpriteManager_Ptr spriteManager = SpriteNamesSection().load(is);
 	spriteManager->load_all();
 
-	objectManager = ObjectsSection::load(is, boundsManager, componentPropertyTypes, archetypes, modelManager, spriteManager);
-
-	// Construct and return the level.
-	GeometryRenderer_Ptr geomRenderer(new LitGeometryRenderer(polygons, lightmaps));
-	return Level_Ptr(new Level(geomRenderer, tree, portals, leafVis, onionPolygons, onionTree, onionPortals, navManager, objectManager));
+	return ObjectsSection::load(is, boundsManager, componentPropertyTypes, archetypes, modelManager, spriteManager);
 }
 
 /**
@@ -201,44 +366,177 @@ Level_Ptr LevelFile::load_unlit(std::istream& is)
 	std::vector<TexturedPolygon_Ptr> polygons;
 	BSPTree_Ptr tree;
 	std::vector<Portal_Ptr> portals;
-	LeafVisTable_Ptr leafVis;
+	CompressedLeafVisTable_Ptr leafVis;
 	std::vector<CollisionPolygon_Ptr> onionPolygons;
 	OnionTree_Ptr onionTree;
 	std::vector<OnionPortal_Ptr> onionPortals;
 	NavManager_Ptr navManager;
-	std::string definitionsFilename;
-	ModelManager_Ptr modelManager;
-	SpriteManager_Ptr spriteManager;
 	ObjectManager_Ptr objectManager;
 
 	// Load the level data.
 	PolygonsSection::load(is, "Polygons", polygons);
 	tree = TreeSection::load(is);
 	PolygonsSection::load(is, "Portals", portals);
-	leafVis = VisSection::load(is);
+	leafVis = VisSection::load_compressed(is);
 	PolygonsSection::load(is, "OnionPolygons", onionPolygons);
 	onionTree = OnionTreeSection::load(is);
 	PolygonsSection::load(is, "OnionPortals", onionPortals);
 	navManager = NavSection::load(is);
-	definitionsFilename = DefinitionsSpecifierSection::load(is);
+	objectManager = load_objects(is);
 
-	bf::path settingsDir = determine_settings_directory();
-	BoundsManager_Ptr boundsManager;
-	ComponentPropertyTypeMap componentPropertyTypes;
-	std::map<std::string,ObjectSpecification> archetypes;
-	DefinitionsFile::load((settingsDir / definitionsFilename).file_string(), boundsManager, componentPropertyTypes, archetypes);
+	// Construct and return the level.
+	GeometryRenderer_Ptr geomRenderer(new UnlitGeometryRenderer(polygons));
+	DynamicLightManager_Ptr dynamicLightManager(new DynamicLightManager(polygons, tree, leafVis));
+	return Level_Ptr(new Level(geomRenderer, tree, portals, leafVis, onionPolygons, onionTree, onionPortals, navManager, objectManager, dynamicLightManager));
+}
 
-	modelManager = ModelNamesSection().load(is);
-	modelManager->load_all();
+//#################### SAVING SUPPORT METHODS ####################
+/**
+Converts the remainder of a text level file (everything after the file type) to a binary level file.
 
-	spriteManager = SpriteNamesSection().load(is);
-	spriteManager->load_all();
+@param is				The std::istream from which to read the text level file
+@param lit				Whether or not the level is lit
+@param outputFilename	The name of the binary level file to write
+*/
+template <typename Poly>
+void LevelFile::convert_to_binary_sub(std::istream& is, bool lit, const std::string& outputFilename)
+{
+	std::vector<shared_ptr<Poly> > polygons;
+	std::vector<Portal_Ptr> portals;
+	std::vector<Image24_Ptr> lightmaps;
+	std::vector<int> lightmapIndices;
+	std::vector<CollisionPolygon_Ptr> onionPolygons;
+	std::vector<OnionPortal_Ptr> onionPortals;
 
-	objectManager = ObjectsSection::load(is, boundsManager, componentPropertyTypes, archetypes, modelManager, spriteManager);
+	PolygonsSection::load(is, "Polygons", polygons);
+	BSPTree_Ptr tree = TreeSection::load(is);
+	PolygonsSection::load(is, "Portals", portals);
+	CompressedLeafVisTable_Ptr leafVis = VisSection::load_compressed(is);
+	if(lit) lightmaps = LightmapsSection::load(is, lightmapIndices);
+	PolygonsSection::load(is, "OnionPolygons", onionPolygons);
+	OnionTree_Ptr onionTree = OnionTreeSection::load(is);
+	PolygonsSection::load(is, "OnionPortals", onionPortals);
+	NavManager_Ptr navManager = NavSection::load(is);
 
-	// Construct and return the level.
-	GeometryRenderer_Ptr geomRenderer(new UnlitGeometryRenderer(polygons));
-	return Level_Ptr(new Level(geomRenderer, tree, portals, leafVis, onionPolygons, onionTree, onionPortals, navManager, objectManager));
+	// The remaining sections (the definitions specifier, model and sprite names, and objects)
+	// are stored in the same form in both kinds of level file, so they can be copied as is.
+	std::string objectsData((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+
+	save_binary(outputFilename, polygons, tree, portals, leafVis, lit ? &lightmaps : NULL, lit ? &lightmapIndices : NULL,
+				onionPolygons, onionTree, onionPortals, navManager, objectsData);
+}
+
+/**
+Saves a level to the specified file in binary form.
+
+@param filename			The name of the output file
+@param polygons			The level polygons
+@param tree				The BSP tree for the level
+@param portals			The portals for the level
+@param leafVis			The (compressed) leaf visibility table for the level
+@param lightmaps		The lightmaps for the level (NULL for an unlit level)
+@param lightmapIndices	The index of the lightmap for each level polygon (NULL for an unlit level)
+@param onionPolygons	The polygons for the onion tree
+@param onionTree		The onion tree for the level
+@param onionPortals		The onion portals for the level
+@param navManager		The navigation manager containing the navigation datasets for the level
+@param objectsData		The definitions specifier, model names, sprite names and objects sections for the level (in text form)
+*/
+template <typename Poly>
+void LevelFile::save_binary(const std::string& filename,
+							const std::vector<shared_ptr<Poly> >& polygons, const BSPTree_CPtr& tree,
+							const std::vector<Portal_Ptr>& portals,
+							const CompressedLeafVisTable_CPtr& leafVis,
+							const std::vector<Image24_Ptr> *lightmaps, const std::vector<int> *lightmapIndices,
+							const std::vector<CollisionPolygon_Ptr>& onionPolygons, const OnionTree_CPtr& onionTree,
+							const std::vector<OnionPortal_Ptr>& onionPortals,
+							const NavManager_CPtr& navManager,
+							const std::string& objectsData)
+{
+	// Write each section into a separate block.
+	typedef std::vector<std::pair<std::string,BinaryWriter> > Sections;
+	Sections sections;
+	sections.push_back(std::make_pair("Polygons", BinaryWriter()));
+	PolygonsSection::save_binary(sections.back().second, polygons);
+	sections.push_back(std::make_pair("BSPTree", BinaryWriter()));
+	TreeSection::save_binary(sections.back().second, tree);
+	sections.push_back(std::make_pair("Portals", BinaryWriter()));
+	PolygonsSection::save_binary(sections.back().second, portals);
+	sections.push_back(std::make_pair("Vis", BinaryWriter()));
+	VisSection::save_binary(sections.back().second, leafVis);
+	if(lightmaps)
+	{
+		// Note:	Binary levels are built for fast loading, so their lightmaps are palettised rather than stored as PNGs.
+		std::ostringstream lightmapsData;
+		LightmapsSection::save(lightmapsData, *lightmaps, *lightmapIndices, LightmapsSection::ENCODING_PALETTE);
+		sections.push_back(std::make_pair("Lightmaps", BinaryWriter()));
+		sections.back().second.write_string(lightmapsData.str());
+	}
+	sections.push_back(std::make_pair("OnionPolygons", BinaryWriter()));
+	PolygonsSection::save_binary(sections.back().second, onionPolygons);
+	sections.push_back(std::make_pair("OnionTree", BinaryWriter()));
+	OnionTreeSection::save_binary(sections.back().second, onionTree);
+	sections.push_back(std::make_pair("OnionPortals", BinaryWriter()));
+	PolygonsSection::save_binary(sections.back().second, onionPortals);
+	sections.push_back(std::make_pair("Nav", BinaryWriter()));
+	NavSection::save_binary(sections.back().second, navManager);
+	sections.push_back(std::make_pair("Objects", BinaryWriter()));
+	sections.back().second.write_string(objectsData);
+
+	// Write the header and table of contents, followed by the sections themselves (each aligned so that its arrays can be used in place).
+	BinaryWriter header;
+	int sectionCount = static_cast<int>(sections.size());
+	header.write_array("HBSPB\n\0", 8);
+	header.write(static_cast<boost::uint32_t>(BINARY_BYTE_ORDER_MARK));
+	header.write(static_cast<boost::uint32_t>(BINARY_VERSION));
+	header.write(sectionCount);
+	header.write(static_cast<boost::uint32_t>(0));
+
+	const boost::uint64_t tocSize = sectionCount * (BINARY_SECTION_NAME_LENGTH + 2 * sizeof(boost::uint64_t));
+	boost::uint64_t offset = header.data().length() + tocSize;
+	for(int i=0; i<sectionCount; ++i)
+	{
+		offset = (offset + BinaryReader::ALIGNMENT - 1) / BinaryReader::ALIGNMENT * BinaryReader::ALIGNMENT;
+
+		char name[BINARY_SECTION_NAME_LENGTH] = {0};
+		sections[i].first.copy(name, BINARY_SECTION_NAME_LENGTH - 1);
+		header.write_array(name, BINARY_SECTION_NAME_LENGTH);
+		header.write(offset);
+		header.write(static_cast<boost::uint64_t>(sections[i].second.data().length()));
+
+		offset += sections[i].second.data().length();
+	}
+
+	std::ofstream os(filename.c_str(), std::ios_base::binary);
+	if(os.fail()) throw Exception("Could not open " + filename + " for writing");
+
+	os.write(header.data().data(), header.data().length());
+	boost::uint64_t written = header.data().length();
+	for(int i=0; i<sectionCount; ++i)
+	{
+		for(; written % BinaryReader::ALIGNMENT != 0; ++written) os.put('\0');
+
+		const std::string& data = sections[i].second.data();
+		os.write(data.data(), data.length());
+		written += data.length();
+	}
+
+	if(os.fail()) throw Exception("Could not write to " + filename);
+}
+
+/**
+Saves the definitions specifier, model names, sprite names and objects sections of a level.
+
+@param os					The std::ostream
+@param definitionsFilename	The name of the definitions file for the level
+@param objectManager		The object manager containing the objects for the level
+*/
+void LevelFile::save_objects(std::ostream& os, const std::string& definitionsFilename, const ObjectManager_Ptr& objectManager)
+{
+	DefinitionsSpecifierSection::save(os, definitionsFilename);
+	ModelNamesSection().save(os, objectManager->model_manager());
+	SpriteNamesSection().save(os, objectManager->sprite_manager());
+	ObjectsSection::save(os, objectManager);
 }
 
 }
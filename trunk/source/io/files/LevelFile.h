@@ -6,29 +6,57 @@
 #ifndef H_HESP_LEVELFILE
 #define H_HESP_LEVELFILE
 
+#include <iosfwd>
+#include <map>
+#include <string>
+
 #include <source/images/Image.h>
 #include <source/level/Level.h>
 
 namespace hesp {
 
+//#################### FORWARD DECLARATIONS ####################
+class BinaryReader;
+
+/**
+This class loads and saves level files. Levels can be stored either in text form
+("HBSPL" for lit levels, "HBSPU" for unlit ones) or in binary form ("HBSPB").
+
+A binary level file consists of a fixed-size header, a table of contents giving the
+name, offset and size of each section, and then the sections themselves. The bulky
+sections (polygons, trees, portals, vis table and nav data) are stored as flat,
+aligned arrays that are read directly from a memory mapping of the file; the small
+ones (lightmaps and objects) are stored in the same form as in text level files.
+*/
 class LevelFile
 {
+	//#################### CONSTANTS ####################
+private:
+	enum
+	{
+		BINARY_BYTE_ORDER_MARK = 0x01020304,
+		BINARY_SECTION_NAME_LENGTH = 24,
+		BINARY_VERSION = 3
+	};
+
 	//#################### LOADING METHODS ####################
 public:
 	static Level_Ptr load(const std::string& filename);
 
 	//#################### SAVING METHODS ####################
 public:
+	static void convert_to_binary(const std::string& inputFilename, const std::string& outputFilename);
 	static void save_lit(const std::string& filename,
 						 const std::vector<TexturedLitPolygon_Ptr>& polygons, const BSPTree_CPtr& tree,
 						 const std::vector<Portal_Ptr>& portals,
 						 const LeafVisTable_CPtr& leafVis,
-						 const std::vector<Image24_Ptr>& lightmaps,
+						 const std::vector<Image24_Ptr>& lightmaps, const std::vector<int>& lightmapIndices,
 						 const std::vector<CollisionPolygon_Ptr>& onionPolygons, const OnionTree_CPtr& onionTree,
 						 const std::vector<OnionPortal_Ptr>& onionPortals,
 						 const NavManager_CPtr& navManager,
 						 const std::string& definitionsFilename,
-						 const ObjectManager_Ptr& objectManager);
+						 const ObjectManager_Ptr& objectManager,
+						 bool binary = false);
 	static void save_unlit(const std::string& filename,
 						   const std::vector<TexturedPolygon_Ptr>& polygons, const BSPTree_CPtr& tree,
 						   const std::vector<Portal_Ptr>& portals,
@@ -37,12 +65,31 @@ public:
 						   const std::vector<OnionPortal_Ptr>& onionPortals,
 						   const NavManager_CPtr& navManager,
 						   const std::string& definitionsFilename,
-						   const ObjectManager_Ptr& objectManager);
+						   const ObjectManager_Ptr& objectManager,
+						   bool binary = false);
 
 	//#################### LOADING SUPPORT METHODS ####################
 private:
+	static BinaryReader& binary_section(std::map<std::string,BinaryReader>& sections, const std::string& name);
+	static Level_Ptr load_binary(const std::string& filename);
 	static Level_Ptr load_lit(std::istream& is);
+	static ObjectManager_Ptr load_objects(std::istream& is);
 	static Level_Ptr load_unlit(std::istream& is);
+
+	//#################### SAVING SUPPORT METHODS ####################
+private:
+	template <typename Poly> static void convert_to_binary_sub(std::istream& is, bool lit, const std::string& outputFilename);
+	template <typename Poly>
+	static void save_binary(const std::string& filename,
+							const std::vector<shared_ptr<Poly> >& polygons, const BSPTree_CPtr& tree,
+							const std::vector<Portal_Ptr>& portals,
+							const CompressedLeafVisTable_CPtr& leafVis,
+							const std::vector<Image24_Ptr> *lightmaps, const std::vector<int> *lightmapIndices,
+							const std::vector<CollisionPolygon_Ptr>& onionPolygons, const OnionTree_CPtr& onionTree,
+							const std::vector<OnionPortal_Ptr>& onionPortals,
+							const NavManager_CPtr& navManager,
+							const std::string& objectsData);
+	static void save_objects(std::ostream& os, const std::string& definitionsFilename, const ObjectManager_Ptr& objectManager);
 };
 
 }
@@ -0,0 +1,118 @@
+/***
+ * hesperus: LightmapCacheFile.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "LightmapCacheFile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <source/exceptions/Exception.h>
+#include <source/io/util/BinaryIO.h>
+#include <source/level/lighting/Lightmap.h>
+
+namespace hesp {
+
+//#################### LOADING METHODS ####################
+/**
+Loads the light contributions from the specified lightmap cache file.
+
+@param filename		The name of the file
+@param key			The key under which the contributions are expected to have been cached
+@return				The contributions
+@throws Exception	If the file cannot be read, is not a valid lightmap cache file or was cached under a different key
+*/
+LightmapCacheFile::Contributions LightmapCacheFile::load(const std::string& filename, boost::uint64_t key)
+{
+	std::ifstream is(filename.c_str(), std::ios_base::binary);
+	if(is.fail()) throw Exception("Could not open " + filename + " for reading");
+	std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+
+	BinaryReader reader(data.data(), data.data() + data.length(), filename);
+	if(std::memcmp(reader.read_array<char>(8), "HLMC\n\0\0\0", 8) != 0) throw Exception(filename + " is not a valid lightmap cache file");
+	if(reader.read<boost::uint32_t>() != VERSION) throw Exception(filename + " has an unsupported lightmap cache file version");
+	reader.read<boost::uint32_t>();
+	if(reader.read<boost::uint64_t>() != key) throw Exception(filename + " was cached under a different key");
+
+	int contributionCount = reader.read<int>();
+	if(contributionCount < 0) throw Exception("Negative contribution count in " + filename);
+
+	Contributions contributions;
+	contributions.reserve(contributionCount);
+	for(int i=0; i<contributionCount; ++i)
+	{
+		int polyIndex = reader.read<int>();
+		int rows = reader.read<int>();
+		int cols = reader.read<int>();
+		if(rows <= 0 || cols <= 0) throw Exception("Bad lightmap dimensions in " + filename);
+
+		const double *values = reader.read_array<double>(rows * cols * 3);
+		Lightmap_Ptr lightmap(new Lightmap(rows, cols));
+		for(int r=0; r<rows; ++r)
+		{
+			for(int c=0; c<cols; ++c, values += 3)
+			{
+				(*lightmap)(r,c) = Colour3d(values[0], values[1], values[2]);
+			}
+		}
+
+		contributions.push_back(std::make_pair(polyIndex, lightmap));
+	}
+
+	if(!reader.at_end()) throw Exception("Unexpected trailing data in " + filename);
+	return contributions;
+}
+
+//#################### SAVING METHODS ####################
+/**
+Saves light contributions to the specified lightmap cache file.
+
+@param filename			The name of the file
+@param key				The key under which to cache the contributions
+@param contributions	The contributions
+@throws Exception		If the file cannot be written
+*/
+void LightmapCacheFile::save(const std::string& filename, boost::uint64_t key, const Contributions& contributions)
+{
+	BinaryWriter writer;
+	writer.write_array("HLMC\n\0\0\0", 8);
+	writer.write(static_cast<boost::uint32_t>(VERSION));
+	writer.write(static_cast<boost::uint32_t>(0));
+	writer.write(key);
+
+	int contributionCount = static_cast<int>(contributions.size());
+	writer.write(contributionCount);
+
+	std::vector<double> values;
+	for(int i=0; i<contributionCount; ++i)
+	{
+		const Lightmap& lightmap = *contributions[i].second;
+		int rows = lightmap.rows(), cols = lightmap.cols();
+		writer.write(contributions[i].first);
+		writer.write(rows);
+		writer.write(cols);
+
+		values.clear();
+		values.reserve(rows * cols * 3);
+		for(int r=0; r<rows; ++r)
+		{
+			for(int c=0; c<cols; ++c)
+			{
+				const Colour3d& colour = lightmap(r,c);
+				values.push_back(colour.r);
+				values.push_back(colour.g);
+				values.push_back(colour.b);
+			}
+		}
+		writer.write_array(values);
+	}
+
+	std::ofstream os(filename.c_str(), std::ios_base::binary);
+	if(os.fail()) throw Exception("Could not open " + filename + " for writing");
+	os.write(writer.data().data(), writer.data().length());
+	if(os.fail()) throw Exception("Could not write to " + filename);
+}
+
+}
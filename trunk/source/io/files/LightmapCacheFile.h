@@ -0,0 +1,48 @@
+/***
+ * hesperus: LightmapCacheFile.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_LIGHTMAPCACHEFILE
+#define H_HESP_LIGHTMAPCACHEFILE
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+
+namespace hesp {
+
+//#################### FORWARD DECLARATIONS ####################
+typedef shared_ptr<class Lightmap> Lightmap_Ptr;
+
+/**
+This struct loads and saves lightmap cache files. A lightmap cache file holds the
+contribution made by a single light to each of the polygons it lights, stored as
+(polygon index, lightmap) pairs, together with the key under which it was cached.
+The lumels are stored at full precision, in the native byte order of the machine.
+*/
+struct LightmapCacheFile
+{
+	//#################### TYPEDEFS ####################
+	typedef std::vector<std::pair<int,Lightmap_Ptr> > Contributions;
+
+	//#################### CONSTANTS ####################
+	enum
+	{
+		VERSION = 1
+	};
+
+	//#################### LOADING METHODS ####################
+	static Contributions load(const std::string& filename, boost::uint64_t key);
+
+	//#################### SAVING METHODS ####################
+	static void save(const std::string& filename, boost::uint64_t key, const Contributions& contributions);
+};
+
+}
+
+#endif
@@ -14,11 +14,11 @@ struct LitTreeFile
 {
 	//#################### LOADING METHODS ####################
 	template <typename Poly> static void load(const std::string& filename, std::vector<shared_ptr<Poly> >& polygons,
-											  BSPTree_Ptr& tree, std::string& lightmapPrefix);
+											  BSPTree_Ptr& tree, std::string& lightmapPrefix, std::vector<int>& lightmapIndices);
 
 	//#################### SAVING METHODS ####################
 	template <typename Poly> static void save(const std::string& filename, const std::vector<shared_ptr<Poly> >& polygons,
-											  const BSPTree_CPtr& tree, const std::string& lightmapPrefix);
+											  const BSPTree_CPtr& tree, const std::string& lightmapPrefix, const std::vector<int>& lightmapIndices);
 };
 
 }
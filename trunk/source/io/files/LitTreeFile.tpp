@@ -13,44 +13,56 @@ namespace hesp {
 
 //#################### LOADING METHODS ####################
 /**
-Loads the polygons, tree and lightmap prefix from the specified lit tree file.
+Loads the polygons, tree, lightmap prefix and lightmap indices from the specified lit tree file.
 
 @param filename			The name of the lit tree file
 @param polygons			Used to return the polygons to the caller
 @param tree				Used to return the tree to the caller
 @param lightmapPrefix	Used to return the lightmap prefix to the caller
+@param lightmapIndices	Used to return the index of the lightmap (atlas page) for each polygon to the caller
+@throws Exception		If the file could not be read or the number of lightmap indices is wrong
 */
 template <typename Poly>
 void LitTreeFile::load(const std::string& filename, std::vector<shared_ptr<Poly> >& polygons, BSPTree_Ptr& tree,
-					   std::string& lightmapPrefix)
+					   std::string& lightmapPrefix, std::vector<int>& lightmapIndices)
 {
 	std::ifstream is(filename.c_str());
 	if(is.fail()) throw Exception("Could not open " + filename + " for reading");
 
 	PolygonsSection::load(is, "Polygons", polygons);
 	tree = TreeSection::load(is);
-	lightmapPrefix = LightmapPrefixSection::load(is);
+	lightmapPrefix = LightmapPrefixSection::load(is, lightmapIndices);
+
+	// Files written before lightmaps were packed into atlases have one lightmap per polygon.
+	int polyCount = static_cast<int>(polygons.size());
+	if(lightmapIndices.empty())
+	{
+		lightmapIndices.resize(polyCount);
+		for(int i=0; i<polyCount; ++i) lightmapIndices[i] = i;
+	}
+	else if(static_cast<int>(lightmapIndices.size()) != polyCount) throw Exception("The number of lightmap indices in " + filename + " does not match the number of polygons");
 }
 
 //#################### SAVING METHODS ####################
 /**
-Saves the polygons, tree and lightmap prefix to the specified lit tree file.
+Saves the polygons, tree, lightmap prefix and lightmap indices to the specified lit tree file.
 
 @param filename			The name of the lit tree file
 @param polygons			The polygons
 @param tree				The tree
 @param lightmapPrefix	The lightmap prefix
+@param lightmapIndices	The index of the lightmap (atlas page) for each polygon
 */
 template <typename Poly>
 void LitTreeFile::save(const std::string& filename, const std::vector<shared_ptr<Poly> >& polygons,
-					   const BSPTree_CPtr& tree, const std::string& lightmapPrefix)
+					   const BSPTree_CPtr& tree, const std::string& lightmapPrefix, const std::vector<int>& lightmapIndices)
 {
 	std::ofstream os(filename.c_str());
 	if(os.fail()) throw Exception("Could not open " + filename + " for writing");
 
 	PolygonsSection::save(os, "Polygons", polygons);
 	TreeSection::save(os, tree);
-	LightmapPrefixSection::save(os, lightmapPrefix);
+	LightmapPrefixSection::save(os, lightmapPrefix, lightmapIndices);
 }
 
 }
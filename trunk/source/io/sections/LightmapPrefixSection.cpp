@@ -6,41 +6,57 @@
 #include "LightmapPrefixSection.h"
 
 #include <source/io/util/LineIO.h>
+#include "LightmapsSection.h"
 
 namespace hesp {
 
 //#################### LOADING METHODS ####################
 /**
-Loads a lightmap prefix from the specified std::istream.
-
-@param is			The std::istream
-@return				The lightmap prefix
-@throws Exception	If EOF is encountered whilst trying to read the lightmap prefix
+Loads a lightmap prefix from the specified std::istream, together with the index of the
+lightmap (atlas page) used by each polygon. Sections written before lightmaps were packed
+into atlases have no index line, in which case the returned list of indices is empty and
+polygon i should be assumed to use lightmap i.
+
+@param is				The std::istream
+@param lightmapIndices	Used to return the index of the lightmap for each polygon to the caller
+@return					The lightmap prefix
+@throws Exception		If EOF is encountered whilst trying to read the lightmap prefix
 */
-std::string LightmapPrefixSection::load(std::istream& is)
+std::string LightmapPrefixSection::load(std::istream& is, std::vector<int>& lightmapIndices)
 {
 	std::string lightmapPrefix;
 
 	LineIO::read_checked_line(is, "LightmapPrefix");
 	LineIO::read_checked_line(is, "{");
 	LineIO::read_line(is, lightmapPrefix, "lightmap prefix");
-	LineIO::read_checked_line(is, "}");
+
+	std::string line;
+	LineIO::read_line(is, line, "lightmap indices");
+	if(line == "}") lightmapIndices.clear();
+	else
+	{
+		lightmapIndices = LightmapsSection::load_lightmap_indices(line);
+		LineIO::read_checked_line(is, "}");
+	}
 
 	return lightmapPrefix;
 }
 
 //#################### SAVING METHODS ####################
 /**
-Saves a lightmap prefix to the specified std::ostream.
+Saves a lightmap prefix to the specified std::ostream, together with the index of the
+lightmap (atlas page) used by each polygon.
 
-@param os	The std::ostream
-@param		The lightmap prefix
+@param os				The std::ostream
+@param lightmapPrefix	The lightmap prefix
+@param lightmapIndices	The index of the lightmap for each polygon
 */
-void LightmapPrefixSection::save(std::ostream& os, const std::string& lightmapPrefix)
+void LightmapPrefixSection::save(std::ostream& os, const std::string& lightmapPrefix, const std::vector<int>& lightmapIndices)
 {
 	os << "LightmapPrefix\n";
 	os << "{\n";
 	os << lightmapPrefix << '\n';
+	LightmapsSection::save_lightmap_indices(os, lightmapIndices);
 	os << "}\n";
 }
 
@@ -8,16 +8,17 @@
 
 #include <iosfwd>
 #include <string>
+#include <vector>
 
 namespace hesp {
 
 struct LightmapPrefixSection
 {
 	//#################### LOADING METHODS ####################
-	static std::string load(std::istream& is);
+	static std::string load(std::istream& is, std::vector<int>& lightmapIndices);
 
 	//#################### SAVING METHODS ####################
-	static void save(std::ostream& os, const std::string& lightmapPrefix);
+	static void save(std::ostream& os, const std::string& lightmapPrefix, const std::vector<int>& lightmapIndices);
 };
 
 }
@@ -6,10 +6,13 @@
 #include "LightmapsSection.h"
 
 #include <boost/lexical_cast.hpp>
+#include <boost/tokenizer.hpp>
 using boost::bad_lexical_cast;
 using boost::lexical_cast;
 
 #include <source/exceptions/Exception.h>
+#include <source/images/PalettedImageLoader.h>
+#include <source/images/PalettedImageSaver.h>
 #include <source/images/PNGLoader.h>
 #include <source/images/PNGSaver.h>
 #include <source/io/util/LineIO.h>
@@ -18,13 +21,18 @@ namespace hesp {
 
 //#################### LOADING METHODS ####################
 /**
-Loads an array of lightmaps from the specified std::istream.
-
-@param is			The std::istream
-@return				The lightmaps
-@throws Exception	If EOF is encountered whilst trying to read the lightmaps
+Loads an array of lightmaps from the specified std::istream, together with the index
+of the lightmap used by each polygon. (Lightmaps sections written before lightmaps
+were packed into atlases contain one lightmap per polygon and no index line: in that
+case, polygon i uses lightmap i.) The lightmaps may be encoded either as PNGs or as
+palettised images: the latter is marked by a "Palette" line before the lightmap count.
+
+@param is				The std::istream
+@param lightmapIndices	Used to return the index of the lightmap for each polygon to the caller
+@return					The lightmaps
+@throws Exception		If EOF is encountered whilst trying to read the lightmaps
 */
-std::vector<Image24_Ptr> LightmapsSection::load(std::istream& is)
+std::vector<Image24_Ptr> LightmapsSection::load(std::istream& is, std::vector<int>& lightmapIndices)
 {
 	std::vector<Image24_Ptr> lightmaps;
 
@@ -33,6 +41,13 @@ std::vector<Image24_Ptr> LightmapsSection::load(std::istream& is)
 
 	std::string line;
 	LineIO::read_line(is, line, "lightmap count");
+	Encoding encoding = ENCODING_PNG;
+	if(line == "Palette")
+	{
+		encoding = ENCODING_PALETTE;
+		LineIO::read_line(is, line, "lightmap count");
+	}
+
 	int lightmapCount;
 	try							{ lightmapCount = lexical_cast<int,std::string>(line); }
 	catch(bad_lexical_cast&)	{ throw Exception("The lightmap count was not an integer"); }
@@ -40,37 +55,107 @@ std::vector<Image24_Ptr> LightmapsSection::load(std::istream& is)
 	lightmaps.resize(lightmapCount);
 	for(int i=0; i<lightmapCount; ++i)
 	{
-		lightmaps[i] = PNGLoader::load_streamed_image24(is);
+		switch(encoding)
+		{
+			case ENCODING_PALETTE:	lightmaps[i] = PalettedImageLoader::load_streamed_image24(is); break;
+			case ENCODING_PNG:		lightmaps[i] = PNGLoader::load_streamed_image24(is); break;
+		}
 	}
 
 	if(is.get() != '\n') throw Exception("Expected newline after lightmaps");
 
-	LineIO::read_checked_line(is, "}");
+	LineIO::read_line(is, line, "lightmap indices");
+	if(line == "}")
+	{
+		lightmapIndices.resize(lightmapCount);
+		for(int i=0; i<lightmapCount; ++i) lightmapIndices[i] = i;
+	}
+	else
+	{
+		lightmapIndices = load_lightmap_indices(line);
+		LineIO::read_checked_line(is, "}");
+	}
+
+	int indexCount = static_cast<int>(lightmapIndices.size());
+	for(int i=0; i<indexCount; ++i)
+	{
+		if(lightmapIndices[i] < 0 || lightmapIndices[i] >= lightmapCount) throw Exception("Bad lightmap index for polygon " + lexical_cast<std::string,int>(i));
+	}
 
 	return lightmaps;
 }
 
+/**
+Parses a line containing a space-separated list of lightmap indices.
+
+@param line			The line
+@return				The lightmap indices
+@throws Exception	If any of the indices is not an integer
+*/
+std::vector<int> LightmapsSection::load_lightmap_indices(const std::string& line)
+{
+	typedef boost::char_separator<char> sep;
+	typedef boost::tokenizer<sep> tokenizer;
+	tokenizer tok(line.begin(), line.end(), sep(" "));
+
+	std::vector<int> lightmapIndices;
+	for(tokenizer::const_iterator it=tok.begin(), iend=tok.end(); it!=iend; ++it)
+	{
+		try							{ lightmapIndices.push_back(lexical_cast<int,std::string>(*it)); }
+		catch(bad_lexical_cast&)	{ throw Exception("The lightmap index " + *it + " was not an integer"); }
+	}
+	return lightmapIndices;
+}
+
 //#################### SAVING METHODS ####################
 /**
-Saves an array of lightmaps to the specified std::ostream.
+Saves an array of lightmaps to the specified std::ostream, together with the index
+of the lightmap used by each polygon.
 
-@param os			The std::ostream
-@param lightmaps	The lightmaps
+@param os				The std::ostream
+@param lightmaps		The lightmaps
+@param lightmapIndices	The index of the lightmap for each polygon
+@param encoding			The format in which to encode the lightmaps
 */
-void LightmapsSection::save(std::ostream& os, const std::vector<Image24_Ptr>& lightmaps)
+void LightmapsSection::save(std::ostream& os, const std::vector<Image24_Ptr>& lightmaps, const std::vector<int>& lightmapIndices,
+							Encoding encoding)
 {
 	os << "Lightmaps\n";
 	os << "{\n";
+	if(encoding == ENCODING_PALETTE) os << "Palette\n";
 
 	int lightmapCount = static_cast<int>(lightmaps.size());
 	os << lightmapCount << '\n';
 
 	for(int i=0; i<lightmapCount; ++i)
 	{
-		PNGSaver::save_streamed_image24(os, lightmaps[i]);
+		switch(encoding)
+		{
+			case ENCODING_PALETTE:	PalettedImageSaver::save_streamed_image24(os, lightmaps[i]); break;
+			case ENCODING_PNG:		PNGSaver::save_streamed_image24(os, lightmaps[i]); break;
+		}
 	}
 
-	os << "\n}\n";
+	os << '\n';
+	save_lightmap_indices(os, lightmapIndices);
+	os << "}\n";
+}
+
+/**
+Saves a list of lightmap indices to the specified std::ostream as a single space-separated line.
+
+@param os				The std::ostream
+@param lightmapIndices	The lightmap indices
+*/
+void LightmapsSection::save_lightmap_indices(std::ostream& os, const std::vector<int>& lightmapIndices)
+{
+	int indexCount = static_cast<int>(lightmapIndices.size());
+	for(int i=0; i<indexCount; ++i)
+	{
+		if(i != 0) os << ' ';
+		os << lightmapIndices[i];
+	}
+	os << '\n';
 }
 
 }
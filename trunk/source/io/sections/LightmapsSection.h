@@ -7,6 +7,7 @@
 #define H_HESP_LIGHTMAPSSECTION
 
 #include <iosfwd>
+#include <string>
 #include <vector>
 
 #include <source/images/Image.h>
@@ -15,11 +16,21 @@ namespace hesp {
 
 struct LightmapsSection
 {
+	//#################### ENUMERATIONS ####################
+	enum Encoding
+	{
+		ENCODING_PALETTE,	// each lightmap is stored as a run-length encoded palettised image (compact and fast to decode, but lossy for lightmaps with more than 256 colours)
+		ENCODING_PNG		// each lightmap is stored as a PNG stream (lossless, but slow to decode)
+	};
+
 	//#################### LOADING METHODS ####################
-	static std::vector<Image24_Ptr> load(std::istream& is);
+	static std::vector<Image24_Ptr> load(std::istream& is, std::vector<int>& lightmapIndices);
+	static std::vector<int> load_lightmap_indices(const std::string& line);
 
 	//#################### SAVING METHODS ####################
-	static void save(std::ostream& os, const std::vector<Image24_Ptr>& lightmaps);
+	static void save(std::ostream& os, const std::vector<Image24_Ptr>& lightmaps, const std::vector<int>& lightmapIndices,
+					 Encoding encoding = ENCODING_PNG);
+	static void save_lightmap_indices(std::ostream& os, const std::vector<int>& lightmapIndices);
 };
 
 }
@@ -5,16 +5,21 @@
 
 #include "NavSection.h"
 
+#include <algorithm>
+#include <sstream>
+
 #include <boost/lexical_cast.hpp>
 #include <boost/tokenizer.hpp>
 using boost::bad_lexical_cast;
 using boost::lexical_cast;
 
 #include <source/exceptions/Exception.h>
+#include <source/io/util/BinaryIO.h>
 #include <source/io/util/LineIO.h>
 #include <source/io/util/NavLinkFactory.h>
 #include <source/level/nav/AdjacencyList.h>
 #include <source/level/nav/NavDataset.h>
+#include <source/level/nav/NavLeafIndex.h>
 #include <source/level/nav/NavLink.h>
 #include <source/level/nav/NavManager.h>
 #include <source/level/nav/NavMesh.h>
@@ -56,11 +61,46 @@ NavManager_Ptr NavSection::load(std::istream& is)
 
 		NavMesh_Ptr navMesh = read_navmesh(is);
 		AdjacencyList_Ptr adjList = read_adjacency_list(is);
-		PathTable_Ptr pathTable = read_path_table(is);
+		PathTable_Ptr pathTable = read_path_table(is, *adjList);
+
+		// The leaf index is optional (older files don't have one).
+		LineIO::read_line(is, line, "nav leaf index or }");
+		if(line == "LeafIndex")
+		{
+			navMesh->set_leaf_index(read_leaf_index(is, static_cast<int>(navMesh->polygons().size())));
+			LineIO::read_checked_line(is, "}");
+		}
+		else if(line != "}") throw Exception("Expected LeafIndex or } but read: " + line);
 
 		navManager->set_dataset(index, NavDataset_Ptr(new NavDataset(adjList, navMesh, pathTable)));
+	}
+
+	return navManager;
+}
+
+/**
+Loads a set of navigation datasets from a binary level file (see save_binary for the format).
+
+@param reader		A reader for the section
+@return				The navigation datasets
+@throws Exception	If the section is malformed
+*/
+NavManager_Ptr NavSection::load_binary(BinaryReader& reader)
+{
+	NavManager_Ptr navManager(new NavManager);
 
-		LineIO::read_checked_line(is, "}");
+	int datasetCount = reader.read<int>();
+	for(int i=0; i<datasetCount; ++i)
+	{
+		int index = reader.read<int>();
+		if(index < 0) throw Exception("One of the dataset indices was < 0: " + lexical_cast<std::string,int>(index));
+
+		NavMesh_Ptr navMesh = read_binary_navmesh(reader);
+		AdjacencyList_Ptr adjList = read_binary_adjacency_list(reader);
+		PathTable_Ptr pathTable = read_binary_path_table(reader, *adjList);
+		if(reader.read<int>() != 0) navMesh->set_leaf_index(read_binary_leaf_index(reader, static_cast<int>(navMesh->polygons().size())));
+
+		navManager->set_dataset(index, NavDataset_Ptr(new NavDataset(adjList, navMesh, pathTable)));
 	}
 
 	return navManager;
@@ -88,6 +128,7 @@ void NavSection::save(std::ostream& os, const NavManager_CPtr& navManager)
 		write_navmesh(os, it->second->nav_mesh());
 		write_adjacency_list(os, it->second->adjacency_list());
 		write_path_table(os, it->second->path_table());
+		if(it->second->nav_mesh()->leaf_index()) write_leaf_index(os, it->second->nav_mesh()->leaf_index());
 
 		os << "}\n";
 	}
@@ -95,7 +136,88 @@ void NavSection::save(std::ostream& os, const NavManager_CPtr& navManager)
 	os << "}\n";
 }
 
+/**
+Saves a set of navigation datasets to a binary level file. For each dataset, the
+nav links are stored as strings (in the same format as in text files), and the nav
+polygons, adjacency list, path table and (optional) leaf index are stored as flat arrays.
+
+@param writer		The writer for the section
+@param navManager	The navigation manager containing the datasets
+*/
+void NavSection::save_binary(BinaryWriter& writer, const NavManager_CPtr& navManager)
+{
+	std::map<int,NavDataset_CPtr> datasets = navManager->datasets();
+	writer.write(static_cast<int>(datasets.size()));
+	for(std::map<int,NavDataset_CPtr>::const_iterator it=datasets.begin(), iend=datasets.end(); it!=iend; ++it)
+	{
+		writer.write(it->first);
+		write_binary_navmesh(writer, it->second->nav_mesh());
+		write_binary_adjacency_list(writer, it->second->adjacency_list());
+		write_binary_path_table(writer, it->second->path_table());
+
+		NavLeafIndex_CPtr leafIndex = it->second->nav_mesh()->leaf_index();
+		writer.write(leafIndex ? 1 : 0);
+		if(leafIndex) write_binary_leaf_index(writer, leafIndex);
+	}
+}
+
 //#################### LOADING SUPPORT METHODS ####################
+/**
+Checks that an array of start offsets (of size count+1) describes a valid set of
+consecutive ranges, starting at zero.
+
+@param starts		The start offsets
+@param count		The number of ranges
+@param description	A description of the ranges (used in error messages)
+@throws Exception	If the ranges are invalid
+*/
+void NavSection::check_ranges(const int *starts, int count, const std::string& description)
+{
+	if(starts[0] != 0) throw Exception("Bad " + description);
+	for(int i=0; i<count; ++i)
+	{
+		if(starts[i+1] < starts[i]) throw Exception("Bad " + description);
+	}
+}
+
+/**
+Constructs a nav leaf index from flat arrays (see write_binary_leaf_index for the layout).
+
+@throws Exception	If the arrays are inconsistent
+*/
+NavLeafIndex_Ptr NavSection::construct_leaf_index(int leafCount, const double *gridParams, const int *gridSizes, int cellCount, const int *cellStarts,
+												  const int *cellPolys, int navPolyCount, const double *polyBounds)
+{
+	std::vector<NavLeafIndex::LeafGrid> leafGrids(leafCount);
+	int gridCellCount = 0;
+	for(int i=0; i<leafCount; ++i)
+	{
+		if(gridSizes[i*2] < 0 || gridSizes[i*2+1] < 0) throw Exception("Bad nav leaf index grid size");
+
+		NavLeafIndex::LeafGrid& grid = leafGrids[i];
+		grid.minX = gridParams[i*3];
+		grid.minY = gridParams[i*3+1];
+		grid.cellSize = gridParams[i*3+2];
+		grid.width = gridSizes[i*2];
+		grid.height = gridSizes[i*2+1];
+		grid.firstCell = gridCellCount;
+		gridCellCount += grid.width * grid.height;
+	}
+	if(gridCellCount != cellCount) throw Exception("The nav leaf index cell count does not match the leaf grids");
+
+	std::vector<AABB3d> bounds;
+	bounds.reserve(navPolyCount);
+	for(int i=0; i<navPolyCount; ++i)
+	{
+		const double *b = polyBounds + i*6;
+		bounds.push_back(AABB3d(Vector3d(b[0], b[1], b[2]), Vector3d(b[3], b[4], b[5])));
+	}
+
+	// Note: The cell ranges have already been checked by the caller, and the rest is checked by NavLeafIndex.
+	return NavLeafIndex_Ptr(new NavLeafIndex(leafGrids, std::vector<int>(cellStarts, cellStarts + cellCount + 1),
+											 std::vector<int>(cellPolys, cellPolys + cellStarts[cellCount]), bounds));
+}
+
 /**
 Reads an adjacency list from the specified std::istream.
 */
@@ -160,6 +282,166 @@ AdjacencyList_Ptr NavSection::read_adjacency_list(std::istream& is)
 	return adjList;
 }
 
+/**
+Reads an adjacency list from a binary level file.
+*/
+AdjacencyList_Ptr NavSection::read_binary_adjacency_list(BinaryReader& reader)
+{
+	int size = reader.read<int>();
+	if(size < 0) throw Exception("Bad binary adjacency list size");
+
+	const int *edgeStarts = reader.read_array<int>(size + 1);
+	check_ranges(edgeStarts, size, "binary adjacency list");
+	const int *toNodes = reader.read_array<int>(edgeStarts[size]);
+	const float *lengths = reader.read_array<float>(edgeStarts[size]);
+
+	AdjacencyList_Ptr adjList(new AdjacencyList(size));
+	for(int i=0; i<size; ++i)
+	{
+		for(int j=edgeStarts[i]; j<edgeStarts[i+1]; ++j)
+		{
+			adjList->add_edge(i, AdjacencyList::Edge(toNodes[j], lengths[j]));
+		}
+	}
+
+	return adjList;
+}
+
+/**
+Reads a nav leaf index from a binary level file.
+*/
+NavLeafIndex_Ptr NavSection::read_binary_leaf_index(BinaryReader& reader, int navPolyCount)
+{
+	int leafCount = reader.read<int>();
+	if(leafCount < 0) throw Exception("Bad binary nav leaf index leaf count");
+	int cellCount = reader.read<int>();
+	if(cellCount < 0) throw Exception("Bad binary nav leaf index cell count");
+
+	const double *gridParams = reader.read_array<double>(leafCount * 3);
+	const int *gridSizes = reader.read_array<int>(leafCount * 2);
+	const int *cellStarts = reader.read_array<int>(cellCount + 1);
+	check_ranges(cellStarts, cellCount, "binary nav leaf index cells");
+	const int *cellPolys = reader.read_array<int>(cellStarts[cellCount]);
+	const double *polyBounds = reader.read_array<double>(navPolyCount * 6);
+
+	return construct_leaf_index(leafCount, gridParams, gridSizes, cellCount, cellStarts, cellPolys, navPolyCount, polyBounds);
+}
+
+/**
+Reads a navigation mesh from a binary level file.
+*/
+NavMesh_Ptr NavSection::read_binary_navmesh(BinaryReader& reader)
+{
+	// Read in the nav links.
+	NavLinkFactory navLinkFactory;
+
+	int linkCount = reader.read<int>();
+	if(linkCount < 0) throw Exception("Bad binary nav link count");
+
+	std::vector<NavLink_Ptr> navLinks;
+	navLinks.reserve(linkCount);
+	for(int i=0; i<linkCount; ++i)
+	{
+		navLinks.push_back(navLinkFactory.construct_navlink(reader.read_string()));
+	}
+
+	// Read in the nav polygons.
+	int polyCount = reader.read<int>();
+	if(polyCount < 0) throw Exception("Bad binary nav polygon count");
+
+	const int *colIndices = reader.read_array<int>(polyCount);
+	const int *inStarts = reader.read_array<int>(polyCount + 1);
+	check_ranges(inStarts, polyCount, "binary nav polygon in links");
+	const int *inLinks = reader.read_array<int>(inStarts[polyCount]);
+	const int *outStarts = reader.read_array<int>(polyCount + 1);
+	check_ranges(outStarts, polyCount, "binary nav polygon out links");
+	const int *outLinks = reader.read_array<int>(outStarts[polyCount]);
+
+	std::vector<NavPolygon_Ptr> navPolygons;
+	navPolygons.reserve(polyCount);
+	for(int i=0; i<polyCount; ++i)
+	{
+		NavPolygon_Ptr poly(new NavPolygon(colIndices[i]));
+		for(int j=inStarts[i]; j<inStarts[i+1]; ++j) poly->add_in_link(inLinks[j]);
+		for(int j=outStarts[i]; j<outStarts[i+1]; ++j) poly->add_out_link(outLinks[j]);
+		navPolygons.push_back(poly);
+	}
+
+	return NavMesh_Ptr(new NavMesh(navPolygons, navLinks));
+}
+
+/**
+Reads a (compressed) path table from a binary level file.
+*/
+PathTable_Ptr NavSection::read_binary_path_table(BinaryReader& reader, const AdjacencyList& adjList)
+{
+	int size = reader.read<int>();
+	if(size != adjList.size()) throw Exception("Bad binary path table size");
+	int rowCount = reader.read<int>();
+	if(rowCount < 0 || rowCount > std::max(size, 1)) throw Exception("Bad binary path table row count");
+
+	const int *rowIndices = reader.read_array<int>(size);
+	const float *costScales = reader.read_array<float>(rowCount);
+	const unsigned short *costCodes = reader.read_array<unsigned short>(rowCount * size);
+	const PathTable::NextHop *nextHops = reader.read_array<PathTable::NextHop>(rowCount * size);
+
+	std::vector<PathTable::Row> rows(rowCount);
+	for(int i=0; i<rowCount; ++i)
+	{
+		rows[i].costScale = costScales[i];
+		rows[i].costCodes.assign(costCodes + i*size, costCodes + (i+1)*size);
+		rows[i].nextHops.assign(nextHops + i*size, nextHops + (i+1)*size);
+	}
+
+	PathTable_Ptr pathTable(new PathTable(adjList));
+	pathTable->set_rows(rows, std::vector<int>(rowIndices, rowIndices + size));
+	return pathTable;
+}
+
+/**
+Reads a (binary format) nav leaf index from the specified std::istream. The LeafIndex
+header line is assumed to have been read already.
+*/
+NavLeafIndex_Ptr NavSection::read_leaf_index(std::istream& is, int navPolyCount)
+{
+	LineIO::read_checked_line(is, "{");
+
+	std::string line;
+	int leafCount, cellCount;
+	LineIO::read_line(is, line, "nav leaf index leaf count");
+	try							{ leafCount = lexical_cast<int,std::string>(line); }
+	catch(bad_lexical_cast&)	{ throw Exception("The nav leaf index leaf count was not an integer"); }
+	LineIO::read_line(is, line, "nav leaf index cell count");
+	try							{ cellCount = lexical_cast<int,std::string>(line); }
+	catch(bad_lexical_cast&)	{ throw Exception("The nav leaf index cell count was not an integer"); }
+	if(leafCount < 0 || cellCount < 0) throw Exception("The nav leaf index counts must be >= 0");
+
+	// TODO: There may be endian issues with this if we ever port to another platform.
+	std::vector<double> gridParams(leafCount * 3);
+	std::vector<int> gridSizes(leafCount * 2), cellStarts(cellCount + 1);
+	if(leafCount > 0)
+	{
+		is.read(reinterpret_cast<char*>(&gridParams[0]), gridParams.size() * sizeof(double));
+		is.read(reinterpret_cast<char*>(&gridSizes[0]), gridSizes.size() * sizeof(int));
+	}
+	is.read(reinterpret_cast<char*>(&cellStarts[0]), cellStarts.size() * sizeof(int));
+	if(!is) throw Exception("Unexpected end of file in the nav leaf index");
+	check_ranges(&cellStarts[0], cellCount, "nav leaf index cells");
+
+	std::vector<int> cellPolys(cellStarts[cellCount]);
+	std::vector<double> polyBounds(navPolyCount * 6);
+	if(!cellPolys.empty()) is.read(reinterpret_cast<char*>(&cellPolys[0]), cellPolys.size() * sizeof(int));
+	if(!polyBounds.empty()) is.read(reinterpret_cast<char*>(&polyBounds[0]), polyBounds.size() * sizeof(double));
+	if(!is) throw Exception("Unexpected end of file in the nav leaf index");
+
+	if(is.get() != '\n') throw Exception("Expected newline after nav leaf index");
+
+	LineIO::read_checked_line(is, "}");
+
+	return construct_leaf_index(leafCount, leafCount > 0 ? &gridParams[0] : NULL, leafCount > 0 ? &gridSizes[0] : NULL, cellCount, &cellStarts[0],
+								cellPolys.empty() ? NULL : &cellPolys[0], navPolyCount, polyBounds.empty() ? NULL : &polyBounds[0]);
+}
+
 /**
 Reads a navigation mesh from the specified std::istream.
 */
@@ -254,29 +536,75 @@ NavMesh_Ptr NavSection::read_navmesh(std::istream& is)
 }
 
 /**
-Reads a (binary format) path table from the specified std::istream.
+Reads a (binary format) path table from the specified std::istream. Both the compressed
+and the (older) uncompressed formats are supported.
 */
-PathTable_Ptr NavSection::read_path_table(std::istream& is)
+PathTable_Ptr NavSection::read_path_table(std::istream& is, const AdjacencyList& adjList)
 {
-	LineIO::read_checked_line(is, "PathTable");
+	std::string line;
+	LineIO::read_line(is, line, "path table header");
+	bool compressed;
+	if(line == "CompressedPathTable") compressed = true;
+	else if(line == "PathTable") compressed = false;
+	else throw Exception("Expected CompressedPathTable or PathTable");
+
 	LineIO::read_checked_line(is, "{");
 
-	std::string line;
 	LineIO::read_line(is, line, "path table size");
 	int size;
 	try							{ size = lexical_cast<int,std::string>(line); }
 	catch(bad_lexical_cast&)	{ throw Exception("The path table size was not an integer"); }
+	if(size != adjList.size()) throw Exception("The path table size does not match the adjacency list size");
 
-	PathTable_Ptr pathTable(new PathTable(size));
+	PathTable_Ptr pathTable(new PathTable(adjList));
 
-	for(int i=0; i<size; ++i)
-		for(int j=0; j<size; ++j)
+	// TODO: There may be endian issues with this if we ever port to another platform.
+	if(compressed)
+	{
+		LineIO::read_line(is, line, "path table row count");
+		int rowCount;
+		try							{ rowCount = lexical_cast<int,std::string>(line); }
+		catch(bad_lexical_cast&)	{ throw Exception("The path table row count was not an integer"); }
+		if(rowCount < 0) throw Exception("The path table row count was < 0");
+
+		std::vector<int> rowIndices(size);
+		if(size > 0) is.read(reinterpret_cast<char*>(&rowIndices[0]), size * sizeof(int));
+
+		std::vector<PathTable::Row> rows(rowCount);
+		for(int i=0; i<rowCount; ++i)
 		{
-			// TODO: There may be endian issues with this if we ever port to another platform.
-			is.read(reinterpret_cast<char*>(&pathTable->next_node(i,j)), sizeof(int));
-			is.read(reinterpret_cast<char*>(&pathTable->cost(i,j)), sizeof(float));
+			PathTable::Row& row = rows[i];
+			row.costCodes.resize(size);
+			row.nextHops.resize(size);
+			is.read(reinterpret_cast<char*>(&row.costScale), sizeof(float));
+			if(size > 0)
+			{
+				is.read(reinterpret_cast<char*>(&row.costCodes[0]), size * sizeof(unsigned short));
+				is.read(reinterpret_cast<char*>(&row.nextHops[0]), size * sizeof(PathTable::NextHop));
+			}
 		}
 
+		if(!is) throw Exception("Unexpected end of file in the path table");
+		pathTable->set_rows(rows, rowIndices);
+	}
+	else
+	{
+		std::vector<PathTable::Row> rows(size);
+		std::vector<float> costs(size);
+		std::vector<int> nextNodes(size);
+		for(int i=0; i<size; ++i)
+		{
+			for(int j=0; j<size; ++j)
+			{
+				is.read(reinterpret_cast<char*>(&nextNodes[j]), sizeof(int));
+				is.read(reinterpret_cast<char*>(&costs[j]), sizeof(float));
+			}
+			if(!is) throw Exception("Unexpected end of file in the path table");
+			rows[i] = pathTable->encode_row(i, costs, nextNodes);
+		}
+		pathTable->set_rows(rows);
+	}
+
 	if(is.get() != '\n') throw Exception("Expected newline after path table");
 
 	LineIO::read_checked_line(is, "}");
@@ -285,6 +613,32 @@ PathTable_Ptr NavSection::read_path_table(std::istream& is)
 }
 
 //#################### SAVING SUPPORT METHODS ####################
+/**
+Flattens the leaf grids and nav polygon bounds of a nav leaf index into arrays for saving.
+*/
+void NavSection::flatten_leaf_index(const NavLeafIndex_CPtr& leafIndex, std::vector<double>& gridParams, std::vector<int>& gridSizes,
+									std::vector<double>& polyBounds)
+{
+	const std::vector<NavLeafIndex::LeafGrid>& leafGrids = leafIndex->leaf_grids();
+	for(std::vector<NavLeafIndex::LeafGrid>::const_iterator it=leafGrids.begin(), iend=leafGrids.end(); it!=iend; ++it)
+	{
+		gridParams.push_back(it->minX);
+		gridParams.push_back(it->minY);
+		gridParams.push_back(it->cellSize);
+		gridSizes.push_back(it->width);
+		gridSizes.push_back(it->height);
+	}
+
+	const std::vector<AABB3d>& bounds = leafIndex->poly_bounds();
+	for(std::vector<AABB3d>::const_iterator it=bounds.begin(), iend=bounds.end(); it!=iend; ++it)
+	{
+		const Vector3d& minimum = it->minimum();
+		const Vector3d& maximum = it->maximum();
+		polyBounds.push_back(minimum.x);	polyBounds.push_back(minimum.y);	polyBounds.push_back(minimum.z);
+		polyBounds.push_back(maximum.x);	polyBounds.push_back(maximum.y);	polyBounds.push_back(maximum.z);
+	}
+}
+
 /**
 Writes an adjacency list to the specified std::ostream.
 */
@@ -311,6 +665,158 @@ void NavSection::write_adjacency_list(std::ostream& os, const AdjacencyList_CPtr
 	os << "}\n";
 }
 
+/**
+Writes an adjacency list to a binary level file.
+*/
+void NavSection::write_binary_adjacency_list(BinaryWriter& writer, const AdjacencyList_CPtr& adjList)
+{
+	int size = adjList->size();
+	std::vector<int> edgeStarts(1, 0), toNodes;
+	std::vector<float> lengths;
+	for(int i=0; i<size; ++i)
+	{
+		const std::list<AdjacencyList::Edge>& adjEdges = adjList->adjacent_edges(i);
+		for(std::list<AdjacencyList::Edge>::const_iterator jt=adjEdges.begin(), jend=adjEdges.end(); jt!=jend; ++jt)
+		{
+			toNodes.push_back(jt->to_node());
+			lengths.push_back(jt->length());
+		}
+		edgeStarts.push_back(static_cast<int>(toNodes.size()));
+	}
+
+	writer.write(size);
+	writer.write_array(edgeStarts);
+	writer.write_array(toNodes);
+	writer.write_array(lengths);
+}
+
+/**
+Writes a nav leaf index to a binary level file. After the leaf and cell counts come the
+(minX, minY, cellSize) and (width, height) of each leaf's grid, the cell ranges and the
+nav polygons in the cells, and finally the (enlarged) bounds of each nav polygon.
+*/
+void NavSection::write_binary_leaf_index(BinaryWriter& writer, const NavLeafIndex_CPtr& leafIndex)
+{
+	std::vector<double> gridParams, polyBounds;
+	std::vector<int> gridSizes;
+	flatten_leaf_index(leafIndex, gridParams, gridSizes, polyBounds);
+
+	const std::vector<int>& cellStarts = leafIndex->cell_starts();
+	writer.write(leafIndex->leaf_count());
+	writer.write(static_cast<int>(cellStarts.size()) - 1);
+	writer.write_array(gridParams);
+	writer.write_array(gridSizes);
+	writer.write_array(cellStarts);
+	writer.write_array(leafIndex->cell_polys());
+	writer.write_array(polyBounds);
+}
+
+/**
+Writes a navigation mesh to a binary level file.
+*/
+void NavSection::write_binary_navmesh(BinaryWriter& writer, const NavMesh_CPtr& mesh)
+{
+	// Write the nav links.
+	const std::vector<NavLink_Ptr>& links = mesh->links();
+	int linkCount = static_cast<int>(links.size());
+	writer.write(linkCount);
+	for(int i=0; i<linkCount; ++i)
+	{
+		std::ostringstream oss;
+		links[i]->output(oss);
+		writer.write_string(oss.str());
+	}
+
+	// Write the polygons.
+	const std::vector<NavPolygon_Ptr>& polygons = mesh->polygons();
+	int polyCount = static_cast<int>(polygons.size());
+	std::vector<int> colIndices(polyCount), inStarts(1, 0), inLinks, outStarts(1, 0), outLinks;
+	for(int i=0; i<polyCount; ++i)
+	{
+		colIndices[i] = polygons[i]->collision_poly_index();
+
+		const std::vector<int>& polyInLinks = polygons[i]->in_links();
+		inLinks.insert(inLinks.end(), polyInLinks.begin(), polyInLinks.end());
+		inStarts.push_back(static_cast<int>(inLinks.size()));
+
+		const std::vector<int>& polyOutLinks = polygons[i]->out_links();
+		outLinks.insert(outLinks.end(), polyOutLinks.begin(), polyOutLinks.end());
+		outStarts.push_back(static_cast<int>(outLinks.size()));
+	}
+
+	writer.write(polyCount);
+	writer.write_array(colIndices);
+	writer.write_array(inStarts);
+	writer.write_array(inLinks);
+	writer.write_array(outStarts);
+	writer.write_array(outLinks);
+}
+
+/**
+Writes a (compressed) path table to a binary level file. The stored rows are written
+as flat arrays of cost scales, cost codes and next hops, preceded by the index of the
+stored row used by each node.
+*/
+void NavSection::write_binary_path_table(BinaryWriter& writer, const PathTable_CPtr& pathTable)
+{
+	int size = pathTable->size();
+	int rowCount = pathTable->row_count();
+
+	std::vector<int> rowIndices(size);
+	for(int i=0; i<size; ++i) rowIndices[i] = pathTable->row_index(i);
+
+	std::vector<float> costScales(rowCount);
+	std::vector<unsigned short> costCodes;
+	std::vector<PathTable::NextHop> nextHops;
+	costCodes.reserve(rowCount * size);
+	nextHops.reserve(rowCount * size);
+	for(int i=0; i<rowCount; ++i)
+	{
+		const PathTable::Row& row = pathTable->row(i);
+		costScales[i] = row.costScale;
+		costCodes.insert(costCodes.end(), row.costCodes.begin(), row.costCodes.end());
+		nextHops.insert(nextHops.end(), row.nextHops.begin(), row.nextHops.end());
+	}
+
+	writer.write(size);
+	writer.write(rowCount);
+	writer.write_array(rowIndices);
+	writer.write_array(costScales);
+	writer.write_array(costCodes);
+	writer.write_array(nextHops);
+}
+
+/**
+Writes a nav leaf index to the specified std::ostream in binary format (with the
+same layout as in binary level files).
+*/
+void NavSection::write_leaf_index(std::ostream& os, const NavLeafIndex_CPtr& leafIndex)
+{
+	os << "LeafIndex\n";
+	os << "{\n";
+
+	std::vector<double> gridParams, polyBounds;
+	std::vector<int> gridSizes;
+	flatten_leaf_index(leafIndex, gridParams, gridSizes, polyBounds);
+
+	const std::vector<int>& cellStarts = leafIndex->cell_starts();
+	const std::vector<int>& cellPolys = leafIndex->cell_polys();
+	os << leafIndex->leaf_count() << '\n';
+	os << cellStarts.size() - 1 << '\n';
+
+	// TODO: There may be endian issues with this if we ever port to another platform.
+	if(!gridParams.empty())
+	{
+		os.write(reinterpret_cast<const char*>(&gridParams[0]), gridParams.size() * sizeof(double));
+		os.write(reinterpret_cast<const char*>(&gridSizes[0]), gridSizes.size() * sizeof(int));
+	}
+	os.write(reinterpret_cast<const char*>(&cellStarts[0]), cellStarts.size() * sizeof(int));
+	if(!cellPolys.empty()) os.write(reinterpret_cast<const char*>(&cellPolys[0]), cellPolys.size() * sizeof(int));
+	if(!polyBounds.empty()) os.write(reinterpret_cast<const char*>(&polyBounds[0]), polyBounds.size() * sizeof(double));
+
+	os << "\n}\n";
+}
+
 /**
 Writes a navigation mesh to the specified std::ostream.
 */
@@ -361,23 +867,37 @@ void NavSection::write_navmesh(std::ostream& os, const NavMesh_CPtr& mesh)
 }
 
 /**
-Writes a path table to the specified std::ostream in binary format.
+Writes a (compressed) path table to the specified std::ostream in binary format. The
+index of the stored row used by each node is written first, followed by the stored
+rows themselves (see PathTable).
 */
 void NavSection::write_path_table(std::ostream& os, const PathTable_CPtr& pathTable)
 {
-	os << "PathTable\n";
+	os << "CompressedPathTable\n";
 	os << "{\n";
 
 	int size = pathTable->size();
+	int rowCount = pathTable->row_count();
 	os << size << '\n';
+	os << rowCount << '\n';
 
+	// TODO: There may be endian issues with this if we ever port to another platform.
 	for(int i=0; i<size; ++i)
-		for(int j=0; j<size; ++j)
+	{
+		int rowIndex = pathTable->row_index(i);
+		os.write(reinterpret_cast<const char*>(&rowIndex), sizeof(int));
+	}
+
+	for(int i=0; i<rowCount; ++i)
+	{
+		const PathTable::Row& row = pathTable->row(i);
+		os.write(reinterpret_cast<const char*>(&row.costScale), sizeof(float));
+		if(size > 0)
 		{
-			// TODO: There may be endian issues with this if we ever port to another platform.
-			os.write(reinterpret_cast<const char*>(&pathTable->next_node(i,j)), sizeof(int));
-			os.write(reinterpret_cast<const char*>(&pathTable->cost(i,j)), sizeof(float));
+			os.write(reinterpret_cast<const char*>(&row.costCodes[0]), size * sizeof(unsigned short));
+			os.write(reinterpret_cast<const char*>(&row.nextHops[0]), size * sizeof(PathTable::NextHop));
 		}
+	}
 
 	os << "\n}\n";
 }
@@ -6,14 +6,22 @@
 #ifndef H_HESP_NAVSECTION
 #define H_HESP_NAVSECTION
 
+#include <iosfwd>
+#include <string>
+#include <vector>
+
 #include <boost/shared_ptr.hpp>
 using boost::shared_ptr;
 
 namespace hesp {
 
 //#################### FORWARD DECLARATIONS ####################
+class BinaryReader;
+class BinaryWriter;
 typedef shared_ptr<class AdjacencyList> AdjacencyList_Ptr;
 typedef shared_ptr<const class AdjacencyList> AdjacencyList_CPtr;
+typedef shared_ptr<class NavLeafIndex> NavLeafIndex_Ptr;
+typedef shared_ptr<const class NavLeafIndex> NavLeafIndex_CPtr;
 typedef shared_ptr<class NavManager> NavManager_Ptr;
 typedef shared_ptr<const class NavManager> NavManager_CPtr;
 typedef shared_ptr<class NavMesh> NavMesh_Ptr;
@@ -26,20 +34,36 @@ class NavSection
 	//#################### LOADING METHODS ####################
 public:
 	static NavManager_Ptr load(std::istream& is);
+	static NavManager_Ptr load_binary(BinaryReader& reader);
 
 	//#################### SAVING METHODS ####################
 public:
 	static void save(std::ostream& os, const NavManager_CPtr& navManager);
+	static void save_binary(BinaryWriter& writer, const NavManager_CPtr& navManager);
 
 	//#################### LOADING SUPPORT METHODS ####################
 private:
+	static void check_ranges(const int *starts, int count, const std::string& description);
+	static NavLeafIndex_Ptr construct_leaf_index(int leafCount, const double *gridParams, const int *gridSizes, int cellCount, const int *cellStarts,
+												 const int *cellPolys, int navPolyCount, const double *polyBounds);
 	static AdjacencyList_Ptr read_adjacency_list(std::istream& is);
+	static AdjacencyList_Ptr read_binary_adjacency_list(BinaryReader& reader);
+	static NavLeafIndex_Ptr read_binary_leaf_index(BinaryReader& reader, int navPolyCount);
+	static NavMesh_Ptr read_binary_navmesh(BinaryReader& reader);
+	static PathTable_Ptr read_binary_path_table(BinaryReader& reader, const AdjacencyList& adjList);
+	static NavLeafIndex_Ptr read_leaf_index(std::istream& is, int navPolyCount);
 	static NavMesh_Ptr read_navmesh(std::istream& is);
-	static PathTable_Ptr read_path_table(std::istream& is);
+	static PathTable_Ptr read_path_table(std::istream& is, const AdjacencyList& adjList);
 
 	//#################### SAVING SUPPORT METHODS ####################
 private:
+	static void flatten_leaf_index(const NavLeafIndex_CPtr& leafIndex, std::vector<double>& gridParams, std::vector<int>& gridSizes, std::vector<double>& polyBounds);
 	static void write_adjacency_list(std::ostream& os, const AdjacencyList_CPtr& adjList);
+	static void write_binary_adjacency_list(BinaryWriter& writer, const AdjacencyList_CPtr& adjList);
+	static void write_binary_leaf_index(BinaryWriter& writer, const NavLeafIndex_CPtr& leafIndex);
+	static void write_binary_navmesh(BinaryWriter& writer, const NavMesh_CPtr& mesh);
+	static void write_binary_path_table(BinaryWriter& writer, const PathTable_CPtr& pathTable);
+	static void write_leaf_index(std::ostream& os, const NavLeafIndex_CPtr& leafIndex);
 	static void write_navmesh(std::ostream& os, const NavMesh_CPtr& mesh);
 	static void write_path_table(std::ostream& os, const PathTable_CPtr& pathTable);
 };
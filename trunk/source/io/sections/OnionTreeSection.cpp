@@ -26,6 +26,17 @@ OnionTree_Ptr OnionTreeSection::load(std::istream& is)
 	return tree;
 }
 
+/**
+Loads an onion tree from a binary level file.
+
+@param reader	A reader for the section
+@return			The onion tree
+*/
+OnionTree_Ptr OnionTreeSection::load_binary(BinaryReader& reader)
+{
+	return OnionTree::load_binary(reader);
+}
+
 //#################### SAVING METHODS ####################
 /**
 Saves an onion tree to the specified std::ostream.
@@ -41,4 +52,15 @@ void OnionTreeSection::save(std::ostream& os, const OnionTree_CPtr& tree)
 	os << "}\n";
 }
 
+/**
+Saves an onion tree to a binary level file.
+
+@param writer	The writer for the section
+@param tree		The onion tree
+*/
+void OnionTreeSection::save_binary(BinaryWriter& writer, const OnionTree_CPtr& tree)
+{
+	tree->output_binary(writer);
+}
+
 }
@@ -12,6 +12,8 @@ using boost::shared_ptr;
 namespace hesp {
 
 //#################### FORWARD DECLARATIONS ####################
+class BinaryReader;
+class BinaryWriter;
 typedef shared_ptr<class OnionTree> OnionTree_Ptr;
 typedef shared_ptr<const class OnionTree> OnionTree_CPtr;
 
@@ -19,9 +21,11 @@ struct OnionTreeSection
 {
 	//#################### LOADING METHODS ####################
 	static OnionTree_Ptr load(std::istream& is);
+	static OnionTree_Ptr load_binary(BinaryReader& reader);
 
 	//#################### SAVING METHODS ####################
 	static void save(std::ostream& os, const OnionTree_CPtr& tree);
+	static void save_binary(BinaryWriter& writer, const OnionTree_CPtr& tree);
 };
 
 }
@@ -13,15 +13,56 @@
 #include <boost/shared_ptr.hpp>
 using boost::shared_ptr;
 
+#include <source/math/vectors/TexturedLitVector3d.h>
+#include <source/math/vectors/TexturedVector3d.h>
+
 namespace hesp {
 
+//#################### FORWARD DECLARATIONS ####################
+class BinaryReader;
+class BinaryWriter;
+
+//#################### TRAITS ####################
+/**
+This traits class template specifies how the vertices of a polygon are stored in
+binary level files: each vertex is stored as COMPONENTS consecutive doubles.
+*/
+template <typename Vert> struct BinaryVertexTraits;
+
+template <>
+struct BinaryVertexTraits<Vector3d>
+{
+	enum { COMPONENTS = 3 };
+	static void pack(const Vector3d& v, double *c)		{ c[0] = v.x; c[1] = v.y; c[2] = v.z; }
+	static Vector3d unpack(const double *c)				{ return Vector3d(c[0], c[1], c[2]); }
+};
+
+template <>
+struct BinaryVertexTraits<TexturedVector3d>
+{
+	enum { COMPONENTS = 5 };
+	static void pack(const TexturedVector3d& v, double *c)	{ c[0] = v.x; c[1] = v.y; c[2] = v.z; c[3] = v.u; c[4] = v.v; }
+	static TexturedVector3d unpack(const double *c)			{ return TexturedVector3d(c[0], c[1], c[2], c[3], c[4]); }
+};
+
+template <>
+struct BinaryVertexTraits<TexturedLitVector3d>
+{
+	enum { COMPONENTS = 7 };
+	static void pack(const TexturedLitVector3d& v, double *c)	{ c[0] = v.x; c[1] = v.y; c[2] = v.z; c[3] = v.u; c[4] = v.v; c[5] = v.lu; c[6] = v.lv; }
+	static TexturedLitVector3d unpack(const double *c)			{ return TexturedLitVector3d(c[0], c[1], c[2], c[3], c[4], c[5], c[6]); }
+};
+
+//#################### CLASSES ####################
 struct PolygonsSection
 {
 	//#################### LOADING METHODS ####################
 	template <typename Poly> static void load(std::istream& is, const std::string& sectionName, std::vector<shared_ptr<Poly> >& polygons);
+	template <typename Poly> static void load_binary(BinaryReader& reader, std::vector<shared_ptr<Poly> >& polygons);
 
 	//#################### SAVING METHODS ####################
 	template <typename Poly> static void save(std::ostream& os, const std::string& sectionName, const std::vector<shared_ptr<Poly> >& polygons);
+	template <typename Poly> static void save_binary(BinaryWriter& writer, const std::vector<shared_ptr<Poly> >& polygons);
 };
 
 }
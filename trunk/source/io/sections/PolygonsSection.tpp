@@ -3,6 +3,12 @@
  * Copyright Stuart Golodetz, 2009. All rights reserved.
  ***/
 
+#include <climits>
+
+#include <boost/lexical_cast.hpp>
+
+#include <source/exceptions/Exception.h>
+#include <source/io/util/BinaryIO.h>
 #include <source/io/util/LineIO.h>
 #include <source/io/util/IOUtil.h>
 
@@ -25,6 +31,71 @@ void PolygonsSection::load(std::istream& is, const std::string& sectionName, std
 	LineIO::read_checked_line(is, "}");
 }
 
+/**
+Loads a polygon section from a binary level file. The vertex and auxiliary data start
+arrays are checked before they are used to index the data, so that a truncated or
+corrupt section causes an exception rather than a read outside the section.
+
+@param reader		A reader for the section
+@param polygons		The array into which to read the polygons
+@throws Exception	If the section is malformed
+*/
+template <typename Poly>
+void PolygonsSection::load_binary(BinaryReader& reader, std::vector<shared_ptr<Poly> >& polygons)
+{
+	typedef typename Poly::Vert Vert;
+	typedef typename Poly::AuxData AuxData;
+	typedef BinaryVertexTraits<Vert> Traits;
+
+	int polyCount = reader.read<int>();
+	int components = reader.read<int>();
+	if(polyCount < 0 || polyCount == INT_MAX) throw Exception("Bad polygon count in binary polygon section");
+	if(components != Traits::COMPONENTS) throw Exception("Bad vertex format in binary polygon section");
+
+	// Each polygon must have at least three vertices, and the starts must begin at zero and
+	// increase, so that the last start is the size of the data array and every polygon's
+	// range of data lies within it.
+	const int *vertexStarts = reader.read_array<int>(polyCount + 1);
+	if(vertexStarts[0] != 0) throw Exception("Bad vertex starts in binary polygon section");
+	for(int i=0; i<polyCount; ++i)
+	{
+		if(vertexStarts[i+1] < vertexStarts[i] || vertexStarts[i+1] - vertexStarts[i] < 3)
+		{
+			throw Exception("Bad vertex count in binary polygon section for polygon " + boost::lexical_cast<std::string,int>(i));
+		}
+	}
+	if(vertexStarts[polyCount] > INT_MAX / components) throw Exception("Too many vertices in binary polygon section");
+	const double *vertexData = reader.read_array<double>(vertexStarts[polyCount] * components);
+
+	const int *auxStarts = reader.read_array<int>(polyCount + 1);
+	if(auxStarts[0] != 0) throw Exception("Bad auxiliary data starts in binary polygon section");
+	for(int i=0; i<polyCount; ++i)
+	{
+		if(auxStarts[i+1] < auxStarts[i])
+		{
+			throw Exception("Bad auxiliary data length in binary polygon section for polygon " + boost::lexical_cast<std::string,int>(i));
+		}
+	}
+	const char *auxChars = reader.read_array<char>(auxStarts[polyCount]);
+
+	polygons.reserve(polygons.size() + polyCount);
+	for(int i=0; i<polyCount; ++i)
+	{
+		std::vector<Vert> vertices;
+		vertices.reserve(vertexStarts[i+1] - vertexStarts[i]);
+		for(int j=vertexStarts[i]; j<vertexStarts[i+1]; ++j)
+		{
+			vertices.push_back(Traits::unpack(&vertexData[j * components]));
+		}
+
+		AuxData auxData;
+		try								{ auxData = boost::lexical_cast<AuxData,std::string>(std::string(auxChars + auxStarts[i], auxChars + auxStarts[i+1])); }
+		catch(boost::bad_lexical_cast&)	{ throw Exception("Bad auxiliary data in binary polygon section: " + boost::lexical_cast<std::string,int>(i)); }
+
+		polygons.push_back(shared_ptr<Poly>(new Poly(vertices, auxData)));
+	}
+}
+
 //#################### SAVING METHODS ####################
 /**
 Saves a polygon section to the specified std::ostream.
@@ -42,4 +113,44 @@ void PolygonsSection::save(std::ostream& os, const std::string& sectionName, con
 	os << "}\n";
 }
 
+/**
+Saves a polygon section to a binary level file. The vertices of all the polygons
+are stored in a single flat array, as are their auxiliary data strings.
+
+@param writer		The writer for the section
+@param polygons		The array of polygons
+*/
+template <typename Poly>
+void PolygonsSection::save_binary(BinaryWriter& writer, const std::vector<shared_ptr<Poly> >& polygons)
+{
+	typedef typename Poly::Vert Vert;
+	typedef BinaryVertexTraits<Vert> Traits;
+
+	int polyCount = static_cast<int>(polygons.size());
+	std::vector<int> vertexStarts(1, 0), auxStarts(1, 0);
+	std::vector<double> vertexData;
+	std::string auxChars;
+	for(int i=0; i<polyCount; ++i)
+	{
+		const Poly& poly = *polygons[i];
+		int vertCount = poly.vertex_count();
+		for(int j=0; j<vertCount; ++j)
+		{
+			vertexData.resize(vertexData.size() + Traits::COMPONENTS);
+			Traits::pack(poly.vertex(j), &vertexData[vertexData.size() - Traits::COMPONENTS]);
+		}
+		vertexStarts.push_back(vertexStarts.back() + vertCount);
+
+		auxChars += boost::lexical_cast<std::string>(poly.auxiliary_data());
+		auxStarts.push_back(static_cast<int>(auxChars.length()));
+	}
+
+	writer.write(polyCount);
+	writer.write(static_cast<int>(Traits::COMPONENTS));
+	writer.write_array(vertexStarts);
+	writer.write_array(vertexData);
+	writer.write_array(auxStarts);
+	writer.write_array(auxChars.data(), static_cast<int>(auxChars.length()));
+}
+
 }
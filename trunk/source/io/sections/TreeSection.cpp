@@ -27,6 +27,17 @@ BSPTree_Ptr TreeSection::load(std::istream& is)
 	return tree;
 }
 
+/**
+Loads a BSP tree from a binary level file.
+
+@param reader	A reader for the section
+@return			The BSP tree
+*/
+BSPTree_Ptr TreeSection::load_binary(BinaryReader& reader)
+{
+	return BSPTree::load_binary(reader);
+}
+
 //#################### SAVING METHODS ####################
 /**
 Saves a BSP tree to the specified std::ostream.
@@ -42,5 +53,16 @@ void TreeSection::save(std::ostream& os, const BSPTree_CPtr& tree)
 	os << "}\n";
 }
 
+/**
+Saves a BSP tree to a binary level file.
+
+@param writer	The writer for the section
+@param tree		The BSP tree
+*/
+void TreeSection::save_binary(BinaryWriter& writer, const BSPTree_CPtr& tree)
+{
+	tree->output_binary(writer);
+}
+
 
 }
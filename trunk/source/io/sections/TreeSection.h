@@ -12,6 +12,8 @@ using boost::shared_ptr;
 namespace hesp {
 
 //#################### FORWARD DECLARATIONS ####################
+class BinaryReader;
+class BinaryWriter;
 typedef shared_ptr<class BSPTree> BSPTree_Ptr;
 typedef shared_ptr<const class BSPTree> BSPTree_CPtr;
 
@@ -19,9 +21,11 @@ struct TreeSection
 {
 	//#################### LOADING METHODS ####################
 	static BSPTree_Ptr load(std::istream& is);
+	static BSPTree_Ptr load_binary(BinaryReader& reader);
 
 	//#################### SAVING METHODS ####################
 	static void save(std::ostream& os, const BSPTree_CPtr& tree);
+	static void save_binary(BinaryWriter& writer, const BSPTree_CPtr& tree);
 };
 
 }
@@ -10,87 +10,99 @@ using boost::bad_lexical_cast;
 using boost::lexical_cast;
 
 #include <source/exceptions/Exception.h>
+#include <source/io/util/BinaryIO.h>
 #include <source/io/util/LineIO.h>
 
 namespace hesp {
 
 //#################### LOADING METHODS ####################
 /**
-Loads a leaf visibility table from the specified std::istream.
+Loads a leaf visibility table from the specified std::istream. Both the
+compressed and the (older) uncompressed formats are supported.
 
 @param is	The std::istream
 @return		The visibility table
 */
 LeafVisTable_Ptr VisSection::load(std::istream& is)
 {
-	LeafVisTable_Ptr leafVis;
-
 	std::string line;
+	LineIO::read_line(is, line, "vis table header");
+	if(line == "CompressedVisTable") return load_compressed_table(is)->decompress();
+	else if(line == "VisTable") return load_uncompressed_table(is);
+	else throw Exception("Expected CompressedVisTable or VisTable");
+}
 
-	LineIO::read_checked_line(is, "VisTable");
-	LineIO::read_checked_line(is, "{");
+/**
+Loads a compressed leaf visibility table from a binary level file (see save_binary for the format).
 
-	// Read in the size of the vis table.
-	LineIO::read_line(is, line, "vis table size");
-	int size;
-	try							{ size = lexical_cast<int,std::string>(line); }
-	catch(bad_lexical_cast&)	{ throw Exception("The vis table size was not an integer"); }
+@param reader		A reader for the section
+@return				The compressed visibility table
+@throws Exception	If the section is malformed
+*/
+CompressedLeafVisTable_Ptr VisSection::load_binary(BinaryReader& reader)
+{
+	int size = reader.read<int>();
+	if(size < 0) throw Exception("Bad binary vis table size");
 
-	// Construct an empty vis table of the right size.
-	leafVis.reset(new LeafVisTable(size));
+	const int *rowStarts = reader.read_array<int>(size + 1);
+	const unsigned char *rowData = reader.read_array<unsigned char>(rowStarts[size]);
 
-	// Read in the vis table itself.
+	CompressedLeafVisTable_Ptr leafVis(new CompressedLeafVisTable(size));
 	for(int i=0; i<size; ++i)
 	{
-		LineIO::read_line(is, line, "vis table row " + lexical_cast<std::string,int>(i));
-		if(line.length() != size) throw Exception("Bad vis table row " + lexical_cast<std::string,int>(i));
-
-		for(int j=0; j<size; ++j)
+		if(rowStarts[i] < 0 || rowStarts[i] > rowStarts[i+1] || rowStarts[i+1] > rowStarts[size])
 		{
-			if(line[j] == '0') (*leafVis)(i,j) = LEAFVIS_NO;
-			else if(line[j] == '1') (*leafVis)(i,j) = LEAFVIS_YES;
-			else throw Exception("Bad vis table value in row " + lexical_cast<std::string,int>(i));
+			throw Exception("Bad binary vis table row " + lexical_cast<std::string,int>(i));
 		}
+		leafVis->set_compressed_row(i, CompressedLeafVisTable::CompressedRow(rowData + rowStarts[i], rowData + rowStarts[i+1]));
 	}
 
-	LineIO::read_checked_line(is, "}");
-
 	return leafVis;
 }
 
+/**
+Loads a leaf visibility table from the specified std::istream, keeping its rows
+in compressed form. Both the compressed and the (older) uncompressed formats are
+supported.
+
+@param is	The std::istream
+@return		The compressed visibility table
+*/
+CompressedLeafVisTable_Ptr VisSection::load_compressed(std::istream& is)
+{
+	std::string line;
+	LineIO::read_line(is, line, "vis table header");
+	if(line == "CompressedVisTable") return load_compressed_table(is);
+	else if(line == "VisTable") return CompressedLeafVisTable::compress(*load_uncompressed_table(is));
+	else throw Exception("Expected CompressedVisTable or VisTable");
+}
+
 //#################### SAVING METHODS ####################
 /**
-Saves a leaf visibility table to a std::ostream.
+Saves a leaf visibility table to a std::ostream in compressed form. Each
+row is written as a line of hex digits containing the row's bytes after
+run-length compression (see CompressedLeafVisTable).
 
 @param os		The std::ostream
 @param leafVis	The leaf visibility table
 */
 void VisSection::save(std::ostream& os, const LeafVisTable_CPtr& leafVis)
 {
-	const LeafVisTable& table = *leafVis;
+	static const char hexDigits[] = "0123456789ABCDEF";
+
+	CompressedLeafVisTable_Ptr table = CompressedLeafVisTable::compress(*leafVis);
 
-	os << "VisTable\n";
+	os << "CompressedVisTable\n";
 	os << "{\n";
 
-	int size = table.size();
+	int size = table->size();
 	os << size << '\n';
 	for(int i=0; i<size; ++i)
 	{
-		for(int j=0; j<size; ++j)
+		const CompressedLeafVisTable::CompressedRow& row = table->compressed_row(i);
+		for(size_t j=0, rowSize=row.size(); j<rowSize; ++j)
 		{
-			switch(table(i,j))
-			{
-				case LEAFVIS_NO:
-				{
-					os << '0';
-					break;
-				}
-				case LEAFVIS_YES:
-				{
-					os << '1';
-					break;
-				}
-			}
+			os << hexDigits[row[j] >> 4] << hexDigits[row[j] & 0xF];
 		}
 		os << '\n';
 	}
@@ -98,4 +110,116 @@ void VisSection::save(std::ostream& os, const LeafVisTable_CPtr& leafVis)
 	os << "}\n";
 }
 
+/**
+Saves a compressed leaf visibility table to a binary level file. The compressed
+rows are stored back to back in a single byte array, preceded by an array of
+row start offsets.
+
+@param writer	The writer for the section
+@param leafVis	The compressed leaf visibility table
+*/
+void VisSection::save_binary(BinaryWriter& writer, const CompressedLeafVisTable_CPtr& leafVis)
+{
+	int size = leafVis->size();
+	std::vector<int> rowStarts(1, 0);
+	std::vector<unsigned char> rowData;
+	for(int i=0; i<size; ++i)
+	{
+		const CompressedLeafVisTable::CompressedRow& row = leafVis->compressed_row(i);
+		rowData.insert(rowData.end(), row.begin(), row.end());
+		rowStarts.push_back(static_cast<int>(rowData.size()));
+	}
+
+	writer.write(size);
+	writer.write_array(rowStarts);
+	writer.write_array(rowData);
+}
+
+//#################### LOADING SUPPORT METHODS ####################
+/**
+Returns the value of a (capital) hex digit, or -1 if the character isn't one.
+*/
+int VisSection::hex_digit_value(char c)
+{
+	if(c >= '0' && c <= '9') return c - '0';
+	else if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+	else return -1;
+}
+
+/**
+Loads the body of a compressed leaf visibility table (everything after the header line).
+*/
+CompressedLeafVisTable_Ptr VisSection::load_compressed_table(std::istream& is)
+{
+	int size = load_table_size(is);
+	CompressedLeafVisTable_Ptr leafVis(new CompressedLeafVisTable(size));
+
+	std::string line;
+	CompressedLeafVisTable::CompressedRow row;
+	for(int i=0; i<size; ++i)
+	{
+		LineIO::read_line(is, line, "vis table row " + lexical_cast<std::string,int>(i));
+		if(line.length() % 2 != 0) throw Exception("Bad vis table row " + lexical_cast<std::string,int>(i));
+
+		row.resize(line.length() / 2);
+		for(size_t j=0, rowSize=row.size(); j<rowSize; ++j)
+		{
+			int hi = hex_digit_value(line[2*j]), lo = hex_digit_value(line[2*j+1]);
+			if(hi == -1 || lo == -1) throw Exception("Bad vis table value in row " + lexical_cast<std::string,int>(i));
+			row[j] = static_cast<unsigned char>((hi << 4) | lo);
+		}
+		leafVis->set_compressed_row(i, row);
+	}
+
+	LineIO::read_checked_line(is, "}");
+
+	return leafVis;
+}
+
+/**
+Reads the opening brace and the size of a leaf visibility table.
+*/
+int VisSection::load_table_size(std::istream& is)
+{
+	LineIO::read_checked_line(is, "{");
+
+	std::string line;
+	LineIO::read_line(is, line, "vis table size");
+	int size;
+	try							{ size = lexical_cast<int,std::string>(line); }
+	catch(bad_lexical_cast&)	{ throw Exception("The vis table size was not an integer"); }
+
+	return size;
+}
+
+/**
+Loads the body of an uncompressed leaf visibility table (everything after the header line).
+*/
+LeafVisTable_Ptr VisSection::load_uncompressed_table(std::istream& is)
+{
+	int size = load_table_size(is);
+
+	// Construct an empty vis table of the right size.
+	LeafVisTable_Ptr leafVis(new LeafVisTable(size));
+
+	// Read in the vis table itself.
+	std::string line;
+	for(int i=0; i<size; ++i)
+	{
+		LineIO::read_line(is, line, "vis table row " + lexical_cast<std::string,int>(i));
+		if(line.length() != size) throw Exception("Bad vis table row " + lexical_cast<std::string,int>(i));
+
+		for(int j=0; j<size; ++j)
+		{
+			if(line[j] == '0') (*leafVis)(i,j) = LEAFVIS_NO;
+			else if(line[j] == '1') (*leafVis)(i,j) = LEAFVIS_YES;
+			else throw Exception("Bad vis table value in row " + lexical_cast<std::string,int>(i));
+		}
+	}
+
+	LineIO::read_checked_line(is, "}");
+
+	return leafVis;
+}
+
 }
@@ -6,17 +6,31 @@
 #ifndef H_HESP_VISSECTION
 #define H_HESP_VISSECTION
 
-#include <source/level/vis/VisTable.h>
+#include <source/level/vis/CompressedLeafVisTable.h>
 
 namespace hesp {
 
+//#################### FORWARD DECLARATIONS ####################
+class BinaryReader;
+class BinaryWriter;
+
 struct VisSection
 {
 	//#################### LOADING METHODS ####################
 	static LeafVisTable_Ptr load(std::istream& is);
+	static CompressedLeafVisTable_Ptr load_binary(BinaryReader& reader);
+	static CompressedLeafVisTable_Ptr load_compressed(std::istream& is);
 
 	//#################### SAVING METHODS ####################
 	static void save(std::ostream& os, const LeafVisTable_CPtr& leafVis);
+	static void save_binary(BinaryWriter& writer, const CompressedLeafVisTable_CPtr& leafVis);
+
+	//#################### LOADING SUPPORT METHODS ####################
+private:
+	static int hex_digit_value(char c);
+	static CompressedLeafVisTable_Ptr load_compressed_table(std::istream& is);
+	static int load_table_size(std::istream& is);
+	static LeafVisTable_Ptr load_uncompressed_table(std::istream& is);
 };
 
 }
@@ -0,0 +1,86 @@
+/***
+ * hesperus: BinaryIO.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "BinaryIO.h"
+
+#include <source/exceptions/Exception.h>
+
+namespace hesp {
+
+//#################### BinaryReader - CONSTRUCTORS ####################
+/**
+Constructs a reader for the block of memory [begin,end).
+
+@param begin	The start of the block (should be aligned to ALIGNMENT bytes)
+@param end		The end of the block
+@param context	A description of the block (used in error messages)
+*/
+BinaryReader::BinaryReader(const char *begin, const char *end, const std::string& context)
+:	m_begin(begin), m_pos(begin), m_end(end), m_context(context)
+{}
+
+//#################### BinaryReader - PUBLIC METHODS ####################
+bool BinaryReader::at_end() const
+{
+	return m_pos == m_end;
+}
+
+/**
+Reads a length-prefixed string from the block.
+
+@return				The string
+@throws Exception	If there are too few bytes left in the block
+*/
+std::string BinaryReader::read_string()
+{
+	int length = read<int>();
+	const char *chars = read_array<char>(length);
+	return std::string(chars, chars + length);
+}
+
+//#################### BinaryReader - PRIVATE METHODS ####################
+void BinaryReader::align()
+{
+	size_t offset = (m_pos - m_begin) % ALIGNMENT;
+	if(offset != 0)
+	{
+		check_available(ALIGNMENT - offset);
+		m_pos += ALIGNMENT - offset;
+	}
+}
+
+/**
+Checks that there are enough bytes left in the block for the specified number of elements.
+(The check is done by division, so that a large count can't make the byte count overflow.)
+
+@param count		The number of elements
+@param elementSize	The size of each element (in bytes)
+@throws Exception	If there are too few bytes left in the block
+*/
+void BinaryReader::check_available(size_t count, size_t elementSize) const
+{
+	if(count > static_cast<size_t>(m_end - m_pos) / elementSize) throw Exception("Unexpected end of data in " + m_context);
+}
+
+//#################### BinaryWriter - PUBLIC METHODS ####################
+const std::string& BinaryWriter::data() const
+{
+	return m_data;
+}
+
+void BinaryWriter::write_string(const std::string& s)
+{
+	write(static_cast<int>(s.length()));
+	write_array(s.data(), static_cast<int>(s.length()));
+}
+
+//#################### BinaryWriter - PRIVATE METHODS ####################
+void BinaryWriter::align()
+{
+	size_t offset = m_data.length() % BinaryReader::ALIGNMENT;
+	if(offset != 0) m_data.append(BinaryReader::ALIGNMENT - offset, '\0');
+}
+
+}
@@ -0,0 +1,81 @@
+/***
+ * hesperus: BinaryIO.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_BINARYIO
+#define H_HESP_BINARYIO
+
+#include <string>
+#include <vector>
+
+namespace hesp {
+
+/**
+This class reads values and arrays from a block of memory written by a BinaryWriter
+(typically a section of a memory-mapped binary level file). Arrays are aligned to
+ALIGNMENT bytes relative to the start of the block, so provided the block itself is
+suitably aligned, they can be used in place without copying.
+
+Note:	Values are stored in the native byte order of the machine that wrote them.
+*/
+class BinaryReader
+{
+	//#################### CONSTANTS ####################
+public:
+	enum
+	{
+		ALIGNMENT = 8
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	const char *m_begin;
+	const char *m_pos;
+	const char *m_end;
+	std::string m_context;		// a description of the block being read (used in error messages)
+
+	//#################### CONSTRUCTORS ####################
+public:
+	BinaryReader(const char *begin, const char *end, const std::string& context);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	bool at_end() const;
+	template <typename T> T read();
+	template <typename T> const T *read_array(int count);
+	std::string read_string();
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void align();
+	void check_available(size_t count, size_t elementSize = 1) const;
+};
+
+/**
+This class builds up a block of binary data that can later be read by a BinaryReader.
+*/
+class BinaryWriter
+{
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::string m_data;
+
+	//#################### PUBLIC METHODS ####################
+public:
+	const std::string& data() const;
+	template <typename T> void write(const T& value);
+	template <typename T> void write_array(const std::vector<T>& values);
+	template <typename T> void write_array(const T *values, int count);
+	void write_string(const std::string& s);
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void align();
+};
+
+}
+
+#include "BinaryIO.tpp"
+
+#endif
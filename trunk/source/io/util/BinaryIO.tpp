@@ -0,0 +1,74 @@
+/***
+ * hesperus: BinaryIO.tpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include <cstring>
+
+#include <source/exceptions/Exception.h>
+
+namespace hesp {
+
+//#################### BinaryReader - PUBLIC METHODS ####################
+/**
+Reads a single value from the block.
+
+@return				The value
+@throws Exception	If there are too few bytes left in the block
+*/
+template <typename T>
+T BinaryReader::read()
+{
+	check_available(sizeof(T));
+	T value;
+	std::memcpy(&value, m_pos, sizeof(T));
+	m_pos += sizeof(T);
+	return value;
+}
+
+/**
+Reads an aligned array of values from the block. The returned pointer points
+directly into the block, so it remains valid for as long as the block does.
+
+@param count		The number of values in the array
+@return				A pointer to the first value in the array
+@throws Exception	If the count is negative or there are too few bytes left in the block
+*/
+template <typename T>
+const T *BinaryReader::read_array(int count)
+{
+	if(count < 0) throw Exception("Negative array size in " + m_context);
+	align();
+	check_available(count, sizeof(T));
+	const T *values = reinterpret_cast<const T*>(m_pos);
+	m_pos += count * sizeof(T);
+	return values;
+}
+
+//#################### BinaryWriter - PUBLIC METHODS ####################
+template <typename T>
+void BinaryWriter::write(const T& value)
+{
+	m_data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void BinaryWriter::write_array(const std::vector<T>& values)
+{
+	write_array(values.empty() ? NULL : &values[0], static_cast<int>(values.size()));
+}
+
+/**
+Writes an array of values to the block, aligned so that it can be used in place when read back.
+
+@param values	A pointer to the first value in the array
+@param count	The number of values in the array
+*/
+template <typename T>
+void BinaryWriter::write_array(const T *values, int count)
+{
+	align();
+	if(count > 0) m_data.append(reinterpret_cast<const char*>(values), count * sizeof(T));
+}
+
+}
@@ -12,6 +12,18 @@ namespace bf = boost::filesystem;
 
 namespace hesp {
 
+//#################### PUBLIC METHODS ####################
+/**
+Adds the dynamic lighting for the specified polygons to the rendered scene (the polygons should
+already have been rendered using render()). By default, this does nothing: geometry renderers
+which don't support dynamic lighting can simply ignore it.
+
+@param polyIndices			The indices of the polygons to render
+@param dynamicLightManager	The dynamic light manager containing the lighting for the polygons
+*/
+void GeometryRenderer::render_dynamic_lighting(const std::vector<int>& polyIndices, const DynamicLightManager& dynamicLightManager) const
+{}
+
 //#################### PROTECTED METHODS ####################
 void GeometryRenderer::load_textures(const std::set<std::string>& textureNames)
 {
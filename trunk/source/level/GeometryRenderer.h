@@ -17,6 +17,7 @@ using boost::shared_ptr;
 namespace hesp {
 
 //#################### FORWARD DECLARATIONS ####################
+class DynamicLightManager;
 typedef shared_ptr<class Texture> Texture_Ptr;
 
 class GeometryRenderer
@@ -33,6 +34,10 @@ public:
 public:
 	virtual void render(const std::vector<int>& polyIndices) const = 0;
 
+	//#################### PUBLIC METHODS ####################
+public:
+	virtual void render_dynamic_lighting(const std::vector<int>& polyIndices, const DynamicLightManager& dynamicLightManager) const;
+
 	//#################### PROTECTED METHODS ####################
 protected:
 	void load_textures(const std::set<std::string>& textureNames);
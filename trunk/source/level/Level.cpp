@@ -7,6 +7,7 @@
 
 #include <source/level/nav/NavDataset.h>
 #include <source/level/nav/NavMesh.h>
+#include <source/level/objects/base/ObjectManager.h>
 #include <source/level/trees/BSPTree.h>
 #include <source/level/trees/TreeUtil.h>
 
@@ -14,14 +15,17 @@ namespace hesp {
 
 //#################### CONSTRUCTORS ####################
 Level::Level(const GeometryRenderer_Ptr& geomRenderer, const BSPTree_Ptr& tree,
-			 const PortalVector& portals, const LeafVisTable_Ptr& leafVis,
+			 const PortalVector& portals, const CompressedLeafVisTable_Ptr& leafVis,
 			 const ColPolyVector& onionPolygons, const OnionTree_Ptr& onionTree,
 			 const OnionPortalVector& onionPortals, const NavManager_Ptr& navManager,
-			 const ObjectManager_Ptr& objectManager)
+			 const ObjectManager_Ptr& objectManager, const DynamicLightManager_Ptr& dynamicLightManager)
 :	m_geomRenderer(geomRenderer), m_tree(tree), m_portals(portals), m_leafVis(leafVis),
 	m_onionPolygons(onionPolygons), m_onionTree(onionTree), m_onionPortals(onionPortals),
-	m_navManager(navManager), m_objectManager(objectManager)
-{}
+	m_navManager(navManager), m_objectManager(objectManager), m_dynamicLightManager(dynamicLightManager)
+{
+	// Allow the objects to create dynamic lights (e.g. muzzle flashes).
+	m_objectManager->set_dynamic_light_manager(dynamicLightManager);
+}
 
 //#################### PUBLIC METHODS ####################
 BSPTree_CPtr Level::bsp_tree() const
@@ -29,6 +33,11 @@ BSPTree_CPtr Level::bsp_tree() const
 	return m_tree;
 }
 
+const DynamicLightManager_Ptr& Level::dynamic_light_manager()
+{
+	return m_dynamicLightManager;
+}
+
 /**
 Determine which leaves are potentially visible from the specified eye position.
 */
@@ -43,10 +52,23 @@ std::vector<int> Level::find_visible_leaves(const Vector3d& eye) const
 	}
 
 	std::vector<int> visibleLeaves;
-	for(int i=0, size=m_leafVis->size(); i<size; ++i)
+	int leafCount = m_leafVis->size();
+	if(allVisible)
+	{
+		for(int i=0; i<leafCount; ++i) visibleLeaves.push_back(i);
+		return visibleLeaves;
+	}
+
+	// Decompress the row of the vis table for the current leaf and walk its set bits.
+	// TODO: View frustum culling.
+	typedef CompressedLeafVisTable::Word Word;
+	const std::vector<Word>& bits = m_leafVis->row_bits(curLeaf);
+	for(int w=0, wordCount=static_cast<int>(bits.size()); w<wordCount; ++w)
 	{
-		// TODO: View frustum culling.
-		if(allVisible || (*m_leafVis)(curLeaf,i)) visibleLeaves.push_back(i);
+		for(Word b = bits[w]; b != 0; b &= b - 1)
+		{
+			visibleLeaves.push_back(w * LeafVisTable::WORD_BITS + LeafVisTable::lowest_set_bit(b));
+		}
 	}
 
 	return visibleLeaves;
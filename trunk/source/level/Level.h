@@ -11,7 +11,7 @@ using boost::shared_ptr;
 
 #include <source/level/portals/OnionPortal.h>
 #include <source/level/portals/Portal.h>
-#include <source/level/vis/VisTable.h>
+#include <source/level/vis/CompressedLeafVisTable.h>
 #include <source/util/PolygonTypes.h>
 
 namespace hesp {
@@ -19,6 +19,7 @@ namespace hesp {
 //#################### FORWARD DECLARATIONS ####################
 typedef shared_ptr<class BSPTree> BSPTree_Ptr;
 typedef shared_ptr<const class BSPTree> BSPTree_CPtr;
+typedef shared_ptr<class DynamicLightManager> DynamicLightManager_Ptr;
 typedef shared_ptr<class GeometryRenderer> GeometryRenderer_Ptr;
 typedef shared_ptr<const class GeometryRenderer> GeometryRenderer_CPtr;
 typedef shared_ptr<class ModelManager> ModelManager_Ptr;
@@ -41,24 +42,26 @@ private:
 	GeometryRenderer_Ptr m_geomRenderer;
 	BSPTree_Ptr m_tree;
 	PortalVector m_portals;
-	LeafVisTable_Ptr m_leafVis;
+	CompressedLeafVisTable_Ptr m_leafVis;
 	ColPolyVector m_onionPolygons;
 	OnionTree_Ptr m_onionTree;
 	OnionPortalVector m_onionPortals;
 	NavManager_Ptr m_navManager;
 	ObjectManager_Ptr m_objectManager;
+	DynamicLightManager_Ptr m_dynamicLightManager;
 
 	//#################### CONSTRUCTORS ####################
 public:
 	Level(const GeometryRenderer_Ptr& geomRenderer, const BSPTree_Ptr& tree,
-		  const PortalVector& portals, const LeafVisTable_Ptr& leafVis,
+		  const PortalVector& portals, const CompressedLeafVisTable_Ptr& leafVis,
 		  const ColPolyVector& onionPolygons, const OnionTree_Ptr& onionTree,
 		  const OnionPortalVector& onionPortals, const NavManager_Ptr& navManager,
-		  const ObjectManager_Ptr& objectManager);
+		  const ObjectManager_Ptr& objectManager, const DynamicLightManager_Ptr& dynamicLightManager);
 
 	//#################### PUBLIC METHODS ####################
 public:
 	BSPTree_CPtr bsp_tree() const;
+	const DynamicLightManager_Ptr& dynamic_light_manager();
 	std::vector<int> find_visible_leaves(const Vector3d& eye) const;
 	GeometryRenderer_CPtr geom_renderer() const;
 	NavManager_CPtr nav_manager() const;
@@ -19,6 +19,7 @@
 #include <source/level/objects/components/ICmpModelRender.h>
 #include <source/level/sprites/SpriteManager.h>
 #include <source/level/trees/BSPTree.h>
+#include <source/level/lighting/DynamicLightManager.h>
 #include "GeometryRenderer.h"
 
 namespace hesp {
@@ -72,6 +73,7 @@ void LevelViewer::render_level() const
 		std::copy(leaf->polygon_indices().begin(), leaf->polygon_indices().end(), std::back_inserter(polyIndices));
 	}
 	m_level->geom_renderer()->render(polyIndices);
+	m_level->geom_renderer()->render_dynamic_lighting(polyIndices, *m_level->dynamic_light_manager());
 #if 0
 	std::cout << "Polygon Count " << polyIndices.size() << std::endl;
 #endif
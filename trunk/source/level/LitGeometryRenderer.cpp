@@ -7,16 +7,17 @@
 
 #include "LitGeometryRenderer.h"
 
+#include <source/level/lighting/DynamicLightManager.h>
 #include <source/textures/Texture.h>
 #include <source/textures/TextureFactory.h>
 
 namespace hesp {
 
 //#################### CONSTRUCTORS ####################
-LitGeometryRenderer::LitGeometryRenderer(const TexLitPolyVector& polygons, const std::vector<Image24_Ptr>& lightmaps)
-:	m_polygons(polygons)
+LitGeometryRenderer::LitGeometryRenderer(const TexLitPolyVector& polygons, const std::vector<Image24_Ptr>& lightmaps, const std::vector<int>& lightmapIndices)
+:	m_polygons(polygons), m_lightmapIndices(lightmapIndices)
 {
-	assert(polygons.size() == lightmaps.size());
+	assert(polygons.size() == lightmapIndices.size());
 
 	// Determine the set of unique texture names.
 	std::set<std::string> textureNames;
@@ -28,12 +29,13 @@ LitGeometryRenderer::LitGeometryRenderer(const TexLitPolyVector& polygons, const
 
 	load_textures(textureNames);
 
-	// Create the lightmaps.
+	// Create the lightmaps. Note that these are atlas pages containing many polygons' lightmaps, so they aren't mipmapped:
+	// the border around each lightmap only stops bilinear filtering bleeding between them at the top mip level.
 	int lightmapCount = static_cast<int>(lightmaps.size());
 	m_lightmaps.resize(lightmapCount);
 	for(int i=0; i<lightmapCount; ++i)
 	{
-		m_lightmaps[i] = TextureFactory::create_texture24(lightmaps[i], true);
+		m_lightmaps[i] = TextureFactory::create_texture24(lightmaps[i], true, false);
 	}
 }
 
@@ -44,6 +46,63 @@ void LitGeometryRenderer::render(const std::vector<int>& polyIndices) const
 	render_simple(polyIndices);
 }
 
+/**
+Adds the dynamic lighting for the specified polygons to the rendered scene. Each dynamically-lit
+polygon is redrawn with its texture modulated by the lighting at its vertices, and the result is
+added to what's already in the frame buffer.
+
+@param polyIndices			The indices of the polygons to render
+@param dynamicLightManager	The dynamic light manager containing the lighting for the polygons
+*/
+void LitGeometryRenderer::render_dynamic_lighting(const std::vector<int>& polyIndices, const DynamicLightManager& dynamicLightManager) const
+{
+	typedef DynamicLightManager::PolygonLighting PolygonLighting;
+	const PolygonLighting& lighting = dynamicLightManager.polygon_lighting();
+	if(lighting.empty()) return;
+
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_TEXTURE_BIT | GL_CURRENT_BIT);
+
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+	glEnable(GL_TEXTURE_2D);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	// The polygons have already been drawn, so add the lighting on top of them without touching the z-buffer.
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	glDepthMask(GL_FALSE);
+
+	const Texture *boundTexture = NULL;
+
+	int indexCount = static_cast<int>(polyIndices.size());
+	for(int i=0; i<indexCount; ++i)
+	{
+		PolygonLighting::const_iterator it = lighting.find(polyIndices[i]);
+		if(it == lighting.end()) continue;
+
+		TexturedLitPolygon_Ptr poly = m_polygons[polyIndices[i]];
+		std::map<std::string,Texture_Ptr>::const_iterator jt = m_textures.find(poly->auxiliary_data());
+		if(jt->second.get() != boundTexture)
+		{
+			jt->second->bind();
+			boundTexture = jt->second.get();
+		}
+
+		const DynamicLightManager::VertexColours& colours = it->second;
+		int vertCount = poly->vertex_count();
+		glBegin(GL_POLYGON);
+			for(int j=0; j<vertCount; ++j)
+			{
+				const TexturedLitVector3d& v = poly->vertex(j);
+				glColor3d(colours[j].r, colours[j].g, colours[j].b);
+				glTexCoord2d(v.u, v.v);
+				glVertex3d(v.x, v.y, v.z);
+			}
+		glEnd();
+	}
+
+	glPopAttrib();
+}
+
 //#################### PRIVATE METHODS ####################
 void LitGeometryRenderer::render_simple(const std::vector<int>& polyIndices) const
 {
@@ -60,6 +119,11 @@ void LitGeometryRenderer::render_simple(const std::vector<int>& polyIndices) con
 
 	glColor3d(1,1,1);
 
+	// Polygons which are drawn consecutively often share a texture, and usually share a lightmap atlas page,
+	// so keep track of what's currently bound and avoid rebinding it.
+	const Texture *boundTexture = NULL;
+	const Texture *boundLightmap = NULL;
+
 	int indexCount = static_cast<int>(polyIndices.size());
 	for(int i=0; i<indexCount; ++i)
 	{
@@ -68,11 +132,20 @@ void LitGeometryRenderer::render_simple(const std::vector<int>& polyIndices) con
 		// Note:	If we got to this point, all textures were loaded successfully,
 		//			so the texture's definitely in the map.
 		std::map<std::string,Texture_Ptr>::const_iterator jt = m_textures.find(poly->auxiliary_data());
-		glActiveTextureARB(GL_TEXTURE0_ARB);
-		jt->second->bind();
-
-		glActiveTextureARB(GL_TEXTURE1_ARB);
-		m_lightmaps[polyIndices[i]]->bind();
+		if(jt->second.get() != boundTexture)
+		{
+			glActiveTextureARB(GL_TEXTURE0_ARB);
+			jt->second->bind();
+			boundTexture = jt->second.get();
+		}
+
+		const Texture_Ptr& lightmap = m_lightmaps[m_lightmapIndices[polyIndices[i]]];
+		if(lightmap.get() != boundLightmap)
+		{
+			glActiveTextureARB(GL_TEXTURE1_ARB);
+			lightmap->bind();
+			boundLightmap = lightmap.get();
+		}
 
 		int vertCount = poly->vertex_count();
 		glBegin(GL_POLYGON);
@@ -22,14 +22,16 @@ private:
 private:
 	TexLitPolyVector m_polygons;
 	std::vector<Texture_Ptr> m_lightmaps;
+	std::vector<int> m_lightmapIndices;
 
 	//#################### CONSTRUCTORS ####################
 public:
-	LitGeometryRenderer(const TexLitPolyVector& polygons, const std::vector<Image24_Ptr>& lightmaps);
+	LitGeometryRenderer(const TexLitPolyVector& polygons, const std::vector<Image24_Ptr>& lightmaps, const std::vector<int>& lightmapIndices);
 
 	//#################### PUBLIC METHODS ####################
 public:
 	void render(const std::vector<int>& polyIndices) const;
+	void render_dynamic_lighting(const std::vector<int>& polyIndices, const DynamicLightManager& dynamicLightManager) const;
 
 	//#################### PRIVATE METHODS ####################
 private:
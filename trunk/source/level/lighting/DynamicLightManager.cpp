@@ -0,0 +1,355 @@
+/***
+ * hesperus: DynamicLightManager.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "DynamicLightManager.h"
+
+#include <algorithm>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+using boost::lexical_cast;
+
+#include <source/exceptions/Exception.h>
+#include <source/level/trees/BSPTree.h>
+#include <source/level/trees/BSPUtil.h>
+#include <source/level/trees/TreeUtil.h>
+#include <source/level/vis/CompressedLeafVisTable.h>
+
+namespace {
+
+//#################### CONSTANTS ####################
+// The intensity below which a dynamic light's contribution is ignored (in every colour channel).
+const double ATTENUATION_CUTOFF = 1.0 / 64;
+
+// The distance by which vertices are moved off their polygons before testing them for line-of-sight to a light
+// (this stops the polygons which meet a vertex from shadowing it).
+const double VERTEX_OFFSET = 0.01;
+
+}
+
+namespace hesp {
+
+//#################### PUBLIC METHODS ####################
+/**
+Adds a dynamic light. The light will be lit as soon as update() has had enough time to do so.
+
+@param light	The light
+@return			The ID of the new light
+*/
+int DynamicLightManager::add_light(const Light& light)
+{
+	int id = m_idAllocator.allocate();
+	LightState& state = m_lights.insert(std::make_pair(id, LightState(light))).first->second;
+	queue_relight(id, state);
+	return id;
+}
+
+/**
+Returns the dynamic light with the specified ID.
+
+@param id			The ID of the light
+@return				The light
+@throws Exception	If there is no light with the specified ID
+*/
+const Light& DynamicLightManager::light(int id) const
+{
+	std::map<int,LightState>::const_iterator it = m_lights.find(id);
+	if(it == m_lights.end()) throw Exception("There is no dynamic light with ID " + lexical_cast<std::string,int>(id));
+	return it->second.light;
+}
+
+/**
+Returns the total dynamic lighting at the vertices of each polygon which is currently dynamically lit.
+Polygons which are not in the map receive no dynamic lighting.
+
+@return	As stated
+*/
+const DynamicLightManager::PolygonLighting& DynamicLightManager::polygon_lighting() const
+{
+	return m_polygonLighting;
+}
+
+/**
+Removes a dynamic light (its lighting is removed at the next update).
+
+@param id			The ID of the light
+@throws Exception	If there is no light with the specified ID
+*/
+void DynamicLightManager::remove_light(int id)
+{
+	LightState& state = light_state(id);
+
+	for(PolygonLighting::const_iterator it=state.lighting.begin(), iend=state.lighting.end(); it!=iend; ++it)
+	{
+		m_changedPolygons.insert(it->first);
+	}
+
+	if(state.queued) m_updateQueue.erase(std::find(m_updateQueue.begin(), m_updateQueue.end(), id));
+	m_lights.erase(id);
+	m_idAllocator.deallocate(id);
+}
+
+/**
+Changes a dynamic light (e.g. to move it). Until the light has been relit, its old lighting remains in place.
+
+@param id			The ID of the light
+@param light		The new version of the light
+@throws Exception	If there is no light with the specified ID
+*/
+void DynamicLightManager::set_light(int id, const Light& light)
+{
+	LightState& state = light_state(id);
+	state.light = light;
+	queue_relight(id, state);
+}
+
+/**
+Relights as many of the changed lights as possible within the specified time budget, and then
+recalculates the total dynamic lighting for any polygons whose lighting has changed. At least
+one polygon is relit on every call (if there's any work to do), so that updates always make
+progress, however small the budget.
+
+@param budgetMicroseconds	The time budget for relighting (in microseconds)
+*/
+void DynamicLightManager::update(int budgetMicroseconds)
+{
+	using namespace boost::posix_time;
+	ptime startTime = microsec_clock::universal_time();
+
+	bool first = true;
+	while(!m_updateQueue.empty())
+	{
+		if(!first && (microsec_clock::universal_time() - startTime).total_microseconds() >= budgetMicroseconds) break;
+		first = false;
+
+		LightState& state = light_state(m_updateQueue.front());
+		if(!state.started)
+		{
+			begin_relight(state);
+			state.started = true;
+		}
+
+		if(state.pendingPos < state.pendingPolygons.size())
+		{
+			relight_polygon(state.light, state.pendingPolygons[state.pendingPos++], state.pendingLighting);
+		}
+
+		if(state.pendingPos == state.pendingPolygons.size())
+		{
+			commit_relight(state);
+			m_updateQueue.pop_front();
+		}
+	}
+
+	recalculate_polygon_lighting();
+}
+
+//#################### PRIVATE METHODS ####################
+/**
+Determines which polygons a light can potentially reach from its current position, namely those
+in the leaves potentially visible from the light's leaf which lie within its radius of influence.
+
+@param state	The state of the light
+*/
+void DynamicLightManager::begin_relight(LightState& state) const
+{
+	const Light& light = state.light;
+
+	// If the light is too weak to make a significant contribution anywhere, it can't reach any polygons.
+	double radiusSquared = influence_radius_squared(light);
+	if(radiusSquared <= 0) return;
+
+	// Likewise if the light is in a wall.
+	int lightLeaf = TreeUtil::find_leaf_index(light.position, m_tree);
+	if(lightLeaf >= m_tree->empty_leaf_count()) return;
+
+	typedef CompressedLeafVisTable::Word Word;
+	const std::vector<Word>& bits = m_leafVis->row_bits(lightLeaf);
+	for(int w=0, wordCount=static_cast<int>(bits.size()); w<wordCount; ++w)
+	{
+		for(Word b = bits[w]; b != 0; b &= b - 1)
+		{
+			int i = w * LeafVisTable::WORD_BITS + LeafVisTable::lowest_set_bit(b);
+			if(!m_leafBounds[i]) continue;
+			if(distance_squared_to_bounding_box(light.position, *m_leafBounds[i]) > radiusSquared) continue;
+
+			const std::vector<int>& polyIndices = m_tree->leaf(i)->polygon_indices();
+			for(std::vector<int>::const_iterator jt=polyIndices.begin(), jend=polyIndices.end(); jt!=jend; ++jt)
+			{
+				if(distance_squared_to_bounding_box(light.position, m_polygons[*jt].bounds) > radiusSquared) continue;
+				state.pendingPolygons.push_back(*jt);
+			}
+		}
+	}
+
+	std::sort(state.pendingPolygons.begin(), state.pendingPolygons.end());
+	state.pendingPolygons.erase(std::unique(state.pendingPolygons.begin(), state.pendingPolygons.end()), state.pendingPolygons.end());
+}
+
+/**
+Replaces a light's current lighting with the lighting calculated for its new position,
+and marks every polygon whose lighting differs as needing to be recalculated.
+
+@param state	The state of the light
+*/
+void DynamicLightManager::commit_relight(LightState& state)
+{
+	for(PolygonLighting::const_iterator it=state.lighting.begin(), iend=state.lighting.end(); it!=iend; ++it)
+	{
+		m_changedPolygons.insert(it->first);
+	}
+	for(PolygonLighting::const_iterator it=state.pendingLighting.begin(), iend=state.pendingLighting.end(); it!=iend; ++it)
+	{
+		m_changedPolygons.insert(it->first);
+	}
+
+	state.lighting.swap(state.pendingLighting);
+	state.pendingLighting.clear();
+	state.pendingPolygons.clear();
+	state.pendingPos = 0;
+	state.queued = false;
+	state.started = false;
+}
+
+/**
+Constructs a bounding box for the polygons in each empty leaf of the tree (leaves without polygons get no box).
+*/
+void DynamicLightManager::construct_leaf_bounds()
+{
+	int emptyLeafCount = m_tree->empty_leaf_count();
+	m_leafBounds.assign(emptyLeafCount, boost::none);
+	for(int i=0; i<emptyLeafCount; ++i)
+	{
+		const std::vector<int>& polyIndices = m_tree->leaf(i)->polygon_indices();
+		if(polyIndices.empty()) continue;
+
+		Vector3d mins = m_polygons[polyIndices[0]].bounds.minimum();
+		Vector3d maxs = m_polygons[polyIndices[0]].bounds.maximum();
+		for(std::vector<int>::const_iterator jt=polyIndices.begin()+1, jend=polyIndices.end(); jt!=jend; ++jt)
+		{
+			const AABB3d& bounds = m_polygons[*jt].bounds;
+			mins.x = std::min(mins.x, bounds.minimum().x);	maxs.x = std::max(maxs.x, bounds.maximum().x);
+			mins.y = std::min(mins.y, bounds.minimum().y);	maxs.y = std::max(maxs.y, bounds.maximum().y);
+			mins.z = std::min(mins.z, bounds.minimum().z);	maxs.z = std::max(maxs.z, bounds.maximum().z);
+		}
+		m_leafBounds[i] = AABB3d(mins, maxs);
+	}
+}
+
+/**
+Calculates the squared radius beyond which the specified light's contribution is weaker than the
+attenuation cutoff in every colour channel. The attenuation is the same as for the baked lights,
+i.e. c / (1 + d^2/r^2) for a light of colour c and falloff radius r, so this is r^2 (c_max/cutoff - 1).
+
+@param light	The light
+@return			The squared radius (<= 0 if the light is too weak to matter anywhere)
+*/
+double DynamicLightManager::influence_radius_squared(const Light& light)
+{
+	double maxComponent = std::max(std::max(light.colour.r, light.colour.g), light.colour.b);
+	return light.falloffRadius * light.falloffRadius * (maxComponent / ATTENUATION_CUTOFF - 1);
+}
+
+/**
+Returns the state of the dynamic light with the specified ID.
+
+@param id			The ID of the light
+@return				The state of the light
+@throws Exception	If there is no light with the specified ID
+*/
+DynamicLightManager::LightState& DynamicLightManager::light_state(int id)
+{
+	std::map<int,LightState>::iterator it = m_lights.find(id);
+	if(it == m_lights.end()) throw Exception("There is no dynamic light with ID " + lexical_cast<std::string,int>(id));
+	return it->second;
+}
+
+/**
+Queues a light to be relit. If the light is already part-way through being relit,
+the relighting restarts from scratch (but the light keeps its place in the queue).
+
+@param id		The ID of the light
+@param state	The state of the light
+*/
+void DynamicLightManager::queue_relight(int id, LightState& state)
+{
+	state.started = false;
+	state.pendingPolygons.clear();
+	state.pendingPos = 0;
+	state.pendingLighting.clear();
+
+	if(!state.queued)
+	{
+		m_updateQueue.push_back(id);
+		state.queued = true;
+	}
+}
+
+/**
+Recalculates the total dynamic lighting for each polygon whose lighting has changed.
+*/
+void DynamicLightManager::recalculate_polygon_lighting()
+{
+	for(std::set<int>::const_iterator it=m_changedPolygons.begin(), iend=m_changedPolygons.end(); it!=iend; ++it)
+	{
+		int n = *it;
+		VertexColours total;
+		for(std::map<int,LightState>::const_iterator jt=m_lights.begin(), jend=m_lights.end(); jt!=jend; ++jt)
+		{
+			PolygonLighting::const_iterator kt = jt->second.lighting.find(n);
+			if(kt == jt->second.lighting.end()) continue;
+
+			const VertexColours& colours = kt->second;
+			if(total.empty()) total = colours;
+			else for(size_t j=0, size=colours.size(); j<size; ++j) total[j] += colours[j];
+		}
+
+		if(total.empty()) m_polygonLighting.erase(n);
+		else m_polygonLighting[n].swap(total);
+	}
+	m_changedPolygons.clear();
+}
+
+/**
+Calculates the lighting a light contributes to the vertices of polygon n (if any).
+
+@param light		The light
+@param n			The index of the polygon
+@param lighting		The lighting map to which to add the polygon's lighting (if it's lit at all)
+*/
+void DynamicLightManager::relight_polygon(const Light& light, int n, PolygonLighting& lighting) const
+{
+	const PolygonInfo& poly = m_polygons[n];
+
+	// Early-out opportunity: the light is not in front of the polygon.
+	if(classify_point_against_plane(light.position, poly.plane) != CP_FRONT) return;
+
+	int vertCount = static_cast<int>(poly.vertices.size());
+	std::vector<Vector3d> points;
+	points.reserve(vertCount);
+	for(int j=0; j<vertCount; ++j)
+	{
+		points.push_back(poly.vertices[j] + poly.plane.normal() * VERTEX_OFFSET);
+	}
+	std::vector<bool> visibility = BSPUtil::line_of_sight_packet(light.position, points, m_tree);
+
+	// Use the same quadratic attenuation as the baked lights (see LightmapGrid::lightmap_from_light).
+	const double c3 = 1/(light.falloffRadius * light.falloffRadius);
+
+	VertexColours colours(vertCount);
+	bool lit = false;
+	for(int j=0; j<vertCount; ++j)
+	{
+		if(!visibility[j]) continue;
+		double dL = poly.vertices[j].distance(light.position);
+		double fAtt = std::min(1/(1.0 + c3*dL*dL), 1.0);
+		colours[j] = fAtt * light.colour;
+		lit = true;
+	}
+
+	if(lit) lighting[n].swap(colours);
+}
+
+}
@@ -0,0 +1,127 @@
+/***
+ * hesperus: DynamicLightManager.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_DYNAMICLIGHTMANAGER
+#define H_HESP_DYNAMICLIGHTMANAGER
+
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+
+#include <source/math/geom/AABB.h>
+#include <source/math/geom/Plane.h>
+#include <source/util/IDAllocator.h>
+#include "Light.h"
+
+namespace hesp {
+
+//#################### FORWARD DECLARATIONS ####################
+typedef shared_ptr<const class BSPTree> BSPTree_CPtr;
+typedef shared_ptr<const class CompressedLeafVisTable> CompressedLeafVisTable_CPtr;
+
+/**
+This class manages point lights which can be created, moved and destroyed at runtime
+(e.g. for muzzle flashes and projectiles), as opposed to the static lights which are
+baked into the lightmaps by hlight.
+
+Each dynamic light is evaluated at the vertices of the polygons it can reach: these are
+found by walking the PVS row of the light's leaf and culling the visible leaves and their
+polygons against the light's radius of influence. The lighting at each vertex is then
+attenuated in the same way as for the baked lights and shadowed by casting rays through
+the BSP tree. Lights which have changed are relit incrementally, a polygon at a time, in
+update(), which stops once its per-frame time budget is exhausted; a light's new lighting
+only replaces its old lighting once all of its polygons have been relit, and only the
+polygons whose total dynamic lighting has changed are then recalculated.
+*/
+class DynamicLightManager
+{
+	//#################### TYPEDEFS ####################
+public:
+	typedef std::vector<Colour3d> VertexColours;
+	typedef std::map<int,VertexColours> PolygonLighting;	// maps polygon indices to the dynamic lighting at their vertices
+
+	//#################### NESTED CLASSES ####################
+private:
+	struct PolygonInfo
+	{
+		std::vector<Vector3d> vertices;
+		Plane plane;
+		AABB3d bounds;
+
+		PolygonInfo(const std::vector<Vector3d>& vertices_, const Plane& plane_, const AABB3d& bounds_)
+		:	vertices(vertices_), plane(plane_), bounds(bounds_)
+		{}
+	};
+
+	struct LightState
+	{
+		Light light;
+		PolygonLighting lighting;			// the lighting the light currently contributes to each polygon it reaches
+
+		bool queued;						// whether or not the light is waiting to be relit
+		bool started;						// whether or not the polygons to be relit have been determined
+		std::vector<int> pendingPolygons;	// the polygons the light can potentially reach from its new position
+		size_t pendingPos;					// the number of pending polygons relit so far
+		PolygonLighting pendingLighting;	// the lighting calculated so far for the light's new position
+
+		explicit LightState(const Light& light_)
+		:	light(light_), queued(false), started(false), pendingPos(0)
+		{}
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::vector<PolygonInfo> m_polygons;
+	BSPTree_CPtr m_tree;
+	CompressedLeafVisTable_CPtr m_leafVis;
+	std::vector<boost::optional<AABB3d> > m_leafBounds;
+
+	IDAllocator m_idAllocator;
+	std::map<int,LightState> m_lights;
+	std::deque<int> m_updateQueue;			// the IDs of the lights waiting to be relit (in the order in which they changed)
+
+	PolygonLighting m_polygonLighting;		// the total dynamic lighting for each dynamically-lit polygon
+	std::set<int> m_changedPolygons;		// the polygons whose total dynamic lighting needs recalculating
+
+	//#################### CONSTRUCTORS ####################
+public:
+	template <typename Poly>
+	DynamicLightManager(const std::vector<shared_ptr<Poly> >& polygons, const BSPTree_CPtr& tree, const CompressedLeafVisTable_CPtr& leafVis);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	int add_light(const Light& light);
+	const Light& light(int id) const;
+	const PolygonLighting& polygon_lighting() const;
+	void remove_light(int id);
+	void set_light(int id, const Light& light);
+	void update(int budgetMicroseconds);
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void begin_relight(LightState& state) const;
+	void commit_relight(LightState& state);
+	void construct_leaf_bounds();
+	static double influence_radius_squared(const Light& light);
+	LightState& light_state(int id);
+	void queue_relight(int id, LightState& state);
+	void recalculate_polygon_lighting();
+	void relight_polygon(const Light& light, int n, PolygonLighting& lighting) const;
+};
+
+//#################### TYPEDEFS ####################
+typedef shared_ptr<DynamicLightManager> DynamicLightManager_Ptr;
+typedef shared_ptr<const DynamicLightManager> DynamicLightManager_CPtr;
+
+}
+
+#include "DynamicLightManager.tpp"
+
+#endif
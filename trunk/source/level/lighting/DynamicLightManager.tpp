@@ -0,0 +1,41 @@
+/***
+ * hesperus: DynamicLightManager.tpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include <source/math/Constants.h>
+#include <source/math/geom/GeomUtil.h>
+
+namespace hesp {
+
+//#################### CONSTRUCTORS ####################
+/**
+Constructs a dynamic light manager for a level.
+
+@param polygons		The level polygons
+@param tree			The BSP tree for the level
+@param leafVis		The leaf visibility table for the level
+*/
+template <typename Poly>
+DynamicLightManager::DynamicLightManager(const std::vector<shared_ptr<Poly> >& polygons, const BSPTree_CPtr& tree,
+										 const CompressedLeafVisTable_CPtr& leafVis)
+:	m_tree(tree), m_leafVis(leafVis)
+{
+	int polyCount = static_cast<int>(polygons.size());
+	m_polygons.reserve(polyCount);
+	for(int i=0; i<polyCount; ++i)
+	{
+		const Poly& poly = *polygons[i];
+
+		int vertCount = poly.vertex_count();
+		std::vector<Vector3d> vertices;
+		vertices.reserve(vertCount);
+		for(int j=0; j<vertCount; ++j) vertices.push_back(poly.vertex(j));
+
+		m_polygons.push_back(PolygonInfo(vertices, make_plane(poly), construct_bounding_box(std::vector<shared_ptr<Poly> >(1, polygons[i]), EPSILON)));
+	}
+
+	construct_leaf_bounds();
+}
+
+}
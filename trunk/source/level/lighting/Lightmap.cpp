@@ -49,6 +49,9 @@ Lightmap& Lightmap::operator+=(const Lightmap& rhs)
 }
 
 //#################### PUBLIC METHODS ####################
+int Lightmap::cols() const	{ return m_cols; }
+int Lightmap::rows() const	{ return m_rows; }
+
 Image24_Ptr Lightmap::to_image() const
 {
 	Image24_Ptr image(new SimpleImage24(m_cols, m_rows));
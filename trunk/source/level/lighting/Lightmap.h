@@ -35,6 +35,8 @@ public:
 
 	//#################### PUBLIC METHODS ####################
 public:
+	int cols() const;
+	int rows() const;
 	Image24_Ptr to_image() const;
 };
 
@@ -0,0 +1,268 @@
+/***
+ * hesperus: LightmapAtlas.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "LightmapAtlas.h"
+
+#include <algorithm>
+
+#include <boost/lexical_cast.hpp>
+using boost::lexical_cast;
+
+#include <source/exceptions/Exception.h>
+#include <source/exceptions/InvalidParameterException.h>
+#include "Lightmap.h"
+
+namespace hesp {
+
+//#################### CONSTRUCTORS ####################
+/**
+Constructs a lightmap atlas.
+
+@param inputPolygons		The lit polygons (with lightmap coordinates relative to their own lightmaps)
+@param inputLightmaps		The lightmaps (one per polygon)
+@param pageSize				The maximum width and height of an atlas page (must be a power of two)
+@param padding				The width of the border of replicated lumels around each lightmap
+@throws InvalidParameterException	If the numbers of polygons and lightmaps differ, or the page size or padding is invalid
+*/
+LightmapAtlas::LightmapAtlas(const TexLitPolyVector& inputPolygons, const LightmapVector& inputLightmaps, int pageSize, int padding)
+:	m_inputPolygons(inputPolygons), m_inputLightmaps(inputLightmaps), m_pageSize(pageSize), m_padding(padding)
+{
+	if(inputPolygons.size() != inputLightmaps.size()) throw InvalidParameterException("There must be exactly one lightmap per polygon");
+	if(pageSize <= 0 || next_power_of_two(pageSize) != pageSize) throw InvalidParameterException("The atlas page size must be a power of two");
+	if(padding < 0) throw InvalidParameterException("The atlas padding must be non-negative");
+}
+
+//#################### PUBLIC METHODS ####################
+/**
+Packs the lightmaps into atlas pages and remaps the polygons' lightmap coordinates accordingly.
+*/
+void LightmapAtlas::build()
+{
+	if(m_pages) return;
+
+	int polyCount = static_cast<int>(m_inputPolygons.size());
+	std::vector<std::pair<int,int> > lightmapSizes(polyCount);
+	for(int i=0; i<polyCount; ++i)
+	{
+		lightmapSizes[i] = std::make_pair(m_inputLightmaps[i]->rows(), m_inputLightmaps[i]->cols());
+	}
+
+	std::vector<Placement> placements;
+	std::vector<std::pair<int,int> > pageSizes;
+	pack_lightmaps(lightmapSizes, m_pageSize, m_padding, placements, pageSizes);
+
+	// Create the pages.
+	int pageCount = static_cast<int>(pageSizes.size());
+	m_pages.reset(new LightmapVector(pageCount));
+	for(int i=0; i<pageCount; ++i)
+	{
+		(*m_pages)[i].reset(new Lightmap(pageSizes[i].second, pageSizes[i].first));
+	}
+
+	// Copy each lightmap onto its page and remap the corresponding polygon.
+	m_outputPolygons.reset(new TexLitPolyVector(polyCount));
+	m_lightmapIndices.resize(polyCount);
+	for(int i=0; i<polyCount; ++i)
+	{
+		const Placement& placement = placements[i];
+		const Lightmap& lightmap = *m_inputLightmaps[i];
+		Lightmap& page = *(*m_pages)[placement.page];
+
+		blit_lightmap(lightmap, page, placement);
+		(*m_outputPolygons)[i] = remap_polygon(*m_inputPolygons[i], lightmap, placement, page);
+		m_lightmapIndices[i] = placement.page;
+	}
+}
+
+/**
+Returns the index of the atlas page containing each polygon's lightmap (the atlas should have been built first).
+
+@return	As stated
+*/
+const std::vector<int>& LightmapAtlas::lightmap_indices() const
+{
+	return m_lightmapIndices;
+}
+
+/**
+Returns the remapped lit polygons (the atlas should have been built first).
+
+@return	As stated
+*/
+LightmapAtlas::TexLitPolyVector_CPtr LightmapAtlas::lit_polygons() const
+{
+	return m_outputPolygons;
+}
+
+/**
+Calculates the total number of lumels (including the borders and the unused space) on the
+atlas pages into which lightmaps of the specified sizes would be packed. This is the amount
+of lightmap memory the level will actually use, so it can be checked against a budget before
+the lightmaps themselves have been generated.
+
+@param lightmapSizes	The (rows, cols) of each lightmap
+@param pageSize			The maximum width and height of an atlas page (must be a power of two)
+@param padding			The width of the border of replicated lumels around each lightmap
+@return					The total number of lumels on the pages
+@throws Exception		If a lightmap (plus its border) is too large to fit on a page
+*/
+int LightmapAtlas::packed_lumel_count(const std::vector<std::pair<int,int> >& lightmapSizes, int pageSize, int padding)
+{
+	std::vector<Placement> placements;
+	std::vector<std::pair<int,int> > pageSizes;
+	pack_lightmaps(lightmapSizes, pageSize, padding, placements, pageSizes);
+
+	int lumelCount = 0;
+	for(size_t i=0, size=pageSizes.size(); i<size; ++i)
+	{
+		lumelCount += pageSizes[i].first * pageSizes[i].second;
+	}
+	return lumelCount;
+}
+
+/**
+Returns the atlas pages (the atlas should have been built first).
+
+@return	As stated
+*/
+LightmapAtlas::LightmapVector_CPtr LightmapAtlas::pages() const
+{
+	return m_pages;
+}
+
+//#################### PRIVATE METHODS ####################
+/**
+Copies a lightmap onto its atlas page, replicating its edge lumels into the surrounding border.
+
+@param lightmap		The lightmap
+@param page			The page
+@param placement	The position of the lightmap on the page
+*/
+void LightmapAtlas::blit_lightmap(const Lightmap& lightmap, Lightmap& page, const Placement& placement) const
+{
+	int rows = lightmap.rows(), cols = lightmap.cols();
+	for(int r=-m_padding; r<rows+m_padding; ++r)
+	{
+		int sourceRow = std::min(std::max(r, 0), rows-1);
+		for(int c=-m_padding; c<cols+m_padding; ++c)
+		{
+			int sourceCol = std::min(std::max(c, 0), cols-1);
+			page(placement.y + r, placement.x + c) = lightmap(sourceRow, sourceCol);
+		}
+	}
+}
+
+/**
+Returns the smallest power of two which is greater than or equal to n.
+
+@param n	A positive integer
+@return		As stated
+*/
+int LightmapAtlas::next_power_of_two(int n)
+{
+	int result = 1;
+	while(result < n) result <<= 1;
+	return result;
+}
+
+/**
+Assigns each lightmap a position on an atlas page. The lightmaps are placed on horizontal
+shelves in order of decreasing height (with ties broken by polygon index, so that the
+result is deterministic), and a new page is started whenever the current one is full.
+
+@param lightmapSizes	The (rows, cols) of each lightmap
+@param pageSize			The maximum width and height of an atlas page
+@param padding			The width of the border of replicated lumels around each lightmap
+@param placements		Used to return the position of each lightmap to the caller
+@param pageSizes		Used to return the (width, height) of each page to the caller (each rounded up to a power of two)
+@throws Exception		If a lightmap (plus its border) is too large to fit on a page
+*/
+void LightmapAtlas::pack_lightmaps(const std::vector<std::pair<int,int> >& lightmapSizes, int pageSize, int padding,
+								   std::vector<Placement>& placements, std::vector<std::pair<int,int> >& pageSizes)
+{
+	int lightmapCount = static_cast<int>(lightmapSizes.size());
+
+	std::vector<std::pair<int,int> > order;
+	order.reserve(lightmapCount);
+	for(int i=0; i<lightmapCount; ++i)
+	{
+		order.push_back(std::make_pair(-lightmapSizes[i].first, i));
+	}
+	std::sort(order.begin(), order.end());
+
+	placements.resize(lightmapCount);
+	int page = -1, shelfX = 0, shelfY = 0, shelfHeight = 0;
+	for(int k=0; k<lightmapCount; ++k)
+	{
+		int i = order[k].second;
+		int w = lightmapSizes[i].second + 2*padding;
+		int h = lightmapSizes[i].first + 2*padding;
+		if(w > pageSize || h > pageSize)
+		{
+			throw Exception("Lightmap " + lexical_cast<std::string,int>(i) + " is too large to fit on a lightmap atlas page");
+		}
+
+		if(page == -1 || shelfX + w > pageSize)
+		{
+			// Start a new shelf below the current one (or at the top of a new page if there's no room left on this one).
+			// Since the lightmaps are sorted by height, the first lightmap on a shelf determines its height.
+			shelfY += shelfHeight;
+			shelfX = 0;
+			shelfHeight = h;
+			if(page == -1 || shelfY + h > pageSize)
+			{
+				++page;
+				shelfY = 0;
+				pageSizes.push_back(std::make_pair(0, 0));
+			}
+		}
+
+		placements[i].page = page;
+		placements[i].x = shelfX + padding;
+		placements[i].y = shelfY + padding;
+		shelfX += w;
+
+		pageSizes.back().first = std::max(pageSizes.back().first, shelfX);
+		pageSizes.back().second = std::max(pageSizes.back().second, shelfY + h);
+	}
+
+	// Round the page dimensions up to powers of two (in practice, this only shrinks the last page).
+	int pageCount = static_cast<int>(pageSizes.size());
+	for(int i=0; i<pageCount; ++i)
+	{
+		pageSizes[i].first = next_power_of_two(pageSizes[i].first);
+		pageSizes[i].second = next_power_of_two(pageSizes[i].second);
+	}
+}
+
+/**
+Makes a copy of a lit polygon whose lightmap coordinates refer to its lightmap's position on its atlas page.
+
+@param poly			The polygon
+@param lightmap		The polygon's lightmap
+@param placement	The position of the lightmap on its page
+@param page			The page
+@return				The remapped polygon
+*/
+TexturedLitPolygon_Ptr LightmapAtlas::remap_polygon(const TexturedLitPolygon& poly, const Lightmap& lightmap, const Placement& placement,
+													const Lightmap& page) const
+{
+	double pageWidth = page.cols(), pageHeight = page.rows();
+
+	int vertCount = poly.vertex_count();
+	std::vector<TexturedLitVector3d> vertices;
+	vertices.reserve(vertCount);
+	for(int j=0; j<vertCount; ++j)
+	{
+		const TexturedLitVector3d& v = poly.vertex(j);
+		double lu = (placement.x + v.lu * lightmap.cols()) / pageWidth;
+		double lv = (placement.y + v.lv * lightmap.rows()) / pageHeight;
+		vertices.push_back(TexturedLitVector3d(v.x, v.y, v.z, v.u, v.v, lu, lv));
+	}
+
+	return TexturedLitPolygon_Ptr(new TexturedLitPolygon(vertices, poly.auxiliary_data()));
+}
+
+}
@@ -0,0 +1,92 @@
+/***
+ * hesperus: LightmapAtlas.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_LIGHTMAPATLAS
+#define H_HESP_LIGHTMAPATLAS
+
+#include <utility>
+#include <vector>
+
+#include <source/util/PolygonTypes.h>
+
+namespace hesp {
+
+//#################### FORWARD DECLARATIONS ####################
+typedef shared_ptr<class Lightmap> Lightmap_Ptr;
+
+/**
+This class packs the per-polygon lightmaps produced by the lightmap generator into a
+small number of large atlas pages, and rewrites the lightmap coordinates of the lit
+polygons so that they refer to the appropriate region of their page. Each lightmap is
+surrounded by a border of replicated edge lumels so that bilinear filtering does not
+bleed light from neighbouring lightmaps on the same page. The border doesn't protect the
+smaller mip levels of a page, so the pages must be rendered without mipmapping.
+*/
+class LightmapAtlas
+{
+	//#################### CONSTANTS ####################
+public:
+	enum
+	{
+		DEFAULT_PAGE_SIZE = 512,
+		DEFAULT_PADDING = 1
+	};
+
+	//#################### TYPEDEFS ####################
+private:
+	typedef std::vector<Lightmap_Ptr> LightmapVector;
+	typedef shared_ptr<LightmapVector> LightmapVector_Ptr;
+	typedef shared_ptr<const LightmapVector> LightmapVector_CPtr;
+	typedef std::vector<TexturedLitPolygon_Ptr> TexLitPolyVector;
+	typedef shared_ptr<TexLitPolyVector> TexLitPolyVector_Ptr;
+	typedef shared_ptr<const TexLitPolyVector> TexLitPolyVector_CPtr;
+
+	//#################### NESTED CLASSES ####################
+private:
+	struct Placement
+	{
+		int page;
+		int x, y;	// the position of the lightmap's top-left lumel on its page (excluding the border)
+
+		Placement() : page(-1), x(0), y(0) {}
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	// Input data
+	TexLitPolyVector m_inputPolygons;
+	LightmapVector m_inputLightmaps;
+	int m_pageSize;
+	int m_padding;
+
+	// Output data
+	LightmapVector_Ptr m_pages;
+	TexLitPolyVector_Ptr m_outputPolygons;
+	std::vector<int> m_lightmapIndices;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	LightmapAtlas(const TexLitPolyVector& inputPolygons, const LightmapVector& inputLightmaps, int pageSize = DEFAULT_PAGE_SIZE, int padding = DEFAULT_PADDING);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	void build();
+	const std::vector<int>& lightmap_indices() const;
+	TexLitPolyVector_CPtr lit_polygons() const;
+	static int packed_lumel_count(const std::vector<std::pair<int,int> >& lightmapSizes, int pageSize = DEFAULT_PAGE_SIZE, int padding = DEFAULT_PADDING);
+	LightmapVector_CPtr pages() const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void blit_lightmap(const Lightmap& lightmap, Lightmap& page, const Placement& placement) const;
+	static int next_power_of_two(int n);
+	static void pack_lightmaps(const std::vector<std::pair<int,int> >& lightmapSizes, int pageSize, int padding,
+							   std::vector<Placement>& placements, std::vector<std::pair<int,int> >& pageSizes);
+	TexturedLitPolygon_Ptr remap_polygon(const TexturedLitPolygon& poly, const Lightmap& lightmap, const Placement& placement, const Lightmap& page) const;
+};
+
+}
+
+#endif
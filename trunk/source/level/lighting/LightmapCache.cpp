@@ -0,0 +1,138 @@
+/***
+ * hesperus: LightmapCache.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "LightmapCache.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include <boost/filesystem/convenience.hpp>
+#include <boost/filesystem/operations.hpp>
+namespace bf = boost::filesystem;
+
+#include <source/exceptions/Exception.h>
+#include <source/util/Hasher.h>
+
+namespace hesp {
+
+//#################### CONSTRUCTORS ####################
+/**
+Constructs a lightmap cache which stores its entries in the specified directory
+(creating the directory if necessary).
+
+@param directory	The cache directory
+@throws Exception	If the directory could not be created
+*/
+LightmapCache::LightmapCache(const std::string& directory)
+:	m_directory(directory)
+{
+	try
+	{
+		bf::create_directories(directory);
+	}
+	catch(bf::filesystem_error&)
+	{
+		throw Exception("Could not create the lightmap cache directory " + directory);
+	}
+}
+
+//#################### PUBLIC METHODS ####################
+/**
+Attempts to load the cached contributions of the specified light.
+
+@param light			The light
+@param geometryKey		The key summarising everything other than the light that affects its contributions
+@param contributions	Used to return the contributions to the caller (if they were in the cache)
+@return					true, if the contributions were in the cache, or false otherwise
+*/
+bool LightmapCache::load_contributions(const Light& light, boost::uint64_t geometryKey, Contributions& contributions) const
+{
+	std::string filename = entry_filename(light, geometryKey);
+	if(!bf::exists(filename)) return false;
+
+	// A cache entry that can't be read (e.g. because an earlier run was interrupted whilst writing it) is simply treated as missing.
+	try
+	{
+		contributions = LightmapCacheFile::load(filename, entry_key(light, geometryKey));
+		return true;
+	}
+	catch(Exception&)
+	{
+		return false;
+	}
+}
+
+/**
+Removes the cache entries for any geometry other than that specified. (The entries for
+lights which are no longer in the level are kept, since they may well be added back in.)
+
+@param geometryKeys	The keys for the current geometry
+*/
+void LightmapCache::remove_stale_entries(const std::set<boost::uint64_t>& geometryKeys) const
+{
+	std::set<std::string> prefixes;
+	for(std::set<boost::uint64_t>::const_iterator it=geometryKeys.begin(), iend=geometryKeys.end(); it!=iend; ++it)
+	{
+		prefixes.insert(hex_string(*it) + "-");
+	}
+
+	for(bf::directory_iterator it(m_directory), iend; it!=iend; ++it)
+	{
+		std::string leaf = it->path().leaf();
+		if(bf::extension(it->path()) == ".lmc" && prefixes.find(leaf.substr(0, 17)) == prefixes.end())
+		{
+			bf::remove(it->path());
+		}
+	}
+}
+
+/**
+Saves the contributions of the specified light to the cache.
+
+@param light			The light
+@param geometryKey		The key summarising everything other than the light that affects its contributions
+@param contributions	The contributions
+*/
+void LightmapCache::save_contributions(const Light& light, boost::uint64_t geometryKey, const Contributions& contributions) const
+{
+	LightmapCacheFile::save(entry_filename(light, geometryKey), entry_key(light, geometryKey), contributions);
+}
+
+//#################### PRIVATE METHODS ####################
+std::string LightmapCache::entry_filename(const Light& light, boost::uint64_t geometryKey) const
+{
+	return (bf::path(m_directory) / (hex_string(geometryKey) + "-" + hex_string(light_key(light)) + ".lmc")).file_string();
+}
+
+boost::uint64_t LightmapCache::entry_key(const Light& light, boost::uint64_t geometryKey)
+{
+	Hasher hasher;
+	hasher.add_bytes(&geometryKey, sizeof(geometryKey));
+	boost::uint64_t lightKey = light_key(light);
+	hasher.add_bytes(&lightKey, sizeof(lightKey));
+	return hasher.hash();
+}
+
+std::string LightmapCache::hex_string(boost::uint64_t value)
+{
+	std::ostringstream os;
+	os << std::hex << std::setw(16) << std::setfill('0') << value;
+	return os.str();
+}
+
+boost::uint64_t LightmapCache::light_key(const Light& light)
+{
+	Hasher hasher;
+	hasher.add(light.position.x);
+	hasher.add(light.position.y);
+	hasher.add(light.position.z);
+	hasher.add(light.colour.r);
+	hasher.add(light.colour.g);
+	hasher.add(light.colour.b);
+	hasher.add(light.falloffRadius);
+	return hasher.hash();
+}
+
+}
@@ -0,0 +1,62 @@
+/***
+ * hesperus: LightmapCache.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_LIGHTMAPCACHE
+#define H_HESP_LIGHTMAPCACHE
+
+#include <set>
+#include <string>
+
+#include <boost/cstdint.hpp>
+
+#include <source/io/files/LightmapCacheFile.h>
+#include "Light.h"
+
+namespace hesp {
+
+/**
+This class manages an on-disk cache of the contributions made by individual lights to
+the lightmaps of a level, so that relighting a level after a few lights have been added,
+removed or changed only requires the contributions of those lights to be recalculated.
+
+Each light's contributions are stored in a separate file, keyed by a hash of the light
+and a hash of everything else that affects them (the geometry key, which is computed by
+the lightmap generator). Entries for geometry keys which are no longer in use are stale,
+and can be removed.
+*/
+class LightmapCache
+{
+	//#################### TYPEDEFS ####################
+public:
+	typedef LightmapCacheFile::Contributions Contributions;
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::string m_directory;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	explicit LightmapCache(const std::string& directory);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	bool load_contributions(const Light& light, boost::uint64_t geometryKey, Contributions& contributions) const;
+	void remove_stale_entries(const std::set<boost::uint64_t>& geometryKeys) const;
+	void save_contributions(const Light& light, boost::uint64_t geometryKey, const Contributions& contributions) const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	std::string entry_filename(const Light& light, boost::uint64_t geometryKey) const;
+	static boost::uint64_t entry_key(const Light& light, boost::uint64_t geometryKey);
+	static std::string hex_string(boost::uint64_t value);
+	static boost::uint64_t light_key(const Light& light);
+};
+
+//#################### TYPEDEFS ####################
+typedef shared_ptr<LightmapCache> LightmapCache_Ptr;
+
+}
+
+#endif
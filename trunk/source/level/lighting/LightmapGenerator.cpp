@@ -5,29 +5,126 @@
 
 #include "LightmapGenerator.h"
 
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+#include <boost/lexical_cast.hpp>
+using boost::lexical_cast;
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <source/exceptions/Exception.h>
+#include <source/math/Constants.h>
+#include <source/math/geom/GeomUtil.h>
 #include <source/level/trees/BSPTree.h>
+#include <source/level/trees/BSPUtil.h>
 #include <source/level/trees/TreeUtil.h>
+#include <source/util/Hasher.h>
 #include "Lightmap.h"
+#include "LightmapAtlas.h"
+#include "LightmapCache.h"
 #include "LightmapGrid.h"
 
+namespace {
+
+//#################### CONSTANTS ####################
+// The fraction of the light arriving at a surface which it reflects. (TODO: This is really a surface property, which
+// would depend on the surface's texture, but hlight doesn't have access to the textures.)
+const double REFLECTANCE = 0.5;
+
+// The distance by which radiosity patches are moved off their polygons (this stops the polygons which
+// meet a patch from blocking its line-of-sight to other patches).
+const double PATCH_OFFSET = 0.01;
+
+}
+
 namespace hesp {
 
 //#################### CONSTRUCTORS ####################
-LightmapGenerator::LightmapGenerator(const TexPolyVector& inputPolygons, const std::vector<Light>& lights, const BSPTree_Ptr& tree, const LeafVisTable_Ptr& leafVis)
-:	m_inputPolygons(inputPolygons), m_lights(lights), m_tree(tree), m_leafVis(leafVis)
-{}
+/**
+Constructs a lightmap generator.
+
+@param inputPolygons	The polygons to be lit
+@param lights			The lights in the level
+@param tree				The BSP tree for the level
+@param leafVis			The leaf PVS table for the level
+@param threadCount			The number of threads to use when processing the lights (including the calling thread)
+@param attenuationCutoff	The light intensity below which a light's contribution to a polygon can be ignored (0 to disable culling)
+@param cache				The cache in which to look up (and store) the contributions of individual lights (null to disable caching)
+@param lumelBudget			The maximum total number of lumels on the atlas pages into which the lightmaps will be packed,
+							including borders and unused space (0 for no budget). If there's a budget, the
+							lightmap resolution of each polygon is chosen adaptively, based on how much its lighting varies.
+@param radiosityConvergence	The fraction of the reflected light which the radiosity pass may leave unshot (0 to disable the radiosity pass)
+@param radiosityTimeBudget	The maximum time to spend on the radiosity pass, in seconds (0 for no limit)
+*/
+LightmapGenerator::LightmapGenerator(const TexPolyVector& inputPolygons, const std::vector<Light>& lights, const BSPTree_Ptr& tree, const LeafVisTable_Ptr& leafVis,
+									 int threadCount, double attenuationCutoff, const LightmapCache_Ptr& cache, int lumelBudget,
+									 double radiosityConvergence, double radiosityTimeBudget)
+:	m_inputPolygons(inputPolygons), m_lights(lights), m_tree(tree), m_leafVis(leafVis), m_threadCount(std::max(threadCount, 1)),
+	m_attenuationCutoff(attenuationCutoff), m_cache(cache), m_lumelBudget(std::max(lumelBudget, 0)),
+	m_radiosityConvergence(std::max(radiosityConvergence, 0.0)), m_radiosityTimeBudget(std::max(radiosityTimeBudget, 0.0)), m_geometryKey(0),
+	m_batchNumber(0), m_busyWorkers(0), m_stopWorkers(false), m_processItem(NULL)
+{
+	for(int i=1; i<m_threadCount; ++i)
+	{
+		m_workers.push_back(shared_ptr<boost::thread>(new boost::thread(boost::bind(&LightmapGenerator::run_worker, this))));
+	}
+}
+
+//#################### DESTRUCTOR ####################
+LightmapGenerator::~LightmapGenerator()
+{
+	{
+		boost::mutex::scoped_lock lock(m_workMutex);
+		m_stopWorkers = true;
+	}
+	m_batchAvailable.notify_all();
+	for(size_t i=0, size=m_workers.size(); i<size; ++i) m_workers[i]->join();
+}
 
 //#################### PUBLIC METHODS ####################
 /**
 Generates a lit polygon and a lightmap for each polygon in the input array.
+
+If there's a lumel budget, this happens in two passes. The first pass lights every polygon at the
+coarsest lightmap resolution. The rest of the budget is then spent on increasing the resolution of
+the polygons whose coarse lightmaps show the steepest lighting gradients (up to the resolution that
+their size would otherwise warrant), and the second pass relights those polygons.
+
+If radiosity is enabled, the indirect light reflected between the polygons is then added to the lightmaps.
+
+@throws Exception	If the lumel budget is too small for even the coarsest lightmaps
 */
 void LightmapGenerator::generate_lightmaps()
 {
 	if(!m_lightmaps)
 	{
-		construct_grids();
+		construct_grids(m_lumelBudget > 0 ? LightmapGrid::MIN_LUMELS : LightmapGrid::MAX_LUMELS);
+		construct_bounds();
 		construct_ambient_lightmaps();
+		find_polygon_lights();
+		if(m_cache) m_geometryKey = geometry_key();
+
+		int polyCount = static_cast<int>(m_inputPolygons.size());
+		m_passPolygons.resize(polyCount);
+		for(int i=0; i<polyCount; ++i) m_passPolygons[i] = i;
 		process_lights();
+
+		if(m_lumelBudget > 0)
+		{
+			m_passPolygons = refine_grids();
+			for(std::vector<int>::const_iterator it=m_passPolygons.begin(), iend=m_passPolygons.end(); it!=iend; ++it)
+			{
+				construct_ambient_lightmap(*it);
+			}
+			process_lights();
+		}
+
+		if(m_radiosityConvergence > 0) bounce_light();
+
+		if(m_cache) m_cache->remove_stale_entries(m_cacheKeys);
 		clean_intermediate();
 	}
 }
@@ -53,45 +150,257 @@ LightmapGenerator::TexLitPolyVector_CPtr LightmapGenerator::lit_polygons() const
 }
 
 //#################### PRIVATE METHODS ####################
+/**
+Adds the indirect light which has reached the radiosity patches to the lightmaps. The light at each
+lumel is bilinearly interpolated between the centres of the nearest patches on the same polygon, so
+that the patch boundaries don't show up in the lightmaps.
+*/
+void LightmapGenerator::apply_indirect_light()
+{
+	int polyCount = static_cast<int>(m_inputPolygons.size());
+	for(int n=0; n<polyCount; ++n)
+	{
+		const LightmapGrid& grid = *m_grids[n];
+		Lightmap& lightmap = *(*m_lightmaps)[n];
+		const std::vector<int>& patchIndices = m_polygonPatches[n];
+
+		int rows = grid.lightmap_height(), cols = grid.lightmap_width();
+		int patchRows = (rows + PATCH_LUMELS - 1) / PATCH_LUMELS;
+		int patchCols = (cols + PATCH_LUMELS - 1) / PATCH_LUMELS;
+
+		for(int r=0; r<rows; ++r)
+		{
+			// Find the rows of the patches between whose centres the lumel lies.
+			double pr = (r + 0.5) / PATCH_LUMELS - 0.5;
+			int pr0 = std::max(static_cast<int>(floor(pr)), 0), pr1 = std::min(pr0 + 1, patchRows - 1);
+			double fr = std::min(std::max(pr - pr0, 0.0), 1.0);
+
+			for(int c=0; c<cols; ++c)
+			{
+				if(!grid.lumel_within_polygon(r,c)) continue;
+
+				double pc = (c + 0.5) / PATCH_LUMELS - 0.5;
+				int pc0 = std::max(static_cast<int>(floor(pc)), 0), pc1 = std::min(pc0 + 1, patchCols - 1);
+				double fc = std::min(std::max(pc - pc0, 0.0), 1.0);
+
+				int corners[4] = { pr0*patchCols + pc0, pr0*patchCols + pc1, pr1*patchCols + pc0, pr1*patchCols + pc1 };
+				double weights[4] = { (1-fr)*(1-fc), (1-fr)*fc, fr*(1-fc), fr*fc };
+
+				// Ignore any corners without patches (renormalising the weights of the others).
+				Colour3d indirect;
+				double totalWeight = 0;
+				for(int k=0; k<4; ++k)
+				{
+					int patch = patchIndices[corners[k]];
+					if(patch == -1 || weights[k] == 0) continue;
+					indirect += weights[k] * m_patches[patch].incident;
+					totalWeight += weights[k];
+				}
+
+				if(totalWeight > 0) lightmap(r,c) += indirect * (1 / totalWeight);
+			}
+		}
+	}
+}
+
+/**
+Calculates the indirect light reflected between the polygons using progressive refinement radiosity,
+and adds it to the lightmaps. Each polygon's lightmap is divided into patches of up to PATCH_LUMELS
+x PATCH_LUMELS lumels, which start off reflecting a fraction of the direct light falling on them.
+The patch with the most unshot light then repeatedly shoots it to all the patches it can see, which
+reflect a fraction of what they receive in turn. Pairs of patches whose leaves can't see each other
+according to the leaf PVS are skipped without tracing a ray. The receiving patches for each shot are
+shared among the worker threads, and since the shooting patches are chosen by the main thread, the
+results are the same for any number of threads (unless the time budget runs out).
+
+Shooting stops once the unshot light falls below the convergence threshold (as a fraction of the light
+which was initially reflected), or when the time budget runs out.
+*/
+void LightmapGenerator::bounce_light()
+{
+	using namespace boost::posix_time;
+	ptime startTime = microsec_clock::universal_time();
+
+	construct_patches();
+
+	int patchCount = static_cast<int>(m_patches.size());
+	int groupCount = (patchCount + RECEIVER_GROUP_SIZE - 1) / RECEIVER_GROUP_SIZE;
+
+	double initialEnergy = -1;
+	for(;;)
+	{
+		// Find the patch with the most unshot light.
+		double totalEnergy = 0, bestEnergy = 0;
+		int best = -1;
+		for(int i=0; i<patchCount; ++i)
+		{
+			double energy = patch_energy(m_patches[i]);
+			totalEnergy += energy;
+			if(energy > bestEnergy)
+			{
+				bestEnergy = energy;
+				best = i;
+			}
+		}
+
+		if(initialEnergy < 0) initialEnergy = totalEnergy;
+		if(best == -1 || totalEnergy <= m_radiosityConvergence * initialEnergy) break;
+		if(m_radiosityTimeBudget > 0 && (microsec_clock::universal_time() - startTime).total_microseconds() >= m_radiosityTimeBudget * 1000000) break;
+
+		// Shoot its light to the other patches.
+		m_shooter = best;
+		run_workers(groupCount, &LightmapGenerator::process_receiver_group);
+		m_patches[best].unshot = Colour3d();
+	}
+
+	apply_indirect_light();
+
+	std::vector<Patch>().swap(m_patches);
+	std::vector<std::vector<int> >().swap(m_polygonPatches);
+}
+
 /**
 Cleans up the intermediate data structures used during lightmap generation.
 */
 void LightmapGenerator::clean_intermediate()
 {
 	m_grids.swap(LightmapGridVector());
+	std::vector<std::vector<int> >().swap(m_polygonLights);
+	std::vector<boost::optional<AABB3d> >().swap(m_leafBounds);
+	std::vector<AABB3d>().swap(m_polygonBounds);
+	std::vector<int>().swap(m_passPolygons);
+	std::vector<int>().swap(m_currentPolygons);
+	std::vector<Lightmap_Ptr>().swap(m_currentContributions);
 }
 
 /**
-Constructs the initial lightmaps based on the ambient light in the scene.
+Constructs the initial lightmap for polygon n (at the resolution of its lightmap grid) based on the ambient light in the scene.
+
+@param n	The index of the polygon
 */
-void LightmapGenerator::construct_ambient_lightmaps()
+void LightmapGenerator::construct_ambient_lightmap(int n)
 {
-	int polyCount = static_cast<int>(m_inputPolygons.size());
-	m_lightmaps.reset(new LightmapVector(polyCount));
-
 	// Use the light equation I = I_a . k_a (see OUCL Computer Graphics notes - Set 8).
 #if 0
 	const double Ia = 0.5;
 #else
 	const double Ia = 0.0;	// don't use ambient light: we can achieve better-looking shadows if it's turned off
 #endif
+	const double ka = 1.0;	// TODO: k_a (ambient reflection coefficient) is actually a surface property, which we may or may not want to use.
+	double I = Ia * ka;
+	(*m_lightmaps)[n].reset(new Lightmap(m_grids[n]->lightmap_height(), m_grids[n]->lightmap_width(), Colour3d(I,I,I)));
+}
+
+/**
+Constructs the initial lightmaps based on the ambient light in the scene.
+*/
+void LightmapGenerator::construct_ambient_lightmaps()
+{
+	int polyCount = static_cast<int>(m_inputPolygons.size());
+	m_lightmaps.reset(new LightmapVector(polyCount));
+	for(int i=0; i<polyCount; ++i)
+	{
+		construct_ambient_lightmap(i);
+	}
+}
+
+/**
+Constructs the bounding boxes of the polygons and of the (non-empty) sets of polygons in
+each empty leaf, for use when culling lights by distance.
+*/
+void LightmapGenerator::construct_bounds()
+{
+	int polyCount = static_cast<int>(m_inputPolygons.size());
+	m_polygonBounds.clear();
+	m_polygonBounds.reserve(polyCount);
 	for(int i=0; i<polyCount; ++i)
 	{
-		const double ka = 1.0;	// TODO: k_a (ambient reflection coefficient) is actually a surface property, which we may or may not want to use.
-		double I = Ia * ka;
-		(*m_lightmaps)[i].reset(new Lightmap(m_grids[i]->lightmap_height(), m_grids[i]->lightmap_width(), Colour3d(I,I,I)));
+		m_polygonBounds.push_back(construct_bounding_box(TexPolyVector(1, m_inputPolygons[i]), EPSILON));
+	}
+
+	int emptyLeafCount = m_tree->empty_leaf_count();
+	m_leafBounds.assign(emptyLeafCount, boost::none);
+	for(int i=0; i<emptyLeafCount; ++i)
+	{
+		const std::vector<int>& polyIndices = m_tree->leaf(i)->polygon_indices();
+		if(polyIndices.empty()) continue;
+
+		TexPolyVector leafPolygons;
+		leafPolygons.reserve(polyIndices.size());
+		for(std::vector<int>::const_iterator jt=polyIndices.begin(), jend=polyIndices.end(); jt!=jend; ++jt)
+		{
+			leafPolygons.push_back(m_inputPolygons[*jt]);
+		}
+		m_leafBounds[i] = construct_bounding_box(leafPolygons, EPSILON);
+	}
+}
+
+/**
+Divides the lightmap of each polygon into radiosity patches of up to PATCH_LUMELS x PATCH_LUMELS lumels.
+Each patch is placed at the area-weighted centre of its lumels, and initially reflects a fraction of the
+average direct light falling on them. Patches which contain no part of their polygon, or which lie in a
+solid leaf, are omitted.
+*/
+void LightmapGenerator::construct_patches()
+{
+	m_patches.clear();
+
+	int polyCount = static_cast<int>(m_inputPolygons.size());
+	m_polygonPatches.assign(polyCount, std::vector<int>());
+	for(int n=0; n<polyCount; ++n)
+	{
+		const LightmapGrid& grid = *m_grids[n];
+		const Lightmap& lightmap = *(*m_lightmaps)[n];
+
+		int rows = grid.lightmap_height(), cols = grid.lightmap_width();
+		int patchRows = (rows + PATCH_LUMELS - 1) / PATCH_LUMELS;
+		int patchCols = (cols + PATCH_LUMELS - 1) / PATCH_LUMELS;
+		m_polygonPatches[n].assign(patchRows * patchCols, -1);
+
+		for(int pr=0; pr<patchRows; ++pr)
+			for(int pc=0; pc<patchCols; ++pc)
+			{
+				Patch patch;
+				patch.polygon = n;
+				patch.normal = grid.plane().normal();
+				patch.area = 0;
+
+				Colour3d direct;
+				for(int r=pr*PATCH_LUMELS, rend=std::min(r+PATCH_LUMELS, rows); r<rend; ++r)
+					for(int c=pc*PATCH_LUMELS, cend=std::min(c+PATCH_LUMELS, cols); c<cend; ++c)
+					{
+						if(!grid.lumel_within_polygon(r,c)) continue;
+						double area = grid.lumel_area(r,c);
+						patch.position += area * grid.lumel_centre(r,c);
+						direct += area * lightmap(r,c);
+						patch.area += area;
+					}
+
+				if(patch.area <= 0) continue;
+
+				patch.position /= patch.area;
+				patch.position += patch.normal * PATCH_OFFSET;
+				patch.leaf = TreeUtil::find_leaf_index(patch.position, m_tree);
+				if(patch.leaf >= m_tree->empty_leaf_count()) continue;
+
+				patch.unshot = direct * (REFLECTANCE / patch.area);
+
+				m_polygonPatches[n][pr*patchCols + pc] = static_cast<int>(m_patches.size());
+				m_patches.push_back(patch);
+			}
 	}
 }
 
 /**
 Constructs the lightmap grid for polygon n.
 
-@param n	The index of the polygon for which to build a lightmap grid
+@param n			The index of the polygon for which to build a lightmap grid
+@param maxLumels	The maximum number of lumels along each side of the polygon's lightmap
 */
-void LightmapGenerator::construct_grid(int n)
+void LightmapGenerator::construct_grid(int n, int maxLumels)
 {
 	std::vector<TexCoords> vertexLightmapCoords;
-	m_grids[n].reset(new LightmapGrid(*m_inputPolygons[n], vertexLightmapCoords));
+	m_grids[n].reset(new LightmapGrid(*m_inputPolygons[n], vertexLightmapCoords, maxLumels));
 
 	int vertCount = m_inputPolygons[n]->vertex_count();
 	std::vector<TexturedLitVector3d> vertices;
@@ -110,8 +419,10 @@ void LightmapGenerator::construct_grid(int n)
 
 /**
 Constructs the lightmap grids for each polygon.
+
+@param maxLumels	The maximum number of lumels along each side of a lightmap
 */
-void LightmapGenerator::construct_grids()
+void LightmapGenerator::construct_grids(int maxLumels)
 {
 	int polyCount = static_cast<int>(m_inputPolygons.size());
 	m_grids.resize(polyCount);
@@ -119,63 +430,625 @@ void LightmapGenerator::construct_grids()
 
 	for(int i=0; i<polyCount; ++i)
 	{
-		construct_grid(i);
+		construct_grid(i, maxLumels);
 	}
 }
 
 /**
-Processes light n: this involves updating the lightmaps for all the polygons that
-the light can see.
+Calculates the intensity with which a lumel of the specified colour will actually be displayed
+(lightmap colours are clamped to [0,1] when they're converted to images).
 
-@param n	The index of the light to be processed
+@param colour	The colour of the lumel
+@return			The displayed intensity of its brightest component
 */
-void LightmapGenerator::process_light(int n)
+double LightmapGenerator::displayed_intensity(const Colour3d& colour)
 {
-	assert(m_tree->empty_leaf_count() == m_leafVis->size());
+	return std::min(std::max(std::max(colour.r, colour.g), colour.b), 1.0);
+}
 
-	// Determine the BSP leaf in which the light resides.
-	const Light& light = m_lights[n];
-	int lightLeaf = TreeUtil::find_leaf_index(light.position, m_tree);
+/**
+Calculates the squared radius beyond which the specified light's contribution is weaker than the
+attenuation cutoff in every colour channel. With the quadratic attenuation used by LightmapGrid,
+the intensity at distance d is c / (1 + d^2/r^2) for a light of colour c and falloff radius r,
+so this is r^2 (c_max/cutoff - 1).
 
-	// If the light is in a wall, we can simply ignore it.
-	if(lightLeaf >= m_tree->empty_leaf_count()) return;
+@param light	The light
+@return			The squared radius (<= 0 if the light is too weak to matter anywhere)
+*/
+double LightmapGenerator::effective_radius_squared(const Light& light) const
+{
+	double maxComponent = std::max(std::max(light.colour.r, light.colour.g), light.colour.b);
+	return light.falloffRadius * light.falloffRadius * (maxComponent / m_attenuationCutoff - 1);
+}
 
+/**
+Determines which lights can potentially see each polygon, using the leaf PVS. The lights for each
+polygon are listed in the order in which the original light-by-light algorithm would apply them.
+If an attenuation cutoff has been specified, leaves and polygons which are entirely beyond a light's
+effective radius are skipped.
+*/
+void LightmapGenerator::find_polygon_lights()
+{
+	assert(m_tree->empty_leaf_count() == m_leafVis->size());
+
+	m_polygonLights.assign(m_inputPolygons.size(), std::vector<int>());
+
+	int lightCount = static_cast<int>(m_lights.size());
 	int emptyLeafCount = m_leafVis->size();
-	for(int i=0; i<emptyLeafCount; ++i)
+	bool cull = m_attenuationCutoff > 0;
+	for(int n=0; n<lightCount; ++n)
 	{
-		// If the light can potentially see this leaf, we need to process the polygons in it.
-		if((*m_leafVis)(lightLeaf, i))
+		const Light& light = m_lights[n];
+
+		// If the light is too weak to make a significant contribution anywhere, we can simply ignore it.
+		double radiusSquared = cull ? effective_radius_squared(light) : 0;
+		if(cull && radiusSquared <= 0) continue;
+
+		// Determine the BSP leaf in which the light resides.
+		int lightLeaf = TreeUtil::find_leaf_index(light.position, m_tree);
+
+		// If the light is in a wall, we can simply ignore it.
+		if(lightLeaf >= m_tree->empty_leaf_count()) continue;
+
+		for(int i=0; i<emptyLeafCount; ++i)
 		{
-			const BSPLeaf *leaf = m_tree->leaf(i);
-			const std::vector<int>& polyIndices = leaf->polygon_indices();
+			// If the light can potentially see this leaf, it can potentially see the polygons in it.
+			if(!(*m_leafVis)(lightLeaf, i)) continue;
+			if(!m_leafBounds[i]) continue;
+			if(cull && distance_squared_to_bounding_box(light.position, *m_leafBounds[i]) > radiusSquared) continue;
+
+			const std::vector<int>& polyIndices = m_tree->leaf(i)->polygon_indices();
 			for(std::vector<int>::const_iterator jt=polyIndices.begin(), jend=polyIndices.end(); jt!=jend; ++jt)
 			{
-				int j = *jt;
+				if(cull && distance_squared_to_bounding_box(light.position, m_polygonBounds[*jt]) > radiusSquared) continue;
+				m_polygonLights[*jt].push_back(n);
+			}
+		}
+	}
+}
 
-				// Calculate the individual lightmap between this light and the polygon.
-				Lightmap_Ptr newLightmap = m_grids[j]->lightmap_from_light(light, m_tree);
+/**
+Calculates a key which summarises everything apart from the lights themselves that affects
+the contribution a light makes to the lightmaps, namely the polygon geometry, the BSP tree,
+the leaf PVS table and the attenuation cutoff. It's used to key the lightmap cache.
 
-				if(newLightmap)
-				{
-					// Combine it with the existing lightmap for the polygon (from previously processed lights in the scene).
-					Lightmap_Ptr& curLightmap = (*m_lightmaps)[j];
-					*curLightmap += *newLightmap;
-				}
-			}
+@return	The key
+*/
+boost::uint64_t LightmapGenerator::geometry_key() const
+{
+	Hasher hasher;
+
+	// The version of the lighting calculations (to be bumped whenever they change).
+	hasher.add(1);
+
+	hasher.add(m_attenuationCutoff);
+
+	int polyCount = static_cast<int>(m_inputPolygons.size());
+	hasher.add(polyCount);
+	for(int i=0; i<polyCount; ++i)
+	{
+		int vertCount = m_inputPolygons[i]->vertex_count();
+		hasher.add(vertCount);
+		for(int j=0; j<vertCount; ++j)
+		{
+			const TexturedVector3d& v = m_inputPolygons[i]->vertex(j);
+			hasher.add(v.x);
+			hasher.add(v.y);
+			hasher.add(v.z);
+		}
+	}
+
+	const std::vector<FlatBranch>& branches = m_tree->flat_branches();
+	int branchCount = static_cast<int>(branches.size());
+	hasher.add(branchCount);
+	hasher.add(m_tree->flat_root());
+	for(int i=0; i<branchCount; ++i)
+	{
+		const Plane& splitter = branches[i].splitter;
+		hasher.add(splitter.normal().x);
+		hasher.add(splitter.normal().y);
+		hasher.add(splitter.normal().z);
+		hasher.add(splitter.distance_value());
+		hasher.add(branches[i].children[0]);
+		hasher.add(branches[i].children[1]);
+	}
+
+	int emptyLeafCount = m_tree->empty_leaf_count();
+	hasher.add(emptyLeafCount);
+	for(int i=0; i<emptyLeafCount; ++i)
+	{
+		const std::vector<int>& polyIndices = m_tree->leaf(i)->polygon_indices();
+		hasher.add(static_cast<int>(polyIndices.size()));
+		for(std::vector<int>::const_iterator jt=polyIndices.begin(), jend=polyIndices.end(); jt!=jend; ++jt)
+		{
+			hasher.add(*jt);
+		}
+	}
+
+	int visSize = m_leafVis->size();
+	hasher.add(visSize);
+	for(int i=0; i<visSize; ++i)
+	{
+		for(int j=0; j<visSize; ++j)
+		{
+			hasher.add((*m_leafVis)(i,j) ? 1 : 0);
+		}
+	}
+
+	return hasher.hash();
+}
+
+/**
+Estimates how steeply the lighting varies across a polygon, as the largest difference between
+the displayed intensities of adjacent lumels (within the polygon) of its lightmap.
+
+@param lightmap		The polygon's lightmap
+@param grid			The polygon's lightmap grid
+@return				The gradient estimate
+*/
+double LightmapGenerator::lighting_gradient(const Lightmap& lightmap, const LightmapGrid& grid)
+{
+	double gradient = 0;
+
+	int rows = lightmap.rows(), cols = lightmap.cols();
+	for(int r=0; r<rows; ++r)
+	{
+		for(int c=0; c<cols; ++c)
+		{
+			if(!grid.lumel_within_polygon(r,c)) continue;
+
+			double I = displayed_intensity(lightmap(r,c));
+			if(c+1 < cols && grid.lumel_within_polygon(r,c+1)) gradient = std::max(gradient, fabs(I - displayed_intensity(lightmap(r,c+1))));
+			if(r+1 < rows && grid.lumel_within_polygon(r+1,c)) gradient = std::max(gradient, fabs(I - displayed_intensity(lightmap(r+1,c))));
 		}
 	}
+
+	return gradient;
+}
+
+/**
+Takes the next range of work items to be processed from the shared work queue.
+
+@param begin	Used to return the index of the first work item in the range
+@param end		Used to return the index one past the last work item in the range
+@return			true, if there was any work left, or false otherwise
+*/
+bool LightmapGenerator::next_work_range(int& begin, int& end)
+{
+	boost::mutex::scoped_lock lock(m_workMutex);
+
+	if(m_nextWorkItem >= m_workItemCount) return false;
+
+	begin = m_nextWorkItem;
+	end = std::min(begin + WORK_CHUNK_SIZE, m_workItemCount);
+	m_nextWorkItem = end;
+	return true;
+}
+
+/**
+Calculates the total number of lumels on the atlas pages into which the lightmaps would be packed
+if the first refinementCount of the specified refinements were made.
+
+@param lightmapSizes	The (rows, cols) of each polygon's lightmap before the refinements
+@param refinements		The refinements (as pairs of polygon index and refined grid), in priority order
+@param refinementCount	The number of refinements to make
+@return					As stated
+*/
+int LightmapGenerator::packed_lumel_count(std::vector<std::pair<int,int> > lightmapSizes, const std::vector<std::pair<int,LightmapGrid_Ptr> >& refinements,
+										  int refinementCount)
+{
+	for(int k=0; k<refinementCount; ++k)
+	{
+		const LightmapGrid& grid = *refinements[k].second;
+		lightmapSizes[refinements[k].first] = std::make_pair(grid.lightmap_height(), grid.lightmap_width());
+	}
+	return LightmapAtlas::packed_lumel_count(lightmapSizes);
+}
+
+/**
+Calculates the number of lumels a lightmap of the specified size takes up on an atlas page,
+including its border.
+
+@param lightmapSize		The (rows, cols) of the lightmap
+@return					As stated
+*/
+int LightmapGenerator::padded_lumel_count(const std::pair<int,int>& lightmapSize)
+{
+	const int padding = LightmapAtlas::DEFAULT_PADDING;
+	return (lightmapSize.first + 2*padding) * (lightmapSize.second + 2*padding);
 }
 
 /**
-Processes all the lights in the level.
+Calculates the key under which to cache the contributions of the lights in the current lighting pass,
+which depends on the level geometry and on which polygons are being lit at what resolution.
+
+@return	The key
+*/
+boost::uint64_t LightmapGenerator::pass_key() const
+{
+	Hasher hasher;
+	hasher.add_bytes(&m_geometryKey, sizeof(m_geometryKey));
+
+	int passPolyCount = static_cast<int>(m_passPolygons.size());
+	hasher.add(passPolyCount);
+	for(int i=0; i<passPolyCount; ++i)
+	{
+		int n = m_passPolygons[i];
+		hasher.add(n);
+		hasher.add(m_grids[n]->lightmap_width());
+		hasher.add(m_grids[n]->lightmap_height());
+	}
+
+	return hasher.hash();
+}
+
+/**
+Calculates the amount of light a radiosity patch has yet to shoot (its unshot radiosity, scaled by its area).
+
+@param patch	The patch
+@return			As stated
+*/
+double LightmapGenerator::patch_energy(const Patch& patch)
+{
+	return std::max(std::max(patch.unshot.r, patch.unshot.g), patch.unshot.b) * patch.area;
+}
+
+/**
+Calculates the contribution of the current light to the i'th polygon it can potentially see.
+
+@param i	The index of the polygon in the current light's list of polygons
+*/
+void LightmapGenerator::process_light_polygon(int i)
+{
+	m_currentContributions[i] = m_grids[m_currentPolygons[i]]->lightmap_from_light(m_lights[m_currentLight], m_tree);
+}
+
+/**
+Processes all the lights in the level for the polygons in the current lighting pass. The work is partitioned
+by polygon, so that each lightmap is only ever written by one thread, and the lights affecting each polygon
+are always applied in the same order as a single-threaded run would apply them. The output is thus the same
+for any number of threads.
 */
 void LightmapGenerator::process_lights()
 {
+	if(m_cache) process_lights_cached();
+	else run_workers(static_cast<int>(m_passPolygons.size()), &LightmapGenerator::process_pass_polygon);
+}
+
+/**
+Processes all the lights in the level, one light at a time, taking the contributions of lights which
+are already in the cache from there and calculating (and caching) those of the others. Each light's
+contributions are added to the lightmaps before moving on to the next light, so the lights affecting
+each polygon are applied in the same order as in process_lights, and the output is thus the same as
+it would have been without the cache.
+*/
+void LightmapGenerator::process_lights_cached()
+{
+	boost::uint64_t key = pass_key();
+	m_cacheKeys.insert(key);
+
+	// Determine which of the polygons in the pass each light can potentially see.
 	int lightCount = static_cast<int>(m_lights.size());
-	for(int i=0; i<lightCount; ++i)
+	int polyCount = static_cast<int>(m_inputPolygons.size());
+	std::vector<std::vector<int> > lightPolygons(lightCount);
+	for(std::vector<int>::const_iterator it=m_passPolygons.begin(), iend=m_passPolygons.end(); it!=iend; ++it)
+	{
+		const std::vector<int>& lightIndices = m_polygonLights[*it];
+		for(std::vector<int>::const_iterator jt=lightIndices.begin(), jend=lightIndices.end(); jt!=jend; ++jt)
+		{
+			lightPolygons[*jt].push_back(*it);
+		}
+	}
+
+	for(int n=0; n<lightCount; ++n)
+	{
+		if(lightPolygons[n].empty()) continue;
+
+		LightmapCache::Contributions contributions;
+		if(!m_cache->load_contributions(m_lights[n], key, contributions))
+		{
+			// Calculate the light's contribution to each polygon it can potentially see, and cache the result.
+			m_currentLight = n;
+			m_currentPolygons = lightPolygons[n];
+			m_currentContributions.assign(m_currentPolygons.size(), Lightmap_Ptr());
+			run_workers(static_cast<int>(m_currentPolygons.size()), &LightmapGenerator::process_light_polygon);
+
+			int currentPolyCount = static_cast<int>(m_currentPolygons.size());
+			for(int i=0; i<currentPolyCount; ++i)
+			{
+				if(m_currentContributions[i]) contributions.push_back(std::make_pair(m_currentPolygons[i], m_currentContributions[i]));
+			}
+			m_cache->save_contributions(m_lights[n], key, contributions);
+		}
+
+		// Combine the contributions with the existing lightmaps.
+		for(LightmapCache::Contributions::const_iterator it=contributions.begin(), iend=contributions.end(); it!=iend; ++it)
+		{
+			if(it->first < 0 || it->first >= polyCount) throw Exception("The cached lightmaps do not match the level geometry");
+			*(*m_lightmaps)[it->first] += *it->second;
+		}
+	}
+}
+
+/**
+Updates the lightmap for the i'th polygon in the current lighting pass with the contributions of all the lights that can potentially see it.
+
+@param i	The index of the polygon in the current lighting pass
+*/
+void LightmapGenerator::process_pass_polygon(int i)
+{
+	process_polygon(m_passPolygons[i]);
+}
+
+/**
+Updates the lightmap for polygon n with the contributions of all the lights that can potentially see it.
+
+@param n	The index of the polygon
+*/
+void LightmapGenerator::process_polygon(int n)
+{
+	const std::vector<int>& lightIndices = m_polygonLights[n];
+	for(std::vector<int>::const_iterator it=lightIndices.begin(), iend=lightIndices.end(); it!=iend; ++it)
+	{
+		// Calculate the individual lightmap between this light and the polygon.
+		Lightmap_Ptr newLightmap = m_grids[n]->lightmap_from_light(m_lights[*it], m_tree);
+
+		if(newLightmap)
+		{
+			// Combine it with the existing lightmap for the polygon (from previously processed lights in the scene).
+			Lightmap_Ptr& curLightmap = (*m_lightmaps)[n];
+			*curLightmap += *newLightmap;
+		}
+	}
+}
+
+/**
+Shoots the unshot light of the current shooting patch to the patches in the i'th group of receivers.
+The form factors are estimated by treating the shooting patch as a disc facing along its normal.
+
+@param i	The index of the receiver group
+*/
+void LightmapGenerator::process_receiver_group(int i)
+{
+	const Patch& shooter = m_patches[m_shooter];
+
+	// Find the receivers which face the shooter (and vice-versa), and which are in leaves that can potentially see its leaf.
+	std::vector<int> receivers;
+	std::vector<Vector3d> targets;
+	int patchCount = static_cast<int>(m_patches.size());
+	for(int j=i*RECEIVER_GROUP_SIZE, jend=std::min(j+RECEIVER_GROUP_SIZE, patchCount); j<jend; ++j)
 	{
-		process_light(i);
+		const Patch& receiver = m_patches[j];
+		if(receiver.polygon == shooter.polygon) continue;
+		if(!(*m_leafVis)(shooter.leaf, receiver.leaf)) continue;
+
+		Vector3d offset = receiver.position - shooter.position;
+		if(shooter.normal.dot(offset) <= 0 || receiver.normal.dot(offset) >= 0) continue;
+
+		receivers.push_back(j);
+		targets.push_back(receiver.position);
+	}
+
+	if(receivers.empty()) return;
+
+	std::vector<bool> visibility = BSPUtil::line_of_sight_packet(shooter.position, targets, m_tree);
+
+	int receiverCount = static_cast<int>(receivers.size());
+	for(int k=0; k<receiverCount; ++k)
+	{
+		if(!visibility[k]) continue;
+
+		Patch& receiver = m_patches[receivers[k]];
+		Vector3d offset = receiver.position - shooter.position;
+		double distSquared = offset.length_squared();
+		double cosShooter = shooter.normal.dot(offset) / sqrt(distSquared);
+		double cosReceiver = -receiver.normal.dot(offset) / sqrt(distSquared);
+		double formFactor = cosShooter * cosReceiver * shooter.area / (PI * distSquared + shooter.area);
+
+		Colour3d received = formFactor * shooter.unshot;
+		receiver.incident += received;
+		receiver.unshot += REFLECTANCE * received;
+	}
+}
+
+/**
+Repeatedly takes a range of work items from the shared work queue and processes them, until there are none left.
+
+@param processItem	The member function with which to process each work item
+*/
+void LightmapGenerator::process_work_items_worker(WorkItemProcessor processItem)
+try
+{
+	int begin, end;
+	while(next_work_range(begin, end))
+	{
+		for(int i=begin; i<end; ++i)
+		{
+			(this->*processItem)(i);
+		}
+	}
+}
+catch(Exception& e)				{ stop_work(e.cause()); }
+catch(std::exception& e)		{ stop_work(e.what()); }
+catch(...)						{ stop_work("An unknown error occurred whilst generating the lightmaps"); }
+
+/**
+Spends the part of the lumel budget not used by the coarse lightmaps on increasing the lightmap
+resolution of the polygons whose coarse lightmaps show the steepest lighting gradients. Polygons
+are considered in order of decreasing gradient, and each is given the finest lightmap resolution
+which its size warrants and which still fits within the budget. Polygons whose lighting varies
+by less than a small threshold are left at the coarse resolution.
+
+The budget covers the atlas pages into which hlight packs the lightmaps (see LightmapAtlas), so
+each lightmap is charged for its border as well as its lumels. The packed pages also contain space
+wasted by the packing and by the rounding of the pages to powers of two, which can't be known in
+advance: if the pages for the chosen resolutions turn out not to fit, the lowest-priority refinements
+are dropped until they do.
+
+@return				The (sorted) indices of the polygons whose lightmap grids were refined
+@throws Exception	If the lumel budget is too small for even the coarse lightmaps
+*/
+std::vector<int> LightmapGenerator::refine_grids()
+{
+	const double GRADIENT_THRESHOLD = 1.0 / 32;
+
+	int polyCount = static_cast<int>(m_inputPolygons.size());
+	std::vector<std::pair<int,int> > lightmapSizes(polyCount);
+	int lumelCount = 0;
+	for(int i=0; i<polyCount; ++i)
+	{
+		lightmapSizes[i] = std::make_pair(m_grids[i]->lightmap_height(), m_grids[i]->lightmap_width());
+		lumelCount += padded_lumel_count(lightmapSizes[i]);
+	}
+
+	int packedLumelCount = LightmapAtlas::packed_lumel_count(lightmapSizes);
+	if(packedLumelCount > m_lumelBudget)
+	{
+		throw Exception("The lightmap budget of " + lexical_cast<std::string,int>(m_lumelBudget) + " lumels is too small: "
+						"the coarsest possible lightmaps need " + lexical_cast<std::string,int>(packedLumelCount) + " once packed into atlas pages");
+	}
+
+	// Rank the polygons with significant lighting gradients, steepest first (breaking ties by index so that the result is deterministic).
+	std::vector<std::pair<double,int> > candidates;
+	for(int i=0; i<polyCount; ++i)
+	{
+		double gradient = lighting_gradient(*(*m_lightmaps)[i], *m_grids[i]);
+		if(gradient > GRADIENT_THRESHOLD) candidates.push_back(std::make_pair(-gradient, i));
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	// Choose the refinements (in priority order), charging each one for its extra padded lumels.
+	std::vector<std::pair<int,LightmapGrid_Ptr> > refinements;
+	int candidateCount = static_cast<int>(candidates.size());
+	for(int k=0; k<candidateCount && lumelCount < m_lumelBudget; ++k)
+	{
+		int n = candidates[k].second;
+		int coarseLumelCount = padded_lumel_count(lightmapSizes[n]);
+		for(int maxLumels=LightmapGrid::MAX_LUMELS; maxLumels>LightmapGrid::MIN_LUMELS; maxLumels/=2)
+		{
+			std::vector<TexCoords> vertexLightmapCoords;
+			LightmapGrid_Ptr grid(new LightmapGrid(*m_inputPolygons[n], vertexLightmapCoords, maxLumels));
+			int extraLumelCount = padded_lumel_count(std::make_pair(grid->lightmap_height(), grid->lightmap_width())) - coarseLumelCount;
+
+			// If the polygon is too small to warrant a finer lightmap, there's nothing to do.
+			if(extraLumelCount == 0) break;
+
+			if(lumelCount + extraLumelCount <= m_lumelBudget)
+			{
+				refinements.push_back(std::make_pair(n, grid));
+				lumelCount += extraLumelCount;
+				break;
+			}
+		}
+	}
+
+	// Keep as many of the refinements as possible while the packed pages still fit within the budget. The coarse
+	// lightmaps are known to fit, so a binary search finds a number of refinements which fits and one more which doesn't.
+	int refinementCount = static_cast<int>(refinements.size());
+	if(packed_lumel_count(lightmapSizes, refinements, refinementCount) > m_lumelBudget)
+	{
+		int lo = 0, hi = refinementCount;
+		while(hi - lo > 1)
+		{
+			int mid = (lo + hi) / 2;
+			if(packed_lumel_count(lightmapSizes, refinements, mid) <= m_lumelBudget) lo = mid;
+			else hi = mid;
+		}
+		refinementCount = lo;
+	}
+
+	// Note:	The lightmap coordinates of the polygons' vertices don't depend on the resolution,
+	//			so the lit polygons constructed for the coarse grids are still valid.
+	std::vector<int> refined;
+	for(int k=0; k<refinementCount; ++k)
+	{
+		m_grids[refinements[k].first] = refinements[k].second;
+		refined.push_back(refinements[k].first);
+	}
+
+	std::sort(refined.begin(), refined.end());
+	return refined;
+}
+
+/**
+Runs a worker thread, which helps to process each batch of work items handed to the workers
+until the generator is destroyed.
+*/
+void LightmapGenerator::run_worker()
+{
+	int lastBatchNumber = 0;
+	for(;;)
+	{
+		WorkItemProcessor processItem;
+		{
+			boost::mutex::scoped_lock lock(m_workMutex);
+			while(!m_stopWorkers && m_batchNumber == lastBatchNumber) m_batchAvailable.wait(lock);
+			if(m_stopWorkers) return;
+			lastBatchNumber = m_batchNumber;
+			processItem = m_processItem;
+		}
+
+		process_work_items_worker(processItem);
+
+		bool lastToFinish;
+		{
+			boost::mutex::scoped_lock lock(m_workMutex);
+			lastToFinish = --m_busyWorkers == 0;
+		}
+		if(lastToFinish) m_batchFinished.notify_one();
 	}
 }
 
+/**
+Processes the work items [0,itemCount) using the worker pool. The calling thread
+takes work items from the shared work queue alongside the workers.
+
+@param itemCount	The number of work items
+@param processItem	The member function with which to process each work item
+@throws Exception	If any of the work items could not be processed
+*/
+void LightmapGenerator::run_workers(int itemCount, WorkItemProcessor processItem)
+{
+	m_workItemCount = itemCount;
+	m_nextWorkItem = 0;
+	m_workerError = "";
+
+	if(m_workers.empty())
+	{
+		process_work_items_worker(processItem);
+	}
+	else
+	{
+		// Wake the workers, help them to process the work items, and then wait for them to finish.
+		{
+			boost::mutex::scoped_lock lock(m_workMutex);
+			m_processItem = processItem;
+			m_busyWorkers = static_cast<int>(m_workers.size());
+			++m_batchNumber;
+		}
+		m_batchAvailable.notify_all();
+
+		process_work_items_worker(processItem);
+
+		boost::mutex::scoped_lock lock(m_workMutex);
+		while(m_busyWorkers > 0) m_batchFinished.wait(lock);
+	}
+
+	if(m_workerError != "") throw Exception(m_workerError);
+}
+
+/**
+Records an error which occurred whilst processing a work item (if it's the first), and stops
+the workers from picking up any more work.
+
+@param error	The error
+*/
+void LightmapGenerator::stop_work(const std::string& error)
+{
+	boost::mutex::scoped_lock lock(m_workMutex);
+	if(m_workerError == "") m_workerError = error;
+	m_nextWorkItem = m_workItemCount;
+}
+
+
 }
@@ -6,9 +6,18 @@
 #ifndef H_HESP_LIGHTMAPGENERATOR
 #define H_HESP_LIGHTMAPGENERATOR
 
+#include <set>
+#include <string>
 #include <vector>
 
+#include <boost/cstdint.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
 #include <source/level/vis/VisTable.h>
+#include <source/math/geom/AABB.h>
 #include <source/util/PolygonTypes.h>
 #include "Light.h"
 
@@ -17,10 +26,21 @@ namespace hesp {
 //#################### FORWARD DECLARATIONS ####################
 typedef shared_ptr<class BSPTree> BSPTree_Ptr;
 typedef shared_ptr<class Lightmap> Lightmap_Ptr;
+typedef shared_ptr<class LightmapCache> LightmapCache_Ptr;
+class LightmapGrid;
 typedef shared_ptr<class LightmapGrid> LightmapGrid_Ptr;
 
 class LightmapGenerator
 {
+	//#################### CONSTANTS ####################
+private:
+	enum
+	{
+		PATCH_LUMELS = 4,			// the maximum number of lumels along each side of a radiosity patch
+		RECEIVER_GROUP_SIZE = 64,	// the number of receiving patches whose visibility from a shooting patch is tested together
+		WORK_CHUNK_SIZE = 8			// the number of work items a worker thread takes from the shared work queue at a time
+	};
+
 	//#################### TYPEDEFS ####################
 private:
 	typedef std::vector<LightmapGrid_Ptr> LightmapGridVector;
@@ -31,6 +51,20 @@ private:
 	typedef std::vector<TexturedLitPolygon_Ptr> TexLitPolyVector;
 	typedef shared_ptr<TexLitPolyVector> TexLitPolyVector_Ptr;
 	typedef shared_ptr<const TexLitPolyVector> TexLitPolyVector_CPtr;
+	typedef void (LightmapGenerator::*WorkItemProcessor)(int);
+
+	//#################### NESTED CLASSES ####################
+private:
+	struct Patch
+	{
+		int polygon;			// the index of the polygon containing the patch
+		int leaf;				// the index of the empty leaf containing the patch
+		Vector3d position;		// the centre of the patch (moved slightly off the polygon)
+		Vector3d normal;
+		double area;
+		Colour3d incident;		// the indirect light which has reached the patch so far
+		Colour3d unshot;		// the light reflected by the patch which has yet to be shot to the other patches
+	};
 
 	//#################### PRIVATE VARIABLES ####################
 private:
@@ -39,9 +73,44 @@ private:
 	std::vector<Light> m_lights;
 	BSPTree_Ptr m_tree;
 	LeafVisTable_Ptr m_leafVis;
+	int m_threadCount;
+	double m_attenuationCutoff;		// contributions which would be weaker than this everywhere on a polygon are skipped (0 means "never skip")
+	LightmapCache_Ptr m_cache;		// the cache of per-light contributions (if any)
+	int m_lumelBudget;				// the maximum total number of lumels on the packed lightmap atlas pages (0 means "no budget": the lightmap sizes then depend only on the polygon sizes)
+	double m_radiosityConvergence;	// the fraction of the reflected light which can be left unshot by the radiosity pass (0 means "no radiosity pass")
+	double m_radiosityTimeBudget;	// the maximum time to spend on the radiosity pass, in seconds (0 means "no limit")
 
 	// Intermediate data
 	LightmapGridVector m_grids;
+	std::vector<boost::optional<AABB3d> > m_leafBounds;	// the bounds of the polygons in each empty leaf (if any)
+	std::vector<AABB3d> m_polygonBounds;
+	std::vector<std::vector<int> > m_polygonLights;	// the indices of the lights which can potentially see each polygon (in the order in which they must be applied)
+	std::vector<int> m_passPolygons;				// the polygons being lit in the current lighting pass
+	boost::uint64_t m_geometryKey;					// the key summarising the level geometry for the lightmap cache
+	std::set<boost::uint64_t> m_cacheKeys;			// the keys under which the lighting passes have looked up contributions in the cache
+
+	// Radiosity data
+	std::vector<Patch> m_patches;
+	std::vector<std::vector<int> > m_polygonPatches;	// the indices of the patches covering each polygon's lightmap, in row-major order (-1 for no patch)
+	int m_shooter;										// the patch currently shooting its unshot light
+
+	// Cached relighting data
+	int m_currentLight;								// the light whose contributions are being calculated
+	std::vector<int> m_currentPolygons;				// the polygons which that light can potentially see
+	std::vector<Lightmap_Ptr> m_currentContributions;	// the light's contribution to each of those polygons (if any)
+
+	// Worker pool data (the workers are started when the generator is constructed, and reused by every run_workers call)
+	std::vector<shared_ptr<boost::thread> > m_workers;
+	boost::condition_variable m_batchAvailable;
+	boost::condition_variable m_batchFinished;
+	int m_batchNumber;								// incremented each time a batch of work items is handed to the workers (guarded by m_workMutex)
+	int m_busyWorkers;								// the number of workers still processing the current batch (guarded by m_workMutex)
+	bool m_stopWorkers;								// guarded by m_workMutex
+	WorkItemProcessor m_processItem;					// the member function with which to process the current batch (guarded by m_workMutex)
+	int m_workItemCount;
+	int m_nextWorkItem;
+	boost::mutex m_workMutex;
+	std::string m_workerError;
 
 	// Output data
 	TexLitPolyVector_Ptr m_outputPolygons;
@@ -49,7 +118,18 @@ private:
 
 	//#################### CONSTRUCTORS ####################
 public:
-	LightmapGenerator(const TexPolyVector& inputPolygons, const std::vector<Light>& lights, const BSPTree_Ptr& tree, const LeafVisTable_Ptr& leafVis);
+	LightmapGenerator(const TexPolyVector& inputPolygons, const std::vector<Light>& lights, const BSPTree_Ptr& tree, const LeafVisTable_Ptr& leafVis,
+					  int threadCount = 1, double attenuationCutoff = 0.0, const LightmapCache_Ptr& cache = LightmapCache_Ptr(),
+					  int lumelBudget = 0, double radiosityConvergence = 0.0, double radiosityTimeBudget = 0.0);
+
+	//#################### DESTRUCTOR ####################
+public:
+	~LightmapGenerator();
+
+	//#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+	LightmapGenerator(const LightmapGenerator&);
+	LightmapGenerator& operator=(const LightmapGenerator&);
 
 	//#################### PUBLIC METHODS ####################
 public:
@@ -59,12 +139,37 @@ public:
 
 	//#################### PRIVATE METHODS ####################
 private:
+	void apply_indirect_light();
+	void bounce_light();
 	void clean_intermediate();
+	void construct_ambient_lightmap(int n);
 	void construct_ambient_lightmaps();
-	void construct_grid(int n);
-	void construct_grids();
-	void process_light(int n);
+	void construct_bounds();
+	void construct_grid(int n, int maxLumels);
+	void construct_grids(int maxLumels);
+	void construct_patches();
+	static double displayed_intensity(const Colour3d& colour);
+	double effective_radius_squared(const Light& light) const;
+	void find_polygon_lights();
+	boost::uint64_t geometry_key() const;
+	static double lighting_gradient(const Lightmap& lightmap, const LightmapGrid& grid);
+	bool next_work_range(int& begin, int& end);
+	static int packed_lumel_count(std::vector<std::pair<int,int> > lightmapSizes, const std::vector<std::pair<int,LightmapGrid_Ptr> >& refinements,
+								  int refinementCount);
+	static int padded_lumel_count(const std::pair<int,int>& lightmapSize);
+	boost::uint64_t pass_key() const;
+	static double patch_energy(const Patch& patch);
+	void process_light_polygon(int i);
 	void process_lights();
+	void process_lights_cached();
+	void process_pass_polygon(int i);
+	void process_polygon(int n);
+	void process_receiver_group(int i);
+	void process_work_items_worker(WorkItemProcessor processItem);
+	std::vector<int> refine_grids();
+	void run_worker();
+	void run_workers(int itemCount, WorkItemProcessor processItem);
+	void stop_work(const std::string& error);
 };
 
 }
@@ -31,13 +31,25 @@ Lightmap_Ptr LightmapGrid::lightmap_from_light(const Light& light, const BSPTree
 	int gridCols = static_cast<int>(m_grid[0].size());
 
 	Lightmap_Ptr gridLightmap(new Lightmap(gridRows, gridCols));
+	std::vector<Vector3d> rowPoints;
+	rowPoints.reserve(gridCols);
 	for(int r=0; r<gridRows; ++r)
+	{
+		// Test the whole row of grid points for line-of-sight to the light at once (the rays are nearly coherent).
+		rowPoints.clear();
+		for(int c=0; c<gridCols; ++c)
+		{
+			if(m_grid[r][c].withinPolygon) rowPoints.push_back(m_grid[r][c].position);
+		}
+		std::vector<bool> rowVisibility = BSPUtil::line_of_sight_packet(light.position, rowPoints, tree);
+
+		int k = 0;
 		for(int c=0; c<gridCols; ++c)
 		{
 			if(m_grid[r][c].withinPolygon)
 			{
 				const Vector3d& p = m_grid[r][c].position;
-				if(BSPUtil::line_of_sight(light.position, p, tree))
+				if(rowVisibility[k++])
 				{
 					// Use the light equation I = I_p . k_d . (N . L) . fAtt (see OUCL Computer Graphics notes - Set 8).
 					// In this, fAtt (the atmospheric attenuation coefficient) = min(1/(c1+c2.dL+c3.dL^2), 1), where
@@ -67,6 +79,7 @@ Lightmap_Ptr LightmapGrid::lightmap_from_light(const Light& light, const BSPTree
 				}
 			}
 		}
+	}
 
 	// Now average the light falling on the four corners of each lumel to make the actual lightmap.
 	int lumelsY = gridRows - 1;
@@ -98,6 +111,65 @@ int LightmapGrid::lightmap_width() const
 	return static_cast<int>(m_grid[0].size()) - 1;
 }
 
+/**
+Estimates the area of the part of the specified lumel which lies within the polygon (in world space).
+This is the area of the whole lumel, scaled by the fraction of its corners within the polygon.
+
+@param row	The row of the lumel
+@param col	The column of the lumel
+@return		The estimated area
+*/
+double LightmapGrid::lumel_area(int row, int col) const
+{
+	const Vector3d& p = m_grid[row][col].position;
+	Vector3d across = m_grid[row][col+1].position - p;
+	Vector3d down = m_grid[row+1][col].position - p;
+
+	int count = 0;
+	if(m_grid[row][col].withinPolygon)		++count;
+	if(m_grid[row][col+1].withinPolygon)	++count;
+	if(m_grid[row+1][col].withinPolygon)	++count;
+	if(m_grid[row+1][col+1].withinPolygon)	++count;
+
+	return across.cross(down).length() * count / 4;
+}
+
+/**
+Returns the position of the centre of the specified lumel (in world space).
+
+@param row	The row of the lumel
+@param col	The column of the lumel
+@return		As stated
+*/
+Vector3d LightmapGrid::lumel_centre(int row, int col) const
+{
+	Vector3d centre = m_grid[row][col].position;
+	centre += m_grid[row][col+1].position;
+	centre += m_grid[row+1][col].position;
+	centre += m_grid[row+1][col+1].position;
+	centre /= 4;
+	return centre;
+}
+
+/**
+Determines whether or not the specified lumel of the polygon's lightmap is (at least partly) within
+the polygon. Lumels which aren't are never lit, and can be ignored when examining the lightmap.
+
+@param row	The row of the lumel
+@param col	The column of the lumel
+@return		true, if any corner of the lumel is within the polygon, or false otherwise
+*/
+bool LightmapGrid::lumel_within_polygon(int row, int col) const
+{
+	return m_grid[row][col].withinPolygon || m_grid[row][col+1].withinPolygon ||
+		   m_grid[row+1][col].withinPolygon || m_grid[row+1][col+1].withinPolygon;
+}
+
+const Plane& LightmapGrid::plane() const
+{
+	return m_plane;
+}
+
 //#################### PRIVATE METHODS ####################
 /**
 Find the best axis plane onto which to project the polygon.
@@ -127,9 +199,11 @@ lightmap coordinates for each vertex.
 
 @param projectedVertices		The projection of the original polygon's vertices onto the best axis plane
 @param axisPlane				The axis plane
+@param maxLumels				The maximum number of lumels along each side of the lightmap
 @param vertexLightmapCoords		Used to return lightmap coordinates for each vertex to the caller
 */
-void LightmapGrid::make_planar_grid(const std::vector<Vector2d>& projectedVertices, AxisPlane axisPlane, std::vector<TexCoords>& vertexLightmapCoords)
+void LightmapGrid::make_planar_grid(const std::vector<Vector2d>& projectedVertices, AxisPlane axisPlane, int maxLumels,
+									std::vector<TexCoords>& vertexLightmapCoords)
 {
 	// Determine a 2D AABB for the projected vertices.
 	double minX, minY, maxX, maxY;
@@ -152,15 +226,15 @@ void LightmapGrid::make_planar_grid(const std::vector<Vector2d>& projectedVertic
 	// Figure out a good size for the lightmap. Start with 8x8 lumels, and subdivide if each lumel would be too large.
 	// (Note for the curious: lumel is short for 'luminance element'.)
 	const double MAX_LUMEL_SIZE = 0.5;
-	int lumelsX = 8;
-	int lumelsY = 8;
+	int lumelsX = MIN_LUMELS;
+	int lumelsY = MIN_LUMELS;
 	double lumelWidth = width / lumelsX, lumelHeight = height / lumelsY;
-	while(lumelWidth > MAX_LUMEL_SIZE && lumelsX < 64)
+	while(lumelWidth > MAX_LUMEL_SIZE && lumelsX < maxLumels)
 	{
 		lumelWidth /= 2;
 		lumelsX *= 2;
 	}
-	while(lumelHeight > MAX_LUMEL_SIZE && lumelsY < 64)
+	while(lumelHeight > MAX_LUMEL_SIZE && lumelsY < maxLumels)
 	{
 		lumelHeight /= 2;
 		lumelsY *= 2;
@@ -25,6 +25,15 @@ typedef shared_ptr<class Lightmap> Lightmap_Ptr;
 
 class LightmapGrid
 {
+	//#################### CONSTANTS ####################
+public:
+	// The minimum and maximum number of lumels along each side of a lightmap.
+	enum
+	{
+		MIN_LUMELS = 8,
+		MAX_LUMELS = 64
+	};
+
 	//#################### ENUMERATIONS ####################
 private:
 	enum AxisPlane
@@ -50,19 +59,23 @@ private:
 	//#################### CONSTRUCTORS ####################
 public:
 	template <typename Vert, typename AuxData>
-	LightmapGrid(const Polygon<Vert,AuxData>& poly, std::vector<TexCoords>& vertexLightmapCoords);
+	LightmapGrid(const Polygon<Vert,AuxData>& poly, std::vector<TexCoords>& vertexLightmapCoords, int maxLumels = MAX_LUMELS);
 
 	//#################### PUBLIC METHODS ####################
 public:
 	Lightmap_Ptr lightmap_from_light(const Light& light, const BSPTree_Ptr& tree) const;
 	int lightmap_height() const;
 	int lightmap_width() const;
+	double lumel_area(int row, int col) const;
+	Vector3d lumel_centre(int row, int col) const;
+	bool lumel_within_polygon(int row, int col) const;
+	const Plane& plane() const;
 
 	//#################### PRIVATE METHODS ####################
 private:
 	static AxisPlane find_best_axis_plane(const Vector3d& n);
 
-	void make_planar_grid(const std::vector<Vector2d>& projectedVertices, AxisPlane axisPlane, std::vector<TexCoords>& vertexLightmapCoords);
+	void make_planar_grid(const std::vector<Vector2d>& projectedVertices, AxisPlane axisPlane, int maxLumels, std::vector<TexCoords>& vertexLightmapCoords);
 
 	static Vector3d planar_to_real(const Vector2d& v, AxisPlane axisPlane);
 
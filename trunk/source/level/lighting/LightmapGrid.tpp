@@ -13,14 +13,15 @@ Constructs the lightmap grid for a polygon and calculates the lightmap coordinat
 
 @param poly						The polygon
 @param vertexLightmapCoords		Used to return the vertex lightmap coordinates to the caller
+@param maxLumels				The maximum number of lumels along each side of the lightmap (a power of two between MIN_LUMELS and MAX_LUMELS)
 */
 template <typename Vert, typename AuxData>
-LightmapGrid::LightmapGrid(const Polygon<Vert,AuxData>& poly, std::vector<TexCoords>& vertexLightmapCoords)
+LightmapGrid::LightmapGrid(const Polygon<Vert,AuxData>& poly, std::vector<TexCoords>& vertexLightmapCoords, int maxLumels)
 :	m_plane(make_plane(poly))
 {
 	AxisPlane bestAxisPlane = find_best_axis_plane(poly.normal());
 	std::vector<Vector2d> projectedVertices = project_vertices_onto(poly, bestAxisPlane);
-	make_planar_grid(projectedVertices, bestAxisPlane, vertexLightmapCoords);
+	make_planar_grid(projectedVertices, bestAxisPlane, maxLumels, vertexLightmapCoords);
 	project_grid_onto_polygon(poly, bestAxisPlane);
 }
 
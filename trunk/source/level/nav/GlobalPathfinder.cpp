@@ -5,8 +5,13 @@
 
 #include "GlobalPathfinder.h"
 
+#include <algorithm>
+#include <climits>
+#include <functional>
 #include <queue>
 
+#include <source/exceptions/Exception.h>
+#include "AdjacencyList.h"
 #include "NavLink.h"
 #include "NavMesh.h"
 #include "NavPolygon.h"
@@ -17,10 +22,21 @@ namespace hesp {
 //#################### CONSTRUCTORS ####################
 GlobalPathfinder::GlobalPathfinder(const NavMesh_CPtr& navMesh, const AdjacencyList_CPtr& adjList,
 								   const PathTable_CPtr& pathTable)
-:	m_navMesh(navMesh), m_adjList(adjList), m_pathTable(pathTable)
+:	m_navMesh(navMesh), m_adjList(adjList), m_pathTable(pathTable),
+	m_blockedLinks(navMesh->links().size(), false), m_blockedLinkCount(0),
+	m_searchNodes(navMesh->links().size()), m_searchGen(0)
 {}
 
 //#################### PUBLIC METHODS ####################
+/**
+Unblocks all the nav links.
+*/
+void GlobalPathfinder::clear_blocked_links()
+{
+	std::fill(m_blockedLinks.begin(), m_blockedLinks.end(), false);
+	m_blockedLinkCount = 0;
+}
+
 /**
 Tries to find a (high-level) path from sourcePos in sourcePoly to destPos in destPoly.
 
@@ -70,6 +86,7 @@ bool GlobalPathfinder::find_path(const Vector3d& sourcePos, int sourcePoly,
 			const NavLink_Ptr& destLink = links[destLinkIndex];
 			float destCost = static_cast<float>(destPos.distance(destLink->dest_position()));
 			float interlinkCost = m_pathTable->cost(sourceLinkIndex, destLinkIndex);
+			if(interlinkCost == (float)INT_MAX) continue;	// the dest navlink can't be reached from the source navlink
 			pq.push(PathDescriptor(sourceCost + interlinkCost + destCost, sourceLinkIndex, destLinkIndex));
 		}
 	}
@@ -90,29 +107,211 @@ bool GlobalPathfinder::find_path(const Vector3d& sourcePos, int sourcePoly,
 
 			path = m_pathTable->construct_path(desc.sourceLink, desc.destLink);
 
-			if(!is_blocked(sourcePos, path, destPos))
+			if(!is_blocked(path))
 				return true;	// note that the path to be returned has already been stored in the out parameter
 		}
 	}
 
 	// Step 3:	If a reasonable unblocked path-table path does not exist, do an A* search on
-	//			the adjacency list representation of the navigation graph. Use a temporary node
-	//			in both the source and destination polygons to represent the actual position of
-	//			the player.
-	// TODO
+	//			the adjacency list representation of the navigation graph. (If no links are
+	//			blocked, the path table is exact, so there's no need to search.)
+	if(m_blockedLinkCount == 0) return false;
+	return find_astar_path(sourcePos, sourcePoly, destPos, destPoly, path);
+}
 
-	// Step 4:	If an A* path was found, use it. Otherwise, no valid path exists.
-	// TODO
+/**
+Returns whether or not the specified nav link is currently blocked.
 
-	// NYI
-	return false;
+@param link			The index of the nav link
+@return				true, if the link is blocked, or false otherwise
+@throws Exception	If the link index is out of range
+*/
+bool GlobalPathfinder::link_blocked(int link) const
+{
+	if(link < 0 || link >= static_cast<int>(m_blockedLinks.size())) throw Exception("Nav link index out of range");
+	return m_blockedLinks[link];
+}
+
+/**
+Blocks or unblocks the specified nav link (e.g. when a door closes or opens). Paths
+returned by find_path never use blocked links.
+
+@param link			The index of the nav link
+@param blocked		Whether the link should be blocked
+@throws Exception	If the link index is out of range
+*/
+void GlobalPathfinder::set_link_blocked(int link, bool blocked)
+{
+	if(link < 0 || link >= static_cast<int>(m_blockedLinks.size())) throw Exception("Nav link index out of range");
+	if(m_blockedLinks[link] == blocked) return;
+	m_blockedLinks[link] = blocked;
+	m_blockedLinkCount += blocked ? 1 : -1;
 }
 
 //#################### PRIVATE METHODS ####################
-bool GlobalPathfinder::is_blocked(const Vector3d& sourcePos, const std::list<int>& potentialPath, const Vector3d& destPos) const
+/**
+Finds the cheapest unblocked path from sourcePos in sourcePoly to destPos in destPoly using A*.
+The source and dest positions act as temporary nodes connected to the out links of the source
+polygon and the in links of the dest polygon, respectively. The heuristic for each link is the
+cost of the cheapest path from it to destPos when blocks are ignored, which is admissible
+(up to the small quantisation error in the path table costs).
+
+@param sourcePos	The source position
+@param sourcePoly	The source nav polygon
+@param destPos		The destination position
+@param destPoly		The destination nav polygon
+@param path			Used to return the path (if found) to the caller
+@return				true, if a path was found, or false otherwise
+*/
+bool GlobalPathfinder::find_astar_path(const Vector3d& sourcePos, int sourcePoly, const Vector3d& destPos, int destPoly,
+									   std::list<int>& path) const
+{
+	const std::vector<NavLink_Ptr>& links = m_navMesh->links();
+	const std::vector<NavPolygon_Ptr>& polygons = m_navMesh->polygons();
+	const std::vector<int>& sourceLinkIndices = polygons[sourcePoly]->out_links();
+	const std::vector<int>& destLinkIndices = polygons[destPoly]->in_links();
+
+	// Start a new search. Rather than clearing the search nodes, we give each search its own
+	// generation number and treat any node not stamped with it as unvisited.
+	if(++m_searchGen == 0)
+	{
+		// The generation number has wrapped around, so the old stamps have to be cleared after all.
+		std::fill(m_searchNodes.begin(), m_searchNodes.end(), SearchNode());
+		m_searchGen = 1;
+	}
+	m_openList.clear();
+
+	int destLinkCount = static_cast<int>(destLinkIndices.size());
+	m_destExitCosts.resize(destLinkCount);
+	for(int i=0; i<destLinkCount; ++i)
+	{
+		m_destExitCosts[i] = static_cast<float>(destPos.distance(links[destLinkIndices[i]]->dest_position()));
+	}
+
+	int sourceLinkCount = static_cast<int>(sourceLinkIndices.size());
+	for(int i=0; i<sourceLinkCount; ++i)
+	{
+		int sourceLinkIndex = sourceLinkIndices[i];
+		if(m_blockedLinks[sourceLinkIndex]) continue;
+		float sourceCost = static_cast<float>(sourcePos.distance(links[sourceLinkIndex]->source_position()));
+		push_open(sourceLinkIndex, sourceCost, -1, destLinkIndices);
+	}
+
+	float bestDestCost = (float)INT_MAX;
+	int bestDestLink = -1;
+	while(!m_openList.empty())
+	{
+		OpenEntry entry = m_openList.front();
+		std::pop_heap(m_openList.begin(), m_openList.end(), std::greater<OpenEntry>());
+		m_openList.pop_back();
+
+		// If the dest position comes off the open list, the cheapest path to it has been found.
+		if(entry.link == -1)
+		{
+			path.clear();
+			for(int link=bestDestLink; link!=-1; link=m_searchNodes[link].parent)
+			{
+				path.push_front(link);
+			}
+			return true;
+		}
+
+		SearchNode& node = m_searchNodes[entry.link];
+		if(node.closedGen == m_searchGen) continue;
+		node.closedGen = m_searchGen;
+
+		// If the link leads into the dest polygon, we can go straight from it to the dest position.
+		for(int i=0; i<destLinkCount; ++i)
+		{
+			if(destLinkIndices[i] == entry.link && node.g + m_destExitCosts[i] < bestDestCost)
+			{
+				bestDestCost = node.g + m_destExitCosts[i];
+				bestDestLink = entry.link;
+				m_openList.push_back(OpenEntry(bestDestCost, -1));
+				std::push_heap(m_openList.begin(), m_openList.end(), std::greater<OpenEntry>());
+			}
+		}
+
+		const std::list<AdjacencyList::Edge>& adjEdges = m_adjList->adjacent_edges(entry.link);
+		for(std::list<AdjacencyList::Edge>::const_iterator it=adjEdges.begin(), iend=adjEdges.end(); it!=iend; ++it)
+		{
+			int toLink = it->to_node();
+			if(m_blockedLinks[toLink] || m_searchNodes[toLink].closedGen == m_searchGen) continue;
+			push_open(toLink, node.g + it->length(), entry.link, destLinkIndices);
+		}
+	}
+
+	return false;
+}
+
+/**
+Estimates the cost of going from the end of the specified link to the dest position, by
+looking up the cheapest path to one of the dest links in the path table (ignoring blocks).
+
+@param link				The link
+@param destLinkIndices	The in links of the dest polygon
+@return					The estimated cost, or (float)INT_MAX if the dest position can't be reached from the link
+*/
+float GlobalPathfinder::heuristic_cost(int link, const std::vector<int>& destLinkIndices) const
+{
+	float bestCost = (float)INT_MAX;
+	int destLinkCount = static_cast<int>(destLinkIndices.size());
+	for(int i=0; i<destLinkCount; ++i)
+	{
+		float interlinkCost = m_pathTable->cost(link, destLinkIndices[i]);
+		if(interlinkCost == (float)INT_MAX) continue;
+		bestCost = std::min(bestCost, interlinkCost + m_destExitCosts[i]);
+	}
+	return bestCost;
+}
+
+/**
+Determines whether any of the links on a potential path are blocked.
+
+@param potentialPath	The potential path
+@return					true, if the path is blocked, or false otherwise
+*/
+bool GlobalPathfinder::is_blocked(const std::list<int>& potentialPath) const
 {
-	// NYI
+	if(m_blockedLinkCount == 0) return false;
+
+	for(std::list<int>::const_iterator it=potentialPath.begin(), iend=potentialPath.end(); it!=iend; ++it)
+	{
+		if(m_blockedLinks[*it]) return true;
+	}
 	return false;
 }
 
+/**
+Records a (possibly) cheaper path to the specified link during an A* search, and adds
+the link to the open list if so.
+
+@param link				The link
+@param g				The cost of the path to the link
+@param parent			The previous link on the path (or -1 if the link is a source link)
+@param destLinkIndices	The in links of the dest polygon
+*/
+void GlobalPathfinder::push_open(int link, float g, int parent, const std::vector<int>& destLinkIndices) const
+{
+	SearchNode& node = m_searchNodes[link];
+	if(node.openGen == m_searchGen)
+	{
+		if(node.g <= g) return;
+	}
+	else
+	{
+		node.h = heuristic_cost(link, destLinkIndices);
+		node.openGen = m_searchGen;
+	}
+
+	node.g = g;
+	node.parent = parent;
+
+	// If the dest position can't be reached from the link even when blocks are ignored, there's no point in exploring it.
+	if(node.h == (float)INT_MAX) return;
+
+	m_openList.push_back(OpenEntry(g + node.h, link));
+	std::push_heap(m_openList.begin(), m_openList.end(), std::greater<OpenEntry>());
+}
+
 }
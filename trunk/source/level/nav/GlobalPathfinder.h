@@ -7,6 +7,7 @@
 #define H_HESP_GLOBALPATHFINDER
 
 #include <list>
+#include <vector>
 
 #include <source/math/vectors/Vector3.h>
 
@@ -22,6 +23,14 @@ This class provides global (high-level) pathfinding, i.e.
 it allows us to find a path from one side of the level to
 the other. There should be one of these for each navmesh,
 i.e. one for each AABB map.
+
+Paths are normally looked up in the path table, but links can
+be blocked at runtime (e.g. by closed doors), in which case an
+A* search is run over the navigation graph instead, using the
+path table costs (which ignore blocks) as its heuristic. The
+search reuses the same working arrays for every query, so
+a single pathfinder must not be used from more than one
+thread at once.
 */
 class GlobalPathfinder
 {
@@ -43,23 +52,63 @@ private:
 		}
 	};
 
+	struct OpenEntry
+	{
+		float f;		// the estimated cost of the cheapest complete path through the node
+		int link;		// the link, or -1 for the destination position
+
+		OpenEntry(float f_, int link_)
+		:	f(f_), link(link_)
+		{}
+
+		bool operator>(const OpenEntry& rhs) const
+		{
+			return f > rhs.f;
+		}
+	};
+
+	struct SearchNode
+	{
+		float g;				// the cost of the cheapest path to the link found so far
+		float h;				// the heuristic estimate of the remaining cost from the link to the destination
+		int parent;				// the previous link on the cheapest path (or -1 if the link is a source link)
+		unsigned int openGen;	// the search in which g, h and parent were last set
+		unsigned int closedGen;	// the search in which the link was last expanded
+
+		SearchNode() : g(0.0f), h(0.0f), parent(-1), openGen(0), closedGen(0) {}
+	};
+
 	//#################### PRIVATE VARIABLES ####################
 private:
 	NavMesh_CPtr m_navMesh;
 	AdjacencyList_CPtr m_adjList;
 	PathTable_CPtr m_pathTable;
 
+	std::vector<bool> m_blockedLinks;
+	int m_blockedLinkCount;
+
+	mutable std::vector<float> m_destExitCosts;		// the costs of going from the end of each dest link to the dest position
+	mutable std::vector<OpenEntry> m_openList;		// a binary heap (stale entries are skipped when popped)
+	mutable std::vector<SearchNode> m_searchNodes;
+	mutable unsigned int m_searchGen;
+
 	//#################### CONSTRUCTORS ####################
 public:
 	GlobalPathfinder(const NavMesh_CPtr& navMesh, const AdjacencyList_CPtr& adjList, const PathTable_CPtr& pathTable);
 
 	//#################### PUBLIC METHODS ####################
 public:
+	void clear_blocked_links();
 	bool find_path(const Vector3d& sourcePos, int sourcePoly, const Vector3d& destPos, int destPoly, std::list<int>& path) const;
+	bool link_blocked(int link) const;
+	void set_link_blocked(int link, bool blocked);
 
 	//#################### PRIVATE METHODS ####################
 private:
-	bool is_blocked(const Vector3d& sourcePos, const std::list<int>& potentialPath, const Vector3d& destPos) const;
+	bool find_astar_path(const Vector3d& sourcePos, int sourcePoly, const Vector3d& destPos, int destPoly, std::list<int>& path) const;
+	float heuristic_cost(int link, const std::vector<int>& destLinkIndices) const;
+	bool is_blocked(const std::list<int>& potentialPath) const;
+	void push_open(int link, float g, int parent, const std::vector<int>& destLinkIndices) const;
 };
 
 //#################### TYPEDEFS ####################
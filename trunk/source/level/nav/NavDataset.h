@@ -9,6 +9,8 @@
 #include <boost/shared_ptr.hpp>
 using boost::shared_ptr;
 
+#include "GlobalPathfinder.h"
+
 namespace hesp {
 
 //#################### FORWARD DECLARATIONS ####################
@@ -29,21 +31,25 @@ private:
 	AdjacencyList_Ptr m_adjList;
 	NavMesh_Ptr m_navMesh;
 	PathTable_Ptr m_pathTable;
+	GlobalPathfinder_Ptr m_globalPathfinder;
 
 	//#################### CONSTRUCTORS ####################
 public:
 	NavDataset(const AdjacencyList_Ptr& adjList, const NavMesh_Ptr& navMesh, const PathTable_Ptr& pathTable)
-	:	m_adjList(adjList), m_navMesh(navMesh), m_pathTable(pathTable)
+	:	m_adjList(adjList), m_navMesh(navMesh), m_pathTable(pathTable),
+		m_globalPathfinder(new GlobalPathfinder(navMesh, adjList, pathTable))
 	{}
 
 	//#################### PUBLIC METHODS ####################
 public:
-	const AdjacencyList_Ptr& adjacency_list()	{ return m_adjList; }
-	AdjacencyList_CPtr adjacency_list() const	{ return m_adjList; }
-	const NavMesh_Ptr& nav_mesh()				{ return m_navMesh; }
-	NavMesh_CPtr nav_mesh() const				{ return m_navMesh; }
-	const PathTable_Ptr& path_table()			{ return m_pathTable; }
-	PathTable_CPtr path_table() const			{ return m_pathTable; }
+	const AdjacencyList_Ptr& adjacency_list()			{ return m_adjList; }
+	AdjacencyList_CPtr adjacency_list() const			{ return m_adjList; }
+	const GlobalPathfinder_Ptr& global_pathfinder()		{ return m_globalPathfinder; }
+	GlobalPathfinder_CPtr global_pathfinder() const		{ return m_globalPathfinder; }
+	const NavMesh_Ptr& nav_mesh()						{ return m_navMesh; }
+	NavMesh_CPtr nav_mesh() const						{ return m_navMesh; }
+	const PathTable_Ptr& path_table()					{ return m_pathTable; }
+	PathTable_CPtr path_table() const					{ return m_pathTable; }
 };
 
 //#################### TYPEDEFS ####################
@@ -0,0 +1,255 @@
+/***
+ * hesperus: NavLeafIndex.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "NavLeafIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <source/exceptions/Exception.h>
+#include <source/level/trees/OnionTree.h>
+#include <source/math/Constants.h>
+#include "NavMesh.h"
+#include "NavPolygon.h"
+
+namespace {
+
+//#################### CONSTANTS ####################
+const int MAX_GRID_RESOLUTION = 16;			// the maximum number of cells along each side of a leaf's grid
+const double RELATIVE_BOUNDS_SLACK = 0.01;	// the amount by which polygon bounds are enlarged, relative to their size
+
+}
+
+namespace hesp {
+
+//#################### CONSTRUCTORS ####################
+/**
+Builds the index for a nav mesh.
+
+@param polygons		The collision polygons for the level
+@param tree			The onion tree for the level
+@param navMesh		The nav mesh to index
+*/
+NavLeafIndex::NavLeafIndex(const std::vector<CollisionPolygon_Ptr>& polygons, const OnionTree_CPtr& tree, const NavMesh_CPtr& navMesh)
+{
+	// Calculate the bounds of the nav polygons.
+	const std::vector<NavPolygon_Ptr>& navPolys = navMesh->polygons();
+	int navPolyCount = static_cast<int>(navPolys.size());
+	m_polyBounds.reserve(navPolyCount);
+	for(int i=0; i<navPolyCount; ++i)
+	{
+		m_polyBounds.push_back(calculate_enlarged_bounds(*polygons[navPolys[i]->collision_poly_index()]));
+	}
+
+	// Build the grid for each leaf from the nav polygons in it (in the order in which the leaf lists them).
+	int leafCount = tree->leaf_count();
+	m_leafGrids.reserve(leafCount);
+	m_cellStarts.push_back(0);
+	for(int i=0; i<leafCount; ++i)
+	{
+		const std::vector<int>& polyIndices = tree->leaf(i)->polygon_indices();
+		std::vector<int> navPolyIndices;
+		for(std::vector<int>::const_iterator it=polyIndices.begin(), iend=polyIndices.end(); it!=iend; ++it)
+		{
+			int navPolyIndex = navMesh->lookup_nav_poly_index(*it);
+			if(navPolyIndex != -1) navPolyIndices.push_back(navPolyIndex);
+		}
+		m_leafGrids.push_back(build_leaf_grid(navPolyIndices));
+	}
+}
+
+/**
+Constructs the index from previously-built data (e.g. loaded from a file).
+
+@param leafGrids	The grid for each leaf
+@param cellStarts	The starts of the cells' ranges in cellPolys (one more than the total number of cells)
+@param cellPolys	The nav polygons in each cell
+@param polyBounds	The (enlarged) bounds of each nav polygon
+@throws Exception	If the data is inconsistent
+*/
+NavLeafIndex::NavLeafIndex(const std::vector<LeafGrid>& leafGrids, const std::vector<int>& cellStarts, const std::vector<int>& cellPolys,
+						   const std::vector<AABB3d>& polyBounds)
+:	m_leafGrids(leafGrids), m_cellStarts(cellStarts), m_cellPolys(cellPolys), m_polyBounds(polyBounds)
+{
+	int cellCount = 0;
+	for(std::vector<LeafGrid>::const_iterator it=m_leafGrids.begin(), iend=m_leafGrids.end(); it!=iend; ++it)
+	{
+		if(it->width < 0 || it->height < 0 || it->cellSize <= 0) throw Exception("Bad nav leaf index grid");
+		if(it->firstCell != cellCount) throw Exception("Bad nav leaf index grid");
+		cellCount += it->width * it->height;
+	}
+
+	if(static_cast<int>(m_cellStarts.size()) != cellCount + 1 || m_cellStarts[0] != 0) throw Exception("Bad nav leaf index cells");
+	for(int i=0; i<cellCount; ++i)
+	{
+		if(m_cellStarts[i+1] < m_cellStarts[i]) throw Exception("Bad nav leaf index cells");
+	}
+	if(m_cellStarts[cellCount] != static_cast<int>(m_cellPolys.size())) throw Exception("Bad nav leaf index cells");
+
+	int navPolyCount = static_cast<int>(m_polyBounds.size());
+	for(std::vector<int>::const_iterator it=m_cellPolys.begin(), iend=m_cellPolys.end(); it!=iend; ++it)
+	{
+		if(*it < 0 || *it >= navPolyCount) throw Exception("Bad nav polygon index in nav leaf index");
+	}
+}
+
+//#################### PUBLIC METHODS ####################
+const std::vector<int>& NavLeafIndex::cell_polys() const
+{
+	return m_cellPolys;
+}
+
+const std::vector<int>& NavLeafIndex::cell_starts() const
+{
+	return m_cellStarts;
+}
+
+/**
+Finds the nav polygons in the specified leaf which could contain the specified point (i.e. the ones
+in the point's grid cell whose bounds contain it). The point must still be tested against each of
+them exactly, but there is generally only one.
+
+@param leafIndex		The index of the leaf containing the point
+@param p				The point
+@param navPolyIndices	The array to which to append the indices of the candidate nav polygons
+*/
+void NavLeafIndex::find_candidates(int leafIndex, const Vector3d& p, std::vector<int>& navPolyIndices) const
+{
+	const LeafGrid& grid = m_leafGrids[leafIndex];
+	if(grid.width == 0) return;
+
+	int x = grid_coordinate(p.x - grid.minX, grid.cellSize, grid.width);
+	int y = grid_coordinate(p.y - grid.minY, grid.cellSize, grid.height);
+	int cell = grid.firstCell + y * grid.width + x;
+	for(int i=m_cellStarts[cell], iend=m_cellStarts[cell+1]; i<iend; ++i)
+	{
+		int navPolyIndex = m_cellPolys[i];
+		const Vector3d& minimum = m_polyBounds[navPolyIndex].minimum();
+		const Vector3d& maximum = m_polyBounds[navPolyIndex].maximum();
+		if(minimum.x <= p.x && p.x <= maximum.x &&
+		   minimum.y <= p.y && p.y <= maximum.y &&
+		   minimum.z <= p.z && p.z <= maximum.z)
+		{
+			navPolyIndices.push_back(navPolyIndex);
+		}
+	}
+}
+
+int NavLeafIndex::leaf_count() const
+{
+	return static_cast<int>(m_leafGrids.size());
+}
+
+const std::vector<NavLeafIndex::LeafGrid>& NavLeafIndex::leaf_grids() const
+{
+	return m_leafGrids;
+}
+
+const std::vector<AABB3d>& NavLeafIndex::poly_bounds() const
+{
+	return m_polyBounds;
+}
+
+//#################### PRIVATE METHODS ####################
+/**
+Builds the grid for a leaf, appending its cells to the cell arrays. The number of cells is chosen to
+be roughly the same as the number of nav polygons, up to a limit.
+
+@param navPolyIndices	The nav polygons in the leaf
+@return					The grid
+*/
+NavLeafIndex::LeafGrid NavLeafIndex::build_leaf_grid(const std::vector<int>& navPolyIndices)
+{
+	LeafGrid grid;
+	grid.firstCell = static_cast<int>(m_cellStarts.size()) - 1;
+	if(navPolyIndices.empty()) return grid;
+
+	// Calculate the extent of the nav polygons in the xy plane.
+	int polyCount = static_cast<int>(navPolyIndices.size());
+	double minX = m_polyBounds[navPolyIndices[0]].minimum().x, maxX = m_polyBounds[navPolyIndices[0]].maximum().x;
+	double minY = m_polyBounds[navPolyIndices[0]].minimum().y, maxY = m_polyBounds[navPolyIndices[0]].maximum().y;
+	for(int i=1; i<polyCount; ++i)
+	{
+		const AABB3d& bounds = m_polyBounds[navPolyIndices[i]];
+		minX = std::min(minX, bounds.minimum().x);
+		maxX = std::max(maxX, bounds.maximum().x);
+		minY = std::min(minY, bounds.minimum().y);
+		maxY = std::max(maxY, bounds.maximum().y);
+	}
+
+	// Choose the grid dimensions. Note that the enlarged bounds always have a non-zero extent.
+	int resolution = std::min(static_cast<int>(ceil(sqrt(static_cast<double>(polyCount)))), MAX_GRID_RESOLUTION);
+	grid.minX = minX;
+	grid.minY = minY;
+	grid.cellSize = std::max(maxX - minX, maxY - minY) / resolution;
+	grid.width = std::max(1, std::min(resolution, static_cast<int>(ceil((maxX - minX) / grid.cellSize))));
+	grid.height = std::max(1, std::min(resolution, static_cast<int>(ceil((maxY - minY) / grid.cellSize))));
+
+	// Add each nav polygon to the cells its bounds overlap.
+	std::vector<std::vector<int> > cells(grid.width * grid.height);
+	for(int i=0; i<polyCount; ++i)
+	{
+		const AABB3d& bounds = m_polyBounds[navPolyIndices[i]];
+		int x1 = grid_coordinate(bounds.minimum().x - minX, grid.cellSize, grid.width);
+		int x2 = grid_coordinate(bounds.maximum().x - minX, grid.cellSize, grid.width);
+		int y1 = grid_coordinate(bounds.minimum().y - minY, grid.cellSize, grid.height);
+		int y2 = grid_coordinate(bounds.maximum().y - minY, grid.cellSize, grid.height);
+		for(int y=y1; y<=y2; ++y)
+			for(int x=x1; x<=x2; ++x)
+				cells[y * grid.width + x].push_back(navPolyIndices[i]);
+	}
+
+	for(std::vector<std::vector<int> >::const_iterator it=cells.begin(), iend=cells.end(); it!=iend; ++it)
+	{
+		m_cellPolys.insert(m_cellPolys.end(), it->begin(), it->end());
+		m_cellStarts.push_back(static_cast<int>(m_cellPolys.size()));
+	}
+
+	return grid;
+}
+
+/**
+Calculates the bounds of a polygon, enlarged so that they contain all the points which point_in_polygon
+considers to be in it (it allows a small tolerance both off the polygon's plane and outside its edges).
+
+@param poly		The polygon
+@return			The enlarged bounds
+*/
+AABB3d NavLeafIndex::calculate_enlarged_bounds(const CollisionPolygon& poly)
+{
+	Vector3d minimum = poly.vertex(0), maximum = poly.vertex(0);
+	int vertCount = poly.vertex_count();
+	for(int i=1; i<vertCount; ++i)
+	{
+		const Vector3d& v = poly.vertex(i);
+		minimum.x = std::min(minimum.x, v.x);	maximum.x = std::max(maximum.x, v.x);
+		minimum.y = std::min(minimum.y, v.y);	maximum.y = std::max(maximum.y, v.y);
+		minimum.z = std::min(minimum.z, v.z);	maximum.z = std::max(maximum.z, v.z);
+	}
+
+	double size = std::max(std::max(maximum.x - minimum.x, maximum.y - minimum.y), maximum.z - minimum.z);
+	double slack = 2*EPSILON + RELATIVE_BOUNDS_SLACK * size;
+	Vector3d slackVec(slack, slack, slack);
+	return AABB3d(minimum - slackVec, maximum + slackVec);
+}
+
+/**
+Calculates the grid coordinate of the cell containing the specified offset from the grid's origin,
+clamping it to the grid.
+
+@param offset		The offset from the grid's origin
+@param cellSize		The side length of each cell
+@param cellCount	The number of cells along the relevant side of the grid
+@return				The grid coordinate
+*/
+int NavLeafIndex::grid_coordinate(double offset, double cellSize, int cellCount)
+{
+	double coord = floor(offset / cellSize);
+	if(coord < 0) return 0;
+	else if(coord >= cellCount) return cellCount - 1;
+	else return static_cast<int>(coord);
+}
+
+}
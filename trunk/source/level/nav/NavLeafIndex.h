@@ -0,0 +1,80 @@
+/***
+ * hesperus: NavLeafIndex.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_NAVLEAFINDEX
+#define H_HESP_NAVLEAFINDEX
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+
+#include <source/math/geom/AABB.h>
+#include <source/util/PolygonTypes.h>
+
+namespace hesp {
+
+//#################### FORWARD DECLARATIONS ####################
+typedef shared_ptr<const class NavMesh> NavMesh_CPtr;
+typedef shared_ptr<const class OnionTree> OnionTree_CPtr;
+
+/**
+This class indexes the nav polygons of a nav mesh by the leaves of the onion tree in which
+they lie, so that the nav polygon containing a point can be found without testing the point
+against every polygon in its leaf. The nav polygons in each leaf are bucketed into a small
+uniform grid over their bounds in the xy plane, and the bounds of each nav polygon are kept
+so that most of the candidates in a cell can be rejected without an exact test. The bounds
+are enlarged slightly, so that they contain every point that point_in_polygon accepts.
+*/
+class NavLeafIndex
+{
+	//#################### NESTED CLASSES ####################
+public:
+	struct LeafGrid
+	{
+		double minX, minY;	// the lower corner of the grid in the xy plane
+		double cellSize;	// the side length of each (square) cell
+		int width, height;	// the number of cells along each side (both 0 if the leaf contains no nav polygons)
+		int firstCell;		// the index of the grid's first cell in the cell arrays
+
+		LeafGrid() : minX(0), minY(0), cellSize(1), width(0), height(0), firstCell(0) {}
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::vector<LeafGrid> m_leafGrids;
+	std::vector<int> m_cellStarts;		// the nav polygons in cell i are m_cellPolys[m_cellStarts[i]..m_cellStarts[i+1])
+	std::vector<int> m_cellPolys;
+	std::vector<AABB3d> m_polyBounds;	// the (enlarged) bounds of each nav polygon
+
+	//#################### CONSTRUCTORS ####################
+public:
+	NavLeafIndex(const std::vector<CollisionPolygon_Ptr>& polygons, const OnionTree_CPtr& tree, const NavMesh_CPtr& navMesh);
+	NavLeafIndex(const std::vector<LeafGrid>& leafGrids, const std::vector<int>& cellStarts, const std::vector<int>& cellPolys,
+				 const std::vector<AABB3d>& polyBounds);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	const std::vector<int>& cell_polys() const;
+	const std::vector<int>& cell_starts() const;
+	void find_candidates(int leafIndex, const Vector3d& p, std::vector<int>& navPolyIndices) const;
+	int leaf_count() const;
+	const std::vector<LeafGrid>& leaf_grids() const;
+	const std::vector<AABB3d>& poly_bounds() const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	LeafGrid build_leaf_grid(const std::vector<int>& navPolyIndices);
+	static AABB3d calculate_enlarged_bounds(const CollisionPolygon& poly);
+	static int grid_coordinate(double offset, double cellSize, int cellCount);
+};
+
+//#################### TYPEDEFS ####################
+typedef shared_ptr<NavLeafIndex> NavLeafIndex_Ptr;
+typedef shared_ptr<const NavLeafIndex> NavLeafIndex_CPtr;
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 
 #include "NavMesh.h"
 
+#include "NavLeafIndex.h"
 #include "NavPolygon.h"
 
 namespace hesp {
@@ -17,6 +18,14 @@ NavMesh::NavMesh(const NavPolyVector& polygons, const NavLinkVector& links)
 }
 
 //#################### PUBLIC METHODS ####################
+/**
+Returns the index used to speed up finding the nav polygons containing points, if any (see NavLeafIndex).
+*/
+const NavLeafIndex_CPtr& NavMesh::leaf_index() const
+{
+	return m_leafIndex;
+}
+
 const NavMesh::NavLinkVector& NavMesh::links() const
 {
 	return m_links;
@@ -34,6 +43,11 @@ const NavMesh::NavPolyVector& NavMesh::polygons() const
 	return m_polygons;
 }
 
+void NavMesh::set_leaf_index(const NavLeafIndex_CPtr& leafIndex)
+{
+	m_leafIndex = leafIndex;
+}
+
 //#################### PRIVATE METHODS ####################
 void NavMesh::build_collision_to_nav_lookup()
 {
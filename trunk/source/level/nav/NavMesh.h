@@ -15,6 +15,7 @@ using boost::shared_ptr;
 namespace hesp {
 
 //#################### FORWARD DECLARATIONS ####################
+typedef shared_ptr<const class NavLeafIndex> NavLeafIndex_CPtr;
 typedef shared_ptr<class NavLink> NavLink_Ptr;
 typedef shared_ptr<class NavPolygon> NavPolygon_Ptr;
 
@@ -30,6 +31,7 @@ private:
 	NavLinkVector m_links;
 	NavPolyVector m_polygons;
 	std::map<int,int> m_colToNavLookup;
+	NavLeafIndex_CPtr m_leafIndex;
 
 	//#################### CONSTRUCTORS ####################
 public:
@@ -37,9 +39,11 @@ public:
 
 	//#################### PUBLIC METHODS ####################
 public:
+	const NavLeafIndex_CPtr& leaf_index() const;
 	const NavLinkVector& links() const;
 	int lookup_nav_poly_index(int collisionPolyIndex) const;
 	const NavPolyVector& polygons() const;
+	void set_leaf_index(const NavLeafIndex_CPtr& leafIndex);
 
 	//#################### PRIVATE METHODS ####################
 private:
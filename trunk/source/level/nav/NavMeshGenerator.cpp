@@ -5,6 +5,9 @@
 
 #include "NavMeshGenerator.h"
 
+#include <algorithm>
+#include <climits>
+
 #include <source/math/Constants.h>
 #include <source/math/Interval.h>
 #include <source/math/geom/GeomUtil.h>
@@ -248,6 +251,12 @@ void NavMeshGenerator::clean_intermediate()
 	m_navLinks.swap(NavLinkVector());
 }
 
+/**
+Determines the links between the nav polygons. For each undirected edge plane, the same-facing and
+opposite-facing edges in it are projected into 2D and swept along the plane horizontally, so that
+only pairs of edges whose horizontal extents actually overlap are considered. Each such pair is then
+checked to see whether there should be any links between the polygons on either side of the plane.
+*/
 void NavMeshGenerator::determine_links()
 {
 	for(EdgePlaneTable::const_iterator it=m_edgePlaneTable.begin(), iend=m_edgePlaneTable.end(); it!=iend; ++it)
@@ -256,85 +265,178 @@ void NavMeshGenerator::determine_links()
 		const Plane& plane = it->first;
 		OrthonormalCoordSystem2D coordSystem(plane);
 
-		// Check pairs of different-facing edges to see whether we need to create any links.
+		// Calculate the 2D coordinates of the edges in the plane.
 		const EdgeReferences& sameFacingEdgeRefs = it->second.sameFacing;
 		const EdgeReferences& oppFacingEdgeRefs = it->second.oppFacing;
-		int sameFacingEdgeRefCount = static_cast<int>(sameFacingEdgeRefs.size());
-		int oppFacingEdgeRefCount = static_cast<int>(oppFacingEdgeRefs.size());
+		if(sameFacingEdgeRefs.empty() || oppFacingEdgeRefs.empty()) continue;
+		PlanarEdges sameFacingEdges = project_edges(sameFacingEdgeRefs, coordSystem);
+		PlanarEdges oppFacingEdges = project_edges(oppFacingEdgeRefs, coordSystem);
+
+		// Check pairs of different-facing edges that overlap to see whether we need to create any links.
+		EdgePairs edgePairs = find_overlapping_edges(sameFacingEdges, oppFacingEdges);
+		for(EdgePairs::const_iterator jt=edgePairs.begin(), jend=edgePairs.end(); jt!=jend; ++jt)
+		{
+			const EdgeReference& edgeJ = sameFacingEdgeRefs[jt->first];
+			const EdgeReference& edgeK = oppFacingEdgeRefs[jt->second];
+			const PlanarEdge& planarEdgeJ = sameFacingEdges[jt->first];
+			const PlanarEdge& planarEdgeK = oppFacingEdges[jt->second];
+
+			// Calculate the x overlap between the 2D edges. If there's no overlap,
+			// then we don't need to carry on looking for a link.
+			Interval xIntervalJ(planarEdgeJ.xLow, planarEdgeJ.xHigh);
+			Interval xIntervalK(planarEdgeK.xLow, planarEdgeK.xHigh);
+			Interval xOverlap = xIntervalJ.intersect(xIntervalK);
+			if(xOverlap.empty()) continue;
+
+			// Calculate the segments for the various types of link.
+			LinkSegments linkSegments = calculate_link_segments(planarEdgeJ.q1, planarEdgeJ.q2, planarEdgeK.q1, planarEdgeK.q2, xOverlap);
+
+			// Add the appropriate links.
+			if(linkSegments.stepDownSourceToDestSegment)
+			{
+				assert(linkSegments.stepUpDestToSourceSegment != NULL);
+
+				// Add a step down link from j -> k, and a step up one from k -> j.
+				Vector3d j1 = coordSystem.to_canonical(linkSegments.stepDownSourceToDestSegment->e1);
+				Vector3d j2 = coordSystem.to_canonical(linkSegments.stepDownSourceToDestSegment->e2);
+				Vector3d k1 = coordSystem.to_canonical(linkSegments.stepUpDestToSourceSegment->e1);
+				Vector3d k2 = coordSystem.to_canonical(linkSegments.stepUpDestToSourceSegment->e2);
+				add_nav_link(NavLink_Ptr(new StepDownLink(edgeJ.navPolyIndex, edgeK.navPolyIndex, j1, j2, k1, k2)));
+				add_nav_link(NavLink_Ptr(new StepUpLink(edgeK.navPolyIndex, edgeJ.navPolyIndex, k1, k2, j1, j2)));
+			}
+			if(linkSegments.stepUpSourceToDestSegment)
+			{
+				assert(linkSegments.stepDownDestToSourceSegment != NULL);
+
+				// Add a step up link from j -> k, and a step down one from k -> j.
+				Vector3d j1 = coordSystem.to_canonical(linkSegments.stepUpSourceToDestSegment->e1);
+				Vector3d j2 = coordSystem.to_canonical(linkSegments.stepUpSourceToDestSegment->e2);
+				Vector3d k1 = coordSystem.to_canonical(linkSegments.stepDownDestToSourceSegment->e1);
+				Vector3d k2 = coordSystem.to_canonical(linkSegments.stepDownDestToSourceSegment->e2);
+				add_nav_link(NavLink_Ptr(new StepUpLink(edgeJ.navPolyIndex, edgeK.navPolyIndex, j1, j2, k1, k2)));
+				add_nav_link(NavLink_Ptr(new StepDownLink(edgeK.navPolyIndex, edgeJ.navPolyIndex, k1, k2, j1, j2)));
+			}
+			if(linkSegments.walkSegment)
+			{
+				// Add a walk link from j -> k, and one from k -> j.
+				Vector3d e1 = coordSystem.to_canonical(linkSegments.walkSegment->e1);
+				Vector3d e2 = coordSystem.to_canonical(linkSegments.walkSegment->e2);
+				add_nav_link(NavLink_Ptr(new WalkLink(edgeJ.navPolyIndex, edgeK.navPolyIndex, e1, e2)));
+				add_nav_link(NavLink_Ptr(new WalkLink(edgeK.navPolyIndex, edgeJ.navPolyIndex, e1, e2)));
+			}
+		}
+	}
+}
+
+/**
+Finds the pairs of same-facing and opposite-facing edges in an undirected edge plane whose
+horizontal extents overlap and whose nav polygons are in the same map. This is done by sorting
+the edges by map and then by the left-hand ends of their extents, and sweeping across them while
+maintaining lists of the active (i.e. not yet passed) edges of each type: each edge is paired
+with the active edges of the other type when the sweep reaches it. This takes O(n log n + p)
+time for n edges and p pairs, rather than the O(n^2) time needed to check every pair of edges.
+
+@param sameFacingEdges	The same-facing edges in the plane
+@param oppFacingEdges	The opposite-facing edges in the plane
+@return					The (same-facing, opposite-facing) index pairs, in lexicographic order
+*/
+NavMeshGenerator::EdgePairs
+NavMeshGenerator::find_overlapping_edges(const PlanarEdges& sameFacingEdges, const PlanarEdges& oppFacingEdges)
+{
+	typedef std::pair<std::pair<int,double>,int> SweepKey;	// ((map index, left-hand end), edge index)
+
+	int sameFacingEdgeCount = static_cast<int>(sameFacingEdges.size());
+	int oppFacingEdgeCount = static_cast<int>(oppFacingEdges.size());
+
+	std::vector<SweepKey> sameFacingKeys, oppFacingKeys;
+	sameFacingKeys.reserve(sameFacingEdgeCount);
+	oppFacingKeys.reserve(oppFacingEdgeCount);
+	for(int i=0; i<sameFacingEdgeCount; ++i)
+	{
+		sameFacingKeys.push_back(std::make_pair(std::make_pair(sameFacingEdges[i].mapIndex, sameFacingEdges[i].xLow), i));
+	}
+	for(int i=0; i<oppFacingEdgeCount; ++i)
+	{
+		oppFacingKeys.push_back(std::make_pair(std::make_pair(oppFacingEdges[i].mapIndex, oppFacingEdges[i].xLow), i));
+	}
+	std::sort(sameFacingKeys.begin(), sameFacingKeys.end());
+	std::sort(oppFacingKeys.begin(), oppFacingKeys.end());
+
+	EdgePairs edgePairs;
+	std::vector<int> activeSameFacing, activeOppFacing;
+	int curMapIndex = INT_MIN;
+	int j = 0, k = 0;
+	while(j < sameFacingEdgeCount || k < oppFacingEdgeCount)
+	{
+		// Advance the sweep to the next edge (of either type).
+		bool sameFacing = k == oppFacingEdgeCount || (j < sameFacingEdgeCount && sameFacingKeys[j].first <= oppFacingKeys[k].first);
+		const SweepKey& key = sameFacing ? sameFacingKeys[j++] : oppFacingKeys[k++];
+		int mapIndex = key.first.first;
+		double xLow = key.first.second;
+		int edgeIndex = key.second;
+
+		// Edges in different maps are never paired, so the active lists are reset whenever we move on to a new map.
+		if(mapIndex != curMapIndex)
+		{
+			activeSameFacing.clear();
+			activeOppFacing.clear();
+			curMapIndex = mapIndex;
+		}
 
-		for(int j=0; j<sameFacingEdgeRefCount; ++j)
+		// Pair the edge with the active edges of the other type, discarding any that the sweep has now passed.
+		std::vector<int>& activeOthers = sameFacing ? activeOppFacing : activeSameFacing;
+		const PlanarEdges& otherEdges = sameFacing ? oppFacingEdges : sameFacingEdges;
+		for(size_t i=0; i<activeOthers.size();)
 		{
-			const EdgeReference& edgeJ = sameFacingEdgeRefs[j];
-			NavPolygon& navPolyJ = *m_walkablePolygons[edgeJ.navPolyIndex];
-			const CollisionPolygon& colPolyJ = *m_polygons[navPolyJ.collision_poly_index()];
-			int mapIndexJ = colPolyJ.auxiliary_data().map_index();
-
-			// Calculate the 2D coordinates of edgeJ in the plane.
-			const Vector3d& p1J = colPolyJ.vertex(edgeJ.startVertex);
-			const Vector3d& p2J = colPolyJ.vertex((edgeJ.startVertex+1) % colPolyJ.vertex_count());
-			Vector2d q1J = coordSystem.from_canonical(p1J), q2J = coordSystem.from_canonical(p2J);
-			Interval xIntervalJ(std::min(q1J.x,q2J.x), std::max(q1J.x,q2J.x));
-
-			for(int k=0; k<oppFacingEdgeRefCount; ++k)
+			if(otherEdges[activeOthers[i]].xHigh < xLow)
+			{
+				activeOthers[i] = activeOthers.back();
+				activeOthers.pop_back();
+			}
+			else
 			{
-				const EdgeReference& edgeK = oppFacingEdgeRefs[k];
-				NavPolygon& navPolyK = *m_walkablePolygons[edgeK.navPolyIndex];
-				const CollisionPolygon& colPolyK = *m_polygons[navPolyK.collision_poly_index()];
-				int mapIndexK = colPolyK.auxiliary_data().map_index();
-
-				// We only want to create links between polygons in the same map.
-				if(mapIndexJ != mapIndexK) continue;
-
-				// Calculate the 2D coordinates of edgeK in the plane.
-				const Vector3d& p1K = colPolyK.vertex(edgeK.startVertex);
-				const Vector3d& p2K = colPolyK.vertex((edgeK.startVertex+1) % colPolyK.vertex_count());
-				Vector2d q1K = coordSystem.from_canonical(p1K), q2K = coordSystem.from_canonical(p2K);
-
-				// Calculate the x overlap between the 2D edges. If there's no overlap,
-				// then we don't need to carry on looking for a link.
-				Interval xIntervalK(std::min(q1K.x,q2K.x), std::max(q1K.x,q2K.x));
-				Interval xOverlap = xIntervalJ.intersect(xIntervalK);
-				if(xOverlap.empty()) continue;
-
-				// Calculate the segments for the various types of link.
-				LinkSegments linkSegments = calculate_link_segments(q1J, q2J, q1K, q2K, xOverlap);
-
-				// Add the appropriate links.
-				if(linkSegments.stepDownSourceToDestSegment)
-				{
-					assert(linkSegments.stepUpDestToSourceSegment != NULL);
-
-					// Add a step down link from j -> k, and a step up one from k -> j.
-					Vector3d j1 = coordSystem.to_canonical(linkSegments.stepDownSourceToDestSegment->e1);
-					Vector3d j2 = coordSystem.to_canonical(linkSegments.stepDownSourceToDestSegment->e2);
-					Vector3d k1 = coordSystem.to_canonical(linkSegments.stepUpDestToSourceSegment->e1);
-					Vector3d k2 = coordSystem.to_canonical(linkSegments.stepUpDestToSourceSegment->e2);
-					add_nav_link(NavLink_Ptr(new StepDownLink(edgeJ.navPolyIndex, edgeK.navPolyIndex, j1, j2, k1, k2)));
-					add_nav_link(NavLink_Ptr(new StepUpLink(edgeK.navPolyIndex, edgeJ.navPolyIndex, k1, k2, j1, j2)));
-				}
-				if(linkSegments.stepUpSourceToDestSegment)
-				{
-					assert(linkSegments.stepDownDestToSourceSegment != NULL);
-
-					// Add a step up link from j -> k, and a step down one from k -> j.
-					Vector3d j1 = coordSystem.to_canonical(linkSegments.stepUpSourceToDestSegment->e1);
-					Vector3d j2 = coordSystem.to_canonical(linkSegments.stepUpSourceToDestSegment->e2);
-					Vector3d k1 = coordSystem.to_canonical(linkSegments.stepDownDestToSourceSegment->e1);
-					Vector3d k2 = coordSystem.to_canonical(linkSegments.stepDownDestToSourceSegment->e2);
-					add_nav_link(NavLink_Ptr(new StepUpLink(edgeJ.navPolyIndex, edgeK.navPolyIndex, j1, j2, k1, k2)));
-					add_nav_link(NavLink_Ptr(new StepDownLink(edgeK.navPolyIndex, edgeJ.navPolyIndex, k1, k2, j1, j2)));
-				}
-				if(linkSegments.walkSegment)
-				{
-					// Add a walk link from j -> k, and one from k -> j.
-					Vector3d e1 = coordSystem.to_canonical(linkSegments.walkSegment->e1);
-					Vector3d e2 = coordSystem.to_canonical(linkSegments.walkSegment->e2);
-					add_nav_link(NavLink_Ptr(new WalkLink(edgeJ.navPolyIndex, edgeK.navPolyIndex, e1, e2)));
-					add_nav_link(NavLink_Ptr(new WalkLink(edgeK.navPolyIndex, edgeJ.navPolyIndex, e1, e2)));
-				}
+				edgePairs.push_back(sameFacing ? std::make_pair(edgeIndex, activeOthers[i]) : std::make_pair(activeOthers[i], edgeIndex));
+				++i;
 			}
 		}
+
+		(sameFacing ? activeSameFacing : activeOppFacing).push_back(edgeIndex);
+	}
+
+	// Sort the pairs so that the links are generated in a deterministic order.
+	std::sort(edgePairs.begin(), edgePairs.end());
+	return edgePairs;
+}
+
+/**
+Calculates the 2D coordinates of a set of nav polygon edges in their undirected edge plane.
+
+@param edgeRefs		The edges
+@param coordSystem	The 2D coordinate system for the plane
+@return				The projected edges
+*/
+NavMeshGenerator::PlanarEdges
+NavMeshGenerator::project_edges(const EdgeReferences& edgeRefs, const OrthonormalCoordSystem2D& coordSystem) const
+{
+	PlanarEdges planarEdges;
+	planarEdges.reserve(edgeRefs.size());
+	for(EdgeReferences::const_iterator it=edgeRefs.begin(), iend=edgeRefs.end(); it!=iend; ++it)
+	{
+		const NavPolygon& navPoly = *m_walkablePolygons[it->navPolyIndex];
+		const CollisionPolygon& colPoly = *m_polygons[navPoly.collision_poly_index()];
+
+		const Vector3d& p1 = colPoly.vertex(it->startVertex);
+		const Vector3d& p2 = colPoly.vertex((it->startVertex+1) % colPoly.vertex_count());
+
+		PlanarEdge planarEdge;
+		planarEdge.mapIndex = colPoly.auxiliary_data().map_index();
+		planarEdge.q1 = coordSystem.from_canonical(p1);
+		planarEdge.q2 = coordSystem.from_canonical(p2);
+		planarEdge.xLow = std::min(planarEdge.q1.x, planarEdge.q2.x);
+		planarEdge.xHigh = std::max(planarEdge.q1.x, planarEdge.q2.x);
+		planarEdges.push_back(planarEdge);
 	}
+	return planarEdges;
 }
 
 }
@@ -7,6 +7,8 @@
 #define H_HESP_NAVMESHGENERATOR
 
 #include <map>
+#include <utility>
+#include <vector>
 
 #include <source/math/geom/LineSegment.h>
 #include <source/math/geom/UniquePlanePred.h>
@@ -17,6 +19,7 @@ namespace hesp {
 
 //#################### FORWARD DECLARATIONS ####################
 class Interval;
+class OrthonormalCoordSystem2D;
 typedef shared_ptr<class NavLink> NavLink_Ptr;
 typedef shared_ptr<class NavMesh> NavMesh_Ptr;
 typedef shared_ptr<class NavPolygon> NavPolygon_Ptr;
@@ -41,6 +44,13 @@ private:
 		EdgeReferences oppFacing;	// the edge planes for these edges face the opposite way to the undirected edge planes
 	};
 
+	struct PlanarEdge
+	{
+		int mapIndex;		// the index of the map containing the edge's nav polygon
+		Vector2d q1, q2;	// the 2D endpoints of the edge in its undirected edge plane
+		double xLow, xHigh;	// the horizontal extent of the edge in the plane
+	};
+
 	struct LinkSegments
 	{
 		// TODO: We can add jump down and jump up segments here if we want.
@@ -57,6 +67,8 @@ private:
 	typedef std::vector<NavPolygon_Ptr> NavPolyVector;
 	typedef std::map<Plane,EdgeReferencesPair,UniquePlanePred> EdgePlaneTable;
 	typedef std::vector<NavLink_Ptr> NavLinkVector;
+	typedef std::vector<PlanarEdge> PlanarEdges;
+	typedef std::vector<std::pair<int,int> > EdgePairs;
 
 	//#################### PRIVATE VARIABLES ####################
 private:
@@ -87,6 +99,8 @@ private:
 	LinkSegments calculate_link_segments(const Vector2d& s1, const Vector2d& s2, const Vector2d& d1, const Vector2d& d2, const Interval& xOverlap) const;
 	void clean_intermediate();
 	void determine_links();
+	static EdgePairs find_overlapping_edges(const PlanarEdges& sameFacingEdges, const PlanarEdges& oppFacingEdges);
+	PlanarEdges project_edges(const EdgeReferences& edgeRefs, const OrthonormalCoordSystem2D& coordSystem) const;
 };
 
 }
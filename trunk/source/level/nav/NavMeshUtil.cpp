@@ -5,9 +5,12 @@
 
 #include "NavMeshUtil.h"
 
+#include <algorithm>
+
 #include <source/level/trees/OnionTree.h>
 #include <source/level/trees/TreeUtil.h>
 #include <source/math/geom/GeomUtil.h>
+#include "NavLeafIndex.h"
 #include "NavMesh.h"
 #include "NavPolygon.h"
 
@@ -15,7 +18,8 @@ namespace hesp {
 
 //#################### PUBLIC METHODS ####################
 /**
-Finds the nav polygon in which the specified point resides in the nav mesh, if any.
+Finds the nav polygon in which the specified point resides in the nav mesh, if any. If the nav mesh
+has a leaf index, it is used to narrow down the nav polygons in the point's leaf which need testing.
 
 @param p					The point whose nav polygon we want to find
 @param suggestedNavPoly		A suggestion for the result (generally speaking, for a moving object this would be the last nav polygon we were in)
@@ -42,30 +46,40 @@ int NavMeshUtil::find_nav_polygon(const Vector3d& p, int suggestedNavPoly, const
 	}
 
 	//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-	// Step 2:	Find the other potential collision polygons in which the point could lie.
+	// Step 2:	Find the other potential nav polygons in which the point could lie.
 	//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 	int leafIndex = TreeUtil::find_leaf_index(p, tree);
-	const std::vector<int>& polyIndices = tree->leaf(leafIndex)->polygon_indices();
 
-	std::vector<int> potentialColPolyIndices;
-	for(std::vector<int>::const_iterator it=polyIndices.begin(), iend=polyIndices.end(); it!=iend; ++it)
+	std::vector<int> potentialNavPolyIndices;
+	const NavLeafIndex_CPtr& navLeafIndex = navMesh->leaf_index();
+	if(navLeafIndex && leafIndex < navLeafIndex->leaf_count())
+	{
+		navLeafIndex->find_candidates(leafIndex, p, potentialNavPolyIndices);
+		potentialNavPolyIndices.erase(std::remove(potentialNavPolyIndices.begin(), potentialNavPolyIndices.end(), suggestedNavPoly), potentialNavPolyIndices.end());
+	}
+	else
 	{
-		// Note: We only add collision polygons which are also nav polygons to the list of potentials.
-		if(*it != suggestedColPoly && navMesh->lookup_nav_poly_index(*it) != -1) potentialColPolyIndices.push_back(*it);
+		const std::vector<int>& polyIndices = tree->leaf(leafIndex)->polygon_indices();
+		for(std::vector<int>::const_iterator it=polyIndices.begin(), iend=polyIndices.end(); it!=iend; ++it)
+		{
+			// Note: We only add collision polygons which are also nav polygons to the list of potentials.
+			int navPolyIndex = navMesh->lookup_nav_poly_index(*it);
+			if(*it != suggestedColPoly && navPolyIndex != -1) potentialNavPolyIndices.push_back(navPolyIndex);
+		}
 	}
 
 	//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 	// Step 3:	Test each of the polygons to see whether the point's inside it, and return the index of the found nav polygon if so.
 	//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-	int potentialCount = static_cast<int>(potentialColPolyIndices.size());
+	int potentialCount = static_cast<int>(potentialNavPolyIndices.size());
 	for(int i=0; i<potentialCount; ++i)
 	{
-		int colPolyIndex = potentialColPolyIndices[i];
+		int navPolyIndex = potentialNavPolyIndices[i];
+		int colPolyIndex = navMesh->polygons()[navPolyIndex]->collision_poly_index();
 		if(point_in_polygon(p, *polygons[colPolyIndex]))
 		{
-			int navPolyIndex = navMesh->lookup_nav_poly_index(colPolyIndex);
 #if 0
 			std::cout << "Now in polygon (" << colPolyIndex << ',' << navPolyIndex << ')' << std::endl;
 #endif
@@ -5,17 +5,65 @@
 
 #include "PathTable.h"
 
+#include <algorithm>
+#include <climits>
+#include <map>
+
+#include <source/exceptions/Exception.h>
+#include "AdjacencyList.h"
+
+namespace {
+
+//#################### HELPER CLASSES ####################
+struct RowPtrLess
+{
+	bool operator()(const hesp::PathTable::Row *lhs, const hesp::PathTable::Row *rhs) const
+	{
+		if(lhs->costScale != rhs->costScale) return lhs->costScale < rhs->costScale;
+		if(lhs->costCodes != rhs->costCodes) return lhs->costCodes < rhs->costCodes;
+		return lhs->nextHops < rhs->nextHops;
+	}
+};
+
+}
+
 namespace hesp {
 
 //#################### CONSTRUCTORS ####################
-PathTable::PathTable(int size)
-:	m_table(size), m_size(size)
+/**
+Constructs a path table for the navigation graph with the specified adjacency list,
+in which no node can reach any other (the rows should subsequently be set using
+set_rows).
+
+@param adjList		The adjacency list for the navigation graph
+@throws Exception	If the graph has too many nodes for the next hops to fit in 16 bits
+*/
+PathTable::PathTable(const AdjacencyList& adjList)
+:	m_size(adjList.size()), m_rowIndices(m_size, 0)
 {
-	for(int i=0; i<size; ++i)
+	if(m_size > MAX_NODES) throw Exception("The navigation graph has too many nodes for a path table");
+
+	m_edgeStarts.reserve(m_size + 1);
+	m_edgeStarts.push_back(0);
+	for(int i=0; i<m_size; ++i)
 	{
-		m_table[i].resize(size);
-		m_table[i][i].cost = 0.0f;
+		// Note:	Parallel edges are only stored once, so that there are fewer adjacent nodes than nodes.
+		const std::list<AdjacencyList::Edge>& adjEdges = adjList.adjacent_edges(i);
+		for(std::list<AdjacencyList::Edge>::const_iterator it=adjEdges.begin(), iend=adjEdges.end(); it!=iend; ++it)
+		{
+			std::vector<int>::iterator edgesBegin = m_edgeTargets.begin() + m_edgeStarts.back();
+			if(std::find(edgesBegin, m_edgeTargets.end(), it->to_node()) == m_edgeTargets.end())
+			{
+				m_edgeTargets.push_back(it->to_node());
+			}
+		}
+		m_edgeStarts.push_back(static_cast<int>(m_edgeTargets.size()));
 	}
+
+	Row emptyRow;
+	emptyRow.costCodes.resize(m_size, INFINITE_COST_CODE);
+	emptyRow.nextHops.resize(m_size, NO_NEXT_HOP);
+	m_rows.push_back(emptyRow);
 }
 
 //#################### PUBLIC METHODS ####################
@@ -33,16 +81,196 @@ std::list<int> PathTable::construct_path(int i, int j) const
 	while(cur != j)
 	{
 		path.push_back(cur);
-		cur = m_table[cur][j].nextNode;
+		cur = next_node(cur, j);
 	}
 	path.push_back(j);
 	return path;
 }
 
-float& PathTable::cost(int i, int j)					{ return m_table[i][j].cost; }
-const float& PathTable::cost(int i, int j) const		{ return m_table[i][j].cost; }
-int& PathTable::next_node(int i, int j)					{ return m_table[i][j].nextNode; }
-const int& PathTable::next_node(int i, int j) const		{ return m_table[i][j].nextNode; }
-int PathTable::size() const								{ return m_size; }
+/**
+Returns the (quantised) cost of the shortest path from node i to node j. This is never more
+than the true cost, and is less than it by at most the cost scale of node i's row.
+
+@param i	The source node
+@param j	The destination node
+@return		The cost of the path, or (float)INT_MAX if j can't be reached from i
+*/
+float PathTable::cost(int i, int j) const
+{
+	if(i == j) return 0.0f;
+
+	const Row& r = m_rows[m_rowIndices[i]];
+	unsigned short code = r.costCodes[j];
+	if(code == INFINITE_COST_CODE) return (float)INT_MAX;
+	else return code * r.costScale;
+}
+
+/**
+Encodes a row of the path table in compressed form.
+
+@param i			The source node for the row
+@param costs		The costs of the shortest paths from node i to each node (or (float)INT_MAX for unreachable nodes)
+@param nextNodes	The next nodes along those paths (or -1 for unreachable nodes)
+@return				The encoded row
+@throws Exception	If one of the next nodes isn't adjacent to node i
+*/
+PathTable::Row PathTable::encode_row(int i, const std::vector<float>& costs, const std::vector<int>& nextNodes) const
+{
+	Row row;
+	row.costCodes.resize(m_size, INFINITE_COST_CODE);
+	row.nextHops.resize(m_size, NO_NEXT_HOP);
+
+	float maxCost = 0.0f;
+	for(int j=0; j<m_size; ++j)
+	{
+		if(j != i && nextNodes[j] != -1) maxCost = std::max(maxCost, costs[j]);
+	}
+	row.costScale = maxCost / (INFINITE_COST_CODE - 1);
+
+	const int *edgesBegin = &m_edgeTargets[0] + m_edgeStarts[i], *edgesEnd = &m_edgeTargets[0] + m_edgeStarts[i+1];
+	for(int j=0; j<m_size; ++j)
+	{
+		// Note:	The diagonal entries are left as unreachable so that identical rows can be shared.
+		if(j == i || nextNodes[j] == -1) continue;
+
+		const int *hop = std::find(edgesBegin, edgesEnd, nextNodes[j]);
+		if(hop == edgesEnd) throw Exception("The path table next node is not adjacent to its source node");
+		row.nextHops[j] = static_cast<NextHop>(hop - edgesBegin);
+
+		// Round the cost down, making sure that floating-point error can't push the decoded cost above the true one.
+		int code = row.costScale > 0.0f ? static_cast<int>(costs[j] / row.costScale) : 0;
+		code = std::min(code, INFINITE_COST_CODE - 1);
+		while(code > 0 && code * row.costScale > costs[j]) --code;
+		row.costCodes[j] = static_cast<unsigned short>(code);
+	}
+
+	return row;
+}
+
+/**
+Returns the next node along the shortest path from node i to node j.
+
+@param i	The source node
+@param j	The destination node
+@return		The next node, or -1 if i == j or j can't be reached from i
+*/
+int PathTable::next_node(int i, int j) const
+{
+	if(i == j) return -1;
+
+	NextHop hop = m_rows[m_rowIndices[i]].nextHops[j];
+	if(hop == NO_NEXT_HOP) return -1;
+	else return m_edgeTargets[m_edgeStarts[i] + hop];
+}
+
+/**
+Returns the specified stored row (e.g. for saving it to disk).
+
+@param r	The index of the stored row
+@return		As stated
+*/
+const PathTable::Row& PathTable::row(int r) const
+{
+	return m_rows[r];
+}
+
+int PathTable::row_count() const
+{
+	return static_cast<int>(m_rows.size());
+}
+
+/**
+Returns the index of the stored row used by node i.
+
+@param i	The node
+@return		As stated
+*/
+int PathTable::row_index(int i) const
+{
+	return m_rowIndices[i];
+}
+
+/**
+Sets the rows of the path table, one per node. Any identical rows are stored only once.
+
+@param rows			The encoded rows (see encode_row)
+@throws Exception	If the wrong number of rows is specified, or any of them is invalid
+*/
+void PathTable::set_rows(const std::vector<Row>& rows)
+{
+	if(static_cast<int>(rows.size()) != m_size) throw Exception("Bad number of path table rows");
+
+	std::vector<Row> uniqueRows;
+	std::vector<int> rowIndices(m_size);
+	std::map<const Row*,int,RowPtrLess> rowLookup;
+	for(int i=0; i<m_size; ++i)
+	{
+		std::map<const Row*,int,RowPtrLess>::const_iterator it = rowLookup.find(&rows[i]);
+		if(it != rowLookup.end())
+		{
+			rowIndices[i] = it->second;
+		}
+		else
+		{
+			rowIndices[i] = static_cast<int>(uniqueRows.size());
+			rowLookup.insert(std::make_pair(&rows[i], rowIndices[i]));
+			uniqueRows.push_back(rows[i]);
+		}
+	}
+
+	set_rows(uniqueRows, rowIndices);
+}
+
+/**
+Sets the stored rows of the path table, and which of them each node uses.
+
+@param rows			The encoded rows (see encode_row)
+@param rowIndices	The index of the row used by each node
+@throws Exception	If the wrong number of row indices is specified, or any of the rows or row indices is invalid
+*/
+void PathTable::set_rows(const std::vector<Row>& rows, const std::vector<int>& rowIndices)
+{
+	if(static_cast<int>(rowIndices.size()) != m_size) throw Exception("Bad number of path table row indices");
+
+	int rowCount = static_cast<int>(rows.size());
+	for(int i=0; i<rowCount; ++i) check_row(rows[i]);
+
+	for(int i=0; i<m_size; ++i)
+	{
+		if(rowIndices[i] < 0 || rowIndices[i] >= rowCount) throw Exception("Bad path table row index");
+
+		// Check that all the next hops index nodes which are actually adjacent to node i.
+		const std::vector<NextHop>& nextHops = rows[rowIndices[i]].nextHops;
+		int edgeCount = m_edgeStarts[i+1] - m_edgeStarts[i];
+		for(int j=0; j<m_size; ++j)
+		{
+			if(nextHops[j] != NO_NEXT_HOP && nextHops[j] >= edgeCount) throw Exception("Bad path table next hop");
+		}
+	}
+
+	m_rows = rows;
+	m_rowIndices = rowIndices;
+}
+
+int PathTable::size() const
+{
+	return m_size;
+}
+
+//#################### PRIVATE METHODS ####################
+/**
+Checks that an encoded row has the right size and a valid cost scale.
+
+@param row			The row
+@throws Exception	If the row is invalid
+*/
+void PathTable::check_row(const Row& row) const
+{
+	if(static_cast<int>(row.costCodes.size()) != m_size || static_cast<int>(row.nextHops.size()) != m_size)
+	{
+		throw Exception("Bad path table row size");
+	}
+	if(!(row.costScale >= 0.0f)) throw Exception("Bad path table row cost scale");
+}
 
 }
@@ -14,35 +14,79 @@ using boost::shared_ptr;
 
 namespace hesp {
 
+//#################### FORWARD DECLARATIONS ####################
+class AdjacencyList;
+
+/**
+This class represents a path table for a navigation graph, i.e. the costs of the shortest
+paths between every pair of nodes, and the next node along each such path. The table is
+stored in compressed form (4 bytes per pair of nodes rather than 8):
+
+-	The costs in each row are quantised to 16 bits, relative to a per-row scale chosen
+	so that the largest finite cost in the row is representable. The quantised costs are
+	rounded down, so that they never overestimate the true costs: this keeps heuristics
+	based on them (e.g. in GlobalPathfinder) admissible.
+-	Each next node is stored as an index into the list of distinct nodes adjacent to the
+	row's node (which is built from the adjacency list when the table is constructed). A
+	node has fewer adjacent nodes than there are nodes in the graph, so the indices fit in
+	16 bits for any graph small enough to have a path table at all.
+-	The diagonal entries are implicit, so nodes whose rows turn out to be identical (e.g.
+	dead ends, from which nothing is reachable) can share a single stored row.
+*/
 class PathTable
 {
+	//#################### TYPEDEFS ####################
+public:
+	typedef unsigned short NextHop;
+
+	//#################### CONSTANTS ####################
+public:
+	enum
+	{
+		INFINITE_COST_CODE = 65535,		// the cost code for unreachable nodes
+		NO_NEXT_HOP = 65535,			// the next hop for unreachable nodes
+		MAX_NODES = NO_NEXT_HOP			// the maximum number of nodes in a graph with a path table (whose rows would take up about 16GB)
+	};
+
 	//#################### NESTED CLASSES ####################
-private:
-	struct Entry
+public:
+	struct Row
 	{
-		float cost;
-		int nextNode;
+		float costScale;							// the cost represented by each unit of the cost codes
+		std::vector<unsigned short> costCodes;
+		std::vector<NextHop> nextHops;				// the indices of the next nodes in the adjacent node list of the row's node
 
-		Entry() : cost((float)INT_MAX), nextNode(-1) {}
+		Row() : costScale(0.0f) {}
 	};
 
 	//#################### PRIVATE VARIABLES ####################
 private:
-	std::vector<std::vector<Entry> > m_table;
 	int m_size;
+	std::vector<int> m_edgeStarts;		// the nodes adjacent to node i are m_edgeTargets[m_edgeStarts[i]..m_edgeStarts[i+1])
+	std::vector<int> m_edgeTargets;
+	std::vector<Row> m_rows;
+	std::vector<int> m_rowIndices;		// the stored row used by each node
 
 	//#################### CONSTRUCTORS ####################
 public:
-	PathTable(int size);
+	explicit PathTable(const AdjacencyList& adjList);
 
 	//#################### PUBLIC METHODS ####################
 public:
 	std::list<int> construct_path(int i, int j) const;
-	float& cost(int i, int j);
-	const float& cost(int i, int j) const;
-	int& next_node(int i, int j);
-	const int& next_node(int i, int j) const;
+	float cost(int i, int j) const;
+	Row encode_row(int i, const std::vector<float>& costs, const std::vector<int>& nextNodes) const;
+	int next_node(int i, int j) const;
+	const Row& row(int r) const;
+	int row_count() const;
+	int row_index(int i) const;
+	void set_rows(const std::vector<Row>& rows);
+	void set_rows(const std::vector<Row>& rows, const std::vector<int>& rowIndices);
 	int size() const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void check_row(const Row& row) const;
 };
 
 //#################### TYPEDEFS ####################
@@ -6,65 +6,215 @@
 #include "PathTableGenerator.h"
 
 #include <algorithm>
+#include <climits>
+#include <functional>
+#include <queue>
+#include <utility>
 
-#include "AdjacencyTable.h"
-#include "PathTable.h"
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "AdjacencyList.h"
 
 namespace hesp {
 
 //#################### PUBLIC METHODS ####################
-PathTable_Ptr PathTableGenerator::floyd_warshall(const AdjacencyTable& adjTable)
+/**
+Generates the path table for a navigation graph by running Dijkstra's algorithm from each node in turn.
+Since the graph is generally very sparse, this is much faster than running Floyd-Warshall on an adjacency
+table: with a binary heap, it takes O(n (n + e) log n) time, rather than O(n^3). Each run only produces
+the row of the path table for its source node, so the runs can be shared among several threads.
+
+Where several shortest paths tie, the path table is the same as the one floyd_warshall would produce
+(see dijkstra_from), so the choice of generator doesn't change the paths the characters take.
+
+@param adjList		The adjacency list for the navigation graph
+@param threadCount	The number of threads to use
+@return				The path table
+*/
+PathTable_Ptr PathTableGenerator::dijkstra(const AdjacencyList& adjList, int threadCount)
 {
-	// Reference: See p.558-62 of Introduction to Algorithms (Cormen, Leiserson and Rivest) 1st Ed.
+	int size = adjList.size();
+	PathTable_Ptr pathTable(new PathTable(adjList));
+	std::vector<PathTable::Row> rows(size);
 
-	int size = adjTable.size();
-	PathTable_Ptr pathTable(new PathTable(size));
+	threadCount = std::max(std::min(threadCount, size), 1);
+	if(threadCount == 1)
+	{
+		dijkstra_worker(adjList, 0, 1, *pathTable, rows);
+	}
+	else
+	{
+		// Interleave the source nodes among the threads (nearby nodes often have similar amounts of work).
+		boost::thread_group workers;
+		for(int i=0; i<threadCount; ++i)
+		{
+			workers.create_thread(boost::bind(&PathTableGenerator::dijkstra_worker, boost::cref(adjList), i, threadCount,
+											  boost::cref(*pathTable), boost::ref(rows)));
+		}
+		workers.join_all();
+	}
 
-	/*
-	Initialise the path table from the adjacency (weight) table.
+	pathTable->set_rows(rows);
+	return pathTable;
+}
 
+/**
+Generates the path table for a navigation graph using the Floyd-Warshall algorithm. This takes O(n^3) time
+and O(n^2) working space, so it's only suitable for small graphs: it's kept as a reference implementation
+against which to check dijkstra.
+
+@param adjList		The adjacency list for the navigation graph
+@return				The path table
+*/
+PathTable_Ptr PathTableGenerator::floyd_warshall(const AdjacencyList& adjList)
+{
+	// Reference: See p.558-62 of Introduction to Algorithms (Cormen, Leiserson and Rivest) 1st Ed.
+	int size = adjList.size();
+
+	/*
+	Initialise the costs from the edge lengths (taking the shortest edge if there are several from one node to another).
 	Note that the base formula for the next nodes (sigma values) is given by:
 
 	sigma_{ij}^0 =	{ -1	if i = j or w_{ij} = inf
 					{ j		otherwise
 	*/
+	std::vector<std::vector<float> > costs(size, std::vector<float>(size, (float)INT_MAX));
+	std::vector<std::vector<int> > nextNodes(size, std::vector<int>(size, -1));
 	for(int i=0; i<size; ++i)
-		for(int j=0; j<size; ++j)
+	{
+		costs[i][i] = 0.0f;
+
+		const std::list<AdjacencyList::Edge>& adjEdges = adjList.adjacent_edges(i);
+		for(std::list<AdjacencyList::Edge>::const_iterator it=adjEdges.begin(), iend=adjEdges.end(); it!=iend; ++it)
 		{
-			if(i != j && adjTable(i,j) != INT_MAX)
+			int j = it->to_node();
+			if(j != i && it->length() < costs[i][j])
 			{
-				pathTable->cost(i,j) = adjTable(i,j);
-				pathTable->next_node(i,j) = j;
+				costs[i][j] = it->length();
+				nextNodes[i][j] = j;
 			}
 		}
+	}
 
 	/*
-	Run the actual Floyd-Warshall algorithm. Unfortunately it's cubic in the
-	number of nodes, so we might need to change it for a different algorithm
-	in the future (e.g. running Dijkstra's from each node using a Fib heap).
-	This would be an improvement since the graph is generally quite sparse.
-
-	Note that the inductive formula for the next nodes is given by:
+	Run the actual Floyd-Warshall algorithm. Note that the inductive formula for the next nodes is given by:
 
 	sigma_{ij}^k =	{ sigma_{ij}^{k-1}		if d_{ij}^{k-1} <= d_{ik}^{k-1} + d_{kj}^{k-1}
 					{ sigma_{ik}^{k-1}		otherwise
+
+	The table can be updated in place, since d_{ik}, d_{kj} and sigma_{ik} don't change during iteration k.
 	*/
 	for(int k=0; k<size; ++k)
-	{
-		PathTable_Ptr oldPathTable = pathTable;
-		pathTable.reset(new PathTable(size));
 		for(int i=0; i<size; ++i)
 			for(int j=0; j<size; ++j)
 			{
-				pathTable->cost(i,j) = std::min(oldPathTable->cost(i,j), oldPathTable->cost(i,k) + oldPathTable->cost(k,j));
-				if(oldPathTable->cost(i,j) <= oldPathTable->cost(i,k) + oldPathTable->cost(k,j))
-					pathTable->next_node(i,j) = oldPathTable->next_node(i,j);
-				else
-					pathTable->next_node(i,j) = oldPathTable->next_node(i,k);
+				float cost = costs[i][k] + costs[k][j];
+				if(cost < costs[i][j])
+				{
+					costs[i][j] = cost;
+					nextNodes[i][j] = nextNodes[i][k];
+				}
 			}
-	}
 
+	PathTable_Ptr pathTable(new PathTable(adjList));
+	std::vector<PathTable::Row> rows(size);
+	for(int i=0; i<size; ++i) rows[i] = pathTable->encode_row(i, costs[i], nextNodes[i]);
+	pathTable->set_rows(rows);
 	return pathTable;
 }
 
+//#################### PRIVATE METHODS ####################
+/**
+Runs Dijkstra's algorithm from the specified source node, calculating the costs of the shortest
+paths from it to every other node, and the next nodes along them.
+
+Where several shortest paths tie, the path chosen is the same as the one chosen by Floyd-Warshall.
+Since Floyd-Warshall only replaces a path with a strictly shorter one, and considers intermediate
+nodes in increasing order of index, it chooses (from among the shortest paths to a node v) one whose
+highest-numbered intermediate node h(v) is as low as possible, and takes the path to h(v) as its first
+part. To match this, the nodes are labelled with both the cost of the path to them and its highest
+intermediate node, and the labels are compared lexicographically. The next node on the path to v is
+then v itself if there are no intermediate nodes, and otherwise the next node on the path to h(v),
+which is always finalised before v is. (The costs are the same as Floyd-Warshall's, up to differences
+in floating-point rounding caused by adding up the edge lengths in a different order.)
+
+@param adjList				The adjacency list for the navigation graph
+@param source				The source node
+@param costs				Used to return the costs of the paths ((float)INT_MAX for unreachable nodes)
+@param nextNodes			Used to return the next nodes along the paths (-1 for unreachable nodes)
+@param highestIntermediates	A working array of size adjList.size()
+@param done					A working array of size adjList.size()
+*/
+void PathTableGenerator::dijkstra_from(const AdjacencyList& adjList, int source, std::vector<float>& costs, std::vector<int>& nextNodes,
+									   std::vector<int>& highestIntermediates, std::vector<bool>& done)
+{
+	typedef std::pair<float,int> Label;		// the cost of a path, and its highest intermediate node (-1 if none)
+	typedef std::pair<Label,int> QueueEntry;
+	std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > queue;
+
+	std::fill(costs.begin(), costs.end(), (float)INT_MAX);
+	std::fill(nextNodes.begin(), nextNodes.end(), -1);
+	std::fill(highestIntermediates.begin(), highestIntermediates.end(), -1);
+	std::fill(done.begin(), done.end(), false);
+
+	// Note:	Rather than supporting decrease-key, we push a new queue entry whenever a node's label
+	//			decreases and skip the stale entries when they come off the queue.
+	costs[source] = 0.0f;
+	queue.push(std::make_pair(Label(0.0f, -1), source));
+	while(!queue.empty())
+	{
+		int u = queue.top().second;
+		queue.pop();
+		if(done[u]) continue;
+		done[u] = true;
+
+		if(u != source)
+		{
+			int h = highestIntermediates[u];
+			nextNodes[u] = h == -1 ? u : nextNodes[h];
+		}
+
+		// Every path through u has u as an intermediate node, unless u is the source.
+		int highest = u == source ? -1 : std::max(highestIntermediates[u], u);
+
+		const std::list<AdjacencyList::Edge>& adjEdges = adjList.adjacent_edges(u);
+		for(std::list<AdjacencyList::Edge>::const_iterator it=adjEdges.begin(), iend=adjEdges.end(); it!=iend; ++it)
+		{
+			int v = it->to_node();
+			Label label(costs[u] + it->length(), highest);
+			if(label < Label(costs[v], highestIntermediates[v]))
+			{
+				costs[v] = label.first;
+				highestIntermediates[v] = label.second;
+				queue.push(std::make_pair(label, v));
+			}
+		}
+	}
+}
+
+/**
+Calculates the (encoded) rows of the path table for the source nodes firstSource, firstSource + sourceStep, etc.
+
+@param adjList		The adjacency list for the navigation graph
+@param firstSource	The first source node
+@param sourceStep	The step between successive source nodes
+@param pathTable	The path table (used to encode the rows)
+@param rows			The array in which to store the encoded rows
+*/
+void PathTableGenerator::dijkstra_worker(const AdjacencyList& adjList, int firstSource, int sourceStep, const PathTable& pathTable,
+										 std::vector<PathTable::Row>& rows)
+{
+	int size = adjList.size();
+	std::vector<float> costs(size);
+	std::vector<int> nextNodes(size);
+	std::vector<int> highestIntermediates(size);
+	std::vector<bool> done(size);
+	for(int source=firstSource; source<size; source+=sourceStep)
+	{
+		dijkstra_from(adjList, source, costs, nextNodes, highestIntermediates, done);
+		rows[source] = pathTable.encode_row(source, costs, nextNodes);
+	}
+}
+
 }
@@ -6,19 +6,26 @@
 #ifndef H_HESP_PATHTABLEGENERATOR
 #define H_HESP_PATHTABLEGENERATOR
 
-#include <boost/shared_ptr.hpp>
-using boost::shared_ptr;
+#include <vector>
+
+#include "PathTable.h"
 
 namespace hesp {
 
 //#################### FORWARD DECLARATIONS ####################
-class AdjacencyTable;
-typedef shared_ptr<class PathTable> PathTable_Ptr;
+class AdjacencyList;
 
 struct PathTableGenerator
 {
 	//#################### PUBLIC METHODS ####################
-	static PathTable_Ptr floyd_warshall(const AdjacencyTable& adjTable);
+	static PathTable_Ptr dijkstra(const AdjacencyList& adjList, int threadCount = 1);
+	static PathTable_Ptr floyd_warshall(const AdjacencyList& adjList);
+
+	//#################### PRIVATE METHODS ####################
+private:
+	static void dijkstra_from(const AdjacencyList& adjList, int source, std::vector<float>& costs, std::vector<int>& nextNodes,
+							  std::vector<int>& highestIntermediates, std::vector<bool>& done);
+	static void dijkstra_worker(const AdjacencyList& adjList, int firstSource, int sourceStep, const PathTable& pathTable, std::vector<PathTable::Row>& rows);
 };
 
 }
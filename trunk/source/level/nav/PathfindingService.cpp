@@ -0,0 +1,292 @@
+/***
+ * hesperus: PathfindingService.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "PathfindingService.h"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "GlobalPathfinder.h"
+
+namespace hesp {
+
+//#################### CONSTRUCTORS ####################
+/**
+Constructs a pathfinding service.
+
+@param useWorkerThread	Whether to process the requests on a worker thread (rather than in update())
+*/
+PathfindingService::PathfindingService(bool useWorkerThread)
+:	m_stopWorker(false)
+{
+	if(useWorkerThread)
+	{
+		m_worker.reset(new boost::thread(boost::bind(&PathfindingService::run_worker, this)));
+	}
+}
+
+//#################### DESTRUCTOR ####################
+PathfindingService::~PathfindingService()
+{
+	if(m_worker)
+	{
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			m_stopWorker = true;
+		}
+		m_jobAvailable.notify_one();
+		m_worker->join();
+	}
+
+	// Cancel any requests which are still pending (this also breaks the reference cycles between them and their jobs).
+	while(!m_undeliveredJobs.empty())
+	{
+		Job_Ptr job = m_undeliveredJobs.begin()->second;
+		while(!job->requests.empty())
+		{
+			Request_Ptr request = job->requests.back();
+			cancel_request(request);
+		}
+	}
+}
+
+//#################### PUBLIC METHODS ####################
+/**
+Cancels a pending path request (requests which are no longer pending are unaffected).
+If no other requests are sharing the request's search, the search is abandoned.
+
+@param request	The request
+*/
+void PathfindingService::cancel_request(const Request_Ptr& request)
+{
+	if(request->m_status != REQUEST_PENDING) return;
+
+	Job_Ptr job = request->m_job;
+	request->m_status = REQUEST_CANCELLED;
+	request->m_callback = Request::Callback();
+	request->m_job.reset();
+
+	job->requests.erase(std::find(job->requests.begin(), job->requests.end(), request));
+	if(job->requests.empty())
+	{
+		remove_undelivered_job(job);
+
+		boost::mutex::scoped_lock lock(m_mutex);
+		job->cancelled = true;
+	}
+}
+
+/**
+Requests a (high-level) path from sourcePos in sourcePoly to destPos in destPoly (see
+GlobalPathfinder::find_path). The path will be found during a subsequent update().
+
+@param pathfinder	The pathfinder for the navigation mesh containing the source and dest polygons
+@param sourcePos	The source position
+@param sourcePoly	The source nav polygon
+@param destPos		The destination position
+@param destPoly		The destination nav polygon
+@param callback		An optional function to call (from update()) when the path has been found
+@return				A handle for the request
+*/
+PathfindingService::Request_Ptr PathfindingService::request_path(const GlobalPathfinder_CPtr& pathfinder, const Vector3d& sourcePos, int sourcePoly,
+																 const Vector3d& destPos, int destPoly, const Request::Callback& callback)
+{
+	Request_Ptr request(new Request(callback));
+
+	// If there's a pending job with the same pathfinder and source and dest polygons, share its result.
+	JobIndex::key_type key(pathfinder.get(), std::make_pair(sourcePoly, destPoly));
+	JobIndex::iterator it = m_undeliveredJobs.find(key);
+	if(it != m_undeliveredJobs.end())
+	{
+		const Job_Ptr& job = it->second;
+		job->requests.push_back(request);
+		request->m_job = job;
+		return request;
+	}
+
+	// Otherwise, queue up a new job.
+	Job_Ptr job(new Job(pathfinder, sourcePos, sourcePoly, destPos, destPoly));
+	job->requests.push_back(request);
+	request->m_job = job;
+	m_undeliveredJobs.insert(std::make_pair(key, job));
+
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		m_pendingJobs.push_back(job);
+	}
+	m_jobAvailable.notify_one();
+
+	return request;
+}
+
+/**
+Blocks or unblocks a nav link (see GlobalPathfinder::set_link_blocked), making sure that
+no search is using the pathfinder at the time.
+
+@param pathfinder	The pathfinder for the navigation mesh containing the link
+@param link			The index of the nav link
+@param blocked		Whether the link should be blocked
+@throws Exception	If the link index is out of range
+*/
+void PathfindingService::set_link_blocked(const GlobalPathfinder_Ptr& pathfinder, int link, bool blocked)
+{
+	boost::mutex::scoped_lock lock(m_searchMutex);
+	pathfinder->set_link_blocked(link, blocked);
+}
+
+/**
+Processes as many pending requests as possible within the specified time budget (unless
+the service has a worker thread, in which case they are processed in the background), and
+delivers the results of any requests which have finished. At least one job is processed
+on every call (if there's any work to do), so that updates always make progress, however
+small the budget.
+
+@param budgetMicroseconds	The time budget for processing requests (in microseconds)
+*/
+void PathfindingService::update(int budgetMicroseconds)
+{
+	cancel_abandoned_requests();
+
+	if(!m_worker)
+	{
+		using namespace boost::posix_time;
+		ptime startTime = microsec_clock::universal_time();
+
+		bool first = true;
+		while(!m_pendingJobs.empty())
+		{
+			if(!first && (microsec_clock::universal_time() - startTime).total_microseconds() >= budgetMicroseconds) break;
+
+			Job_Ptr job = m_pendingJobs.front();
+			m_pendingJobs.pop_front();
+			if(job->cancelled) continue;
+
+			process_job(*job);
+			m_finishedJobs.push_back(job);
+			first = false;
+		}
+	}
+
+	deliver_finished_jobs();
+}
+
+//#################### PRIVATE METHODS ####################
+/**
+Cancels any pending requests whose handles are no longer held by anyone other than the
+service, and which have no callbacks (nobody can ever find out their results).
+*/
+void PathfindingService::cancel_abandoned_requests()
+{
+	std::vector<Request_Ptr> abandonedRequests;
+	for(JobIndex::const_iterator it=m_undeliveredJobs.begin(), iend=m_undeliveredJobs.end(); it!=iend; ++it)
+	{
+		const std::vector<Request_Ptr>& requests = it->second->requests;
+		for(std::vector<Request_Ptr>::const_iterator jt=requests.begin(), jend=requests.end(); jt!=jend; ++jt)
+		{
+			if(jt->unique() && !(*jt)->m_callback) abandonedRequests.push_back(*jt);
+		}
+	}
+
+	for(std::vector<Request_Ptr>::const_iterator it=abandonedRequests.begin(), iend=abandonedRequests.end(); it!=iend; ++it)
+	{
+		cancel_request(*it);
+	}
+}
+
+/**
+Delivers the results of any finished jobs to their requests, and calls the requests' callbacks.
+*/
+void PathfindingService::deliver_finished_jobs()
+{
+	std::deque<Job_Ptr> finishedJobs;
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		finishedJobs.swap(m_finishedJobs);
+	}
+
+	for(std::deque<Job_Ptr>::const_iterator it=finishedJobs.begin(), iend=finishedJobs.end(); it!=iend; ++it)
+	{
+		const Job_Ptr& job = *it;
+		if(job->requests.empty()) continue;		// the job was cancelled while it was being processed
+
+		remove_undelivered_job(job);
+
+		std::vector<Request_Ptr> requests;
+		requests.swap(job->requests);
+		for(std::vector<Request_Ptr>::const_iterator jt=requests.begin(), jend=requests.end(); jt!=jend; ++jt)
+		{
+			Request& request = **jt;
+			request.m_status = job->pathFound ? REQUEST_SUCCEEDED : REQUEST_FAILED;
+			request.m_path = job->path;
+			request.m_job.reset();
+
+			// Note:	The callback is cleared before it's called, in case it holds the request handle.
+			Request::Callback callback;
+			callback.swap(request.m_callback);
+			if(callback) callback(*jt);
+		}
+	}
+}
+
+/**
+Finds the path for a job. If the search throws, the job is treated as having found no path,
+so that its requests still finish (and their callbacks are still called) when it's delivered.
+
+@param job	The job
+*/
+void PathfindingService::process_job(Job& job)
+{
+	boost::mutex::scoped_lock lock(m_searchMutex);
+	try
+	{
+		job.pathFound = job.pathfinder->find_path(job.sourcePos, job.sourcePoly, job.destPos, job.destPoly, job.path);
+	}
+	catch(...)
+	{
+		job.pathFound = false;
+		job.path.clear();
+	}
+}
+
+/**
+Removes a job from the index of jobs whose results have not yet been delivered.
+
+@param job	The job
+*/
+void PathfindingService::remove_undelivered_job(const Job_Ptr& job)
+{
+	JobIndex::key_type key(job->pathfinder.get(), std::make_pair(job->sourcePoly, job->destPoly));
+	JobIndex::iterator it = m_undeliveredJobs.find(key);
+	if(it != m_undeliveredJobs.end() && it->second == job) m_undeliveredJobs.erase(it);
+}
+
+/**
+Processes pending jobs on the worker thread until the service is destroyed.
+*/
+void PathfindingService::run_worker()
+{
+	for(;;)
+	{
+		Job_Ptr job;
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			while(!m_stopWorker && m_pendingJobs.empty()) m_jobAvailable.wait(lock);
+			if(m_stopWorker) return;
+
+			job = m_pendingJobs.front();
+			m_pendingJobs.pop_front();
+			if(job->cancelled) continue;
+		}
+
+		process_job(*job);
+
+		boost::mutex::scoped_lock lock(m_mutex);
+		m_finishedJobs.push_back(job);
+	}
+}
+
+}
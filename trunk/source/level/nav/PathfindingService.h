@@ -0,0 +1,171 @@
+/***
+ * hesperus: PathfindingService.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_PATHFINDINGSERVICE
+#define H_HESP_PATHFINDINGSERVICE
+
+#include <deque>
+#include <list>
+#include <map>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+using boost::shared_ptr;
+
+#include <source/math/vectors/Vector3.h>
+
+namespace hesp {
+
+//#################### FORWARD DECLARATIONS ####################
+typedef shared_ptr<class GlobalPathfinder> GlobalPathfinder_Ptr;
+typedef shared_ptr<const class GlobalPathfinder> GlobalPathfinder_CPtr;
+
+/**
+This class provides a pathfinding service for the objects in a level. Rather than finding
+paths synchronously (which makes the frame time spike whenever lots of bots decide where
+to go at once), objects submit path requests, which are queued and then processed in
+update() within a per-frame time budget. Alternatively, the service can be constructed
+with a worker thread, which processes the requests in the background: update() then just
+delivers the finished results.
+
+Each request returns a handle, which can be polled for the result or used to cancel the
+request, and an optional callback can be invoked (from update()) when the result is ready.
+Requests whose handles have been released by their callers and which have no callbacks
+are cancelled automatically. A request with the same pathfinder and source and dest
+polygons as one which is still pending shares its result, rather than causing a second
+search (the result is a sequence of nav links leading out of the source polygon and into
+the dest polygon, so it's a valid path from anywhere in one to anywhere in the other).
+
+Note:	The service's methods must all be called from the same thread. When the service
+		has a worker thread, links must be blocked and unblocked via set_link_blocked,
+		rather than by using the pathfinders directly.
+*/
+class PathfindingService
+{
+	//#################### FORWARD DECLARATIONS ####################
+private:
+	struct Job;
+
+	//#################### ENUMERATIONS ####################
+public:
+	enum RequestStatus
+	{
+		REQUEST_PENDING,		// the path has not yet been found
+		REQUEST_SUCCEEDED,		// a path was found
+		REQUEST_FAILED,			// no path was found (either none exists, or the search failed)
+		REQUEST_CANCELLED		// the request was cancelled before its path was found
+	};
+
+	//#################### NESTED CLASSES ####################
+public:
+	class Request
+	{
+		friend class PathfindingService;
+
+		//#################### TYPEDEFS ####################
+	public:
+		typedef boost::function<void (const shared_ptr<const Request>&)> Callback;
+
+		//#################### PRIVATE VARIABLES ####################
+	private:
+		RequestStatus m_status;
+		std::list<int> m_path;
+		Callback m_callback;
+		shared_ptr<Job> m_job;		// the job which is finding the path (while the request is pending)
+
+		//#################### CONSTRUCTORS ####################
+	public:
+		explicit Request(const Callback& callback)
+		:	m_status(REQUEST_PENDING), m_callback(callback)
+		{}
+
+		//#################### PUBLIC METHODS ####################
+	public:
+		const std::list<int>& path() const	{ return m_path; }
+		RequestStatus status() const		{ return m_status; }
+	};
+
+	typedef shared_ptr<Request> Request_Ptr;
+	typedef shared_ptr<const Request> Request_CPtr;
+
+private:
+	struct Job
+	{
+		GlobalPathfinder_CPtr pathfinder;
+		Vector3d sourcePos, destPos;
+		int sourcePoly, destPoly;
+
+		std::vector<Request_Ptr> requests;	// the pending requests which share this job's result
+		bool cancelled;						// whether all of the job's requests have been cancelled (guarded by m_mutex)
+
+		bool pathFound;
+		std::list<int> path;
+
+		Job(const GlobalPathfinder_CPtr& pathfinder_, const Vector3d& sourcePos_, int sourcePoly_, const Vector3d& destPos_, int destPoly_)
+		:	pathfinder(pathfinder_), sourcePos(sourcePos_), destPos(destPos_), sourcePoly(sourcePoly_), destPoly(destPoly_),
+			cancelled(false), pathFound(false)
+		{}
+	};
+
+	typedef shared_ptr<Job> Job_Ptr;
+
+	//#################### TYPEDEFS ####################
+private:
+	typedef std::map<std::pair<const GlobalPathfinder*,std::pair<int,int> >,Job_Ptr> JobIndex;
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	JobIndex m_undeliveredJobs;				// the jobs whose results have not yet been delivered, indexed by pathfinder and source/dest polygons
+
+	boost::mutex m_mutex;
+	std::deque<Job_Ptr> m_pendingJobs;		// the jobs waiting to be processed (guarded by m_mutex)
+	std::deque<Job_Ptr> m_finishedJobs;		// the jobs waiting for their results to be delivered (guarded by m_mutex)
+
+	boost::mutex m_searchMutex;				// held while a search is running (or a pathfinder is being modified)
+	shared_ptr<boost::thread> m_worker;
+	boost::condition_variable m_jobAvailable;
+	bool m_stopWorker;						// guarded by m_mutex
+
+	//#################### CONSTRUCTORS ####################
+public:
+	explicit PathfindingService(bool useWorkerThread = false);
+
+	//#################### DESTRUCTOR ####################
+public:
+	~PathfindingService();
+
+	//#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+	PathfindingService(const PathfindingService&);
+	PathfindingService& operator=(const PathfindingService&);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	void cancel_request(const Request_Ptr& request);
+	Request_Ptr request_path(const GlobalPathfinder_CPtr& pathfinder, const Vector3d& sourcePos, int sourcePoly, const Vector3d& destPos, int destPoly,
+							 const Request::Callback& callback = Request::Callback());
+	void set_link_blocked(const GlobalPathfinder_Ptr& pathfinder, int link, bool blocked);
+	void update(int budgetMicroseconds);
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void cancel_abandoned_requests();
+	void deliver_finished_jobs();
+	void process_job(Job& job);
+	void remove_undelivered_job(const Job_Ptr& job);
+	void run_worker();
+};
+
+//#################### TYPEDEFS ####################
+typedef shared_ptr<PathfindingService> PathfindingService_Ptr;
+typedef shared_ptr<const PathfindingService> PathfindingService_CPtr;
+
+}
+
+#endif
@@ -0,0 +1,258 @@
+/***
+ * hesperus: CrowdMover.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "CrowdMover.h"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include <source/exceptions/Exception.h>
+#include <source/level/bounds/BoundsManager.h>
+#include <source/level/objects/components/ICmpMovement.h>
+#include <source/level/objects/components/ICmpSimulation.h>
+#include <source/level/trees/OnionTree.h>
+#include <source/level/trees/TreeUtil.h>
+#include "ObjectManager.h"
+
+namespace {
+
+//#################### LOCAL CLASSES ####################
+struct BatchOrderPred
+{
+	const std::vector<int>& mapIndices;
+	const std::vector<int>& leafIndices;
+
+	BatchOrderPred(const std::vector<int>& mapIndices_, const std::vector<int>& leafIndices_)
+	:	mapIndices(mapIndices_), leafIndices(leafIndices_)
+	{}
+
+	bool operator()(int lhs, int rhs) const
+	{
+		if(mapIndices[lhs] != mapIndices[rhs]) return mapIndices[lhs] < mapIndices[rhs];
+		if(leafIndices[lhs] != leafIndices[rhs]) return leafIndices[lhs] < leafIndices[rhs];
+		return lhs < rhs;
+	}
+};
+
+}
+
+namespace hesp {
+
+//#################### CONSTRUCTORS ####################
+/**
+Constructs a crowd mover.
+
+@param threadCount	The maximum number of threads to use when flushing a batch of moves (including the calling thread)
+*/
+CrowdMover::CrowdMover(int threadCount)
+:	m_threadCount(std::max(threadCount, 1)), m_batchNumber(0), m_busyWorkers(0), m_stopWorkers(false), m_partCount(0), m_polygons(NULL), m_milliseconds(0)
+{
+	for(int i=1; i<m_threadCount; ++i)
+	{
+		m_workers.push_back(shared_ptr<boost::thread>(new boost::thread(boost::bind(&CrowdMover::run_worker, this, i))));
+	}
+}
+
+//#################### DESTRUCTOR ####################
+CrowdMover::~CrowdMover()
+{
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		m_stopWorkers = true;
+	}
+	m_batchAvailable.notify_all();
+	for(size_t i=0, size=m_workers.size(); i<size; ++i) m_workers[i]->join();
+}
+
+//#################### PUBLIC METHODS ####################
+/**
+Carries out all of the queued moves and empties the queue.
+
+@param objectManager	The object manager for the level
+@param polygons			The collision polygons for the level
+@param tree				The onion tree for the level
+@param navManager		The navigation manager for the level
+@param milliseconds		The length of the move (in milliseconds)
+@throws Exception		If any of the moves fail
+*/
+void CrowdMover::flush(const ObjectManager_Ptr& objectManager, const std::vector<CollisionPolygon_Ptr>& polygons, const OnionTree_CPtr& tree,
+					   const NavManager_CPtr& navManager, int milliseconds)
+{
+	if(m_objectIDs.empty()) return;
+
+	// Note:	Any error is rethrown only after the batch has been cleared, so that a failed batch
+	//			isn't carried out again by the next flush.
+	std::string error;
+	try
+	{
+		gather_batch(objectManager, tree);
+
+		int moveCount = static_cast<int>(m_order.size());
+		m_partCount = std::min(m_threadCount, std::max(moveCount / MIN_MOVES_PER_THREAD, 1));
+		m_errors.assign(m_partCount, "");
+		m_polygons = &polygons;
+		m_tree = tree;
+		m_navManager = navManager;
+		m_milliseconds = milliseconds;
+
+		if(m_partCount == 1)
+		{
+			move_part(0);
+		}
+		else
+		{
+			// Wake the workers to move the other parts of the batch, move the first part on this thread, and then wait for the workers to finish.
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+				m_busyWorkers = static_cast<int>(m_workers.size());
+				++m_batchNumber;
+			}
+			m_batchAvailable.notify_all();
+
+			move_part(0);
+
+			boost::mutex::scoped_lock lock(m_mutex);
+			while(m_busyWorkers > 0) m_batchFinished.wait(lock);
+		}
+
+		for(int i=0; i<m_partCount && error.empty(); ++i) error = m_errors[i];
+	}
+	catch(Exception& e) { error = e.cause(); }
+
+	clear();
+	if(!error.empty()) throw Exception(error);
+}
+
+/**
+Queues a move for the specified object. Each object can only be queued once per batch.
+
+@param objectID		The object to move
+@param dir			The desired movement direction
+@param speed		The speed at which to move (in units/s)
+@return				true, if the move was queued, or false if the object already has a move in the current batch
+*/
+bool CrowdMover::queue_move(const ObjectID& objectID, const Vector3d& dir, double speed)
+{
+	if(!m_queuedObjects.insert(objectID).second) return false;
+
+	m_objectIDs.push_back(objectID);
+	m_dirs.push_back(dir);
+	m_speeds.push_back(speed);
+	return true;
+}
+
+int CrowdMover::queued_move_count() const
+{
+	return static_cast<int>(m_objectIDs.size());
+}
+
+int CrowdMover::thread_count() const
+{
+	return m_threadCount;
+}
+
+//#################### PRIVATE METHODS ####################
+void CrowdMover::clear()
+{
+	m_objectIDs.clear();
+	m_dirs.clear();
+	m_speeds.clear();
+	m_queuedObjects.clear();
+
+	m_cmpMovements.clear();
+	m_mapIndices.clear();
+	m_leafIndices.clear();
+	m_order.clear();
+	m_errors.clear();
+
+	m_polygons = NULL;
+	m_tree.reset();
+	m_navManager.reset();
+}
+
+/**
+Looks up the movement component, map index and leaf index of each queued object, and
+sorts the batch by map index and then leaf index.
+
+@param objectManager	The object manager for the level
+@param tree				The onion tree for the level
+*/
+void CrowdMover::gather_batch(const ObjectManager_Ptr& objectManager, const OnionTree_CPtr& tree)
+{
+	const BoundsManager_CPtr& boundsManager = objectManager->bounds_manager();
+
+	int moveCount = static_cast<int>(m_objectIDs.size());
+	m_cmpMovements.resize(moveCount);
+	m_mapIndices.resize(moveCount);
+	m_leafIndices.resize(moveCount);
+	m_order.resize(moveCount);
+
+	for(int i=0; i<moveCount; ++i)
+	{
+		ICmpMovement_Ptr cmpMovement = objectManager->get_component(m_objectIDs[i], cmpMovement);			assert(cmpMovement != NULL);
+		ICmpSimulation_CPtr cmpSimulation = objectManager->get_component(m_objectIDs[i], cmpSimulation);	assert(cmpSimulation != NULL);
+
+		m_cmpMovements[i] = cmpMovement;
+
+		m_mapIndices[i] = boundsManager->lookup_bounds_index(cmpSimulation->bounds_group(), cmpSimulation->posture());
+		m_leafIndices[i] = TreeUtil::find_leaf_index(cmpSimulation->position(), tree);
+		m_order[i] = i;
+	}
+
+	std::sort(m_order.begin(), m_order.end(), BatchOrderPred(m_mapIndices, m_leafIndices));
+}
+
+/**
+Carries out the moves in the specified part of the sorted batch. The batch is split into
+m_partCount contiguous runs, so that objects in the same leaf are moved by the same thread.
+Any exception is caught and its cause stored in m_errors, so that this can safely be run on
+a worker thread.
+
+@param part		The index of the part to move
+*/
+void CrowdMover::move_part(int part)
+try
+{
+	int moveCount = static_cast<int>(m_order.size());
+	int begin = moveCount * part / m_partCount, end = moveCount * (part+1) / m_partCount;
+	for(int i=begin; i<end; ++i)
+	{
+		int n = m_order[i];
+		m_cmpMovements[n]->move(m_dirs[n], m_speeds[n], m_milliseconds, *m_polygons, m_tree, m_navManager);
+	}
+}
+catch(Exception& e) { m_errors[part] = e.cause(); }
+
+/**
+Runs a worker thread, which moves the specified part of each batch handed to the workers
+(if the batch has that many parts) until the crowd mover is destroyed.
+
+@param part		The index of the part of each batch which the worker moves
+*/
+void CrowdMover::run_worker(int part)
+{
+	int lastBatchNumber = 0;
+	for(;;)
+	{
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			while(!m_stopWorkers && m_batchNumber == lastBatchNumber) m_batchAvailable.wait(lock);
+			if(m_stopWorkers) return;
+			lastBatchNumber = m_batchNumber;
+		}
+
+		if(part < m_partCount) move_part(part);
+
+		bool lastToFinish;
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			lastToFinish = --m_busyWorkers == 0;
+		}
+		if(lastToFinish) m_batchFinished.notify_one();
+	}
+}
+
+}
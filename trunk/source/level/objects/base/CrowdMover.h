@@ -0,0 +1,125 @@
+/***
+ * hesperus: CrowdMover.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_CROWDMOVER
+#define H_HESP_CROWDMOVER
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+using boost::shared_ptr;
+
+#include <source/math/vectors/Vector3.h>
+#include <source/util/PolygonTypes.h>
+#include "ObjectID.h"
+
+namespace hesp {
+
+//#################### FORWARD DECLARATIONS ####################
+typedef shared_ptr<class ICmpMovement> ICmpMovement_Ptr;
+typedef shared_ptr<const class NavManager> NavManager_CPtr;
+typedef shared_ptr<class ObjectManager> ObjectManager_Ptr;
+typedef shared_ptr<const class OnionTree> OnionTree_CPtr;
+
+/**
+This class batches up the navmesh-based movement of the objects in a level. Rather than
+moving each object as soon as its move command is executed, the commands queue their moves
+here, and the whole batch is then carried out by flush().
+
+When the batch is flushed, the moving objects are first gathered into parallel arrays of
+components, map indices and leaf indices, and sorted by map and leaf, so that objects which
+are close together in the level (and thus query the same parts of the onion tree and nav mesh)
+are moved one after the other. The sorted batch is then split into contiguous runs, which are
+moved in parallel if the batch is big enough to make this worthwhile: the calling thread moves
+the first run, and a pool of worker threads (started when the crowd mover is constructed, and
+reused by every flush) moves the others.
+
+Note that the result is the same as that of moving the objects one at a time: an object's move
+only depends on its own state and on the (static) level geometry, and each object can only be
+queued once per batch. Callers must flush the batch before doing anything else which depends
+on the positions of the queued objects.
+*/
+class CrowdMover
+{
+	//#################### CONSTANTS ####################
+private:
+	enum
+	{
+		MIN_MOVES_PER_THREAD = 32	// the minimum number of moves it's worth giving to each thread
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	int m_threadCount;
+
+	// The worker threads
+	std::vector<shared_ptr<boost::thread> > m_workers;
+	boost::mutex m_mutex;
+	boost::condition_variable m_batchAvailable;
+	boost::condition_variable m_batchFinished;
+	int m_batchNumber;						// incremented each time a batch is handed to the workers (guarded by m_mutex)
+	int m_busyWorkers;						// the number of workers still moving their part of the batch (guarded by m_mutex)
+	bool m_stopWorkers;						// guarded by m_mutex
+
+	// The queued moves (in the order in which they were queued)
+	std::vector<ObjectID> m_objectIDs;
+	std::vector<Vector3d> m_dirs;
+	std::vector<double> m_speeds;
+	std::set<ObjectID> m_queuedObjects;
+
+	// The batch being flushed (stored as parallel arrays, indexed in the same way as the queued moves)
+	std::vector<ICmpMovement_Ptr> m_cmpMovements;
+	std::vector<int> m_mapIndices;
+	std::vector<int> m_leafIndices;
+	std::vector<int> m_order;		// the order in which to carry out the moves (sorted by map index, then leaf index)
+	int m_partCount;				// the number of contiguous runs into which the batch is split
+	std::vector<std::string> m_errors;
+
+	// The level and move length for the batch being flushed
+	const std::vector<CollisionPolygon_Ptr> *m_polygons;
+	OnionTree_CPtr m_tree;
+	NavManager_CPtr m_navManager;
+	int m_milliseconds;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	explicit CrowdMover(int threadCount = 1);
+
+	//#################### DESTRUCTOR ####################
+public:
+	~CrowdMover();
+
+	//#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+	CrowdMover(const CrowdMover&);
+	CrowdMover& operator=(const CrowdMover&);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	void flush(const ObjectManager_Ptr& objectManager, const std::vector<CollisionPolygon_Ptr>& polygons, const OnionTree_CPtr& tree, const NavManager_CPtr& navManager, int milliseconds);
+	bool queue_move(const ObjectID& objectID, const Vector3d& dir, double speed);
+	int queued_move_count() const;
+	int thread_count() const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void clear();
+	void gather_batch(const ObjectManager_Ptr& objectManager, const OnionTree_CPtr& tree);
+	void move_part(int part);
+	void run_worker(int part);
+};
+
+//#################### TYPEDEFS ####################
+typedef shared_ptr<CrowdMover> CrowdMover_Ptr;
+typedef shared_ptr<const CrowdMover> CrowdMover_CPtr;
+
+}
+
+#endif
@@ -28,6 +28,23 @@ public:
 	//#################### PUBLIC ABSTRACT METHODS ####################
 public:
 	virtual void execute(const ObjectManager_Ptr& objectManager, const std::vector<CollisionPolygon_Ptr>& polygons, const OnionTree_CPtr& tree, const NavManager_CPtr& navManager, int milliseconds) = 0;
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	Attempts to queue the command's work with the object manager's crowd mover, so that it can
+	be carried out in a batch with that of other commands, rather than by calling execute().
+
+	@param objectManager	The object manager for the level
+	@return					true, if the command was queued, or false if it must be executed as normal
+	*/
+	virtual bool attempt_batching(const ObjectManager_Ptr& objectManager)	{ return false; }
+
+	/**
+	Returns whether or not the outcome of the command could depend on (or affect) the positions of objects,
+	in which case any batched moves must be carried out before the command is executed.
+	*/
+	virtual bool depends_on_movement() const								{ return true; }
 };
 
 //#################### TYPEDEFS ####################
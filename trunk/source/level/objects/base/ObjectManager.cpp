@@ -5,6 +5,8 @@
 
 #include "ObjectManager.h"
 
+#include <boost/thread/thread.hpp>
+
 #include <source/level/objects/components/ICmpActivatable.h>
 #include <source/level/objects/components/ICmpInventory.h>
 #include <source/level/objects/components/ICmpModelRender.h>
@@ -16,7 +18,9 @@
 #include <source/level/objects/contactresolvers/ProjectileDamageContactResolver.h>
 #include <source/level/objects/messages/MsgObjectDestroyed.h>
 #include <source/level/objects/messages/MsgObjectPredestroyed.h>
+#include <source/level/nav/PathfindingService.h>
 #include <source/level/physics/PhysicsSystem.h>
+#include "CrowdMover.h"
 #include "ObjectSpecification.h"
 
 namespace hesp {
@@ -35,9 +39,11 @@ ObjectManager::ObjectManager(const BoundsManager_CPtr& boundsManager, const Comp
 							 const ModelManager_Ptr& modelManager, const SpriteManager_Ptr& spriteManager)
 :	m_boundsManager(boundsManager),
 	m_componentPropertyTypes(componentPropertyTypes),
+	m_crowdMover(new CrowdMover(static_cast<int>(boost::thread::hardware_concurrency()))),
 	m_archetypes(archetypes),
 	m_aiEngine(aiEngine),
 	m_modelManager(modelManager),
+	m_pathfindingService(new PathfindingService),
 	m_physicsSystem(new PhysicsSystem),
 	m_spriteManager(spriteManager)
 {
@@ -127,6 +133,21 @@ void ObjectManager::consolidate_object_ids()
 	//			loaded in (e.g. as part of the level-making process), their IDs will already be contiguous.
 }
 
+const CrowdMover_Ptr& ObjectManager::crowd_mover()
+{
+	return m_crowdMover;
+}
+
+/**
+Returns the manager for the level's dynamic lights (null if the objects aren't part of a level, e.g. in the tools).
+
+@return	As stated
+*/
+const DynamicLightManager_Ptr& ObjectManager::dynamic_light_manager()
+{
+	return m_dynamicLightManager;
+}
+
 void ObjectManager::flush_queues()
 {
 	// Note:	The destruction queue must be flushed second, since some of the
@@ -190,6 +211,11 @@ int ObjectManager::object_count() const
 	return static_cast<int>(m_objects.size());
 }
 
+const PathfindingService_Ptr& ObjectManager::pathfinding_service()
+{
+	return m_pathfindingService;
+}
+
 const PhysicsSystem_Ptr& ObjectManager::physics_system()
 {
 	return m_physicsSystem;
@@ -246,6 +272,17 @@ void ObjectManager::remove_listener(IObjectComponent *listener, const ObjectID&
 	m_listenerTable.remove_listener(listener->object_id(), listener->group_type(), id);
 }
 
+/**
+Sets the manager for the dynamic lights of the level containing the objects, so that components
+can create lights (e.g. muzzle flashes).
+
+@param dynamicLightManager	The dynamic light manager
+*/
+void ObjectManager::set_dynamic_light_manager(const DynamicLightManager_Ptr& dynamicLightManager)
+{
+	m_dynamicLightManager = dynamicLightManager;
+}
+
 const SpriteManager_Ptr& ObjectManager::sprite_manager()
 {
 	return m_spriteManager;
@@ -28,10 +28,13 @@ namespace hesp {
 
 //#################### FORWARD DECLARATIONS ####################
 typedef shared_ptr<const class BoundsManager> BoundsManager_CPtr;
+typedef shared_ptr<class CrowdMover> CrowdMover_Ptr;
+typedef shared_ptr<class DynamicLightManager> DynamicLightManager_Ptr;
 typedef shared_ptr<class IObjectComponent> IObjectComponent_Ptr;
 typedef shared_ptr<const class Message> Message_CPtr;
 typedef shared_ptr<class ModelManager> ModelManager_Ptr;
 typedef shared_ptr<const class ModelManager> ModelManager_CPtr;
+typedef shared_ptr<class PathfindingService> PathfindingService_Ptr;
 typedef shared_ptr<class PhysicsSystem> PhysicsSystem_Ptr;
 typedef shared_ptr<class SpriteManager> SpriteManager_Ptr;
 typedef shared_ptr<const class SpriteManager> SpriteManager_CPtr;
@@ -52,10 +55,13 @@ private:
 	std::map<std::string,ObjectSpecification> m_archetypes;
 	BoundsManager_CPtr m_boundsManager;
 	ComponentPropertyTypeMap m_componentPropertyTypes;
+	CrowdMover_Ptr m_crowdMover;
+	DynamicLightManager_Ptr m_dynamicLightManager;
 	std::map<std::string,GroupPredicate> m_groupPredicates;
 	IDAllocator m_idAllocator;
 	ModelManager_Ptr m_modelManager;
 	std::map<ObjectID,Object> m_objects;
+	PathfindingService_Ptr m_pathfindingService;
 	PhysicsSystem_Ptr m_physicsSystem;
 	SpriteManager_Ptr m_spriteManager;
 
@@ -75,6 +81,8 @@ public:
 	void broadcast_message(const Message_CPtr& msg);
 	const ComponentPropertyTypeMap& component_property_types() const;
 	void consolidate_object_ids();
+	const CrowdMover_Ptr& crowd_mover();
+	const DynamicLightManager_Ptr& dynamic_light_manager();
 	void flush_queues();
 	const ObjectSpecification& get_archetype(const std::string& archetypeName) const;
 	template <typename T> shared_ptr<T> get_component(const ObjectID& id, const shared_ptr<T>& = shared_ptr<T>());
@@ -84,6 +92,7 @@ public:
 	const ModelManager_Ptr& model_manager();
 	ModelManager_CPtr model_manager() const;
 	int object_count() const;
+	const PathfindingService_Ptr& pathfinding_service();
 	const PhysicsSystem_Ptr& physics_system();
 	ObjectID player() const;
 	void post_message(const ObjectID& target, const Message_CPtr& msg);
@@ -92,6 +101,7 @@ public:
 	void queue_for_destruction(const ObjectID& id);
 	void register_group(const std::string& name, const GroupPredicate& pred);
 	void remove_listener(IObjectComponent *listener, const ObjectID& id);
+	void set_dynamic_light_manager(const DynamicLightManager_Ptr& dynamicLightManager);
 	const SpriteManager_Ptr& sprite_manager();
 	SpriteManager_CPtr sprite_manager() const;
 
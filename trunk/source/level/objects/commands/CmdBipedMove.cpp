@@ -5,6 +5,7 @@
 
 #include "CmdBipedMove.h"
 
+#include <source/level/objects/base/CrowdMover.h>
 #include <source/level/objects/components/ICmpBipedAnimChooser.h>
 #include <source/level/objects/components/ICmpMovement.h>
 
@@ -16,6 +17,20 @@ CmdBipedMove::CmdBipedMove(const ObjectID& objectID, const Vector3d& dir)
 {}
 
 //#################### PUBLIC METHODS ####################
+bool CmdBipedMove::attempt_batching(const ObjectManager_Ptr& objectManager)
+{
+	// Lookup the appropriate speed with which to move, and queue the move with the crowd mover.
+	ICmpMovement_Ptr cmpMovement = objectManager->get_component(m_objectID, cmpMovement);	assert(cmpMovement);
+	double speed = lookup_speed(cmpMovement);
+	if(!objectManager->crowd_mover()->queue_move(m_objectID, m_dir, speed)) return false;
+
+	// Set the appropriate animation flag (e.g. walk, run, etc.) - this doesn't depend on the outcome of the move, so it can be done now.
+	ICmpBipedAnimChooser_Ptr cmpAnimChooser = objectManager->get_component(m_objectID, cmpAnimChooser);
+	if(cmpAnimChooser) set_anim_flag(cmpAnimChooser);
+
+	return true;
+}
+
 void CmdBipedMove::execute(const ObjectManager_Ptr& objectManager, const std::vector<CollisionPolygon_Ptr>& polygons, const OnionTree_CPtr& tree,
 						   const NavManager_CPtr& navManager, int milliseconds)
 {
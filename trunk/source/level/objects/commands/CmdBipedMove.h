@@ -32,6 +32,7 @@ private:
 
 	//#################### PUBLIC METHODS ####################
 public:
+	bool attempt_batching(const ObjectManager_Ptr& objectManager);
 	void execute(const ObjectManager_Ptr& objectManager, const std::vector<CollisionPolygon_Ptr>& polygons, const OnionTree_CPtr& tree, const NavManager_CPtr& navManager, int milliseconds);
 };
 
@@ -16,6 +16,12 @@ CmdBipedSetLook::CmdBipedSetLook(const ObjectID& objectID, const Vector3d& look)
 {}
 
 //#################### PUBLIC METHODS ####################
+bool CmdBipedSetLook::depends_on_movement() const
+{
+	// Changing an object's orientation neither affects nor depends on its movement.
+	return false;
+}
+
 void CmdBipedSetLook::execute(const ObjectManager_Ptr& objectManager, const std::vector<CollisionPolygon_Ptr>& polygons, const OnionTree_CPtr& tree,
 							  const NavManager_CPtr& navManager, int milliseconds)
 {
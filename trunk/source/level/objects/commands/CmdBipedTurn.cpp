@@ -16,6 +16,12 @@ CmdBipedTurn::CmdBipedTurn(const ObjectID& objectID, int mouseMotionX, int mouse
 {}
 
 //#################### PUBLIC METHODS ####################
+bool CmdBipedTurn::depends_on_movement() const
+{
+	// Changing an object's orientation neither affects nor depends on its movement.
+	return false;
+}
+
 void CmdBipedTurn::execute(const ObjectManager_Ptr& objectManager, const std::vector<CollisionPolygon_Ptr>& polygons, const OnionTree_CPtr& tree,
 						   const NavManager_CPtr& navManager, int milliseconds)
 {
@@ -23,6 +23,7 @@ public:
 
 	//#################### PUBLIC METHODS ####################
 public:
+	bool depends_on_movement() const;
 	void execute(const ObjectManager_Ptr& objectManager, const std::vector<CollisionPolygon_Ptr>& polygons, const OnionTree_CPtr& tree, const NavManager_CPtr& navManager, int milliseconds);
 };
 
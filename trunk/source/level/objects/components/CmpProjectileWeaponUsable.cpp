@@ -5,19 +5,37 @@
 
 #include "CmpProjectileWeaponUsable.h"
 
+#include <source/level/lighting/DynamicLightManager.h>
 #include <source/level/objects/messages/MsgTimeElapsed.h>
 #include <source/util/Properties.h>
 #include "ICmpInventory.h"
 #include "ICmpOwnable.h"
 
+namespace {
+
+//#################### CONSTANTS ####################
+// The colour, falloff radius and duration (in milliseconds) of the light produced when a weapon fires.
+const hesp::Colour3d MUZZLE_FLASH_COLOUR(1.0, 0.8, 0.5);
+const double MUZZLE_FLASH_RADIUS = 5.0;
+const int MUZZLE_FLASH_DURATION = 100;
+
+}
+
 namespace hesp {
 
 //#################### CONSTRUCTORS ####################
 CmpProjectileWeaponUsable::CmpProjectileWeaponUsable(const std::string& ammoType, int firingInterval, const std::string& usableGroup,
 													 const std::vector<std::string>& hotspots, double muzzleSpeed, int timeTillCanFire)
-:	CmpUsable(usableGroup, hotspots), m_ammoType(ammoType), m_firingInterval(firingInterval), m_muzzleSpeed(muzzleSpeed), m_timeTillCanFire(timeTillCanFire)
+:	CmpUsable(usableGroup, hotspots), m_ammoType(ammoType), m_firingInterval(firingInterval), m_muzzleSpeed(muzzleSpeed), m_timeTillCanFire(timeTillCanFire),
+	m_muzzleFlashLight(-1), m_muzzleFlashTime(0)
 {}
 
+//#################### DESTRUCTOR ####################
+CmpProjectileWeaponUsable::~CmpProjectileWeaponUsable()
+{
+	extinguish_muzzle_flash();
+}
+
 //#################### STATIC FACTORY METHODS ####################
 IObjectComponent_Ptr CmpProjectileWeaponUsable::load(const Properties& properties)
 {
@@ -45,6 +63,12 @@ void CmpProjectileWeaponUsable::process_message(const MsgTimeElapsed& msg)
 {
 	m_timeTillCanFire -= msg.milliseconds();
 	if(m_timeTillCanFire < 0) m_timeTillCanFire = 0;
+
+	if(m_muzzleFlashLight != -1)
+	{
+		m_muzzleFlashTime -= msg.milliseconds();
+		if(m_muzzleFlashTime <= 0) extinguish_muzzle_flash();
+	}
 }
 
 Properties CmpProjectileWeaponUsable::save() const
@@ -86,6 +110,8 @@ void CmpProjectileWeaponUsable::use()
 					specification.set_component_property("Simulation", "Position", *pos);
 					specification.set_component_property("Simulation", "Velocity", m_muzzleSpeed * *ori);
 					m_objectManager->queue_for_construction(specification);
+
+					show_muzzle_flash(*pos);
 				}
 			}
 
@@ -95,4 +121,37 @@ void CmpProjectileWeaponUsable::use()
 	}
 }
 
+//#################### PRIVATE METHODS ####################
+/**
+Removes the muzzle flash light (if any).
+*/
+void CmpProjectileWeaponUsable::extinguish_muzzle_flash()
+{
+	if(m_muzzleFlashLight != -1)
+	{
+		m_dynamicLightManager->remove_light(m_muzzleFlashLight);
+		m_muzzleFlashLight = -1;
+	}
+}
+
+/**
+Lights (or moves) the muzzle flash light, if the object manager has a dynamic light manager. If the weapon
+has several hotspots, the flash is shown at the last one to fire, since one light per weapon is enough.
+
+@param position	The position of the hotspot from which a projectile was just fired
+*/
+void CmpProjectileWeaponUsable::show_muzzle_flash(const Vector3d& position)
+{
+	if(!m_dynamicLightManager)
+	{
+		m_dynamicLightManager = m_objectManager->dynamic_light_manager();
+		if(!m_dynamicLightManager) return;
+	}
+
+	Light light(position, MUZZLE_FLASH_COLOUR, MUZZLE_FLASH_RADIUS);
+	if(m_muzzleFlashLight == -1) m_muzzleFlashLight = m_dynamicLightManager->add_light(light);
+	else m_dynamicLightManager->set_light(m_muzzleFlashLight, light);
+	m_muzzleFlashTime = MUZZLE_FLASH_DURATION;
+}
+
 }
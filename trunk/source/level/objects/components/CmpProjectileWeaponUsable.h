@@ -11,6 +11,8 @@
 #endif
 
 #include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
 
 #include "CmpUsable.h"
 #include "ICmpAmmoNeedingUsable.h"
@@ -18,6 +20,7 @@
 namespace hesp {
 
 //#################### FORWARD DECLARATIONS ####################
+typedef shared_ptr<class DynamicLightManager> DynamicLightManager_Ptr;
 class MsgTimeElapsed;
 
 class CmpProjectileWeaponUsable
@@ -32,10 +35,18 @@ private:
 	double m_muzzleSpeed;
 	int m_timeTillCanFire;				// the time remaining until the weapon can fire (in milliseconds)
 
+	DynamicLightManager_Ptr m_dynamicLightManager;	// the manager for the muzzle flash light (if any)
+	int m_muzzleFlashLight;				// the ID of the muzzle flash light (-1 if there isn't one)
+	int m_muzzleFlashTime;				// the time remaining until the muzzle flash goes out (in milliseconds)
+
 	//#################### CONSTRUCTORS ####################
 public:
 	CmpProjectileWeaponUsable(const std::string& ammoType, int firingInterval, const std::string& usableGroup, const std::vector<std::string>& hotspots, double muzzleSpeed, int timeTillCanFire);
 
+	//#################### DESTRUCTOR ####################
+public:
+	~CmpProjectileWeaponUsable();
+
 	//#################### STATIC FACTORY METHODS ####################
 public:
 	static IObjectComponent_Ptr load(const Properties& properties);
@@ -50,6 +61,11 @@ public:
 
 	std::string own_type() const			{ return "ProjectileWeaponUsable"; }
 	static std::string static_own_type()	{ return "ProjectileWeaponUsable"; }
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void extinguish_muzzle_flash();
+	void show_muzzle_flash(const Vector3d& position);
 };
 
 }
@@ -6,12 +6,12 @@
 #include "MinimusGotoPositionYoke.h"
 
 #include <source/level/bounds/BoundsManager.h>
-#include <source/level/nav/GlobalPathfinder.h>
 #include <source/level/nav/NavDataset.h>
 #include <source/level/nav/NavLink.h>
 #include <source/level/nav/NavManager.h>
 #include <source/level/nav/NavMesh.h>
 #include <source/level/nav/NavMeshUtil.h>
+#include <source/level/nav/PathfindingService.h>
 #include <source/level/objects/commands/CmdBipedSetLook.h>
 #include <source/level/objects/commands/CmdBipedWalk.h>
 #include <source/level/objects/components/ICmpMovement.h>
@@ -41,23 +41,38 @@ std::vector<ObjectCommand_Ptr> MinimusGotoPositionYoke::generate_commands(InputS
 
 	if(!m_path)
 	{
-		int mapIndex = m_objectManager->bounds_manager()->lookup_bounds_index(cmpSimulation->bounds_group(), cmpSimulation->posture());
-		NavDataset_CPtr navDataset = navManager->dataset(mapIndex);
-		NavMesh_CPtr navMesh = navDataset->nav_mesh();
-		GlobalPathfinder pathfinder(navMesh, navDataset->adjacency_list(), navDataset->path_table());
-
-		int suggestedSourcePoly = cmpMovement->cur_nav_poly_index();
-		int sourcePoly = NavMeshUtil::find_nav_polygon(source, suggestedSourcePoly, polygons, tree, navMesh);
-		if(sourcePoly == -1)	{ m_state = YOKE_FAILED; return std::vector<ObjectCommand_Ptr>(); }
-		int destPoly = NavMeshUtil::find_nav_polygon(m_dest, -1, polygons, tree, navMesh);
-		if(destPoly == -1)		{ m_state = YOKE_FAILED; return std::vector<ObjectCommand_Ptr>(); }
-
-		// FIXME: It's wasteful to copy the array of links each time (even though it's an array of pointers).
-		m_links = navMesh->links();
-
-		m_path.reset(new std::list<int>);
-		bool pathFound = pathfinder.find_path(source, sourcePoly, m_dest, destPoly, *m_path);
-		if(!pathFound)			{ m_state = YOKE_FAILED; return std::vector<ObjectCommand_Ptr>(); }
+		// Paths are found asynchronously by the pathfinding service, so if we haven't yet requested
+		// a path, do so, and then wait (without moving) until it's been found.
+		if(!m_pathRequest)
+		{
+			int mapIndex = m_objectManager->bounds_manager()->lookup_bounds_index(cmpSimulation->bounds_group(), cmpSimulation->posture());
+			NavDataset_CPtr navDataset = navManager->dataset(mapIndex);
+			NavMesh_CPtr navMesh = navDataset->nav_mesh();
+
+			int suggestedSourcePoly = cmpMovement->cur_nav_poly_index();
+			int sourcePoly = NavMeshUtil::find_nav_polygon(source, suggestedSourcePoly, polygons, tree, navMesh);
+			if(sourcePoly == -1)	{ m_state = YOKE_FAILED; return std::vector<ObjectCommand_Ptr>(); }
+			int destPoly = NavMeshUtil::find_nav_polygon(m_dest, -1, polygons, tree, navMesh);
+			if(destPoly == -1)		{ m_state = YOKE_FAILED; return std::vector<ObjectCommand_Ptr>(); }
+
+			// FIXME: It's wasteful to copy the array of links each time (even though it's an array of pointers).
+			m_links = navMesh->links();
+
+			m_pathRequest = m_objectManager->pathfinding_service()->request_path(navDataset->global_pathfinder(), source, sourcePoly, m_dest, destPoly);
+		}
+
+		switch(m_pathRequest->status())
+		{
+			case PathfindingService::REQUEST_PENDING:
+				return std::vector<ObjectCommand_Ptr>();
+			case PathfindingService::REQUEST_SUCCEEDED:
+				m_path.reset(new std::list<int>(m_pathRequest->path()));
+				m_pathRequest.reset();
+				break;
+			default:
+				m_state = YOKE_FAILED;
+				return std::vector<ObjectCommand_Ptr>();
+		}
 	}
 
 	// FIXME:	The way this yoke decides that it's traversed a link isn't sufficient.
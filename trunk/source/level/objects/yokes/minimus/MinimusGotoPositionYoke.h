@@ -8,6 +8,7 @@
 
 #include <list>
 
+#include <source/level/nav/PathfindingService.h>
 #include <source/level/objects/base/IYoke.h>
 #include <source/level/objects/base/ObjectID.h>
 
@@ -30,6 +31,7 @@ private:
 	Vector3d m_dest;
 	std::vector<NavLink_Ptr> m_links;
 	shared_ptr<std::list<int> > m_path;
+	PathfindingService::Request_Ptr m_pathRequest;
 
 	//#################### CONSTRUCTORS ####################
 public:
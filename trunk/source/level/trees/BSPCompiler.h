@@ -6,10 +6,14 @@
 #ifndef H_HESP_BSPCOMPILEREX
 #define H_HESP_BSPCOMPILEREX
 
+#include <string>
 #include <vector>
 
+#include <boost/thread/mutex.hpp>
+
 #include <source/math/geom/Plane.h>
 #include "BSPTree.h"
+#include "SplitSelector.h"
 
 namespace hesp {
 
@@ -25,40 +29,73 @@ private:
 		SD_SOLID
 	};
 
+	//#################### CONSTANTS ####################
+private:
+	// The minimum number of polygons a subtree must contain for it to be worth building its front half on another thread.
+	enum
+	{
+		PARALLEL_THRESHOLD = 1000
+	};
+
+	//#################### TYPEDEFS ####################
+private:
+	typedef shared_ptr<Poly> Poly_Ptr;
+	typedef std::vector<Poly_Ptr> PolyVector;
+	typedef shared_ptr<int> Slot;
+
 	//#################### NESTED CLASSES ####################
 private:
 	struct PolyIndex
 	{
-		int index;
+		Poly_Ptr poly;			// the referenced polygon (or the fragment of it that has reached this point)
+		Slot slot;				// the index of the referenced polygon in the output polygon array (assigned once the tree has been built)
 		bool splitCandidate;	// is the plane of the referenced polygon a split candidate?
 		bool hint;				// is the referenced polygon a hint polygon?
 
-		PolyIndex(int index_, bool splitCandidate_, bool hint_)
-		:	index(index_), splitCandidate(splitCandidate_), hint(hint_)
+		PolyIndex(const Poly_Ptr& poly_, const Slot& slot_, bool splitCandidate_, bool hint_)
+		:	poly(poly_), slot(slot_), splitCandidate(splitCandidate_), hint(hint_)
 		{}
 	};
 
-	//#################### TYPEDEFS ####################
-private:
-	typedef shared_ptr<Poly> Poly_Ptr;
-	typedef std::vector<Poly_Ptr> PolyVector;
 	typedef shared_ptr<const PolyIndex> PolyIndex_CPtr;
 
+	struct BuildNode;
+	typedef shared_ptr<BuildNode> BuildNode_Ptr;
+
+	/**
+	A node of the tree as it is being built. The indices of the tree nodes and of the polygon
+	fragments created by splitting are only assigned once the whole tree has been built, so
+	that they don't depend on the order in which (possibly concurrent) subtrees are built.
+	*/
+	struct BuildNode
+	{
+		Plane_Ptr splitter;					// the split plane (NULL for a leaf)
+		BuildNode_Ptr left, right;
+		std::vector<Slot> newSlots;			// the slots of the front fragments created by splitting polygons at this node
+		bool solid;							// is this a solid leaf?
+		std::vector<PolyIndex> polyIndices;	// the polygons which ended up in this leaf
+
+		BuildNode() : solid(false) {}
+	};
+
 	//#################### PRIVATE VARIABLES ####################
 private:
 	// Input data
-	double m_weight;
+	SplitSelector<Poly> m_splitSelector;
+	int m_threadCount;
 
 	// Intermediate data
 	PolyVector m_polygons;
 	std::vector<PolyIndex> m_polyIndices;
+	int m_spareThreads;			// the number of additional threads that can still be started
+	boost::mutex m_threadMutex;
 
 	// Output data
 	BSPTree_Ptr m_tree;
 
 	//#################### CONSTRUCTORS ####################
 public:
-	BSPCompiler(const PolyVector& polygons, const PolyVector& hintPolygons, double weight);
+	BSPCompiler(const PolyVector& polygons, const PolyVector& hintPolygons, double weight, int threadCount = 1, SplitQuality quality = SQ_EXACT);
 
 	//#################### PUBLIC METHODS ####################
 public:
@@ -68,8 +105,15 @@ public:
 
 	//#################### PRIVATE METHODS ####################
 private:
-	BSPNode_Ptr build_subtree(const std::vector<PolyIndex>& polyIndices, std::vector<BSPNode_Ptr>& nodes, SolidityDescriptor solidityDescriptor);
+	void assign_slots(const BuildNode_Ptr& node, int& nextSlot) const;
+	void build_children(const BuildNode_Ptr& node, const std::vector<PolyIndex>& frontPolys, SolidityDescriptor frontDescriptor,
+						const std::vector<PolyIndex>& backPolys, SolidityDescriptor backDescriptor);
+	BuildNode_Ptr build_subtree(const std::vector<PolyIndex>& polyIndices, SolidityDescriptor solidityDescriptor);
+	void build_subtree_task(const std::vector<PolyIndex>& polyIndices, SolidityDescriptor solidityDescriptor, BuildNode_Ptr& result, std::string& error);
 	PolyIndex_CPtr choose_split_poly(const std::vector<PolyIndex>& polyIndices) const;
+	BSPNode_Ptr make_nodes(const BuildNode_Ptr& node, std::vector<BSPNode_Ptr>& nodes);
+	void release_thread();
+	bool reserve_thread();
 };
 
 }
@@ -3,12 +3,28 @@
  * Copyright Stuart Golodetz, 2009. All rights reserved.
  ***/
 
+#include <exception>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <source/exceptions/Exception.h>
+
 namespace hesp {
 
 //#################### CONSTRUCTORS ####################
+/**
+Constructs a BSP compiler.
+
+@param polygons		The polygons from which to build the tree
+@param hintPolygons	Any hint polygons (their planes are used as split planes, but they don't end up in the leaves)
+@param weight		The relative importance of avoiding splits (as opposed to balancing the tree) when choosing split planes
+@param threadCount	The maximum number of threads to use when building the tree
+@param quality		The trade-off between tree quality and build speed to use when choosing split planes
+*/
 template <typename Poly>
-BSPCompiler<Poly>::BSPCompiler(const PolyVector& polygons, const PolyVector& hintPolygons, double weight)
-:	m_polygons(polygons), m_weight(weight)
+BSPCompiler<Poly>::BSPCompiler(const PolyVector& polygons, const PolyVector& hintPolygons, double weight, int threadCount, SplitQuality quality)
+:	m_splitSelector(weight, quality), m_threadCount(std::max(threadCount, 1)), m_polygons(polygons), m_spareThreads(0)
 {
 	std::copy(hintPolygons.begin(), hintPolygons.end(), std::back_inserter(m_polygons));
 
@@ -17,16 +33,27 @@ BSPCompiler<Poly>::BSPCompiler(const PolyVector& polygons, const PolyVector& hin
 	m_polyIndices.reserve(totalPolyCount);
 	for(int i=0; i<totalPolyCount; ++i)
 	{
-		m_polyIndices.push_back(PolyIndex(i, true, i >= normalPolyCount));
+		m_polyIndices.push_back(PolyIndex(m_polygons[i], Slot(new int(i)), true, i >= normalPolyCount));
 	}
 }
 
 //#################### PUBLIC METHODS ####################
+/**
+Builds the tree. The result is independent of the number of threads used.
+*/
 template <typename Poly>
 void BSPCompiler<Poly>::build_tree()
 {
+	m_spareThreads = m_threadCount - 1;
+	BuildNode_Ptr root = build_subtree(m_polyIndices, SD_UNKNOWN);
+
+	// Number the polygon fragments created by splitting in the order in which a depth-first build would have created them.
+	int nextSlot = static_cast<int>(m_polyIndices.size());
+	assign_slots(root, nextSlot);
+	m_polygons.resize(nextSlot);
+
 	std::vector<BSPNode_Ptr> nodes;
-	build_subtree(m_polyIndices, nodes, SD_UNKNOWN);
+	make_nodes(root, nodes);
 	m_tree.reset(new BSPTree(nodes));
 }
 
@@ -43,8 +70,68 @@ BSPTree_Ptr BSPCompiler<Poly>::tree() const
 }
 
 //#################### PRIVATE METHODS ####################
+/**
+Assigns indices in the output polygon array to the polygon fragments created when building
+the specified subtree. Fragments are numbered in preorder, which is the order in which they
+are created when the tree is built depth-first.
+
+@param node		The root of the subtree
+@param nextSlot	The next unused index in the output polygon array
+*/
 template <typename Poly>
-BSPNode_Ptr BSPCompiler<Poly>::build_subtree(const std::vector<PolyIndex>& polyIndices, std::vector<BSPNode_Ptr>& nodes, SolidityDescriptor solidityDescriptor)
+void BSPCompiler<Poly>::assign_slots(const BuildNode_Ptr& node, int& nextSlot) const
+{
+	for(typename std::vector<Slot>::const_iterator it=node->newSlots.begin(), iend=node->newSlots.end(); it!=iend; ++it)
+	{
+		**it = nextSlot++;
+	}
+
+	if(node->splitter)
+	{
+		assign_slots(node->left, nextSlot);
+		assign_slots(node->right, nextSlot);
+	}
+}
+
+/**
+Builds the two subtrees of a branch node. If the subtrees are large enough and a thread is
+available, the front subtree is built on a separate thread while the back one is built on
+this one. This is safe because the two subtrees share no data: each polygon fragment ends
+up on exactly one side of the split plane.
+
+@param node				The branch node
+@param frontPolys		The polygons in front of the node's split plane
+@param frontDescriptor	The solidity descriptor for the front subtree
+@param backPolys		The polygons behind the node's split plane
+@param backDescriptor	The solidity descriptor for the back subtree
+*/
+template <typename Poly>
+void BSPCompiler<Poly>::build_children(const BuildNode_Ptr& node, const std::vector<PolyIndex>& frontPolys, SolidityDescriptor frontDescriptor,
+									   const std::vector<PolyIndex>& backPolys, SolidityDescriptor backDescriptor)
+{
+	if(frontPolys.size() + backPolys.size() < PARALLEL_THRESHOLD || !reserve_thread())
+	{
+		node->left = build_subtree(frontPolys, frontDescriptor);
+		node->right = build_subtree(backPolys, backDescriptor);
+		return;
+	}
+
+	std::string frontError;
+	boost::thread frontThread(boost::bind(&BSPCompiler::build_subtree_task, this, boost::cref(frontPolys), frontDescriptor, boost::ref(node->left), boost::ref(frontError)));
+
+	std::string backError;
+	build_subtree_task(backPolys, backDescriptor, node->right, backError);
+
+	frontThread.join();
+	release_thread();
+
+	if(frontError != "") throw Exception(frontError);
+	if(backError != "") throw Exception(backError);
+}
+
+template <typename Poly>
+typename BSPCompiler<Poly>::BuildNode_Ptr
+BSPCompiler<Poly>::build_subtree(const std::vector<PolyIndex>& polyIndices, SolidityDescriptor solidityDescriptor)
 {
 	typedef typename Poly::Vert Vert;
 	typedef typename Poly::AuxData AuxData;
@@ -54,43 +141,27 @@ BSPNode_Ptr BSPCompiler<Poly>::build_subtree(const std::vector<PolyIndex>& polyI
 	// Don't allow hint polygons to split solid leaves.
 	if(solidityDescriptor == SD_SOLID && splitPoly && splitPoly->hint) splitPoly.reset();
 
+	BuildNode_Ptr node(new BuildNode);
+
 	// If there were no suitable split candidates, we must have ended up in a leaf.
 	if(!splitPoly)
 	{
-		switch(solidityDescriptor)
-		{
-			case SD_UNKNOWN:
-			{
-				// This should never happen.
-				throw Exception("Unknown solidity descriptor for leaf");
-			}
-			case SD_EMPTY:
-			{
-				std::vector<int> indicesOnly;
-				for(size_t i=0, size=polyIndices.size(); i<size; ++i)
-				{
-					if(!polyIndices[i].hint) indicesOnly.push_back(polyIndices[i].index);
-				}
-				nodes.push_back(BSPLeaf::make_empty_leaf((int)nodes.size(), indicesOnly));
-				break;
-			}
-			case SD_SOLID:
-			{
-				nodes.push_back(BSPLeaf::make_solid_leaf((int)nodes.size()));
-				break;
-			}
-		}
-		return nodes.back();
+		// This should never happen.
+		if(solidityDescriptor == SD_UNKNOWN) throw Exception("Unknown solidity descriptor for leaf");
+
+		node->solid = solidityDescriptor == SD_SOLID;
+		node->polyIndices = polyIndices;
+		return node;
 	}
 
-	Plane_Ptr splitter(new Plane(make_plane(*m_polygons[splitPoly->index])));
+	Plane_Ptr splitter(new Plane(make_plane(*splitPoly->poly)));
+	node->splitter = splitter;
 
 	std::vector<PolyIndex> backPolys, frontPolys;
 
-	for(std::vector<PolyIndex>::const_iterator it=polyIndices.begin(), iend=polyIndices.end(); it!=iend; ++it)
+	for(typename std::vector<PolyIndex>::const_iterator it=polyIndices.begin(), iend=polyIndices.end(); it!=iend; ++it)
 	{
-		int curIndex = it->index;
-		const Polygon<Vert,AuxData>& curPoly = *m_polygons[curIndex];
+		const Polygon<Vert,AuxData>& curPoly = *it->poly;
 		switch(classify_polygon_against_plane(curPoly, *splitter))
 		{
 			case CP_BACK:
@@ -100,8 +171,8 @@ BSPNode_Ptr BSPCompiler<Poly>::build_subtree(const std::vector<PolyIndex>& polyI
 			}
 			case CP_COPLANAR:
 			{
-				if(splitter->normal().dot(curPoly.normal()) > 0) frontPolys.push_back(PolyIndex(curIndex,false,it->hint));
-				else backPolys.push_back(PolyIndex(curIndex,false,it->hint));
+				if(splitter->normal().dot(curPoly.normal()) > 0) frontPolys.push_back(PolyIndex(it->poly,it->slot,false,it->hint));
+				else backPolys.push_back(PolyIndex(it->poly,it->slot,false,it->hint));
 				break;
 			}
 			case CP_FRONT:
@@ -111,79 +182,112 @@ BSPNode_Ptr BSPCompiler<Poly>::build_subtree(const std::vector<PolyIndex>& polyI
 			}
 			case CP_STRADDLE:
 			{
+				// The back fragment takes over the slot of the polygon being split, and the front fragment gets a new one.
 				SplitResults<Vert,AuxData> sr = split_polygon(curPoly, *splitter);
-				m_polygons[curIndex] = sr.back;
-				int k = static_cast<int>(m_polygons.size());
-				m_polygons.push_back(sr.front);
-				backPolys.push_back(PolyIndex(curIndex,it->splitCandidate,it->hint));
-				frontPolys.push_back(PolyIndex(k,it->splitCandidate,it->hint));
+				Slot frontSlot(new int(-1));
+				node->newSlots.push_back(frontSlot);
+				backPolys.push_back(PolyIndex(sr.back,it->slot,it->splitCandidate,it->hint));
+				frontPolys.push_back(PolyIndex(sr.front,frontSlot,it->splitCandidate,it->hint));
 				break;
 			}
 		}
 	}
 
-	BSPNode_Ptr left, right;
-	if(splitPoly->hint)
-	{
-		left = build_subtree(frontPolys, nodes, solidityDescriptor);
-		right = build_subtree(backPolys, nodes, solidityDescriptor);
-	}
-	else
-	{
-		left = build_subtree(frontPolys, nodes, SD_EMPTY);
-		right = build_subtree(backPolys, nodes, SD_SOLID);
-	}
+	if(splitPoly->hint) build_children(node, frontPolys, solidityDescriptor, backPolys, solidityDescriptor);
+	else build_children(node, frontPolys, SD_EMPTY, backPolys, SD_SOLID);
 
-	BSPNode_Ptr subtreeRoot(new BSPBranch((int)nodes.size(), splitter, left, right));
-	nodes.push_back(subtreeRoot);
-	return subtreeRoot;
+	return node;
 }
 
+/**
+Builds a subtree, catching any exception so that this can safely be run on a separate thread.
+(Exceptions other than hesp::Exception are caught as well, since an exception escaping from
+the thread would terminate the program rather than reaching the caller.)
+
+@param polyIndices			The polygons in the subtree
+@param solidityDescriptor	The solidity descriptor for the subtree
+@param result				Used to return the root of the subtree
+@param error				Used to return the cause of any exception thrown
+*/
+template <typename Poly>
+void BSPCompiler<Poly>::build_subtree_task(const std::vector<PolyIndex>& polyIndices, SolidityDescriptor solidityDescriptor, BuildNode_Ptr& result, std::string& error)
+try
+{
+	result = build_subtree(polyIndices, solidityDescriptor);
+}
+catch(Exception& e)			{ error = e.cause(); }
+catch(std::exception& e)	{ error = e.what(); }
+catch(...)					{ error = "An unknown error occurred whilst building a subtree"; }
+
 template <typename Poly>
 typename BSPCompiler<Poly>::PolyIndex_CPtr BSPCompiler<Poly>::choose_split_poly(const std::vector<PolyIndex>& polyIndices) const
 {
-	PolyIndex_CPtr bestPolyIndex;
-	double bestMetric = INT_MAX;
+	typedef typename SplitSelector<Poly>::Candidate Candidate;
 
-	int indexCount = static_cast<int>(polyIndices.size());
-	for(int i=0; i<indexCount; ++i)
+	std::vector<Candidate> candidates;
+	candidates.reserve(polyIndices.size());
+	for(typename std::vector<PolyIndex>::const_iterator it=polyIndices.begin(), iend=polyIndices.end(); it!=iend; ++it)
 	{
-		if(!polyIndices[i].splitCandidate) continue;
+		candidates.push_back(Candidate(it->poly.get(), it->splitCandidate, it->hint));
+	}
 
-		Plane plane = make_plane(*m_polygons[polyIndices[i].index]);
-		int balance = 0, splits = 0;
-		int hintPenalty = polyIndices[i].hint ? 100000 : 0;		// make sure hint planes are chosen last
+	int index = m_splitSelector.choose_split_index(candidates);
+	if(index != -1) return PolyIndex_CPtr(new PolyIndex(polyIndices[index]));
+	else return PolyIndex_CPtr();
+}
 
-		for(int j=0; j<indexCount; ++j)
-		{
-			if(j == i) continue;
-			if(polyIndices[j].hint) continue;	// hint polygons shouldn't affect balance or splitting
+/**
+Makes the output nodes for the specified subtree (in postorder), and stores the polygons
+which ended up in its leaves in the output polygon array.
 
-			switch(classify_polygon_against_plane(*m_polygons[polyIndices[j].index], plane))
-			{
-				case CP_BACK:
-					--balance;
-					break;
-				case CP_COPLANAR:
-					break;
-				case CP_FRONT:
-					++balance;
-					break;
-				case CP_STRADDLE:
-					++splits;
-					break;
-			}
-		}
-
-		double metric = abs(balance) + m_weight * splits + hintPenalty;
-		if(metric < bestMetric)
+@param node		The root of the subtree
+@param nodes	The output node array
+@return			The output node for the root of the subtree
+*/
+template <typename Poly>
+BSPNode_Ptr BSPCompiler<Poly>::make_nodes(const BuildNode_Ptr& node, std::vector<BSPNode_Ptr>& nodes)
+{
+	if(!node->splitter)
+	{
+		std::vector<int> indicesOnly;
+		for(size_t i=0, size=node->polyIndices.size(); i<size; ++i)
 		{
-			bestPolyIndex.reset(new PolyIndex(polyIndices[i]));
-			bestMetric = metric;
+			const PolyIndex& polyIndex = node->polyIndices[i];
+			m_polygons[*polyIndex.slot] = polyIndex.poly;
+			if(!polyIndex.hint) indicesOnly.push_back(*polyIndex.slot);
 		}
+
+		if(node->solid) nodes.push_back(BSPLeaf::make_solid_leaf((int)nodes.size()));
+		else nodes.push_back(BSPLeaf::make_empty_leaf((int)nodes.size(), indicesOnly));
+		return nodes.back();
 	}
 
-	return bestPolyIndex;
+	BSPNode_Ptr left = make_nodes(node->left, nodes);
+	BSPNode_Ptr right = make_nodes(node->right, nodes);
+	BSPNode_Ptr subtreeRoot(new BSPBranch((int)nodes.size(), node->splitter, left, right));
+	nodes.push_back(subtreeRoot);
+	return subtreeRoot;
+}
+
+template <typename Poly>
+void BSPCompiler<Poly>::release_thread()
+{
+	boost::mutex::scoped_lock lock(m_threadMutex);
+	++m_spareThreads;
+}
+
+/**
+Attempts to reserve one of the spare threads for building a subtree.
+
+@return	true, if a thread was reserved, or false otherwise
+*/
+template <typename Poly>
+bool BSPCompiler<Poly>::reserve_thread()
+{
+	boost::mutex::scoped_lock lock(m_threadMutex);
+	if(m_spareThreads == 0) return false;
+	--m_spareThreads;
+	return true;
 }
 
 }
@@ -14,6 +14,7 @@ using boost::bad_lexical_cast;
 using boost::lexical_cast;
 
 #include <source/exceptions/Exception.h>
+#include <source/io/util/BinaryIO.h>
 #include <source/math/geom/GeomUtil.h>
 
 namespace hesp {
@@ -23,6 +24,9 @@ BSPTree::BSPTree(const std::vector<BSPNode_Ptr>& nodes)
 :	m_nodes(nodes)
 {
 	index_leaves();
+
+	m_flatBranches.reserve(m_nodes.size() / 2);
+	m_flatRoot = flatten(root());
 }
 
 //#################### PUBLIC METHODS ####################
@@ -36,6 +40,27 @@ int BSPTree::empty_leaf_count() const
 	return m_emptyLeafCount;
 }
 
+/**
+Returns the branches of the tree in the compact form used by the tree queries (see FlatBranch).
+
+@return	As stated
+*/
+const std::vector<FlatBranch>& BSPTree::flat_branches() const
+{
+	return m_flatBranches;
+}
+
+/**
+Returns the root of the tree in the compact form used by the tree queries: this is the
+index of a flat branch, or the complement of a leaf index if the tree is a single leaf.
+
+@return	As stated
+*/
+int BSPTree::flat_root() const
+{
+	return m_flatRoot;
+}
+
 /**
 Returns the leaf with leaf index n.
 
@@ -60,6 +85,66 @@ const BSPLeaf *BSPTree::leaf(int n) const
 	else throw Exception("Leaf index out of range");
 }
 
+/**
+Loads a BSP tree from a binary level file section (see output_binary for the format).
+
+@param reader		A reader for the section
+@return				The BSP tree
+@throws Exception	If the section is malformed
+*/
+BSPTree_Ptr BSPTree::load_binary(BinaryReader& reader)
+{
+	int nodeCount = reader.read<int>();
+	if(nodeCount <= 0) throw Exception("Bad node count in binary BSP tree");
+
+	const int *kinds = reader.read_array<int>(nodeCount);
+	const int *children = reader.read_array<int>(2 * nodeCount);
+	const double *planes = reader.read_array<double>(4 * nodeCount);
+	const int *polyStarts = reader.read_array<int>(nodeCount + 1);
+	const int *polyIndices = reader.read_array<int>(polyStarts[nodeCount]);
+
+	std::vector<BSPNode_Ptr> nodes(nodeCount);
+	for(int n=0; n<nodeCount; ++n)
+	{
+		switch(kinds[n])
+		{
+			case 'B':
+			{
+				int leftIndex = children[2*n], rightIndex = children[2*n+1];
+				if(leftIndex < 0 || leftIndex >= n || rightIndex < 0 || rightIndex >= n)
+				{
+					throw Exception("The BSP nodes are not stored in postorder: the child nodes for this branch have not yet been loaded");
+				}
+
+				const double *p = &planes[4*n];
+				Plane_Ptr splitter(new Plane(Vector3d(p[0],p[1],p[2]), p[3]));
+				nodes[n] = BSPNode_Ptr(new BSPBranch(n, splitter, nodes[leftIndex], nodes[rightIndex]));
+				break;
+			}
+			case 'E':
+			{
+				if(polyStarts[n] < 0 || polyStarts[n] > polyStarts[n+1] || polyStarts[n+1] > polyStarts[nodeCount])
+				{
+					throw Exception("Bad polygon range in empty leaf node: " + lexical_cast<std::string,int>(n));
+				}
+				nodes[n] = BSPLeaf::make_empty_leaf(n, std::vector<int>(polyIndices + polyStarts[n], polyIndices + polyStarts[n+1]));
+				break;
+			}
+			case 'S':
+			{
+				nodes[n] = BSPLeaf::make_solid_leaf(n);
+				break;
+			}
+			default:
+			{
+				throw Exception("Bad BSP node: " + lexical_cast<std::string,int>(n));
+			}
+		}
+	}
+
+	return BSPTree_Ptr(new BSPTree(nodes));
+}
+
 BSPTree_Ptr BSPTree::load_postorder_text(std::istream& is)
 {
 	std::string line;
@@ -141,6 +226,56 @@ BSPTree_Ptr BSPTree::load_postorder_text(std::istream& is)
 	return BSPTree_Ptr(new BSPTree(nodes));
 }
 
+/**
+Outputs the tree to a binary level file section. The nodes are stored in index
+order (which is postorder) as a set of flat arrays: a node kind ('B', 'E' or 'S'),
+the child indices and splitting plane of each branch, and the polygon indices of
+each empty leaf (as a range of a shared index array).
+
+@param writer	The writer for the section
+*/
+void BSPTree::output_binary(BinaryWriter& writer) const
+{
+	int nodeCount = static_cast<int>(m_nodes.size());
+	std::vector<int> kinds(nodeCount), children(2 * nodeCount, -1), polyStarts(1, 0), polyIndices;
+	std::vector<double> planes(4 * nodeCount, 0.0);
+
+	for(int n=0; n<nodeCount; ++n)
+	{
+		if(m_nodes[n]->is_leaf())
+		{
+			const BSPLeaf *leaf = m_nodes[n]->as_leaf();
+			kinds[n] = leaf->is_solid() ? 'S' : 'E';
+			if(!leaf->is_solid())
+			{
+				const std::vector<int>& leafPolyIndices = leaf->polygon_indices();
+				polyIndices.insert(polyIndices.end(), leafPolyIndices.begin(), leafPolyIndices.end());
+			}
+		}
+		else
+		{
+			const BSPBranch *branch = m_nodes[n]->as_branch();
+			kinds[n] = 'B';
+			children[2*n] = branch->left()->index();
+			children[2*n+1] = branch->right()->index();
+
+			const Vector3d& normal = branch->splitter()->normal();
+			planes[4*n] = normal.x;
+			planes[4*n+1] = normal.y;
+			planes[4*n+2] = normal.z;
+			planes[4*n+3] = branch->splitter()->distance_value();
+		}
+		polyStarts.push_back(static_cast<int>(polyIndices.size()));
+	}
+
+	writer.write(nodeCount);
+	writer.write_array(kinds);
+	writer.write_array(children);
+	writer.write_array(planes);
+	writer.write_array(polyStarts);
+	writer.write_array(polyIndices);
+}
+
 void BSPTree::output_postorder_text(std::ostream& os) const
 {
 	os << m_nodes.size() << '\n';
@@ -151,6 +286,28 @@ BSPNode_Ptr BSPTree::root()			{ return m_nodes.back(); }
 BSPNode_CPtr BSPTree::root() const	{ return m_nodes.back(); }
 
 //#################### PRIVATE METHODS ####################
+/**
+Makes the compact representation of the specified subtree used by the tree queries.
+The branches are numbered in preorder, so that each branch is followed by its front child.
+
+@param node	The root of the subtree
+@return		The index of the flat branch for node, or the complement of its leaf index if it's a leaf
+*/
+int BSPTree::flatten(const BSPNode_Ptr& node)
+{
+	if(node->is_leaf()) return FlatBranch::make_leaf(node->as_leaf()->leaf_index());
+
+	BSPBranch *branch = node->as_branch();
+	int index = static_cast<int>(m_flatBranches.size());
+	m_flatBranches.push_back(FlatBranch(*branch->splitter()));
+
+	int left = flatten(branch->left());
+	int right = flatten(branch->right());
+	m_flatBranches[index].children[0] = left;
+	m_flatBranches[index].children[1] = right;
+	return index;
+}
+
 void BSPTree::index_leaves()
 {
 	index_specific_leaves(root(), false);
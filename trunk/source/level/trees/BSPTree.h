@@ -8,9 +8,14 @@
 
 #include "BSPBranch.h"
 #include "BSPLeaf.h"
+#include "FlatBranch.h"
 
 namespace hesp {
 
+//#################### FORWARD DECLARATIONS ####################
+class BinaryReader;
+class BinaryWriter;
+
 //#################### TYPEDEFS ####################
 typedef shared_ptr<class BSPTree> BSPTree_Ptr;
 typedef shared_ptr<const class BSPTree> BSPTree_CPtr;
@@ -28,6 +33,8 @@ private:
 	std::vector<BSPNode_Ptr> m_nodes;
 	std::vector<BSPLeaf*> m_leaves;
 	int m_emptyLeafCount;
+	std::vector<FlatBranch> m_flatBranches;		// the branches in the compact form used by the tree queries
+	int m_flatRoot;
 
 	//#################### CONSTRUCTORS ####################
 public:
@@ -36,15 +43,20 @@ public:
 	//#################### PUBLIC METHODS ####################
 public:
 	int empty_leaf_count() const;
+	const std::vector<FlatBranch>& flat_branches() const;
+	int flat_root() const;
 	BSPLeaf *leaf(int n);
 	const BSPLeaf *leaf(int n) const;
+	static BSPTree_Ptr load_binary(BinaryReader& reader);
 	static BSPTree_Ptr load_postorder_text(std::istream& is);
+	void output_binary(BinaryWriter& writer) const;
 	void output_postorder_text(std::ostream& os) const;
 	BSPNode_Ptr root();
 	BSPNode_CPtr root() const;
 
 	//#################### PRIVATE METHODS ####################
 private:
+	int flatten(const BSPNode_Ptr& node);
 	void index_leaves();
 	void index_specific_leaves(const BSPNode_Ptr& node, bool solidFlag);
 };
@@ -5,6 +5,17 @@
 
 #include "BSPUtil.h"
 
+#include <algorithm>
+#include <cmath>
+
+// SSE2 is used to test packets of points against the split planes where it's available.
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+	#define HESP_BSPUTIL_SSE2
+	#include <emmintrin.h>
+#endif
+
+#include <source/math/Constants.h>
+
 namespace hesp {
 
 //#################### PUBLIC METHODS ####################
@@ -18,44 +29,184 @@ Determines whether or not there is line-of-sight between p1 and p2 in the specif
 */
 bool BSPUtil::line_of_sight(const Vector3d& p1, const Vector3d& p2, const BSPTree_CPtr& tree)
 {
-	return line_of_sight_sub(p1, p2, tree->root());
+	return line_of_sight_sub(p1, p2, *tree, tree->flat_root());
+}
+
+/**
+Determines whether or not there is line-of-sight between a source point and each of a set of target points
+in the specified BSP tree. The rays are traced together in packets, so that each split plane is only fetched
+once per packet and can be tested against several points at a time. The results are exactly the same as
+those of calling line_of_sight for each target in turn.
+
+@param source	The source point (e.g. a light)
+@param targets	The target points (e.g. a row of lightmap grid points)
+@param tree		The BSP tree
+@return			An array whose i'th element is true iff there is line-of-sight between source and targets[i]
+*/
+std::vector<bool> BSPUtil::line_of_sight_packet(const Vector3d& source, const std::vector<Vector3d>& targets, const BSPTree_CPtr& tree)
+{
+	int targetCount = static_cast<int>(targets.size());
+	std::vector<bool> results(targetCount);
+
+	for(int begin=0; begin<targetCount; begin+=MAX_PACKET_SIZE)
+	{
+		int end = std::min(begin + (int)MAX_PACKET_SIZE, targetCount);
+
+		RayPacket packet;
+		bool visible[MAX_PACKET_SIZE];
+		for(int i=begin; i<end; ++i)
+		{
+			packet.add(i - begin, source, targets[i]);
+			visible[i - begin] = true;
+		}
+
+		line_of_sight_packet_sub(packet, *tree, tree->flat_root(), visible);
+
+		for(int i=begin; i<end; ++i) results[i] = visible[i - begin];
+	}
+
+	return results;
 }
 
 //#################### PRIVATE METHODS ####################
-bool BSPUtil::line_of_sight_sub(const Vector3d& p1, const Vector3d& p2, const BSPNode_CPtr& node)
+/**
+Calculates n . p - d for each of the specified points p, where the plane is n . x - d = 0.
+The calculation is done in the same order as classify_point_against_plane, so the values
+(and hence the classifications) are identical.
+
+@param plane	The plane
+@param xs		The x coordinates of the points
+@param ys		The y coordinates of the points
+@param zs		The z coordinates of the points
+@param count	The number of points
+@param values	Used to return the calculated values
+*/
+void BSPUtil::evaluate_plane(const Plane& plane, const double *xs, const double *ys, const double *zs, int count, double *values)
+{
+	const Vector3d& n = plane.normal();
+	double d = plane.distance_value();
+
+	int i = 0;
+#ifdef HESP_BSPUTIL_SSE2
+	__m128d nx = _mm_set1_pd(n.x), ny = _mm_set1_pd(n.y), nz = _mm_set1_pd(n.z), dd = _mm_set1_pd(d);
+	for(; i+1<count; i+=2)
+	{
+		__m128d dot = _mm_add_pd(_mm_add_pd(_mm_mul_pd(nx, _mm_loadu_pd(xs+i)), _mm_mul_pd(ny, _mm_loadu_pd(ys+i))), _mm_mul_pd(nz, _mm_loadu_pd(zs+i)));
+		_mm_storeu_pd(values+i, _mm_sub_pd(dot, dd));
+	}
+#endif
+	for(; i<count; ++i)
+	{
+		values[i] = n.x*xs[i] + n.y*ys[i] + n.z*zs[i] - d;
+	}
+}
+
+/**
+Traces a packet of line segments through the specified subtree, marking any rays which hit a solid leaf
+as not visible. Each ray has at most one segment in the packet, since the intersection of a segment with
+the (convex) region of a node is itself a segment.
+
+@param packet	The packet
+@param tree		The BSP tree
+@param node		The root of the subtree (see FlatBranch)
+@param visible	The visibility flags for the rays
+*/
+void BSPUtil::line_of_sight_packet_sub(const RayPacket& packet, const BSPTree& tree, int node, bool *visible)
+{
+	if(FlatBranch::is_leaf(node))
+	{
+		if(FlatBranch::leaf_index(node) >= tree.empty_leaf_count())
+		{
+			for(int i=0; i<packet.count; ++i) visible[packet.rays[i]] = false;
+		}
+		return;
+	}
+
+	const FlatBranch& branch = tree.flat_branches()[node];
+
+	// Classify the start and end points of all the segments against the split plane (as in classify_linesegment_against_plane).
+	double values1[MAX_PACKET_SIZE], values2[MAX_PACKET_SIZE];
+	evaluate_plane(branch.splitter, packet.x1, packet.y1, packet.z1, packet.count, values1);
+	evaluate_plane(branch.splitter, packet.x2, packet.y2, packet.z2, packet.count, values2);
+
+	PlaneClassifier cp1[MAX_PACKET_SIZE], cp2[MAX_PACKET_SIZE];
+	Vector3d mids[MAX_PACKET_SIZE];
+	for(int i=0; i<packet.count; ++i)
+	{
+		cp1[i] = fabs(values1[i]) < EPSILON ? CP_COPLANAR : values1[i] > 0 ? CP_FRONT : CP_BACK;
+		cp2[i] = fabs(values2[i]) < EPSILON ? CP_COPLANAR : values2[i] > 0 ? CP_FRONT : CP_BACK;
+		if((cp1[i] == CP_BACK && cp2[i] == CP_FRONT) || (cp1[i] == CP_FRONT && cp2[i] == CP_BACK))
+		{
+			Vector3d p1(packet.x1[i], packet.y1[i], packet.z1[i]), p2(packet.x2[i], packet.y2[i], packet.z2[i]);
+			mids[i] = determine_linesegment_intersection_with_plane(p1, p2, branch.splitter).first;
+		}
+	}
+
+	// Trace the parts of the segments in front of (or on) the plane through the left subtree,
+	// and then trace the parts behind it through the right subtree.
+	for(int side=0; side<2; ++side)
+	{
+		RayPacket child;
+		for(int i=0; i<packet.count; ++i)
+		{
+			int ray = packet.rays[i];
+			if(!visible[ray]) continue;
+
+			Vector3d p1(packet.x1[i], packet.y1[i], packet.z1[i]), p2(packet.x2[i], packet.y2[i], packet.z2[i]);
+			bool back1 = cp1[i] == CP_BACK, back2 = cp2[i] == CP_BACK;
+			bool front1 = cp1[i] == CP_FRONT, front2 = cp2[i] == CP_FRONT;
+
+			if((back1 && front2) || (front1 && back2))
+			{
+				// The segment straddles the plane: the part starting at p1 goes on p1's side.
+				if(back1 == (side == 1)) child.add(ray, p1, mids[i]);
+				else child.add(ray, mids[i], p2);
+			}
+			else
+			{
+				int segmentSide = (back1 || back2) ? 1 : 0;
+				if(segmentSide == side) child.add(ray, p1, p2);
+			}
+		}
+
+		if(child.count > 0) line_of_sight_packet_sub(child, tree, branch.children[side], visible);
+	}
+}
+
+bool BSPUtil::line_of_sight_sub(const Vector3d& p1, const Vector3d& p2, const BSPTree& tree, int node)
 {
-	if(node->is_leaf())
+	if(FlatBranch::is_leaf(node))
 	{
 		// If both points are in the same leaf, there's line-of-sight provided the leaf's not solid.
-		const BSPLeaf *leaf = node->as_leaf();
-		return !leaf->is_solid();
+		// (The empty leaves are indexed before the solid ones, so there's no need to look at the leaf itself.)
+		return FlatBranch::leaf_index(node) < tree.empty_leaf_count();
 	}
 
-	const BSPBranch *branch = node->as_branch();
+	const FlatBranch& branch = tree.flat_branches()[node];
 	PlaneClassifier cp1, cp2;
-	switch(classify_linesegment_against_plane(p1, p2, *branch->splitter(), cp1, cp2))
+	switch(classify_linesegment_against_plane(p1, p2, branch.splitter, cp1, cp2))
 	{
 		case CP_BACK:
 		{
-			return line_of_sight_sub(p1, p2, branch->right());
+			return line_of_sight_sub(p1, p2, tree, branch.children[1]);
 		}
 		case CP_COPLANAR:
 		case CP_FRONT:
 		{
-			return line_of_sight_sub(p1, p2, branch->left());
+			return line_of_sight_sub(p1, p2, tree, branch.children[0]);
 		}
 		default:	// case CP_STRADDLE
 		{
-			Vector3d q = determine_linesegment_intersection_with_plane(p1, p2, *branch->splitter()).first;
+			Vector3d q = determine_linesegment_intersection_with_plane(p1, p2, branch.splitter).first;
 			if(cp1 == CP_BACK)
 			{
 				// cp2 == CP_FRONT
-				return line_of_sight_sub(p1, q, branch->right()) && line_of_sight_sub(q, p2, branch->left());
+				return line_of_sight_sub(p1, q, tree, branch.children[1]) && line_of_sight_sub(q, p2, tree, branch.children[0]);
 			}
 			else
 			{
 				// cp1 == CP_FRONT, cp2 == CP_BACK
-				return line_of_sight_sub(p1, q, branch->left()) && line_of_sight_sub(q, p2, branch->right());
+				return line_of_sight_sub(p1, q, tree, branch.children[0]) && line_of_sight_sub(q, p2, tree, branch.children[1]);
 			}
 		}
 	}
@@ -7,6 +7,7 @@
 #define H_HESP_BSPUTIL
 
 #include <list>
+#include <vector>
 
 #include <source/math/geom/Polygon.h>
 #include <source/math/vectors/Vector3.h>
@@ -16,15 +17,49 @@ namespace hesp {
 
 class BSPUtil
 {
+	//#################### CONSTANTS ####################
+public:
+	// The maximum number of rays traced together by line_of_sight_packet (longer arrays of targets are split into packets of this size).
+	enum
+	{
+		MAX_PACKET_SIZE = 16
+	};
+
+	//#################### NESTED CLASSES ####################
+private:
+	/**
+	A set of line segments (at most one per ray) being traced through the same subtree, in SoA form.
+	*/
+	struct RayPacket
+	{
+		int count;
+		int rays[MAX_PACKET_SIZE];		// the index within the packet of the ray to which each segment belongs
+		double x1[MAX_PACKET_SIZE], y1[MAX_PACKET_SIZE], z1[MAX_PACKET_SIZE];
+		double x2[MAX_PACKET_SIZE], y2[MAX_PACKET_SIZE], z2[MAX_PACKET_SIZE];
+
+		RayPacket() : count(0) {}
+
+		void add(int ray, const Vector3d& p1, const Vector3d& p2)
+		{
+			rays[count] = ray;
+			x1[count] = p1.x;	y1[count] = p1.y;	z1[count] = p1.z;
+			x2[count] = p2.x;	y2[count] = p2.y;	z2[count] = p2.z;
+			++count;
+		}
+	};
+
 	//#################### PUBLIC METHODS ####################
 public:
 	template <typename Vert, typename AuxData> static std::list<int> find_leaf_indices(const Polygon<Vert,AuxData>& poly, const BSPTree_CPtr& tree);
 	static bool line_of_sight(const Vector3d& p1, const Vector3d& p2, const BSPTree_CPtr& tree);
+	static std::vector<bool> line_of_sight_packet(const Vector3d& source, const std::vector<Vector3d>& targets, const BSPTree_CPtr& tree);
 
 	//#################### PRIVATE METHODS ####################
 private:
-	template <typename Vert, typename AuxData> static std::list<int> find_leaf_indices_sub(const Polygon<Vert,AuxData>& poly, const BSPNode_CPtr& node);
-	static bool line_of_sight_sub(const Vector3d& p1, const Vector3d& p2, const BSPNode_CPtr& node);
+	template <typename Vert, typename AuxData> static std::list<int> find_leaf_indices_sub(const Polygon<Vert,AuxData>& poly, const BSPTree& tree, int node);
+	static void evaluate_plane(const Plane& plane, const double *xs, const double *ys, const double *zs, int count, double *values);
+	static void line_of_sight_packet_sub(const RayPacket& packet, const BSPTree& tree, int node, bool *visible);
+	static bool line_of_sight_sub(const Vector3d& p1, const Vector3d& p2, const BSPTree& tree, int node);
 };
 
 }
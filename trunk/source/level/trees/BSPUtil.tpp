@@ -11,40 +11,39 @@ namespace hesp {
 template <typename Vert, typename AuxData>
 std::list<int> BSPUtil::find_leaf_indices(const Polygon<Vert,AuxData>& poly, const BSPTree_CPtr& tree)
 {
-	return find_leaf_indices_sub(poly, tree->root());
+	return find_leaf_indices_sub(poly, *tree, tree->flat_root());
 }
 
 //#################### PRIVATE METHODS ####################
 template <typename Vert, typename AuxData>
-std::list<int> BSPUtil::find_leaf_indices_sub(const Polygon<Vert,AuxData>& poly, const BSPNode_CPtr& node)
+std::list<int> BSPUtil::find_leaf_indices_sub(const Polygon<Vert,AuxData>& poly, const BSPTree& tree, int node)
 {
-	if(node->is_leaf())
+	if(FlatBranch::is_leaf(node))
 	{
-		const BSPLeaf *leaf = node->as_leaf();
 		std::list<int> leafIndices;
-		leafIndices.push_back(leaf->leaf_index());
+		leafIndices.push_back(FlatBranch::leaf_index(node));
 		return leafIndices;
 	}
 	else
 	{
-		const BSPBranch *branch = node->as_branch();
-		switch(classify_polygon_against_plane(poly, *branch->splitter()))
+		const FlatBranch& branch = tree.flat_branches()[node];
+		switch(classify_polygon_against_plane(poly, branch.splitter))
 		{
 			case CP_BACK:
 			{
-				return find_leaf_indices_sub(poly, branch->right());
+				return find_leaf_indices_sub(poly, tree, branch.children[1]);
 			}
 			case CP_COPLANAR:
 			case CP_FRONT:
 			{
-				return find_leaf_indices_sub(poly, branch->left());
+				return find_leaf_indices_sub(poly, tree, branch.children[0]);
 			}
 			default:	// case CP_STRADDLE
 			{
-				SplitResults<Vert,AuxData> sr = split_polygon(poly, *branch->splitter());
+				SplitResults<Vert,AuxData> sr = split_polygon(poly, branch.splitter);
 				std::list<int> leafIndices;
-				leafIndices.splice(leafIndices.end(), find_leaf_indices_sub(*sr.front, branch->left()));
-				leafIndices.splice(leafIndices.end(), find_leaf_indices_sub(*sr.back, branch->right()));
+				leafIndices.splice(leafIndices.end(), find_leaf_indices_sub(*sr.front, tree, branch.children[0]));
+				leafIndices.splice(leafIndices.end(), find_leaf_indices_sub(*sr.back, tree, branch.children[1]));
 				return leafIndices;
 			}
 		}
@@ -0,0 +1,43 @@
+/***
+ * hesperus: FlatBranch.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_FLATBRANCH
+#define H_HESP_FLATBRANCH
+
+#include <source/math/geom/Plane.h>
+
+namespace hesp {
+
+/**
+This struct represents a branch node of a BSP or onion tree in the compact form used by the tree
+queries (see TreeUtil, BSPUtil and OnionUtil). The branches of a tree are stored contiguously in
+preorder, with the split plane inline, so that a query never has to follow a shared_ptr. Each child
+is either the index of another branch or, if negative, the bitwise complement of a leaf index.
+
+The split plane is kept in double precision (making the node 40 bytes rather than 32), so that the
+queries classify points exactly as they would against the original tree.
+*/
+struct FlatBranch
+{
+	//#################### PUBLIC VARIABLES ####################
+	Plane splitter;
+	int children[2];	// children[0] is in front of the split plane, children[1] is behind it
+
+	//#################### CONSTRUCTORS ####################
+	explicit FlatBranch(const Plane& splitter_)
+	:	splitter(splitter_)
+	{
+		children[0] = children[1] = -1;
+	}
+
+	//#################### PUBLIC METHODS ####################
+	static bool is_leaf(int child)		{ return child < 0; }
+	static int leaf_index(int child)	{ return ~child; }
+	static int make_leaf(int leafIndex)	{ return ~leafIndex; }
+};
+
+}
+
+#endif
@@ -6,36 +6,65 @@
 #ifndef H_HESP_ONIONCOMPILER
 #define H_HESP_ONIONCOMPILER
 
+#include <string>
 #include <vector>
 
+#include <boost/thread/mutex.hpp>
+
 #include <source/math/geom/Plane.h>
 #include "OnionTree.h"
+#include "SplitSelector.h"
 
 namespace hesp {
 
 template <typename Poly>
 class OnionCompiler
 {
+	//#################### CONSTANTS ####################
+private:
+	// The minimum number of polygons a subtree must contain for it to be worth building its front half on another thread.
+	enum
+	{
+		PARALLEL_THRESHOLD = 1000
+	};
+
 	//#################### TYPEDEFS ####################
 private:
 	typedef shared_ptr<Poly> Poly_Ptr;
 	typedef std::vector<Poly_Ptr> PolyVector;
 	typedef shared_ptr<PolyVector> PolyVector_Ptr;
+	typedef shared_ptr<int> Slot;
 
 	//#################### NESTED CLASSES ####################
 private:
 	struct PolyIndex
 	{
-		int index;
+		Poly_Ptr poly;			// the referenced polygon (or the fragment of it that has reached this point)
+		Slot slot;				// the index of the referenced polygon in the output polygon array (assigned once the tree has been built)
 		bool splitCandidate;	// is the plane of the referenced polygon a split candidate?
 
-		PolyIndex(int index_, bool splitCandidate_)
-		:	index(index_), splitCandidate(splitCandidate_)
+		PolyIndex(const Poly_Ptr& poly_, const Slot& slot_, bool splitCandidate_)
+		:	poly(poly_), slot(slot_), splitCandidate(splitCandidate_)
 		{}
 	};
 
 	typedef shared_ptr<const PolyIndex> PolyIndex_CPtr;
 
+	struct BuildNode;
+	typedef shared_ptr<BuildNode> BuildNode_Ptr;
+
+	/**
+	A node of the tree as it is being built (see BSPCompiler for why the output indices are assigned afterwards).
+	*/
+	struct BuildNode
+	{
+		Plane_Ptr splitter;							// the split plane (NULL for a leaf)
+		BuildNode_Ptr left, right;
+		std::vector<Slot> newSlots;					// the slots of the front fragments created by splitting polygons at this node
+		boost::dynamic_bitset<> solidityDescriptor;	// the solidity descriptor for a leaf
+		std::vector<PolyIndex> polyIndices;			// the polygons which ended up in this leaf
+	};
+
 	struct NullAuxData {};
 
 	//#################### PRIVATE VARIABLES ####################
@@ -43,18 +72,21 @@ private:
 	// Input data
 	int m_mapCount;
 	std::vector<BSPTree_CPtr> m_mapTrees;
-	double m_weight;
+	SplitSelector<Poly> m_splitSelector;
+	int m_threadCount;
 
 	// Intermediate data
 	PolyVector_Ptr m_polygons;
 	std::vector<PolyIndex> m_polyIndices;
+	int m_spareThreads;			// the number of additional threads that can still be started
+	boost::mutex m_threadMutex;
 
 	// Output data
 	OnionTree_Ptr m_tree;
 
 	//#################### CONSTRUCTORS ####################
 public:
-	OnionCompiler(const std::vector<PolyVector>& maps, const std::vector<BSPTree_CPtr>& mapTrees, double weight);
+	OnionCompiler(const std::vector<PolyVector>& maps, const std::vector<BSPTree_CPtr>& mapTrees, double weight, int threadCount = 1, SplitQuality quality = SQ_EXACT);
 
 	//#################### PUBLIC METHODS ####################
 public:
@@ -64,10 +96,17 @@ public:
 
 	//#################### PRIVATE METHODS ####################
 private:
-	OnionNode_Ptr build_subtree(const std::vector<PolyIndex>& polyIndices, std::vector<OnionNode_Ptr>& nodes, std::vector<Plane_Ptr>& ancestorPlanes);
+	void assign_slots(const BuildNode_Ptr& node, int& nextSlot) const;
+	void build_children(const BuildNode_Ptr& node, const std::vector<PolyIndex>& frontPolys, const std::vector<PolyIndex>& backPolys,
+						std::vector<Plane_Ptr>& ancestorPlanes);
+	BuildNode_Ptr build_subtree(const std::vector<PolyIndex>& polyIndices, std::vector<Plane_Ptr>& ancestorPlanes);
+	void build_subtree_task(const std::vector<PolyIndex>& polyIndices, std::vector<Plane_Ptr>& ancestorPlanes, BuildNode_Ptr& result, std::string& error);
 	PolyIndex_CPtr choose_split_poly(const std::vector<PolyIndex>& polyIndices) const;
 	boost::dynamic_bitset<> determine_leaf_solidity(const std::vector<Plane_Ptr>& ancestorPlanes) const;
 	static Vector3d find_arbitrary_leaf_point(const std::vector<Plane_Ptr>& ancestorPlanes);
+	OnionNode_Ptr make_nodes(const BuildNode_Ptr& node, std::vector<OnionNode_Ptr>& nodes);
+	void release_thread();
+	bool reserve_thread();
 };
 
 }
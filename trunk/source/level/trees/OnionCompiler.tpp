@@ -3,6 +3,12 @@
  * Copyright Stuart Golodetz, 2009. All rights reserved.
  ***/
 
+#include <exception>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <source/exceptions/Exception.h>
 #include <source/math/geom/GeomUtil.h>
 #include "OnionBranch.h"
 #include "TreeUtil.h"
@@ -13,28 +19,40 @@ namespace hesp {
 template <typename Poly>
 OnionCompiler<Poly>::OnionCompiler(const std::vector<PolyVector>& maps,
 								   const std::vector<BSPTree_CPtr>& mapTrees,
-								   double weight)
-:	m_mapCount(static_cast<int>(maps.size())), m_mapTrees(mapTrees), m_weight(weight), m_polygons(new PolyVector)
+								   double weight, int threadCount, SplitQuality quality)
+:	m_mapCount(static_cast<int>(maps.size())), m_mapTrees(mapTrees), m_splitSelector(weight, quality), m_threadCount(std::max(threadCount, 1)),
+	m_polygons(new PolyVector), m_spareThreads(0)
 {
 	for(int i=0; i<m_mapCount; ++i)
 	{
-		for(PolyVector::const_iterator jt=maps[i].begin(), jend=maps[i].end(); jt!=jend; ++jt)
+		for(typename PolyVector::const_iterator jt=maps[i].begin(), jend=maps[i].end(); jt!=jend; ++jt)
 		{
 			const Poly_Ptr& poly = *jt;
 			int polyIndex = static_cast<int>(m_polygons->size());
 			m_polygons->push_back(poly);
-			m_polyIndices.push_back(PolyIndex(polyIndex, true));
+			m_polyIndices.push_back(PolyIndex(poly, Slot(new int(polyIndex)), true));
 		}
 	}
 }
 
 //#################### PUBLIC METHODS ####################
+/**
+Builds the tree. The result is independent of the number of threads used.
+*/
 template <typename Poly>
 void OnionCompiler<Poly>::build_tree()
 {
-	std::vector<OnionNode_Ptr> nodes;
+	m_spareThreads = m_threadCount - 1;
 	std::vector<Plane_Ptr> ancestorPlanes;
-	build_subtree(m_polyIndices, nodes, ancestorPlanes);
+	BuildNode_Ptr root = build_subtree(m_polyIndices, ancestorPlanes);
+
+	// Number the polygon fragments created by splitting in the order in which a depth-first build would have created them.
+	int nextSlot = static_cast<int>(m_polyIndices.size());
+	assign_slots(root, nextSlot);
+	m_polygons->resize(nextSlot);
+
+	std::vector<OnionNode_Ptr> nodes;
+	make_nodes(root, nodes);
 	m_tree.reset(new OnionTree(nodes, m_mapCount));
 }
 
@@ -51,34 +69,101 @@ const OnionTree_Ptr& OnionCompiler<Poly>::tree() const
 }
 
 //#################### PRIVATE METHODS ####################
+/**
+Assigns indices in the output polygon array to the polygon fragments created when building
+the specified subtree (in preorder, as for BSPCompiler).
+
+@param node		The root of the subtree
+@param nextSlot	The next unused index in the output polygon array
+*/
+template <typename Poly>
+void OnionCompiler<Poly>::assign_slots(const BuildNode_Ptr& node, int& nextSlot) const
+{
+	for(typename std::vector<Slot>::const_iterator it=node->newSlots.begin(), iend=node->newSlots.end(); it!=iend; ++it)
+	{
+		**it = nextSlot++;
+	}
+
+	if(node->splitter)
+	{
+		assign_slots(node->left, nextSlot);
+		assign_slots(node->right, nextSlot);
+	}
+}
+
+/**
+Builds the two subtrees of a branch node, building the front one on a separate thread if
+the subtrees are large enough and a thread is available. The front thread gets its own
+copy of the ancestor planes, since the back subtree modifies them as it goes.
+
+@param node				The branch node
+@param frontPolys		The polygons in front of the node's split plane
+@param backPolys		The polygons behind the node's split plane
+@param ancestorPlanes	The split planes of the node's ancestors
+*/
 template <typename Poly>
-OnionNode_Ptr OnionCompiler<Poly>::build_subtree(const std::vector<PolyIndex>& polyIndices,
-												 std::vector<OnionNode_Ptr>& nodes,
-												 std::vector<Plane_Ptr>& ancestorPlanes)
+void OnionCompiler<Poly>::build_children(const BuildNode_Ptr& node, const std::vector<PolyIndex>& frontPolys, const std::vector<PolyIndex>& backPolys,
+										 std::vector<Plane_Ptr>& ancestorPlanes)
+{
+	Plane_Ptr backPlane(new Plane(node->splitter->flip()));
+
+	if(frontPolys.size() + backPolys.size() < PARALLEL_THRESHOLD || !reserve_thread())
+	{
+		ancestorPlanes.push_back(node->splitter);
+		node->left = build_subtree(frontPolys, ancestorPlanes);
+		ancestorPlanes.pop_back();
+
+		ancestorPlanes.push_back(backPlane);
+		node->right = build_subtree(backPolys, ancestorPlanes);
+		ancestorPlanes.pop_back();
+		return;
+	}
+
+	std::vector<Plane_Ptr> frontAncestorPlanes = ancestorPlanes;
+	frontAncestorPlanes.push_back(node->splitter);
+
+	std::string frontError;
+	boost::thread frontThread(boost::bind(&OnionCompiler::build_subtree_task, this, boost::cref(frontPolys), boost::ref(frontAncestorPlanes), boost::ref(node->left), boost::ref(frontError)));
+
+	std::string backError;
+	ancestorPlanes.push_back(backPlane);
+	build_subtree_task(backPolys, ancestorPlanes, node->right, backError);
+	ancestorPlanes.pop_back();
+
+	frontThread.join();
+	release_thread();
+
+	if(frontError != "") throw Exception(frontError);
+	if(backError != "") throw Exception(backError);
+}
+
+template <typename Poly>
+typename OnionCompiler<Poly>::BuildNode_Ptr
+OnionCompiler<Poly>::build_subtree(const std::vector<PolyIndex>& polyIndices, std::vector<Plane_Ptr>& ancestorPlanes)
 {
 	typedef typename Poly::Vert Vert;
 	typedef typename Poly::AuxData AuxData;
 
 	PolyIndex_CPtr splitPoly = choose_split_poly(polyIndices);
 
+	BuildNode_Ptr node(new BuildNode);
+
 	// If there were no suitable split candidates, we must have ended up in a leaf.
 	if(!splitPoly)
 	{
-		boost::dynamic_bitset<> solidityDescriptor = determine_leaf_solidity(ancestorPlanes);
-		std::vector<int> indicesOnly;
-		for(size_t i=0, size=polyIndices.size(); i<size; ++i) indicesOnly.push_back(polyIndices[i].index);
-		nodes.push_back(OnionNode_Ptr(new OnionLeaf((int)nodes.size(), solidityDescriptor, indicesOnly)));
-		return nodes.back();
+		node->solidityDescriptor = determine_leaf_solidity(ancestorPlanes);
+		node->polyIndices = polyIndices;
+		return node;
 	}
 
-	Plane_Ptr splitter(new Plane(make_plane(*(*m_polygons)[splitPoly->index])));
+	Plane_Ptr splitter(new Plane(make_plane(*splitPoly->poly)));
+	node->splitter = splitter;
 
 	std::vector<PolyIndex> backPolys, frontPolys;
 
-	for(std::vector<PolyIndex>::const_iterator it=polyIndices.begin(), iend=polyIndices.end(); it!=iend; ++it)
+	for(typename std::vector<PolyIndex>::const_iterator it=polyIndices.begin(), iend=polyIndices.end(); it!=iend; ++it)
 	{
-		int curIndex = it->index;
-		const Poly& curPoly = *(*m_polygons)[curIndex];
+		const Poly& curPoly = *it->poly;
 		switch(classify_polygon_against_plane(curPoly, *splitter))
 		{
 			case CP_BACK:
@@ -88,8 +173,8 @@ OnionNode_Ptr OnionCompiler<Poly>::build_subtree(const std::vector<PolyIndex>& p
 			}
 			case CP_COPLANAR:
 			{
-				if(splitter->normal().dot(curPoly.normal()) > 0) frontPolys.push_back(PolyIndex(curIndex,false));
-				else backPolys.push_back(PolyIndex(curIndex,false));
+				if(splitter->normal().dot(curPoly.normal()) > 0) frontPolys.push_back(PolyIndex(it->poly,it->slot,false));
+				else backPolys.push_back(PolyIndex(it->poly,it->slot,false));
 				break;
 			}
 			case CP_FRONT:
@@ -99,79 +184,57 @@ OnionNode_Ptr OnionCompiler<Poly>::build_subtree(const std::vector<PolyIndex>& p
 			}
 			case CP_STRADDLE:
 			{
+				// The back fragment takes over the slot of the polygon being split, and the front fragment gets a new one.
 				SplitResults<Vert,AuxData> sr = split_polygon(curPoly, *splitter);
-
-				// Copy the back half over the polygon being split.
-				(*m_polygons)[curIndex] = sr.back;
-
-				// Append the front half to the end of the polygon array.
-				int k = static_cast<int>(m_polygons->size());
-				m_polygons->push_back(sr.front);
-
-				backPolys.push_back(PolyIndex(curIndex,it->splitCandidate));
-				frontPolys.push_back(PolyIndex(k,it->splitCandidate));
+				Slot frontSlot(new int(-1));
+				node->newSlots.push_back(frontSlot);
+				backPolys.push_back(PolyIndex(sr.back,it->slot,it->splitCandidate));
+				frontPolys.push_back(PolyIndex(sr.front,frontSlot,it->splitCandidate));
 				break;
 			}
 		}
 	}
 
-	ancestorPlanes.push_back(splitter);
-	OnionNode_Ptr left = build_subtree(frontPolys, nodes, ancestorPlanes);
-	ancestorPlanes.pop_back();
+	build_children(node, frontPolys, backPolys, ancestorPlanes);
+	return node;
+}
 
-	ancestorPlanes.push_back(Plane_Ptr(new Plane(splitter->flip())));
-	OnionNode_Ptr right = build_subtree(backPolys, nodes, ancestorPlanes);
-	ancestorPlanes.pop_back();
+/**
+Builds a subtree, catching any exception so that this can safely be run on a separate thread.
+(Exceptions other than hesp::Exception are caught as well, since an exception escaping from
+the thread would terminate the program rather than reaching the caller.)
 
-	OnionNode_Ptr subtreeRoot(new OnionBranch((int)nodes.size(), splitter, left, right));
-	nodes.push_back(subtreeRoot);
-	return subtreeRoot;
+@param polyIndices		The polygons in the subtree
+@param ancestorPlanes	The split planes of the subtree's ancestors
+@param result			Used to return the root of the subtree
+@param error			Used to return the cause of any exception thrown
+*/
+template <typename Poly>
+void OnionCompiler<Poly>::build_subtree_task(const std::vector<PolyIndex>& polyIndices, std::vector<Plane_Ptr>& ancestorPlanes, BuildNode_Ptr& result, std::string& error)
+try
+{
+	result = build_subtree(polyIndices, ancestorPlanes);
 }
+catch(Exception& e)			{ error = e.cause(); }
+catch(std::exception& e)	{ error = e.what(); }
+catch(...)					{ error = "An unknown error occurred whilst building a subtree"; }
 
 template <typename Poly>
 typename OnionCompiler<Poly>::PolyIndex_CPtr
 OnionCompiler<Poly>::choose_split_poly(const std::vector<PolyIndex>& polyIndices) const
 {
-	PolyIndex_CPtr bestPolyIndex;
-	double bestMetric = INT_MAX;
+	typedef typename SplitSelector<Poly>::Candidate Candidate;
 
-	int indexCount = static_cast<int>(polyIndices.size());
-	for(int i=0; i<indexCount; ++i)
+	std::vector<Candidate> candidates;
+	candidates.reserve(polyIndices.size());
+	for(typename std::vector<PolyIndex>::const_iterator it=polyIndices.begin(), iend=polyIndices.end(); it!=iend; ++it)
 	{
-		if(!polyIndices[i].splitCandidate) continue;
-
-		Plane plane = make_plane(*(*m_polygons)[polyIndices[i].index]);
-
-		int balance = 0, splits = 0;
-		for(int j=0; j<indexCount; ++j)
-		{
-			if(j == i) continue;
-
-			switch(classify_polygon_against_plane(*(*m_polygons)[polyIndices[j].index], plane))
-			{
-				case CP_BACK:
-					--balance;
-					break;
-				case CP_COPLANAR:
-					break;
-				case CP_FRONT:
-					++balance;
-					break;
-				case CP_STRADDLE:
-					++splits;
-					break;
-			}
-		}
-
-		double metric = abs(balance) + m_weight * splits;
-		if(metric < bestMetric)
-		{
-			bestPolyIndex.reset(new PolyIndex(polyIndices[i]));
-			bestMetric = metric;
-		}
+		candidates.push_back(Candidate(it->poly.get(), it->splitCandidate, false));
 	}
 
-	return bestPolyIndex;
+	int index = m_splitSelector.choose_split_index(candidates);
+	if(index != -1) return PolyIndex_CPtr(new PolyIndex(polyIndices[index]));
+	else return PolyIndex_CPtr();
 }
 
 template <typename Poly>
@@ -284,4 +347,57 @@ Vector3d OnionCompiler<Poly>::find_arbitrary_leaf_point(const std::vector<Plane_
 	return p;
 }
 
+/**
+Makes the output nodes for the specified subtree (in postorder), and stores the polygons
+which ended up in its leaves in the output polygon array.
+
+@param node		The root of the subtree
+@param nodes	The output node array
+@return			The output node for the root of the subtree
+*/
+template <typename Poly>
+OnionNode_Ptr OnionCompiler<Poly>::make_nodes(const BuildNode_Ptr& node, std::vector<OnionNode_Ptr>& nodes)
+{
+	if(!node->splitter)
+	{
+		std::vector<int> indicesOnly;
+		for(size_t i=0, size=node->polyIndices.size(); i<size; ++i)
+		{
+			const PolyIndex& polyIndex = node->polyIndices[i];
+			(*m_polygons)[*polyIndex.slot] = polyIndex.poly;
+			indicesOnly.push_back(*polyIndex.slot);
+		}
+
+		nodes.push_back(OnionNode_Ptr(new OnionLeaf((int)nodes.size(), node->solidityDescriptor, indicesOnly)));
+		return nodes.back();
+	}
+
+	OnionNode_Ptr left = make_nodes(node->left, nodes);
+	OnionNode_Ptr right = make_nodes(node->right, nodes);
+	OnionNode_Ptr subtreeRoot(new OnionBranch((int)nodes.size(), node->splitter, left, right));
+	nodes.push_back(subtreeRoot);
+	return subtreeRoot;
+}
+
+template <typename Poly>
+void OnionCompiler<Poly>::release_thread()
+{
+	boost::mutex::scoped_lock lock(m_threadMutex);
+	++m_spareThreads;
+}
+
+/**
+Attempts to reserve one of the spare threads for building a subtree.
+
+@return	true, if a thread was reserved, or false otherwise
+*/
+template <typename Poly>
+bool OnionCompiler<Poly>::reserve_thread()
+{
+	boost::mutex::scoped_lock lock(m_threadMutex);
+	if(m_spareThreads == 0) return false;
+	--m_spareThreads;
+	return true;
+}
+
 }
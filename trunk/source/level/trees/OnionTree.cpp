@@ -11,6 +11,7 @@ using boost::bad_lexical_cast;
 using boost::lexical_cast;
 
 #include <source/exceptions/Exception.h>
+#include <source/io/util/BinaryIO.h>
 #include <source/math/geom/GeomUtil.h>
 
 namespace hesp {
@@ -20,14 +21,124 @@ OnionTree::OnionTree(const std::vector<OnionNode_Ptr>& nodes, int mapCount)
 :	m_nodes(nodes), m_mapCount(mapCount)
 {
 	index_leaves();
+
+	m_flatBranches.reserve(m_nodes.size() / 2);
+	m_flatRoot = flatten(root());
+
+	int leafCount = static_cast<int>(m_leaves.size());
+	m_leafSolidity.resize(leafCount * m_mapCount);
+	for(int i=0; i<leafCount; ++i)
+	{
+		for(int j=0; j<m_mapCount; ++j)
+		{
+			m_leafSolidity[i * m_mapCount + j] = m_leaves[i]->is_solid(j);
+		}
+	}
 }
 
 //#################### PUBLIC METHODS ####################
+/**
+Returns the branches of the tree in the compact form used by the tree queries (see FlatBranch).
+
+@return	As stated
+*/
+const std::vector<FlatBranch>& OnionTree::flat_branches() const
+{
+	return m_flatBranches;
+}
+
+/**
+Returns the root of the tree in the compact form used by the tree queries: this is the
+index of a flat branch, or the complement of a leaf index if the tree is a single leaf.
+
+@return	As stated
+*/
+int OnionTree::flat_root() const
+{
+	return m_flatRoot;
+}
+
 const OnionLeaf *OnionTree::leaf(int n) const
 {
 	return m_leaves[n];
 }
 
+int OnionTree::leaf_count() const
+{
+	return static_cast<int>(m_leaves.size());
+}
+
+/**
+Determines whether the leaf with leaf index n is solid in the specified map.
+This is equivalent to leaf(n)->is_solid(mapIndex), but avoids touching the leaf itself.
+
+@param n		The leaf index
+@param mapIndex	The map index
+@return			true, if the leaf is solid in the map, or false otherwise
+*/
+bool OnionTree::leaf_is_solid(int n, int mapIndex) const
+{
+	return m_leafSolidity[n * m_mapCount + mapIndex];
+}
+
+/**
+Loads an onion tree from a binary level file section (see output_binary for the format).
+
+@param reader		A reader for the section
+@return				The onion tree
+@throws Exception	If the section is malformed
+*/
+OnionTree_Ptr OnionTree::load_binary(BinaryReader& reader)
+{
+	int mapCount = reader.read<int>();
+	int nodeCount = reader.read<int>();
+	if(mapCount < 0) throw Exception("Bad map count in binary onion tree");
+	if(nodeCount <= 0) throw Exception("Bad node count in binary onion tree");
+
+	const int *kinds = reader.read_array<int>(nodeCount);
+	const int *children = reader.read_array<int>(2 * nodeCount);
+	const double *planes = reader.read_array<double>(4 * nodeCount);
+	const unsigned char *solidity = reader.read_array<unsigned char>(nodeCount * mapCount);
+	const int *polyStarts = reader.read_array<int>(nodeCount + 1);
+	const int *polyIndices = reader.read_array<int>(polyStarts[nodeCount]);
+
+	std::vector<OnionNode_Ptr> nodes(nodeCount);
+	for(int n=0; n<nodeCount; ++n)
+	{
+		if(kinds[n] == 'B')
+		{
+			int leftIndex = children[2*n], rightIndex = children[2*n+1];
+			if(leftIndex < 0 || leftIndex >= n || rightIndex < 0 || rightIndex >= n)
+			{
+				throw Exception("The onion nodes are not stored in postorder: the child nodes for this branch have not yet been loaded");
+			}
+
+			const double *p = &planes[4*n];
+			Plane_Ptr splitter(new Plane(Vector3d(p[0],p[1],p[2]), p[3]));
+			nodes[n] = OnionNode_Ptr(new OnionBranch(n, splitter, nodes[leftIndex], nodes[rightIndex]));
+		}
+		else if(kinds[n] == 'L')
+		{
+			if(polyStarts[n] < 0 || polyStarts[n] > polyStarts[n+1] || polyStarts[n+1] > polyStarts[nodeCount])
+			{
+				throw Exception("Bad polygon range in leaf node: " + lexical_cast<std::string,int>(n));
+			}
+
+			boost::dynamic_bitset<> solidityDescriptor(mapCount);
+			for(int i=0; i<mapCount; ++i)
+			{
+				solidityDescriptor.set(i, solidity[n * mapCount + i] != 0);
+			}
+
+			std::vector<int> leafPolyIndices(polyIndices + polyStarts[n], polyIndices + polyStarts[n+1]);
+			nodes[n].reset(new OnionLeaf(n, solidityDescriptor, leafPolyIndices));
+		}
+		else throw Exception("Bad onion node: " + lexical_cast<std::string,int>(n));
+	}
+
+	return OnionTree_Ptr(new OnionTree(nodes, mapCount));
+}
+
 OnionTree_Ptr OnionTree::load_postorder_text(std::istream& is)
 {
 	std::string line;
@@ -130,6 +241,63 @@ int OnionTree::map_count() const
 	return m_mapCount;
 }
 
+/**
+Outputs the tree to a binary level file section. The nodes are stored in index
+order (which is postorder) as a set of flat arrays: a node kind ('B' or 'L'), the
+child indices and splitting plane of each branch, and the solidity descriptor
+(one byte per map) and polygon indices of each leaf.
+
+@param writer	The writer for the section
+*/
+void OnionTree::output_binary(BinaryWriter& writer) const
+{
+	int nodeCount = static_cast<int>(m_nodes.size());
+	std::vector<int> kinds(nodeCount), children(2 * nodeCount, -1), polyStarts(1, 0), polyIndices;
+	std::vector<double> planes(4 * nodeCount, 0.0);
+	std::vector<unsigned char> solidity(nodeCount * m_mapCount, 0);
+
+	for(int n=0; n<nodeCount; ++n)
+	{
+		if(m_nodes[n]->is_leaf())
+		{
+			const OnionLeaf *leaf = m_nodes[n]->as_leaf();
+			kinds[n] = 'L';
+
+			const boost::dynamic_bitset<>& solidityDescriptor = leaf->solidity_descriptor();
+			for(int i=0; i<m_mapCount; ++i)
+			{
+				solidity[n * m_mapCount + i] = solidityDescriptor[i] ? 1 : 0;
+			}
+
+			const std::vector<int>& leafPolyIndices = leaf->polygon_indices();
+			polyIndices.insert(polyIndices.end(), leafPolyIndices.begin(), leafPolyIndices.end());
+		}
+		else
+		{
+			const OnionBranch *branch = m_nodes[n]->as_branch();
+			kinds[n] = 'B';
+			children[2*n] = branch->left()->index();
+			children[2*n+1] = branch->right()->index();
+
+			const Vector3d& normal = branch->splitter()->normal();
+			planes[4*n] = normal.x;
+			planes[4*n+1] = normal.y;
+			planes[4*n+2] = normal.z;
+			planes[4*n+3] = branch->splitter()->distance_value();
+		}
+		polyStarts.push_back(static_cast<int>(polyIndices.size()));
+	}
+
+	writer.write(m_mapCount);
+	writer.write(nodeCount);
+	writer.write_array(kinds);
+	writer.write_array(children);
+	writer.write_array(planes);
+	writer.write_array(solidity);
+	writer.write_array(polyStarts);
+	writer.write_array(polyIndices);
+}
+
 void OnionTree::output_postorder_text(std::ostream& os) const
 {
 	os << m_mapCount << '\n';
@@ -141,6 +309,28 @@ OnionNode_Ptr OnionTree::root()			{ return m_nodes.back(); }
 OnionNode_CPtr OnionTree::root() const	{ return m_nodes.back(); }
 
 //#################### PRIVATE METHODS ####################
+/**
+Makes the compact representation of the specified subtree used by the tree queries.
+The branches are numbered in preorder, so that each branch is followed by its front child.
+
+@param node	The root of the subtree
+@return		The index of the flat branch for node, or the complement of its leaf index if it's a leaf
+*/
+int OnionTree::flatten(const OnionNode_Ptr& node)
+{
+	if(node->is_leaf()) return FlatBranch::make_leaf(node->as_leaf()->leaf_index());
+
+	OnionBranch *branch = node->as_branch();
+	int index = static_cast<int>(m_flatBranches.size());
+	m_flatBranches.push_back(FlatBranch(*branch->splitter()));
+
+	int left = flatten(branch->left());
+	int right = flatten(branch->right());
+	m_flatBranches[index].children[0] = left;
+	m_flatBranches[index].children[1] = right;
+	return index;
+}
+
 void OnionTree::index_leaves()
 {
 	index_leaves_sub(root());
@@ -8,9 +8,14 @@
 
 #include "OnionBranch.h"
 #include "OnionLeaf.h"
+#include "FlatBranch.h"
 
 namespace hesp {
 
+//#################### FORWARD DECLARATIONS ####################
+class BinaryReader;
+class BinaryWriter;
+
 //#################### TYPEDEFS ####################
 typedef shared_ptr<class OnionTree> OnionTree_Ptr;
 typedef shared_ptr<const class OnionTree> OnionTree_CPtr;
@@ -28,6 +33,9 @@ private:
 	std::vector<OnionNode_Ptr> m_nodes;
 	std::vector<OnionLeaf*> m_leaves;
 	int m_mapCount;
+	std::vector<FlatBranch> m_flatBranches;		// the branches in the compact form used by the tree queries
+	int m_flatRoot;
+	boost::dynamic_bitset<> m_leafSolidity;		// the solidity of each leaf in each map, indexed by leafIndex * mapCount + mapIndex
 
 	//#################### CONSTRUCTORS ####################
 public:
@@ -35,15 +43,22 @@ public:
 
 	//#################### PUBLIC METHODS ####################
 public:
+	const std::vector<FlatBranch>& flat_branches() const;
+	int flat_root() const;
 	const OnionLeaf *leaf(int n) const;
+	int leaf_count() const;
+	bool leaf_is_solid(int n, int mapIndex) const;
+	static OnionTree_Ptr load_binary(BinaryReader& reader);
 	static OnionTree_Ptr load_postorder_text(std::istream& is);
 	int map_count() const;
+	void output_binary(BinaryWriter& writer) const;
 	void output_postorder_text(std::ostream& os) const;
 	OnionNode_Ptr root();
 	OnionNode_CPtr root() const;
 
 	//#################### PRIVATE METHODS ####################
 private:
+	int flatten(const OnionNode_Ptr& node);
 	void index_leaves();
 	void index_leaves_sub(const OnionNode_Ptr& node);
 };
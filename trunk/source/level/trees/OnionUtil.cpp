@@ -20,38 +20,37 @@ OnionUtil::find_first_transition(int mapIndex, const Vector3d& source, const Vec
 {
 	if(0 <= mapIndex && mapIndex < tree->map_count())
 	{
-		return find_first_transition_sub(mapIndex, source, dest, tree->root());
+		return find_first_transition_sub(mapIndex, source, dest, *tree, tree->flat_root());
 	}
 	else throw Exception("The onion tree does not contain a map with index " + lexical_cast<std::string>(mapIndex));
 }
 
 //#################### PRIVATE METHODS ####################
 OnionUtil::Transition
-OnionUtil::find_first_transition_sub(int mapIndex, const Vector3d& source, const Vector3d& dest, const OnionNode_CPtr& node)
+OnionUtil::find_first_transition_sub(int mapIndex, const Vector3d& source, const Vector3d& dest, const OnionTree& tree, int node)
 {
-	if(node->is_leaf())
+	if(FlatBranch::is_leaf(node))
 	{
-		const OnionLeaf *leaf = node->as_leaf();
-		if(leaf->is_solid(mapIndex)) return Transition(RAY_SOLID);
+		if(tree.leaf_is_solid(FlatBranch::leaf_index(node), mapIndex)) return Transition(RAY_SOLID);
 		else return Transition(RAY_EMPTY);
 	}
 
-	const OnionBranch *branch = node->as_branch();
-	OnionNode_CPtr left = branch->left();
-	OnionNode_CPtr right = branch->right();
+	const FlatBranch& branch = tree.flat_branches()[node];
+	int left = branch.children[0];
+	int right = branch.children[1];
 
-	Plane_CPtr splitter = branch->splitter();
+	const Plane& splitter = branch.splitter;
 	PlaneClassifier cpSource, cpDest;
-	switch(classify_linesegment_against_plane(source, dest, *splitter, cpSource, cpDest))
+	switch(classify_linesegment_against_plane(source, dest, splitter, cpSource, cpDest))
 	{
 		case CP_BACK:
 		{
-			return find_first_transition_sub(mapIndex, source, dest, right);
+			return find_first_transition_sub(mapIndex, source, dest, tree, right);
 		}
 		case CP_COPLANAR:
 		{
-			Transition trLeft = find_first_transition_sub(mapIndex, source, dest, left);
-			Transition trRight = find_first_transition_sub(mapIndex, source, dest, right);
+			Transition trLeft = find_first_transition_sub(mapIndex, source, dest, tree, left);
+			Transition trRight = find_first_transition_sub(mapIndex, source, dest, tree, right);
 			if(trLeft.classifier == trRight.classifier)
 			{
 				switch(trLeft.classifier)
@@ -85,12 +84,12 @@ OnionUtil::find_first_transition_sub(int mapIndex, const Vector3d& source, const
 		}
 		case CP_FRONT:
 		{
-			return find_first_transition_sub(mapIndex, source, dest, left);
+			return find_first_transition_sub(mapIndex, source, dest, tree, left);
 		}
 		default:	// case CP_STRADDLE
 		{
-			Vector3d mid = determine_linesegment_intersection_with_plane(source, dest, *splitter).first;
-			OnionNode_CPtr near, far;
+			Vector3d mid = determine_linesegment_intersection_with_plane(source, dest, splitter).first;
+			int near, far;
 			if(cpSource == CP_FRONT)
 			{
 				near = left;
@@ -103,11 +102,11 @@ OnionUtil::find_first_transition_sub(int mapIndex, const Vector3d& source, const
 			}
 
 			// Search for a transition on the near side of the plane: if we find one, that's the first transition.
-			Transition trNear = find_first_transition_sub(mapIndex, source, mid, near);
+			Transition trNear = find_first_transition_sub(mapIndex, source, mid, tree, near);
 			if(trNear.location) return trNear;
 
 			// Search for a transition on the far side of the plane.
-			Transition trFar = find_first_transition_sub(mapIndex, mid, dest, far);
+			Transition trFar = find_first_transition_sub(mapIndex, mid, dest, tree, far);
 
 			switch(trFar.classifier)
 			{
@@ -116,13 +115,13 @@ OnionUtil::find_first_transition_sub(int mapIndex, const Vector3d& source, const
 					// If both sides are empty, there's no transition, otherwise there's a solid -> empty transition
 					// at the point where the ray intersects the current split plane.
 					if(trNear.classifier == RAY_EMPTY) return Transition(RAY_EMPTY);
-					else return Transition(RAY_TRANSITION_SE, Vector3d_Ptr(new Vector3d(mid)), splitter);
+					else return Transition(RAY_TRANSITION_SE, Vector3d_Ptr(new Vector3d(mid)), Plane_CPtr(new Plane(splitter)));
 				}
 				case RAY_SOLID:
 				{
 					// If both sides are solid, there's no transition, otherwise there's an empty -> solid transition
 					// at the point where the ray intersects the current split plane.
-					if(trNear.classifier == RAY_EMPTY) return Transition(RAY_TRANSITION_ES, Vector3d_Ptr(new Vector3d(mid)), splitter);
+					if(trNear.classifier == RAY_EMPTY) return Transition(RAY_TRANSITION_ES, Vector3d_Ptr(new Vector3d(mid)), Plane_CPtr(new Plane(splitter)));
 					else return Transition(RAY_SOLID);
 				}
 				case RAY_TRANSITION_ES:
@@ -130,14 +129,14 @@ OnionUtil::find_first_transition_sub(int mapIndex, const Vector3d& source, const
 					// If the near side is empty, the first transition is the empty -> solid one on the far side.
 					// Otherwise, there's a nearer solid -> empty transition on the current split plane.
 					if(trNear.classifier == RAY_EMPTY) return trFar;
-					else return Transition(RAY_TRANSITION_SE, Vector3d_Ptr(new Vector3d(mid)), splitter);
+					else return Transition(RAY_TRANSITION_SE, Vector3d_Ptr(new Vector3d(mid)), Plane_CPtr(new Plane(splitter)));
 				}
 				default:	// case RAY_TRANSITION_SE
 				{
 					// If the near side is solid, the first transition is the solid -> empty one on the far side.
 					// Otherwise, there's a nearer empty -> solid transition on the current split plane.
 					if(trNear.classifier == RAY_SOLID) return trFar;
-					else return Transition(RAY_TRANSITION_ES, Vector3d_Ptr(new Vector3d(mid)), splitter);
+					else return Transition(RAY_TRANSITION_ES, Vector3d_Ptr(new Vector3d(mid)), Plane_CPtr(new Plane(splitter)));
 				}
 			}
 		}
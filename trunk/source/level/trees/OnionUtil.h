@@ -11,7 +11,6 @@
 namespace hesp {
 
 //#################### FORWARD DECLARATIONS ####################
-typedef shared_ptr<const class OnionNode> OnionNode_CPtr;
 typedef shared_ptr<const class OnionTree> OnionTree_CPtr;
 typedef shared_ptr<const class Plane> Plane_CPtr;
 
@@ -49,7 +48,7 @@ public:
 
 	//#################### PRIVATE METHODS ####################
 private:
-	static Transition find_first_transition_sub(int mapIndex, const Vector3d& source, const Vector3d& dest, const OnionNode_CPtr& node);
+	static Transition find_first_transition_sub(int mapIndex, const Vector3d& source, const Vector3d& dest, const OnionTree& tree, int node);
 };
 
 }
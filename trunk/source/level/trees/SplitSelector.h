@@ -0,0 +1,87 @@
+/***
+ * hesperus: SplitSelector.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_SPLITSELECTOR
+#define H_HESP_SPLITSELECTOR
+
+#include <vector>
+
+#include <source/math/geom/Plane.h>
+
+namespace hesp {
+
+//#################### ENUMERATIONS ####################
+/**
+Controls the trade-off between tree quality and build speed when choosing split planes.
+SQ_EXACT considers every unique candidate plane against every polygon; SQ_NORMAL and SQ_FAST
+only consider a sample of the candidate planes (and test them against a sample of the
+polygons) at nodes which are too large to evaluate exhaustively.
+*/
+enum SplitQuality
+{
+	SQ_EXACT,
+	SQ_NORMAL,
+	SQ_FAST
+};
+
+/**
+This class template chooses split planes for the BSP and onion tree compilers. It scores candidate
+planes using the metric |balance| + weight * splits, but only scores each unique plane once (all the
+polygons on a given plane share the same counts), and stops scoring a plane as soon as it can no
+longer beat the best plane found so far.
+*/
+template <typename Poly>
+class SplitSelector
+{
+	//#################### NESTED CLASSES ####################
+public:
+	struct Candidate
+	{
+		const Poly *poly;
+		bool splitCandidate;	// can the plane of the polygon be chosen as a split plane?
+		bool hint;				// hint polygons are only chosen as a last resort, and don't count towards balance or splits
+
+		Candidate(const Poly *poly_, bool splitCandidate_, bool hint_)
+		:	poly(poly_), splitCandidate(splitCandidate_), hint(hint_)
+		{}
+	};
+
+	//#################### CONSTANTS ####################
+private:
+	enum
+	{
+		HINT_PENALTY = 100000,			// makes sure hint planes are chosen last
+		NORMAL_MAX_CANDIDATES = 256,
+		NORMAL_MAX_TESTS = 4096,
+		FAST_MAX_CANDIDATES = 32,
+		FAST_MAX_TESTS = 512
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	double m_weight;
+	SplitQuality m_quality;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	SplitSelector(double weight, SplitQuality quality);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	int choose_split_index(const std::vector<Candidate>& candidates) const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	bool score_plane(const Plane& plane, bool hint, const std::vector<Candidate>& candidates, const std::vector<int>& testIndices,
+					 double bestMetric, double& metric) const;
+	static std::vector<int> sample_evenly(const std::vector<int>& indices, size_t maxCount);
+	std::vector<int> sample_planes(const std::vector<int>& planeIndices, const std::vector<Candidate>& candidates, size_t maxCount) const;
+};
+
+}
+
+#include "SplitSelector.tpp"
+
+#endif
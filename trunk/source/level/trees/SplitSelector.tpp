@@ -0,0 +1,198 @@
+/***
+ * hesperus: SplitSelector.tpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iterator>
+#include <map>
+
+#include <source/math/Constants.h>
+#include <source/math/geom/GeomUtil.h>
+#include <source/math/geom/UniquePlanePred.h>
+
+namespace hesp {
+
+//#################### CONSTRUCTORS ####################
+template <typename Poly>
+SplitSelector<Poly>::SplitSelector(double weight, SplitQuality quality)
+:	m_weight(weight), m_quality(quality)
+{}
+
+//#################### PUBLIC METHODS ####################
+/**
+Chooses the candidate whose plane should be used to split a node.
+
+@param candidates	The polygons in the node
+@return				The index of the chosen candidate, or -1 if there are no split candidates
+*/
+template <typename Poly>
+int SplitSelector<Poly>::choose_split_index(const std::vector<Candidate>& candidates) const
+{
+	typedef std::map<Plane,int,UniquePlanePred> PlaneTable;
+
+	// Find a representative candidate for each unique split plane (ignoring orientation, which doesn't affect the metric).
+	// Where a plane has both hint and non-hint candidates, a non-hint one is chosen to represent it.
+	const double angleTolerance = 0.5 * PI / 180;	// convert 0.5 degrees to radians
+	const double distTolerance = 0.001;
+	PlaneTable planeTable(UniquePlanePred(angleTolerance, distTolerance));
+
+	std::vector<int> testIndices;
+	int candidateCount = static_cast<int>(candidates.size());
+	for(int i=0; i<candidateCount; ++i)
+	{
+		const Candidate& candidate = candidates[i];
+		if(!candidate.hint) testIndices.push_back(i);
+		if(!candidate.splitCandidate) continue;
+
+		std::pair<typename PlaneTable::iterator,bool> result = planeTable.insert(std::make_pair(make_plane(*candidate.poly).to_undirected_form(), i));
+		int& representative = result.first->second;
+		if(!result.second && candidates[representative].hint && !candidate.hint) representative = i;
+	}
+
+	std::vector<int> planeIndices;
+	for(typename PlaneTable::const_iterator it=planeTable.begin(), iend=planeTable.end(); it!=iend; ++it)
+	{
+		planeIndices.push_back(it->second);
+	}
+
+	// Scoring the planes in candidate order means that ties are resolved in favour of the earliest candidate.
+	std::sort(planeIndices.begin(), planeIndices.end());
+
+	// If the node is too large to evaluate exhaustively at the requested quality, sample the planes and test polygons.
+	switch(m_quality)
+	{
+		case SQ_EXACT:
+			break;
+		case SQ_NORMAL:
+			planeIndices = sample_planes(planeIndices, candidates, NORMAL_MAX_CANDIDATES);
+			testIndices = sample_evenly(testIndices, NORMAL_MAX_TESTS);
+			break;
+		case SQ_FAST:
+			planeIndices = sample_planes(planeIndices, candidates, FAST_MAX_CANDIDATES);
+			testIndices = sample_evenly(testIndices, FAST_MAX_TESTS);
+			break;
+	}
+
+	int bestIndex = -1;
+	double bestMetric = INT_MAX;
+	for(std::vector<int>::const_iterator it=planeIndices.begin(), iend=planeIndices.end(); it!=iend; ++it)
+	{
+		const Candidate& candidate = candidates[*it];
+		double metric;
+		if(score_plane(make_plane(*candidate.poly), candidate.hint, candidates, testIndices, bestMetric, metric))
+		{
+			bestIndex = *it;
+			bestMetric = metric;
+		}
+	}
+
+	return bestIndex;
+}
+
+//#################### PRIVATE METHODS ####################
+/**
+Scores a candidate split plane against the test polygons, giving up as soon as it becomes clear
+that the plane can't beat the best one found so far.
+
+@param plane		The candidate split plane
+@param hint			Whether or not the plane comes from a hint polygon
+@param candidates	The polygons in the node
+@param testIndices	The indices of the polygons against which to test the plane
+@param bestMetric	The metric of the best plane found so far
+@param metric		Used to return the metric of the plane (if it beats bestMetric)
+@return				true, if the plane beats bestMetric, or false otherwise
+*/
+template <typename Poly>
+bool SplitSelector<Poly>::score_plane(const Plane& plane, bool hint, const std::vector<Candidate>& candidates, const std::vector<int>& testIndices,
+									  double bestMetric, double& metric) const
+{
+	double hintPenalty = hint ? HINT_PENALTY : 0;
+	if(hintPenalty >= bestMetric) return false;
+
+	int balance = 0, splits = 0;
+	int remaining = static_cast<int>(testIndices.size());
+	for(std::vector<int>::const_iterator it=testIndices.begin(), iend=testIndices.end(); it!=iend; ++it)
+	{
+		--remaining;
+
+		switch(classify_polygon_against_plane(*candidates[*it].poly, plane))
+		{
+			case CP_BACK:
+				--balance;
+				break;
+			case CP_COPLANAR:
+				break;
+			case CP_FRONT:
+				++balance;
+				break;
+			case CP_STRADDLE:
+				++splits;
+				break;
+		}
+
+		// The remaining polygons can at best restore the balance and cause no further splits.
+		double lowerBound = std::max(abs(balance) - remaining, 0) + m_weight * splits + hintPenalty;
+		if(lowerBound >= bestMetric) return false;
+	}
+
+	metric = abs(balance) + m_weight * splits + hintPenalty;
+	return metric < bestMetric;
+}
+
+/**
+Chooses at most maxCount evenly-spaced elements of the specified index array.
+The sampling is deterministic, so that trees can be rebuilt reproducibly.
+
+@param indices	The index array
+@param maxCount	The maximum number of elements to choose
+@return			The chosen elements (in their original order)
+*/
+template <typename Poly>
+std::vector<int> SplitSelector<Poly>::sample_evenly(const std::vector<int>& indices, size_t maxCount)
+{
+	if(indices.size() <= maxCount) return indices;
+
+	std::vector<int> ret;
+	ret.reserve(maxCount);
+	for(size_t i=0; i<maxCount; ++i)
+	{
+		ret.push_back(indices[i * indices.size() / maxCount]);
+	}
+	return ret;
+}
+
+/**
+Chooses at most maxCount of the specified candidate planes. Axis-aligned planes are preferred,
+since they tend to make good split planes for architectural geometry; any remaining places
+are filled by an even sample of the other planes.
+
+@param planeIndices	The indices of the candidates representing the unique planes (in ascending order)
+@param candidates	The polygons in the node
+@param maxCount		The maximum number of planes to choose
+@return				The indices of the candidates representing the chosen planes (in ascending order)
+*/
+template <typename Poly>
+std::vector<int> SplitSelector<Poly>::sample_planes(const std::vector<int>& planeIndices, const std::vector<Candidate>& candidates,
+													size_t maxCount) const
+{
+	if(planeIndices.size() <= maxCount) return planeIndices;
+
+	std::vector<int> axial, other;
+	for(std::vector<int>::const_iterator it=planeIndices.begin(), iend=planeIndices.end(); it!=iend; ++it)
+	{
+		const Vector3d& n = candidates[*it].poly->normal();
+		if(fabs(fabs(n.x) - 1) < EPSILON || fabs(fabs(n.y) - 1) < EPSILON || fabs(fabs(n.z) - 1) < EPSILON) axial.push_back(*it);
+		else other.push_back(*it);
+	}
+
+	std::vector<int> ret = sample_evenly(axial, maxCount);
+	std::vector<int> otherSample = sample_evenly(other, maxCount - ret.size());
+	std::copy(otherSample.begin(), otherSample.end(), std::back_inserter(ret));
+	std::sort(ret.begin(), ret.end());
+	return ret;
+}
+
+}
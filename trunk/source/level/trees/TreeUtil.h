@@ -7,12 +7,14 @@
 #define H_HESP_TREEUTIL
 
 #include <list>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 using boost::shared_ptr;
 
 #include <source/math/geom/Plane.h>
 #include <source/math/vectors/Vector3.h>
+#include "FlatBranch.h"
 
 namespace hesp {
 
@@ -20,6 +20,7 @@ int TreeUtil::find_leaf_index(const Vector3d& p, shared_ptr<Tree> tree)
 
 /**
 Finds the index of the leaf in the specified tree in which the specified point resides.
+The search runs against the tree's compact branch array (see FlatBranch).
 
 @param p		The point
 @param tree		The tree
@@ -28,31 +29,28 @@ Finds the index of the leaf in the specified tree in which the specified point r
 template <typename Tree>
 int TreeUtil::find_leaf_index(const Vector3d& p, shared_ptr<const Tree> tree)
 {
-	typedef typename Tree::Branch Branch;
-	typedef typename Tree::Leaf Leaf;
-	typedef typename Tree::Node Node;
+	const std::vector<FlatBranch>& branches = tree->flat_branches();
 
-	shared_ptr<const Node> cur = tree->root();
-	while(!cur->is_leaf())
+	int cur = tree->flat_root();
+	while(!FlatBranch::is_leaf(cur))
 	{
-		const Branch *branch = cur->as_branch();
-		switch(classify_point_against_plane(p, *branch->splitter()))
+		const FlatBranch& branch = branches[cur];
+		switch(classify_point_against_plane(p, branch.splitter))
 		{
 			case CP_BACK:
 			{
-				cur = branch->right();
+				cur = branch.children[1];
 				break;
 			}
 			default:	// CP_COPLANAR or CP_FRONT
 			{
-				cur = branch->left();
+				cur = branch.children[0];
 				break;
 			}
 		}
 	}
 
-	const Leaf *leaf = cur->as_leaf();
-	return leaf->leaf_index();
+	return FlatBranch::leaf_index(cur);
 }
 
 /**
@@ -0,0 +1,238 @@
+/***
+ * hesperus: CompressedLeafVisTable.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "CompressedLeafVisTable.h"
+
+#include <algorithm>
+
+#include <source/exceptions/Exception.h>
+
+namespace hesp {
+
+//#################### CONSTRUCTORS ####################
+/**
+Constructs a compressed leaf visibility table of the specified size, in which
+no leaf can see any other (each row should subsequently be set using
+set_compressed_row).
+
+@param size	The number of leaves
+*/
+CompressedLeafVisTable::CompressedLeafVisTable(int size)
+:	m_size(size), m_rows(size), m_cache(CACHE_SIZE), m_useCounter(0)
+{
+	CompressedRow emptyRow;
+	for(int n=row_bytes(); n>0; n-=255)
+	{
+		emptyRow.push_back(0);
+		emptyRow.push_back(static_cast<unsigned char>(std::min(n, 255)));
+	}
+
+	for(int i=0; i<size; ++i)
+	{
+		m_rows[i] = emptyRow;
+	}
+}
+
+//#################### PUBLIC OPERATORS ####################
+LeafVisState CompressedLeafVisTable::operator()(int i, int j) const
+{
+	const std::vector<Word>& bits = row_bits(i);
+	return (bits[j / LeafVisTable::WORD_BITS] >> (j % LeafVisTable::WORD_BITS)) & 1 ? LEAFVIS_YES : LEAFVIS_NO;
+}
+
+//#################### PUBLIC METHODS ####################
+/**
+Compresses a leaf visibility table.
+
+@param table	The uncompressed table
+@return			The compressed table
+*/
+CompressedLeafVisTable_Ptr CompressedLeafVisTable::compress(const LeafVisTable& table)
+{
+	int size = table.size();
+	CompressedLeafVisTable_Ptr ret(new CompressedLeafVisTable(size));
+	for(int i=0; i<size; ++i)
+	{
+		ret->m_rows[i] = compress_row(table, i);
+	}
+	return ret;
+}
+
+/**
+Returns the compressed form of the specified row (e.g. for saving it to disk).
+
+@param i	The row
+@return		As stated
+*/
+const CompressedLeafVisTable::CompressedRow& CompressedLeafVisTable::compressed_row(int i) const
+{
+	return m_rows[i];
+}
+
+/**
+Decompresses the entire table.
+
+@return	The uncompressed table
+*/
+LeafVisTable_Ptr CompressedLeafVisTable::decompress() const
+{
+	LeafVisTable_Ptr table(new LeafVisTable(m_size));
+	const int rowWords = table->row_words();
+
+	std::vector<Word> bits;
+	for(int i=0; i<m_size; ++i)
+	{
+		decompress_row(i, bits);
+		std::copy(bits.begin(), bits.end(), table->plane(0).begin() + i * rowWords);
+	}
+
+	return table;
+}
+
+/**
+Returns the specified row of the table as an array of words, in the same format
+as a row of a LeafVisTable (bit j of the row is bit j%32 of word j/32). The row
+is decompressed if it isn't already in the cache.
+
+Note:	The returned reference is only guaranteed to remain valid until the next
+		access to a different row of the table.
+
+@param i	The row
+@return		As stated
+*/
+const std::vector<CompressedLeafVisTable::Word>& CompressedLeafVisTable::row_bits(int i) const
+{
+	++m_useCounter;
+
+	// Look for the row in the cache, keeping track of the least recently used entry in case we need to replace it.
+	int lruIndex = 0;
+	for(int k=0; k<CACHE_SIZE; ++k)
+	{
+		if(m_cache[k].row == i)
+		{
+			m_cache[k].lastUsed = m_useCounter;
+			return m_cache[k].bits;
+		}
+
+		if(m_cache[k].lastUsed < m_cache[lruIndex].lastUsed) lruIndex = k;
+	}
+
+	CacheEntry& entry = m_cache[lruIndex];
+	decompress_row(i, entry.bits);
+	entry.row = i;
+	entry.lastUsed = m_useCounter;
+	return entry.bits;
+}
+
+/**
+Sets the compressed form of the specified row (e.g. when loading it from disk).
+
+@param i			The row
+@param row			The compressed row
+@throws Exception	If the compressed row does not decompress to the right number of bytes
+*/
+void CompressedLeafVisTable::set_compressed_row(int i, const CompressedRow& row)
+{
+	// Check that the row decompresses to the right length.
+	int byteCount = 0;
+	for(size_t k=0, size=row.size(); k<size; ++k)
+	{
+		if(row[k] == 0)
+		{
+			if(++k == size) throw Exception("Truncated zero run in compressed vis table row");
+			byteCount += row[k];
+		}
+		else ++byteCount;
+	}
+	if(byteCount != row_bytes()) throw Exception("Compressed vis table row has the wrong length");
+
+	m_rows[i] = row;
+
+	// Invalidate the cached copy of the row (if any).
+	for(int k=0; k<CACHE_SIZE; ++k)
+	{
+		if(m_cache[k].row == i) m_cache[k].row = -1;
+	}
+}
+
+int CompressedLeafVisTable::size() const
+{
+	return m_size;
+}
+
+//#################### PRIVATE METHODS ####################
+/**
+Compresses the specified row of an uncompressed leaf visibility table.
+
+@param table	The uncompressed table
+@param i		The row
+@return			The compressed row
+*/
+CompressedLeafVisTable::CompressedRow CompressedLeafVisTable::compress_row(const LeafVisTable& table, int i)
+{
+	const int rowWords = table.row_words();
+	const int rowBytes = (table.size() + 7) / 8;
+	const std::vector<Word>& plane = table.plane(0);
+
+	CompressedRow row;
+	for(int k=0; k<rowBytes;)
+	{
+		unsigned char b = static_cast<unsigned char>(plane[i * rowWords + k / 4] >> (8 * (k % 4)));
+		if(b != 0)
+		{
+			row.push_back(b);
+			++k;
+			continue;
+		}
+
+		// Count the zero bytes in this run (up to a maximum of 255).
+		int run = 0;
+		while(k < rowBytes && run < 255 && static_cast<unsigned char>(plane[i * rowWords + k / 4] >> (8 * (k % 4))) == 0)
+		{
+			++run;
+			++k;
+		}
+		row.push_back(0);
+		row.push_back(static_cast<unsigned char>(run));
+	}
+	return row;
+}
+
+/**
+Decompresses the specified row of the table.
+
+@param i	The row
+@param bits	Used to return the decompressed row (in the format described in row_bits)
+*/
+void CompressedLeafVisTable::decompress_row(int i, std::vector<Word>& bits) const
+{
+	bits.assign((m_size + LeafVisTable::WORD_BITS - 1) / LeafVisTable::WORD_BITS, 0);
+
+	const CompressedRow& row = m_rows[i];
+	int k = 0;
+	for(size_t r=0, size=row.size(); r<size; ++r)
+	{
+		if(row[r] == 0)
+		{
+			// Skip a run of zero bytes (the bits are already clear).
+			k += row[++r];
+		}
+		else
+		{
+			bits[k / 4] |= static_cast<Word>(row[r]) << (8 * (k % 4));
+			++k;
+		}
+	}
+}
+
+/**
+Returns the number of bytes in an uncompressed row of the table.
+*/
+int CompressedLeafVisTable::row_bytes() const
+{
+	return (m_size + 7) / 8;
+}
+
+}
@@ -0,0 +1,94 @@
+/***
+ * hesperus: CompressedLeafVisTable.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_COMPRESSEDLEAFVISTABLE
+#define H_HESP_COMPRESSEDLEAFVISTABLE
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+
+#include "VisTable.h"
+
+namespace hesp {
+
+//#################### TYPEDEFS ####################
+typedef shared_ptr<class CompressedLeafVisTable> CompressedLeafVisTable_Ptr;
+typedef shared_ptr<const class CompressedLeafVisTable> CompressedLeafVisTable_CPtr;
+
+//#################### CLASSES ####################
+/**
+This class represents a leaf visibility table whose rows are stored in
+compressed form. Each row is bit-packed into bytes (bit j of the row is
+bit j%8 of byte j/8) and runs of zero bytes are then run-length encoded
+(a zero byte is followed by the number of zero bytes in the run), in the
+same way as the PVS in Quake.
+
+Rows are only decompressed when they are accessed, and the most recently
+used decompressed rows are kept in a small cache. Since the cache is
+updated by const methods, a single table must not be accessed from more
+than one thread at once.
+*/
+class CompressedLeafVisTable
+{
+	//#################### TYPEDEFS ####################
+public:
+	typedef std::vector<unsigned char> CompressedRow;
+	typedef LeafVisTable::Word Word;
+
+	//#################### CONSTANTS ####################
+private:
+	enum
+	{
+		CACHE_SIZE = 4
+	};
+
+	//#################### NESTED CLASSES ####################
+private:
+	struct CacheEntry
+	{
+		int row;
+		int lastUsed;
+		std::vector<Word> bits;
+
+		CacheEntry() : row(-1), lastUsed(0) {}
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	int m_size;
+	std::vector<CompressedRow> m_rows;
+
+	mutable std::vector<CacheEntry> m_cache;
+	mutable int m_useCounter;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	explicit CompressedLeafVisTable(int size);
+
+	//#################### PUBLIC OPERATORS ####################
+public:
+	LeafVisState operator()(int i, int j) const;
+
+	//#################### PUBLIC METHODS ####################
+public:
+	static CompressedLeafVisTable_Ptr compress(const LeafVisTable& table);
+	const CompressedRow& compressed_row(int i) const;
+	LeafVisTable_Ptr decompress() const;
+	const std::vector<Word>& row_bits(int i) const;
+	void set_compressed_row(int i, const CompressedRow& row);
+	int size() const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	static CompressedRow compress_row(const LeafVisTable& table, int i);
+	void decompress_row(int i, std::vector<Word>& bits) const;
+	int row_bytes() const;
+};
+
+}
+
+#endif
@@ -5,16 +5,39 @@
 
 #include "VisCalculator.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
 #include <stack>
 
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <source/exceptions/Exception.h>
+#include <source/io/util/FieldIO.h>
+#include <source/io/util/LineIO.h>
 #include <source/math/geom/GeomUtil.h>
+#include <source/util/Hasher.h>
 #include "Antipenumbra.h"
 
 namespace hesp {
 
 //#################### CONSTRUCTORS ####################
-VisCalculator::VisCalculator(int emptyLeafCount, const std::vector<Portal_Ptr>& portals)
-:	m_emptyLeafCount(emptyLeafCount), m_portals(portals)
+/**
+Constructs a visibility calculator for the specified portals.
+
+@param emptyLeafCount	The number of empty leaves in the level
+@param portals			The portals between the empty leaves
+@param threadCount		The number of worker threads to use when calculating the portal PVSs
+*/
+VisCalculator::VisCalculator(int emptyLeafCount, const std::vector<Portal_Ptr>& portals, int threadCount)
+:	m_emptyLeafCount(emptyLeafCount), m_portals(portals), m_threadCount(std::max(threadCount, 1)),
+	m_checkpointInterval(0), m_resume(false), m_progressStream(NULL), m_processedCount(0), m_clipCount(0), m_batchBegin(0)
 {
 	// Fill in the portal indices: these will be needed later.
 	int portalCount = static_cast<int>(m_portals.size());
@@ -27,7 +50,8 @@ VisCalculator::VisCalculator(int emptyLeafCount, const std::vector<Portal_Ptr>&
 //#################### PUBLIC METHODS ####################
 /**
 Calculates the full leaf visibility table, which indicates which BSP leaves
-can see each other in the game world.
+can see each other in the game world. If checkpointing is enabled, the
+checkpoint file is deleted once the calculation has finished.
 
 @return	The leaf visibility table
 */
@@ -36,16 +60,56 @@ LeafVisTable_Ptr VisCalculator::calculate_leaf_vis_table()
 	if(!m_leafVis)
 	{
 		build_portals_from_leaf_lookup();
-		initial_portal_vis();
-		flood_fill();
+		calculate_classifiers();
+		if(!m_checkpointFilename.empty()) calculate_input_hash();
+		if(m_resume)
+		{
+			load_checkpoint();
+		}
+		else
+		{
+			initial_portal_vis();
+			flood_fill();
+			calculate_portal_order();
+		}
 		full_portal_vis();
 		portal_to_leaf_vis();
 		clean_intermediate();
+
+		// The checkpoint is no longer needed now that the calculation has finished.
+		if(!m_checkpointFilename.empty()) std::remove(m_checkpointFilename.c_str());
 	}
 
 	return m_leafVis;
 }
 
+/**
+Enables the periodic checkpointing of the full portal vis phase, so that
+a long calculation can be resumed if it gets interrupted. The checkpoint
+file is deleted when the calculation finishes successfully.
+
+@param filename	The name of the checkpoint file
+@param interval	The (approximate) number of portals to process between checkpoints
+@param resume	Whether or not to resume the calculation from an existing checkpoint file
+*/
+void VisCalculator::enable_checkpointing(const std::string& filename, int interval, bool resume)
+{
+	m_checkpointFilename = filename;
+	m_checkpointInterval = interval;
+	m_resume = resume;
+}
+
+/**
+Sets a stream to which progress reports (including an ETA) will be written
+during the full portal vis phase.
+
+@param os	The stream
+*/
+void VisCalculator::set_progress_stream(std::ostream& os)
+{
+	m_progressStream = &os;
+}
+
 //#################### PRIVATE METHODS ####################
 /**
 Builds a table which allows us to look up which portals lead
@@ -53,6 +117,10 @@ out of a given leaf.
 */
 void VisCalculator::build_portals_from_leaf_lookup()
 {
+	// Note:	The lookup is sized up-front so that it can be safely read from several
+	//			threads at once during the full portal vis phase.
+	m_portalsFromLeaf.resize(m_emptyLeafCount);
+
 	int portalCount = static_cast<int>(m_portals.size());
 	for(int i=0; i<portalCount; ++i)
 	{
@@ -61,18 +129,133 @@ void VisCalculator::build_portals_from_leaf_lookup()
 	}
 }
 
+/**
+Calculates the classification relation between the portals. Specifically,
+classifiers(i,j) will contain the classification of polygon j relative
+to the plane of i.
+*/
+void VisCalculator::calculate_classifiers()
+{
+	int portalCount = static_cast<int>(m_portals.size());
+
+	// Note:	This bit could potentially be optimized if we required that portal pairs
+	//			occupied consecutive indices in the list (e.g. if 1 were necessarily the
+	//			reverse portal of 0, etc.).
+	m_classifiers.reset(new ClassifierTable(portalCount));
+	for(int i=0; i<portalCount; ++i)
+	{
+		const Plane plane = make_plane(*m_portals[i]);
+		for(int j=0; j<portalCount; ++j)
+		{
+			if(j == i) (*m_classifiers)(i,j) = CP_COPLANAR;
+			else (*m_classifiers)(i,j) = classify_polygon_against_plane(*m_portals[j], plane);
+		}
+	}
+}
+
+/**
+Calculates a hash of the input to the full portal vis phase (the portal geometry and leaf
+links, and the classifier table), so that a checkpoint written for a different level (or a
+different version of the same level) can be detected and rejected when resuming.
+*/
+void VisCalculator::calculate_input_hash()
+{
+	Hasher hasher;
+	hasher.add(m_emptyLeafCount);
+
+	int portalCount = static_cast<int>(m_portals.size());
+	hasher.add(portalCount);
+	for(int i=0; i<portalCount; ++i)
+	{
+		const Portal& portal = *m_portals[i];
+		hasher.add(portal.auxiliary_data().fromLeaf);
+		hasher.add(portal.auxiliary_data().toLeaf);
+
+		int vertCount = portal.vertex_count();
+		hasher.add(vertCount);
+		for(int j=0; j<vertCount; ++j)
+		{
+			const Vector3d& v = portal.vertex(j);
+			hasher.add(v.x);
+			hasher.add(v.y);
+			hasher.add(v.z);
+		}
+	}
+
+	for(int b=0; b<ClassifierTable::BITS; ++b)
+	{
+		const std::vector<ClassifierTable::Word>& plane = m_classifiers->plane(b);
+		if(!plane.empty()) hasher.add_bytes(&plane[0], plane.size() * sizeof(ClassifierTable::Word));
+	}
+
+	std::ostringstream os;
+	os << std::hex << std::setw(16) << std::setfill('0') << hasher.hash();
+	m_inputHash = os.str();
+}
+
+/**
+Calculates the order in which the portal PVSs should be calculated. Portals
+which can potentially see fewer other portals are processed first: their
+PVSs are cheaper to calculate, and once known they can be used to prune the
+calculations for the more complex portals.
+*/
+void VisCalculator::calculate_portal_order()
+{
+	int portalCount = static_cast<int>(m_portals.size());
+
+	std::vector<std::pair<int,int> > complexities(portalCount);
+	for(int i=0; i<portalCount; ++i)
+	{
+		complexities[i] = std::make_pair(m_portalVis->count_in_row(i, PV_FLOODFILLMAYBE), i);
+	}
+	std::sort(complexities.begin(), complexities.end());
+
+	m_portalOrder.resize(portalCount);
+	for(int i=0; i<portalCount; ++i)
+	{
+		m_portalOrder[i] = complexities[i].second;
+	}
+}
+
 /**
 Calculates the set of portals that are potentially visible from
 the specified portal, and updates the portal visibility table
-accordingly.
+accordingly. The portals found to be visible are returned in a
+mask rather than being written to the table straight away: they
+are only marked as PV_YES (and any others as PV_NO) once the batch
+containing the portal has been processed. This ensures that the
+result doesn't depend on the order in which portals within a batch
+are processed (or on which thread processes them), and that the
+table isn't written while worker threads are reading it.
+
+Each path through the portals carries a mask of the portals that
+might still be visible along it: this is the intersection of the
+rows of the portal visibility table for every portal on the path,
+and so benefits from the final PVSs of any portals that have already
+been processed. A path is abandoned as soon as nothing new could be
+seen along it.
 
 @param originalSource	The portal for which to calculate the PVS
+@param sourceVis		Used to return the mask of portals found to be visible from the original source
+@return					The number of antipenumbra clips performed
 */
-void VisCalculator::calculate_portal_pvs(const Portal_Ptr& originalSource)
+int VisCalculator::calculate_portal_pvs(const Portal_Ptr& originalSource, PortalMask& sourceVis)
 {
+	int clipCount = 0;
+
 	int originalSourceIndex = portal_index(originalSource);
 	Plane originalSourcePlane = make_plane(*originalSource);
 
+	const int rowWords = m_portalVis->row_words();
+
+	// The portals known to be visible from the original source.
+	sourceVis.assign(rowWords, 0);
+
+	// The portals which the original source might be able to see.
+	PortalMask sourceMightSee(rowWords, 0);
+	m_portalVis->accumulate_row_mask(originalSourceIndex, PV_FLOODFILLMAYBE, sourceMightSee);
+	m_portalVis->accumulate_row_mask(originalSourceIndex, PV_YES, sourceMightSee);
+
 	std::stack<PortalTriple> st;
 
 	// Initialise the stack with triples targeting all the portals that can be
@@ -83,14 +266,18 @@ void VisCalculator::calculate_portal_pvs(const Portal_Ptr& originalSource)
 	{
 		Portal_Ptr target = m_portals[originalCandidates[i]];
 		int targetIndex = originalCandidates[i];
-		if((*m_portalVis)(originalSourceIndex, targetIndex) != PV_NO)
+		if(test_bit(sourceMightSee, targetIndex))
 		{
 			if((*m_classifiers)(originalSourceIndex, targetIndex) == CP_STRADDLE)
 			{
 				target = split_polygon(*target, originalSourcePlane).front;
 			}
-			st.push(PortalTriple(originalSource, Portal_Ptr(), target));
-			(*m_portalVis)(originalSourceIndex, targetIndex) = PV_YES;
+
+			PortalMask_Ptr mightSee(new PortalMask(sourceMightSee));
+			m_portalVis->exclude_row_mask(targetIndex, PV_NO, *mightSee);
+			st.push(PortalTriple(originalSource, target, mightSee));
+
+			sourceVis[targetIndex / PortalVisTable::WORD_BITS] |= PortalVisTable::Word(1) << (targetIndex % PortalVisTable::WORD_BITS);
 		}
 	}
 
@@ -98,8 +285,7 @@ void VisCalculator::calculate_portal_pvs(const Portal_Ptr& originalSource)
 	while(!st.empty())
 	{
 		PortalTriple triple = st.top();
-		Portal_Ptr source = triple.source, inter = triple.inter, target = triple.target;
-		int targetIndex = portal_index(target);
+		Portal_Ptr source = triple.source, target = triple.target;
 		st.pop();
 
 		Antipenumbra ap(source, target);
@@ -110,32 +296,96 @@ void VisCalculator::calculate_portal_pvs(const Portal_Ptr& originalSource)
 			Portal_Ptr generator = m_portals[candidates[i]];
 			int generatorIndex = candidates[i];
 
-			// If this generator portal might be visible from both the intermediate portal
-			// (if it exists) and the target portal, then we need to clip it to find out.
-			if((!inter || (*m_portalVis)(portal_index(inter), generatorIndex) != PV_NO) &&
-			   ((*m_portalVis)(targetIndex, generatorIndex) != PV_NO))
+			// If this generator portal might be visible along the current path, then we need to clip it to find out.
+			if(!test_bit(*triple.mightSee, generatorIndex)) continue;
+
+			Portal_Ptr clippedGen = ap.clip(generator);
+			++clipCount;
+			if(!clippedGen) continue;
+
+			Antipenumbra reverseAp(clippedGen->flipped_winding(), target);
+			Portal_Ptr clippedSrc = reverseAp.clip(source);
+			++clipCount;
+			if(!clippedSrc) continue;
+
+			PortalMask_Ptr mightSee(new PortalMask(*triple.mightSee));
+			m_portalVis->exclude_row_mask(generatorIndex, PV_NO, *mightSee);
+
+			// If the generator's already known to be visible, and nothing new could be seen through it,
+			// then there's no point in continuing along this path.
+			PortalVisTable::Word& sourceVisWord = sourceVis[generatorIndex / PortalVisTable::WORD_BITS];
+			PortalVisTable::Word generatorBit = PortalVisTable::Word(1) << (generatorIndex % PortalVisTable::WORD_BITS);
+			if(sourceVisWord & generatorBit)
 			{
-				Portal_Ptr clippedGen = ap.clip(generator);
-				if(clippedGen)
+				bool more = false;
+				for(int w=0; w<rowWords && !more; ++w)
 				{
-					Antipenumbra reverseAp(clippedGen->flipped_winding(), target);
-					Portal_Ptr clippedSrc = reverseAp.clip(source);
-					if(clippedSrc)
-					{
-						st.push(PortalTriple(clippedSrc, target, clippedGen));
-						(*m_portalVis)(originalSourceIndex, generatorIndex) = PV_YES;
-					}
+					if((*mightSee)[w] & ~sourceVis[w]) more = true;
 				}
+				if(!more) continue;
 			}
+
+			st.push(PortalTriple(clippedSrc, clippedGen, mightSee));
+			sourceVisWord |= generatorBit;
 		}
 	}
 
-	// Any portals which haven't been definitely marked as potentially visible at this point can't be seen.
-	int portalCount = static_cast<int>(m_portals.size());
-	for(int i=0; i<portalCount; ++i)
+	return clipCount;
+}
+
+/**
+Calculates the PVSs for a batch of source portals, using a pool of worker
+threads if desired. Each worker starts with an equal contiguous range of
+the batch: workers that finish early steal work from the others. Once all
+the PVSs in the batch have been calculated, the portals found to be visible
+are marked as PV_YES in the portal visibility table.
+
+@param batchBegin	The position in m_portalOrder of the first portal in the batch
+@param batchEnd		The position in m_portalOrder one past the last portal in the batch
+*/
+void VisCalculator::calculate_portal_pvs_batch(int batchBegin, int batchEnd)
+{
+	const int batchSize = batchEnd - batchBegin;
+	m_batchBegin = batchBegin;
+	m_batchVis.resize(batchSize);
+
+	if(m_threadCount == 1)
+	{
+		for(int i=batchBegin; i<batchEnd; ++i)
+		{
+			m_clipCount += calculate_portal_pvs(m_portals[m_portalOrder[i]], m_batchVis[i - batchBegin]);
+		}
+	}
+	else
+	{
+		m_workRanges.resize(m_threadCount);
+		for(int i=0; i<m_threadCount; ++i)
+		{
+			m_workRanges[i] = std::make_pair(batchBegin + batchSize * i / m_threadCount, batchBegin + batchSize * (i+1) / m_threadCount);
+		}
+
+		boost::thread_group workers;
+		for(int i=0; i<m_threadCount; ++i)
+		{
+			workers.create_thread(boost::bind(&VisCalculator::full_portal_vis_worker, this, i));
+		}
+		workers.join_all();
+
+		m_workRanges.clear();
+		if(m_workerError != "") throw Exception(m_workerError);
+	}
+
+	for(int i=batchBegin; i<batchEnd; ++i)
 	{
-		if((*m_portalVis)(originalSourceIndex,i) != PV_YES)
-			(*m_portalVis)(originalSourceIndex,i) = PV_NO;
+		int source = m_portalOrder[i];
+		const PortalMask& sourceVis = m_batchVis[i - batchBegin];
+		for(int w=0, rowWords=static_cast<int>(sourceVis.size()); w<rowWords; ++w)
+		{
+			for(PortalVisTable::Word bits=sourceVis[w]; bits; bits &= bits - 1)
+			{
+				(*m_portalVis)(source, w * PortalVisTable::WORD_BITS + PortalVisTable::lowest_set_bit(bits)) = PV_YES;
+			}
+		}
 	}
 }
 
@@ -147,6 +397,7 @@ void VisCalculator::clean_intermediate()
 	m_portalsFromLeaf.clear();
 	m_classifiers.reset();
 	m_portalVis.reset();
+	m_portalOrder.clear();
 }
 
 /**
@@ -164,11 +415,7 @@ void VisCalculator::flood_fill()
 
 		// If any portals previously thought possible didn't get marked by the flood fill,
 		// then they're not actually possible and need to be marked as such.
-		for(int j=0; j<portalCount; ++j)
-		{
-			if((*m_portalVis)(i,j) == PV_INITIALMAYBE)
-				(*m_portalVis)(i,j) = PV_NO;
-		}
+		m_portalVis->replace_in_row(i, PV_INITIALMAYBE, PV_NO);
 	}
 }
 
@@ -204,19 +451,84 @@ void VisCalculator::flood_from(int originalSource)
 /**
 Performs the third (final) phase of the visibility calculation process,
 in which the real PVS is calculated for each portal.
+
+The portals are processed in batches, in ascending order of the number of
+other portals they can potentially see. At the end of each batch, the rows
+of the portal visibility table for the portals in that batch are finalised,
+allowing them to be used to prune the calculations for later batches. This
+is also the point at which checkpoints are saved and progress is reported.
 */
 void VisCalculator::full_portal_vis()
 {
-	// FIXME:	We should process the portals in ascending order of the
-	//			number of other portals they can potentially see: this
-	//			will speed the whole thing up.
+	using namespace boost::posix_time;
 
 	int portalCount = static_cast<int>(m_portals.size());
-	for(int i=0; i<portalCount; ++i)
+
+	m_workerError = "";
+	m_clipCount = 0;
+
+	const ptime startTime = microsec_clock::universal_time();
+	const int startCount = m_processedCount;
+	int lastCheckpointCount = m_processedCount;
+
+	// Note:	When resuming, m_processedCount is the end of a batch, so the batch boundaries are
+	//			the same as they would have been for an uninterrupted run.
+	for(int batchBegin=m_processedCount; batchBegin<portalCount; batchBegin+=BATCH_SIZE)
+	{
+		int batchEnd = std::min(batchBegin + BATCH_SIZE, portalCount);
+		calculate_portal_pvs_batch(batchBegin, batchEnd);
+
+		// Any portals which haven't been definitely marked as potentially visible at this point can't be seen.
+		// (Note that after the flood fill, the only other state left in the table is PV_NO.)
+		for(int i=batchBegin; i<batchEnd; ++i)
+		{
+			m_portalVis->replace_in_row(m_portalOrder[i], PV_FLOODFILLMAYBE, PV_NO);
+		}
+		m_processedCount = batchEnd;
+
+		if(m_checkpointFilename != "" && m_processedCount < portalCount && m_processedCount - lastCheckpointCount >= m_checkpointInterval)
+		{
+			save_checkpoint();
+			lastCheckpointCount = m_processedCount;
+		}
+
+		if(m_progressStream)
+		{
+			report_progress(startCount, (microsec_clock::universal_time() - startTime).total_milliseconds() / 1000.0);
+		}
+	}
+}
+
+/**
+Runs a single worker thread for the multithreaded version of the full portal vis phase.
+Each worker calculates the PVSs of source portals from its own range until it runs out,
+and then tries to steal portals from the other workers.
+
+Note:	This is safe because the portal visibility table is only read while the workers
+		are running: each worker writes the PVS of each of its source portals to its own
+		element of m_batchVis, and the table itself is updated after the workers finish.
+
+Any exception thrown by a worker is caught and its cause recorded, so that it can be
+rethrown on the main thread once all the workers have finished.
+
+@param workerIndex	The index of the worker
+*/
+void VisCalculator::full_portal_vis_worker(int workerIndex)
+try
+{
+	int position;
+	boost::uint64_t clipCount = 0;
+	while(next_work_item(workerIndex, position))
 	{
-		calculate_portal_pvs(m_portals[i]);
+		clipCount += calculate_portal_pvs(m_portals[m_portalOrder[position]], m_batchVis[position - m_batchBegin]);
 	}
+
+	boost::mutex::scoped_lock lock(m_workMutex);
+	m_clipCount += clipCount;
 }
+catch(Exception& e)				{ stop_workers(e.cause()); }
+catch(std::exception& e)		{ stop_workers(e.what()); }
+catch(...)						{ stop_workers("An unknown error occurred whilst calculating the portal PVSs"); }
 
 /**
 Performs the first phase of the visibility calculation process. In this
@@ -229,24 +541,6 @@ void VisCalculator::initial_portal_vis()
 	int portalCount = static_cast<int>(m_portals.size());
 	m_portalVis.reset(new PortalVisTable(portalCount, PV_INITIALMAYBE));
 
-	// Calculate the classification relation between the portals. Specifically,
-	// classifiers(i,j) will contain the classification of polygon j relative
-	// to the plane of i.
-
-	// Note:	This bit could potentially be optimized if we required that portal pairs
-	//			occupied consecutive indices in the list (e.g. if 1 were necessarily the
-	//			reverse portal of 0, etc.).
-	m_classifiers.reset(new ClassifierTable(portalCount));
-	for(int i=0; i<portalCount; ++i)
-	{
-		const Plane plane = make_plane(*m_portals[i]);
-		for(int j=0; j<portalCount; ++j)
-		{
-			if(j == i) (*m_classifiers)(i,j) = CP_COPLANAR;
-			else (*m_classifiers)(i,j) = classify_polygon_against_plane(*m_portals[j], plane);
-		}
-	}
-
 	// Run through the portal visibility table and mark (*m_portalVis)(i,j) as PV_NO
 	// if portal i definitely can't see through portal j.
 	for(int i=0; i<portalCount; ++i)
@@ -273,6 +567,52 @@ void VisCalculator::initial_portal_vis()
 	}
 }
 
+/**
+Loads the state of a partially-completed full portal vis phase from the checkpoint file.
+This replaces the initial portal vis and flood fill phases when resuming.
+
+@throws Exception	If the checkpoint file cannot be read, or was written for a different set of portals
+*/
+void VisCalculator::load_checkpoint()
+{
+	std::ifstream is(m_checkpointFilename.c_str(), std::ios::binary);
+	if(is.fail()) throw Exception("Could not open " + m_checkpointFilename + " for reading");
+
+	int portalCount = static_cast<int>(m_portals.size());
+
+	LineIO::read_checked_line(is, "HVISCheckpoint");
+	if(FieldIO::read_typed_field<int>(is, "PortalCount") != portalCount ||
+	   FieldIO::read_typed_field<int>(is, "EmptyLeafCount") != m_emptyLeafCount ||
+	   FieldIO::read_field(is, "InputHash") != m_inputHash)
+	{
+		throw Exception("The checkpoint file " + m_checkpointFilename + " was written for a different set of portals");
+	}
+
+	m_processedCount = FieldIO::read_typed_field<int>(is, "ProcessedCount");
+	if(m_processedCount < 0 || m_processedCount > portalCount) throw Exception("Bad processed count in the checkpoint file");
+
+	std::istringstream orderStream(FieldIO::read_field(is, "PortalOrder"));
+	m_portalOrder.resize(portalCount);
+	for(int i=0; i<portalCount; ++i)
+	{
+		if(!(orderStream >> m_portalOrder[i]) || m_portalOrder[i] < 0 || m_portalOrder[i] >= portalCount)
+		{
+			throw Exception("Bad portal order in the checkpoint file");
+		}
+	}
+
+	m_portalVis.reset(new PortalVisTable(portalCount));
+	for(int b=0; b<PortalVisTable::BITS; ++b)
+	{
+		std::vector<PortalVisTable::Word>& plane = m_portalVis->plane(b);
+		if(plane.empty()) continue;
+		if(!is.read(reinterpret_cast<char*>(&plane[0]), static_cast<std::streamsize>(plane.size() * sizeof(PortalVisTable::Word))))
+		{
+			throw Exception("The portal visibility table in the checkpoint file was truncated");
+		}
+	}
+}
+
 /**
 Returns the leaf into which the specified portal is facing.
 
@@ -284,6 +624,46 @@ int VisCalculator::neighbour_leaf(const Portal_Ptr& portal) const
 	return portal->auxiliary_data().toLeaf;
 }
 
+/**
+Fetches the next source portal to be processed by the specified worker. Workers take
+portals from the front of their own range: when it's empty, they steal the back half
+of the largest remaining range belonging to another worker.
+
+@param workerIndex	The index of the worker
+@param position		Used to return the position in m_portalOrder of the next source portal to be processed
+@return				true, if there was a portal left to process, or false otherwise
+*/
+bool VisCalculator::next_work_item(int workerIndex, int& position)
+{
+	boost::mutex::scoped_lock lock(m_workMutex);
+
+	std::pair<int,int>& ownRange = m_workRanges[workerIndex];
+	if(ownRange.first == ownRange.second)
+	{
+		// Find the victim with the most remaining work.
+		int victim = -1, victimRemaining = 0;
+		for(int i=0; i<m_threadCount; ++i)
+		{
+			int remaining = m_workRanges[i].second - m_workRanges[i].first;
+			if(remaining > victimRemaining)
+			{
+				victim = i;
+				victimRemaining = remaining;
+			}
+		}
+		if(victim == -1) return false;
+
+		// Steal the back half of its range.
+		std::pair<int,int>& victimRange = m_workRanges[victim];
+		int mid = victimRange.second - (victimRemaining + 1) / 2;
+		ownRange = std::make_pair(mid, victimRange.second);
+		victimRange.second = mid;
+	}
+
+	position = ownRange.first++;
+	return true;
+}
+
 /**
 Returns the index of the specified portal.
 
@@ -304,15 +684,21 @@ once we've finished calculating.
 */
 void VisCalculator::portal_to_leaf_vis()
 {
-	const int portalCount = static_cast<int>(m_portals.size());
+	typedef PortalVisTable::Word Word;
 
 	m_leafVis.reset(new LeafVisTable(m_emptyLeafCount, LEAFVIS_NO));
 
+	const int rowWords = m_portalVis->row_words();
+	std::vector<Word> visiblePortals(rowWords);
+
 	for(int i=0; i<m_emptyLeafCount; ++i)
 	{
 		// Leaf i can see itself, plus the union of whatever leaves its portals can see.
 		(*m_leafVis)(i, i) = LEAFVIS_YES;
 
+		// Calculate the union of the sets of portals which can be seen by the portals out of leaf i.
+		std::fill(visiblePortals.begin(), visiblePortals.end(), 0);
+
 		const std::vector<int>& ps = m_portalsFromLeaf[i];
 		for(std::vector<int>::const_iterator jt=ps.begin(), jend=ps.end(); jt!=jend; ++jt)
 		{
@@ -321,16 +707,130 @@ void VisCalculator::portal_to_leaf_vis()
 			// Leaf i can see the leaf pointed to by portal j (even though portal j can't see itself).
 			(*m_leafVis)(i, m_portals[j]->auxiliary_data().toLeaf) = LEAFVIS_YES;
 
-			// Leaf i can see all the leaves pointed to by portals portal j can see.
-			for(int k=0; k<portalCount; ++k)
+			m_portalVis->accumulate_row_mask(j, PV_YES, visiblePortals);
+		}
+
+		// Leaf i can see all the leaves pointed to by portals its portals can see.
+		for(int w=0; w<rowWords; ++w)
+		{
+			for(Word bits = visiblePortals[w]; bits != 0; bits &= bits - 1)
 			{
-				if((*m_portalVis)(j,k) == PV_YES)
-				{
-					(*m_leafVis)(i, m_portals[k]->auxiliary_data().toLeaf) = LEAFVIS_YES;
-				}
+				int k = w * PortalVisTable::WORD_BITS + PortalVisTable::lowest_set_bit(bits);
+				(*m_leafVis)(i, m_portals[k]->auxiliary_data().toLeaf) = LEAFVIS_YES;
 			}
 		}
 	}
 }
 
+/**
+Writes a progress report for the full portal vis phase to the progress stream.
+
+@param startCount		The number of portals that had already been processed when the phase (re)started
+@param elapsedSeconds	The time (in seconds) since the phase (re)started
+*/
+void VisCalculator::report_progress(int startCount, double elapsedSeconds) const
+{
+	int portalCount = static_cast<int>(m_portals.size());
+	int remaining = portalCount - m_processedCount;
+
+	double portalRate = elapsedSeconds > 0 ? (m_processedCount - startCount) / elapsedSeconds : 0;
+	double clipRate = elapsedSeconds > 0 ? m_clipCount / elapsedSeconds : 0;
+
+	std::ostream& os = *m_progressStream;
+	os << "Portal vis: " << m_processedCount << '/' << portalCount << " portals ("
+	   << (portalCount > 0 ? m_processedCount * 100 / portalCount : 100) << "%), "
+	   << static_cast<int>(portalRate) << " portals/sec, "
+	   << static_cast<int>(clipRate) << " clips/sec";
+
+	// Note:	The portals are processed in ascending order of complexity, so the ETA is
+	//			only a lower bound (albeit one that improves as the calculation proceeds).
+	if(portalRate > 0)
+	{
+		int eta = static_cast<int>(remaining / portalRate);
+		os << ", ETA " << eta / 3600 << 'h' << (eta / 60) % 60 << 'm' << eta % 60 << 's';
+	}
+
+	os << std::endl;
+}
+
+/**
+Saves the state of the full portal vis phase to the checkpoint file. The checkpoint
+is written to a temporary file first, so that an existing checkpoint isn't lost if
+the process is killed whilst the new one is being written.
+
+Note:	The portal visibility table is written as raw words, so checkpoints can only be
+		resumed on a machine with the same endianness.
+
+@throws Exception	If the checkpoint file cannot be written
+*/
+void VisCalculator::save_checkpoint() const
+{
+	std::string tempFilename = m_checkpointFilename + ".tmp";
+
+	{
+		std::ofstream os(tempFilename.c_str(), std::ios::binary);
+		if(os.fail()) throw Exception("Could not open " + tempFilename + " for writing");
+
+		int portalCount = static_cast<int>(m_portals.size());
+
+		os << "HVISCheckpoint\n";
+		FieldIO::write_typed_field(os, "PortalCount", portalCount);
+		FieldIO::write_typed_field(os, "EmptyLeafCount", m_emptyLeafCount);
+		FieldIO::write_typed_field(os, "InputHash", m_inputHash);
+		FieldIO::write_typed_field(os, "ProcessedCount", m_processedCount);
+
+		os << "PortalOrder = ";
+		for(int i=0; i<portalCount; ++i)
+		{
+			if(i != 0) os << ' ';
+			os << m_portalOrder[i];
+		}
+		os << '\n';
+
+		for(int b=0; b<PortalVisTable::BITS; ++b)
+		{
+			const std::vector<PortalVisTable::Word>& plane = m_portalVis->plane(b);
+			if(plane.empty()) continue;
+			os.write(reinterpret_cast<const char*>(&plane[0]), static_cast<std::streamsize>(plane.size() * sizeof(PortalVisTable::Word)));
+		}
+
+		if(os.fail()) throw Exception("Could not write the checkpoint to " + tempFilename);
+	}
+
+	std::remove(m_checkpointFilename.c_str());
+	if(std::rename(tempFilename.c_str(), m_checkpointFilename.c_str()) != 0)
+	{
+		throw Exception("Could not rename " + tempFilename + " to " + m_checkpointFilename);
+	}
+}
+
+/**
+Records an error which occurred on a worker thread (if no other error has been recorded
+for the current batch), and stops the other workers from picking up any more work.
+
+@param error	The cause of the error
+*/
+void VisCalculator::stop_workers(const std::string& error)
+{
+	boost::mutex::scoped_lock lock(m_workMutex);
+	if(m_workerError == "") m_workerError = error;
+
+	for(size_t i=0, size=m_workRanges.size(); i<size; ++i)
+	{
+		m_workRanges[i].second = m_workRanges[i].first;
+	}
+}
+
+/**
+Tests whether the bit for the specified portal is set in a portal mask.
+
+@param mask	The mask
+@param i	The index of the portal
+@return		true, if the bit is set, or false otherwise
+*/
+bool VisCalculator::test_bit(const PortalMask& mask, int i)
+{
+	return (mask[i / PortalVisTable::WORD_BITS] & (PortalVisTable::Word(1) << (i % PortalVisTable::WORD_BITS))) != 0;
+}
+
 }
@@ -6,10 +6,14 @@
 #ifndef H_HESP_VISCALCULATOR
 #define H_HESP_VISCALCULATOR
 
-#include <map>
+#include <iosfwd>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 using boost::shared_ptr;
 
 #include <source/math/geom/Plane.h>
@@ -22,6 +26,7 @@ class VisCalculator
 {
 	//#################### ENUMERATIONS ####################
 private:
+	// Note: The values of this enumeration must fit into the two bits used per cell by VisTable.
 	enum PortalVisState
 	{
 		PV_NO,				// these portals definitely can't see each other
@@ -30,58 +35,102 @@ private:
 		PV_YES				// these portals definitely can see each other
 	};
 
+	//#################### TYPEDEFS ####################
+private:
+	typedef VisTable<PlaneClassifier> ClassifierTable;
+	typedef shared_ptr<ClassifierTable> ClassifierTable_Ptr;
+	typedef VisTable<PortalVisState> PortalVisTable;
+	typedef shared_ptr<PortalVisTable> PortalVisTable_Ptr;
+	typedef std::vector<PortalVisTable::Word> PortalMask;
+	typedef shared_ptr<PortalMask> PortalMask_Ptr;
+
 	//#################### NESTED CLASSES ####################
 private:
 	struct PortalTriple
 	{
-		Portal_Ptr source, inter, target;
+		Portal_Ptr source, target;
+		PortalMask_Ptr mightSee;	// the portals which might still be visible from the original source along this path
 
-		PortalTriple(const Portal_Ptr& source_, const Portal_Ptr& inter_, const Portal_Ptr& target_)
-		:	source(source_), inter(inter_), target(target_)
+		PortalTriple(const Portal_Ptr& source_, const Portal_Ptr& target_, const PortalMask_Ptr& mightSee_)
+		:	source(source_), target(target_), mightSee(mightSee_)
 		{}
 	};
 
-	//#################### TYPEDEFS ####################
+	//#################### CONSTANTS ####################
 private:
-	typedef VisTable<PlaneClassifier> ClassifierTable;
-	typedef shared_ptr<ClassifierTable> ClassifierTable_Ptr;
-	typedef VisTable<PortalVisState> PortalVisTable;
-	typedef shared_ptr<PortalVisTable> PortalVisTable_Ptr;
+	// The number of source portals whose PVSs are calculated before the results are
+	// made available to prune the calculations for the remaining portals. This must
+	// not depend on the thread count, or the results would too.
+	enum
+	{
+		BATCH_SIZE = 256
+	};
 
 	//#################### PRIVATE VARIABLES ####################
 private:
 	// Input data
 	int m_emptyLeafCount;
 	std::vector<Portal_Ptr> m_portals;
+	int m_threadCount;
+
+	// Checkpointing and progress reporting
+	std::string m_checkpointFilename;		// the file to which to write checkpoints (empty if checkpointing is disabled)
+	int m_checkpointInterval;				// the (approximate) number of portals to process between checkpoints
+	bool m_resume;							// whether or not to resume from the checkpoint file
+	std::string m_inputHash;				// a hash of the portal geometry and classifier table, used to validate checkpoints
+	std::ostream *m_progressStream;			// the stream to which to write progress reports (NULL if none)
 
 	// Intermediate data
-	std::map<int,std::vector<int> > m_portalsFromLeaf;
+	std::vector<std::vector<int> > m_portalsFromLeaf;
 	ClassifierTable_Ptr m_classifiers;
 	PortalVisTable_Ptr m_portalVis;
+	std::vector<int> m_portalOrder;					// the order in which to calculate the portal PVSs (simplest first)
+	int m_processedCount;							// the number of portals in m_portalOrder whose PVSs have been finalised
+	boost::uint64_t m_clipCount;					// the number of antipenumbra clips performed during the full portal vis phase
+	int m_batchBegin;								// the position in m_portalOrder of the first portal in the current batch
+	std::vector<PortalMask> m_batchVis;				// the portals found to be visible from each portal in the current batch
+
+	// Worker pool data (only used when m_threadCount > 1)
+	std::vector<std::pair<int,int> > m_workRanges;	// the [begin,end) range of positions in m_portalOrder still queued for each worker
+	boost::mutex m_workMutex;
+	std::string m_workerError;
 
 	// Output data
 	LeafVisTable_Ptr m_leafVis;
 
 	//#################### CONSTRUCTORS ####################
 public:
-	VisCalculator(int emptyLeafCount, const std::vector<Portal_Ptr>& portals);
+	VisCalculator(int emptyLeafCount, const std::vector<Portal_Ptr>& portals, int threadCount = 1);
 
 	//#################### PUBLIC METHODS ####################
 public:
 	LeafVisTable_Ptr calculate_leaf_vis_table();
+	void enable_checkpointing(const std::string& filename, int interval, bool resume);
+	void set_progress_stream(std::ostream& os);
 
 	//#################### PRIVATE METHODS ####################
 private:
 	void build_portals_from_leaf_lookup();
-	void calculate_portal_pvs(const Portal_Ptr& originalSource);
+	void calculate_classifiers();
+	void calculate_input_hash();
+	void calculate_portal_order();
+	int calculate_portal_pvs(const Portal_Ptr& originalSource, PortalMask& sourceVis);
+	void calculate_portal_pvs_batch(int batchBegin, int batchEnd);
 	void clean_intermediate();
 	void flood_fill();
 	void flood_from(int originalSource);
 	void full_portal_vis();
+	void full_portal_vis_worker(int workerIndex);
 	void initial_portal_vis();
+	void load_checkpoint();
 	int neighbour_leaf(const Portal_Ptr& portal) const;
+	bool next_work_item(int workerIndex, int& position);
 	int portal_index(const Portal_Ptr& portal) const;
 	void portal_to_leaf_vis();
+	void report_progress(int startCount, double elapsedSeconds) const;
+	void save_checkpoint() const;
+	void stop_workers(const std::string& error);
+	static bool test_bit(const PortalMask& mask, int i);
 };
 
 }
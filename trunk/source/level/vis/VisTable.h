@@ -8,34 +8,91 @@
 
 #include <vector>
 
+#include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
 using boost::shared_ptr;
 
 namespace hesp {
 
 //#################### ENUMERATIONS ####################
-// Note:	We don't use bool instead of LeafVisState because VisTable
-//			can be implemented internally using std::vector, and sadly
-//			std::vector<bool> is not a container (yuk!)
 enum LeafVisState
 {
 	LEAFVIS_NO,
 	LEAFVIS_YES
 };
 
+//#################### TRAITS ####################
+/**
+This traits class template specifies how many bits are needed to store
+a single cell of a visibility table with values of type T. The values
+themselves must lie in the range [0,2^BITS).
+*/
+template <typename T>
+struct VisTableTraits
+{
+	enum { BITS = 2 };
+};
+
+template <>
+struct VisTableTraits<LeafVisState>
+{
+	enum { BITS = 1 };
+};
+
 //#################### CLASSES ####################
 /**
 This class template represents a visibility table. It stores the
 visibility relation for an ordered set of objects (note that for
 the purposes of the PVS calculator, it can store the visibility
 relation for both portals and leaves).
+
+The table is bit-packed: each cell is stored across BITS bit planes,
+and each row of each plane is a contiguous, zero-padded array of words.
+This means that the table only takes BITS bits per cell, and that whole
+rows can be processed a word at a time. It also means that distinct rows
+never share a word, so different threads can safely write to different
+rows at the same time.
 */
 template <typename T>
 class VisTable
 {
+	//#################### TYPEDEFS ####################
+public:
+	typedef boost::uint32_t Word;
+
+	//#################### ENUMERATIONS ####################
+public:
+	enum
+	{
+		BITS = VisTableTraits<T>::BITS,
+		WORD_BITS = 32
+	};
+
+	//#################### NESTED CLASSES ####################
+public:
+	/**
+	A proxy for a single (writable) cell of the table.
+	*/
+	class Reference
+	{
+	private:
+		VisTable *m_table;
+		int m_i, m_j;
+
+	public:
+		Reference(VisTable *table, int i, int j) : m_table(table), m_i(i), m_j(j) {}
+
+		operator T() const									{ return m_table->get(m_i, m_j); }
+		Reference& operator=(const T& value)				{ m_table->set(m_i, m_j, value); return *this; }
+		Reference& operator=(const Reference& rhs)			{ m_table->set(m_i, m_j, static_cast<T>(rhs)); return *this; }
+	};
+
 	//#################### PRIVATE VARIABLES ####################
 private:
-	std::vector<std::vector<T> > m_table;
+	int m_size;
+	int m_rowWords;
+	Word m_lastWordMask;				// the valid (i.e. non-padding) bits of the last word in each row
+	std::vector<Word> m_planes[BITS];
 
 	//#################### CONSTRUCTORS ####################
 public:
@@ -43,12 +100,27 @@ public:
 
 	//#################### PUBLIC OPERATORS ####################
 public:
-	T& operator()(int i, int j);
-	const T& operator()(int i, int j) const;
+	Reference operator()(int i, int j);
+	T operator()(int i, int j) const;
 
 	//#################### PUBLIC METHODS ####################
 public:
+	void accumulate_row_mask(int i, const T& value, std::vector<Word>& mask) const;
+	int count_in_row(int i, const T& value) const;
+	void exclude_row_mask(int i, const T& value, std::vector<Word>& mask) const;
+	T get(int i, int j) const;
+	static int lowest_set_bit(Word w);
+	std::vector<Word>& plane(int b);
+	const std::vector<Word>& plane(int b) const;
+	static int popcount(Word w);
+	void replace_in_row(int i, const T& from, const T& to);
+	int row_words() const;
+	void set(int i, int j, const T& value);
 	int size() const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	Word row_mask_word(int i, int w, const T& value) const;
 };
 
 //#################### TYPEDEFS ####################
@@ -8,32 +8,221 @@ namespace hesp {
 //#################### CONSTRUCTORS ####################
 template <typename T>
 VisTable<T>::VisTable(int n, const T& initialValue)
-:	m_table(n)
+:	m_size(n), m_rowWords((n + WORD_BITS - 1) / WORD_BITS)
 {
-	for(int i=0; i<n; ++i)
+	int lastWordBits = n % WORD_BITS;
+	m_lastWordMask = lastWordBits != 0 ? (Word(1) << lastWordBits) - 1 : ~Word(0);
+
+	for(int b=0; b<BITS; ++b)
 	{
-		m_table[i].resize(n, initialValue);
+		m_planes[b].resize(m_size * m_rowWords, 0);
+	}
+
+	if(static_cast<int>(initialValue) != 0)
+	{
+		for(int i=0; i<n; ++i)
+		{
+			replace_in_row(i, T(), initialValue);
+		}
 	}
 }
 
 //#################### PUBLIC OPERATORS ####################
 template <typename T>
-T& VisTable<T>::operator()(int i, int j)
+typename VisTable<T>::Reference VisTable<T>::operator()(int i, int j)
 {
-	return m_table[i][j];
+	return Reference(this, i, j);
 }
 
 template <typename T>
-const T& VisTable<T>::operator()(int i, int j) const
+T VisTable<T>::operator()(int i, int j) const
 {
-	return m_table[i][j];
+	return get(i, j);
 }
 
 //#################### PUBLIC METHODS ####################
+/**
+ORs a bit mask indicating which cells in row i have the specified value into mask.
+
+@param i		The row
+@param value	The value for which to look
+@param mask		The mask (must have row_words() words)
+*/
+template <typename T>
+void VisTable<T>::accumulate_row_mask(int i, const T& value, std::vector<Word>& mask) const
+{
+	for(int w=0; w<m_rowWords; ++w)
+	{
+		mask[w] |= row_mask_word(i, w, value);
+	}
+}
+
+/**
+Counts the number of cells in row i with the specified value.
+
+@param i		The row
+@param value	The value for which to look
+@return			As stated
+*/
+template <typename T>
+int VisTable<T>::count_in_row(int i, const T& value) const
+{
+	int count = 0;
+	for(int w=0; w<m_rowWords; ++w)
+	{
+		count += popcount(row_mask_word(i, w, value));
+	}
+	return count;
+}
+
+/**
+Clears the bits in mask which correspond to cells in row i with the specified value.
+
+@param i		The row
+@param value	The value for which to look
+@param mask		The mask (must have row_words() words)
+*/
+template <typename T>
+void VisTable<T>::exclude_row_mask(int i, const T& value, std::vector<Word>& mask) const
+{
+	for(int w=0; w<m_rowWords; ++w)
+	{
+		mask[w] &= ~row_mask_word(i, w, value);
+	}
+}
+
+template <typename T>
+T VisTable<T>::get(int i, int j) const
+{
+	int offset = i * m_rowWords + j / WORD_BITS;
+	int shift = j % WORD_BITS;
+
+	int value = 0;
+	for(int b=0; b<BITS; ++b)
+	{
+		value |= ((m_planes[b][offset] >> shift) & 1) << b;
+	}
+	return static_cast<T>(value);
+}
+
+/**
+Returns the index of the lowest set bit in a (non-zero) word.
+*/
+template <typename T>
+int VisTable<T>::lowest_set_bit(Word w)
+{
+	int index = 0;
+	if((w & 0xFFFF) == 0)	{ index += 16; w >>= 16; }
+	if((w & 0xFF) == 0)		{ index += 8; w >>= 8; }
+	if((w & 0xF) == 0)		{ index += 4; w >>= 4; }
+	if((w & 0x3) == 0)		{ index += 2; w >>= 2; }
+	if((w & 0x1) == 0)		{ index += 1; }
+	return index;
+}
+
+/**
+Returns the raw words for the specified bit plane of the table (e.g. for serialization).
+Each row occupies row_words() consecutive words of each plane.
+
+@param b	The index of the bit plane (in the range [0,BITS))
+@return		As stated
+*/
+template <typename T>
+std::vector<typename VisTable<T>::Word>& VisTable<T>::plane(int b)
+{
+	return m_planes[b];
+}
+
+template <typename T>
+const std::vector<typename VisTable<T>::Word>& VisTable<T>::plane(int b) const
+{
+	return m_planes[b];
+}
+
+/**
+Returns the number of set bits in a word.
+*/
+template <typename T>
+int VisTable<T>::popcount(Word w)
+{
+	w = w - ((w >> 1) & 0x55555555);
+	w = (w & 0x33333333) + ((w >> 2) & 0x33333333);
+	w = (w + (w >> 4)) & 0x0F0F0F0F;
+	return static_cast<int>((w * 0x01010101) >> 24);
+}
+
+/**
+Replaces every occurrence of one value in row i with another.
+
+@param i	The row
+@param from	The value to replace
+@param to	The value with which to replace it
+*/
+template <typename T>
+void VisTable<T>::replace_in_row(int i, const T& from, const T& to)
+{
+	const int toBits = static_cast<int>(to);
+	const int rowOffset = i * m_rowWords;
+	for(int w=0; w<m_rowWords; ++w)
+	{
+		Word mask = row_mask_word(i, w, from);
+		if(mask == 0) continue;
+
+		for(int b=0; b<BITS; ++b)
+		{
+			Word& word = m_planes[b][rowOffset + w];
+			if(toBits & (1 << b))	word |= mask;
+			else					word &= ~mask;
+		}
+	}
+}
+
+/**
+Returns the number of words needed to hold a bit mask for a single row of the table.
+*/
+template <typename T>
+int VisTable<T>::row_words() const
+{
+	return m_rowWords;
+}
+
+template <typename T>
+void VisTable<T>::set(int i, int j, const T& value)
+{
+	int offset = i * m_rowWords + j / WORD_BITS;
+	Word bit = Word(1) << (j % WORD_BITS);
+
+	const int valueBits = static_cast<int>(value);
+	for(int b=0; b<BITS; ++b)
+	{
+		if(valueBits & (1 << b))	m_planes[b][offset] |= bit;
+		else						m_planes[b][offset] &= ~bit;
+	}
+}
+
 template <typename T>
 int VisTable<T>::size() const
 {
-	return static_cast<int>(m_table.size());
+	return m_size;
+}
+
+//#################### PRIVATE METHODS ####################
+/**
+Returns a bit mask indicating which cells in word w of row i have the specified value.
+*/
+template <typename T>
+typename VisTable<T>::Word VisTable<T>::row_mask_word(int i, int w, const T& value) const
+{
+	const int valueBits = static_cast<int>(value);
+	const int offset = i * m_rowWords + w;
+
+	Word mask = w == m_rowWords - 1 ? m_lastWordMask : ~Word(0);
+	for(int b=0; b<BITS; ++b)
+	{
+		if(valueBits & (1 << b))	mask &= m_planes[b][offset];
+		else						mask &= ~m_planes[b][offset];
+	}
+	return mask;
 }
 
 }
@@ -5,6 +5,7 @@
 
 #include "GeomUtil.h"
 
+#include <algorithm>
 #include <set>
 
 #include "Sphere.h"
@@ -217,6 +218,23 @@ double displacement_from_plane(const Vector3d& p, const Plane& plane)
 	return n.dot(p) - d;
 }
 
+/**
+Calculates the squared distance from a point to the nearest point of a bounding box.
+
+@param p		The point
+@param bounds	The bounding box
+@return			The squared distance (0 if the point is inside the box)
+*/
+double distance_squared_to_bounding_box(const Vector3d& p, const AABB3d& bounds)
+{
+	const Vector3d& mins = bounds.minimum();
+	const Vector3d& maxs = bounds.maximum();
+	double dx = std::max(std::max(mins.x - p.x, p.x - maxs.x), 0.0);
+	double dy = std::max(std::max(mins.y - p.y, p.y - maxs.y), 0.0);
+	double dz = std::max(std::max(mins.z - p.z, p.z - maxs.z), 0.0);
+	return dx*dx + dy*dy + dz*dz;
+}
+
 /**
 Calculates the perpendicular distance between the point p and the plane.
 
@@ -43,7 +43,7 @@ template <typename Vert, typename AuxData>
 PlaneClassifier classify_polygon_against_plane(const Polygon<Vert,AuxData>& poly, const Plane& plane);
 
 template <typename Vert, typename AuxData>
-AABB3d construct_bounding_box(const std::vector<shared_ptr<Polygon<Vert,AuxData> > >& polys);
+AABB3d construct_bounding_box(const std::vector<shared_ptr<Polygon<Vert,AuxData> > >& polys, double padding = 0.0);
 
 template <typename T>
 boost::optional<std::pair<Vector3d,Vector3d> > determine_halfray_intersection_with_shape(const Vector3d& s, const Vector3d& v, const T& shape);
@@ -62,6 +62,8 @@ boost::optional<std::pair<double,double> > determine_ray_intersection_parameters
 
 double displacement_from_plane(const Vector3d& p, const Plane& plane);
 
+double distance_squared_to_bounding_box(const Vector3d& p, const AABB3d& bounds);
+
 double distance_to_plane(const Vector3d& p, const Plane& plane);
 
 std::list<Plane_CPtr> find_unique_planes(const std::list<Plane_CPtr>& planes);
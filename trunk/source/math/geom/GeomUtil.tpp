@@ -63,13 +63,16 @@ PlaneClassifier classify_polygon_against_plane(const Polygon<Vert,AuxData>& poly
 }
 
 /**
-Constructs a bounding box around an array of polygons.
+Constructs a bounding box around an array of polygons, optionally enlarged by a small padding on
+every side. Note that the bounds of a single axis-aligned polygon are only valid if padded, since
+they would otherwise have no extent along one of the axes.
 
 @param polys	The polygons
+@param padding	The distance by which to enlarge the box on every side
 @return			The bounding box
 */
 template <typename Vert, typename AuxData>
-AABB3d construct_bounding_box(const std::vector<shared_ptr<Polygon<Vert,AuxData> > >& polys)
+AABB3d construct_bounding_box(const std::vector<shared_ptr<Polygon<Vert,AuxData> > >& polys, double padding)
 {
 	Vector3d minimum(INT_MAX, INT_MAX, INT_MAX), maximum(INT_MIN, INT_MIN, INT_MIN);
 
@@ -86,7 +89,8 @@ AABB3d construct_bounding_box(const std::vector<shared_ptr<Polygon<Vert,AuxData>
 		}
 	}
 
-	return AABB3d(minimum, maximum);
+	Vector3d pad(padding, padding, padding);
+	return AABB3d(minimum - pad, maximum + pad);
 }
 
 /**
@@ -14,8 +14,8 @@
 namespace hesp {
 
 //#################### CONSTRUCTORS ####################
-Image24Texture::Image24Texture(const Image24_CPtr& image, bool clamp)
-:	Texture(clamp), m_image(image)
+Image24Texture::Image24Texture(const Image24_CPtr& image, bool clamp, bool mipmap)
+:	Texture(clamp, mipmap), m_image(image)
 {
 	reload();
 }
@@ -34,7 +34,8 @@ void Image24Texture::reload_image() const
 		pixels[i*3+1]	= p.g();
 		pixels[i*3+2]	= p.b();
 	}
-	gluBuild2DMipmaps(GL_TEXTURE_2D, 3, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+	if(m_mipmap) gluBuild2DMipmaps(GL_TEXTURE_2D, 3, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+	else glTexImage2D(GL_TEXTURE_2D, 0, 3, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
 }
 
 }
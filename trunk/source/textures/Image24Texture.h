@@ -29,7 +29,7 @@ private:
 
 	//#################### CONSTRUCTORS ####################
 protected:
-	Image24Texture(const Image24_CPtr& image, bool clamp);
+	Image24Texture(const Image24_CPtr& image, bool clamp, bool mipmap);
 
 	//#################### PROTECTED METHODS ####################
 protected:
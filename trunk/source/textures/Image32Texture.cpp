@@ -14,8 +14,8 @@
 namespace hesp {
 
 //#################### CONSTRUCTORS ####################
-Image32Texture::Image32Texture(const Image32_CPtr& image, bool clamp)
-:	Texture(clamp), m_image(image)
+Image32Texture::Image32Texture(const Image32_CPtr& image, bool clamp, bool mipmap)
+:	Texture(clamp, mipmap), m_image(image)
 {
 	reload();
 }
@@ -35,7 +35,8 @@ void Image32Texture::reload_image() const
 		pixels[i*4+2]	= p.b();
 		pixels[i*4+3]	= p.a();
 	}
-	gluBuild2DMipmaps(GL_TEXTURE_2D, 4, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	if(m_mipmap) gluBuild2DMipmaps(GL_TEXTURE_2D, 4, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	else glTexImage2D(GL_TEXTURE_2D, 0, 4, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
 }
 
 }
@@ -29,7 +29,7 @@ private:
 
 	//#################### CONSTRUCTORS ####################
 protected:
-	Image32Texture(const Image32_CPtr& image, bool clamp);
+	Image32Texture(const Image32_CPtr& image, bool clamp, bool mipmap);
 
 	//#################### PROTECTED METHODS ####################
 protected:
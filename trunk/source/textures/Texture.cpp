@@ -25,9 +25,10 @@ struct TextureDeleter
 Constructs an empty texture (the subclass constructor will initialise it).
 
 @param clamp	Whether or not the texture should be clamped to its edges (rather than wrapped)
+@param mipmap	Whether or not the texture should be mipmapped (and trilinearly filtered when minifying)
 */
-Texture::Texture(bool clamp)
-:	m_clamp(clamp)
+Texture::Texture(bool clamp, bool mipmap)
+:	m_clamp(clamp), m_mipmap(mipmap)
 {}
 
 //#################### DESTRUCTOR ####################
@@ -55,9 +56,9 @@ void Texture::reload() const
 
 	glBindTexture(GL_TEXTURE_2D, id);
 
-	// Enable trilinear filtering for this texture when minifying.
+	// Enable trilinear filtering for this texture when minifying (or just bilinear filtering if it isn't mipmapped).
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 
 	// Clamp the texture if necessary (useful for things like lightmaps, for example).
 	if(m_clamp)
@@ -22,11 +22,12 @@ class Texture
 	//#################### PROTECTED VARIABLES ####################
 protected:
 	bool m_clamp;
+	bool m_mipmap;
 	mutable shared_ptr<GLuint> m_id;
 
 	//#################### CONSTRUCTORS ####################
 protected:
-	explicit Texture(bool clamp);
+	Texture(bool clamp, bool mipmap);
 
 	//#################### DESTRUCTOR ####################
 public:
@@ -20,13 +20,14 @@ Creates a texture from a 24-bit image.
 
 @param image		The image from which to create the texture
 @param clamp		Whether or not we want to clamp the texture at the edges
+@param mipmap		Whether or not we want the texture to be mipmapped
 @return				The created texture
 */
-Texture_Ptr TextureFactory::create_texture24(const Image24_CPtr& image, bool clamp)
+Texture_Ptr TextureFactory::create_texture24(const Image24_CPtr& image, bool clamp, bool mipmap)
 {
 	int width = image->width(), height = image->height();
 	check_dimensions(width, height);
-	return Texture_Ptr(new Image24Texture(image, clamp));
+	return Texture_Ptr(new Image24Texture(image, clamp, mipmap));
 }
 
 /**
@@ -34,13 +35,14 @@ Creates a texture from a 32-bit image.
 
 @param image		The image from which to create the texture
 @param clamp		Whether or not we want to clamp the texture at the edges
+@param mipmap		Whether or not we want the texture to be mipmapped
 @return				The created texture
 */
-Texture_Ptr TextureFactory::create_texture32(const Image32_CPtr& image, bool clamp)
+Texture_Ptr TextureFactory::create_texture32(const Image32_CPtr& image, bool clamp, bool mipmap)
 {
 	int width = image->width(), height = image->height();
 	check_dimensions(width, height);
-	return Texture_Ptr(new Image32Texture(image, clamp));
+	return Texture_Ptr(new Image32Texture(image, clamp, mipmap));
 }
 
 //#################### PRIVATE METHODS ####################
@@ -17,8 +17,8 @@ class TextureFactory
 {
 	//#################### PUBLIC METHODS ####################
 public:
-	static Texture_Ptr create_texture24(const Image24_CPtr& image, bool clamp = false);
-	static Texture_Ptr create_texture32(const Image32_CPtr& image, bool clamp = false);
+	static Texture_Ptr create_texture24(const Image24_CPtr& image, bool clamp = false, bool mipmap = true);
+	static Texture_Ptr create_texture32(const Image32_CPtr& image, bool clamp = false, bool mipmap = true);
 
 	//#################### PRIVATE METHODS ####################
 private:
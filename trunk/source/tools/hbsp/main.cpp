@@ -28,12 +28,21 @@ void quit_with_error(const std::string& error)
 
 void quit_with_usage()
 {
-	std::cout << "Usage: hbsp {-r|-c} <input geometry> {<input hints>|nohints} <output tree> [-w<number>]" << std::endl;
+	std::cout << "Usage: hbsp {-r|-c} <input geometry> {<input hints>|nohints} <output tree> [-w<number>] [-t<threads>] [-q{exact|normal|fast}]" << std::endl;
 	exit(EXIT_FAILURE);
 }
 
+SplitQuality parse_quality(const std::string& s)
+{
+	if(s == "exact") return SQ_EXACT;
+	else if(s == "normal") return SQ_NORMAL;
+	else if(s == "fast") return SQ_FAST;
+	else quit_with_usage();
+	return SQ_EXACT;	// never reached, but keeps the compiler happy
+}
+
 template <typename Poly>
-void run_compiler(const std::string& inputGeometryFilename, const std::string& hintGeometryFilename, const std::string& outputTreeFilename, double weight)
+void run_compiler(const std::string& inputGeometryFilename, const std::string& hintGeometryFilename, const std::string& outputTreeFilename, double weight, int threadCount, SplitQuality quality)
 {
 	typedef shared_ptr<Poly> Poly_Ptr;
 	typedef std::vector<Poly_Ptr> PolyVector;
@@ -47,7 +56,7 @@ void run_compiler(const std::string& inputGeometryFilename, const std::string& h
 	if(hintGeometryFilename != "nohints") GeometryFile::load(hintGeometryFilename, hintPolygons);
 
 	// Build the BSP tree.
-	BSPCompiler<Poly> compiler(polygons, hintPolygons, weight);
+	BSPCompiler<Poly> compiler(polygons, hintPolygons, weight, threadCount, quality);
 	compiler.build_tree();
 
 	// Save the polygons and the BSP tree to the output file.
@@ -57,7 +66,7 @@ void run_compiler(const std::string& inputGeometryFilename, const std::string& h
 int main(int argc, char *argv[])
 try
 {
-	if(argc != 5 && argc != 6) quit_with_usage();
+	if(argc < 5 || argc > 8) quit_with_usage();
 
 	const std::vector<std::string> args(argv, argv+argc);
 
@@ -66,16 +75,30 @@ try
 	std::string outputTreeFilename = args[4];
 
 	double weight = 4;
-	if(argc == 6)
+	int threadCount = 1;
+	SplitQuality quality = SQ_EXACT;
+	for(int i=5; i<argc; ++i)
 	{
-		if(args[5].substr(0,2) != "-w") quit_with_usage();
-
-		try							{ weight = lexical_cast<double,std::string>(args[5].substr(2)); }
-		catch(bad_lexical_cast&)	{ quit_with_usage(); }
+		if(args[i].substr(0,2) == "-w")
+		{
+			try							{ weight = lexical_cast<double,std::string>(args[i].substr(2)); }
+			catch(bad_lexical_cast&)	{ quit_with_usage(); }
+		}
+		else if(args[i].substr(0,2) == "-t")
+		{
+			try							{ threadCount = lexical_cast<int,std::string>(args[i].substr(2)); }
+			catch(bad_lexical_cast&)	{ quit_with_usage(); }
+			if(threadCount < 1) quit_with_usage();
+		}
+		else if(args[i].substr(0,2) == "-q")
+		{
+			quality = parse_quality(args[i].substr(2));
+		}
+		else quit_with_usage();
 	}
 
-	if(args[1] == "-r") run_compiler<TexturedPolygon>(inputGeometryFilename, hintGeometryFilename, outputTreeFilename, weight);
-	else if(args[1] == "-c") run_compiler<CollisionPolygon>(inputGeometryFilename, hintGeometryFilename, outputTreeFilename, weight);
+	if(args[1] == "-r") run_compiler<TexturedPolygon>(inputGeometryFilename, hintGeometryFilename, outputTreeFilename, weight, threadCount, quality);
+	else if(args[1] == "-c") run_compiler<CollisionPolygon>(inputGeometryFilename, hintGeometryFilename, outputTreeFilename, weight, threadCount, quality);
 	else quit_with_usage();
 
 	return 0;
@@ -3,6 +3,7 @@
  * Copyright Stuart Golodetz, 2009. All rights reserved.
  ***/
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -50,22 +51,24 @@ void quit_with_error(const std::string& error)
 
 void quit_with_usage()
 {
-	std::cout << "Usage: hcollate {+L <input lit tree> | -L <input tree>} <input portals> <input vis> <input onion tree> <input onion portals> <input nav data> <input definitions specifier file> <input objects> <output filename>" << std::endl;
+	std::cout << "Usage: hcollate [-binary] {+L <input lit tree> | -L <input tree>} <input portals> <input vis> <input onion tree> <input onion portals> <input nav data> <input definitions specifier file> <input objects> <output filename>" << std::endl;
+	std::cout << "   or: hcollate -convert <input text level> <output binary level>" << std::endl;
 	exit(EXIT_FAILURE);
 }
 
 void collate_lit(const std::string& treeFilename, const std::string& portalsFilename, const std::string& visFilename,
 				 const std::string& onionTreeFilename, const std::string& onionPortalsFilename,
 				 const std::string& navFilename, const std::string& definitionsSpecifierFilename,
-				 const std::string& objectsFilename, const std::string& outputFilename)
+				 const std::string& objectsFilename, const std::string& outputFilename, bool binary)
 try
 {
-	// Load the lit polygons, tree and lightmap prefix.
+	// Load the lit polygons, tree, lightmap prefix and lightmap indices.
 	typedef std::vector<TexturedLitPolygon_Ptr> TexLitPolyVector;
 	TexLitPolyVector polygons;
 	BSPTree_Ptr tree;
 	std::string lightmapPrefix;
-	LitTreeFile::load(treeFilename, polygons, tree, lightmapPrefix);
+	std::vector<int> lightmapIndices;
+	LitTreeFile::load(treeFilename, polygons, tree, lightmapPrefix, lightmapIndices);
 
 	// Load the portals.
 	int emptyLeafCount;
@@ -75,10 +78,10 @@ try
 	// Load the vis table.
 	LeafVisTable_Ptr leafVis = VisFile::load(visFilename);
 
-	// Load the lightmaps.
-	int polyCount = static_cast<int>(polygons.size());
-	std::vector<Image24_Ptr> lightmaps(polyCount);
-	for(int i=0; i<polyCount; ++i)
+	// Load the lightmaps (atlas pages).
+	int lightmapCount = lightmapIndices.empty() ? 0 : *std::max_element(lightmapIndices.begin(), lightmapIndices.end()) + 1;
+	std::vector<Image24_Ptr> lightmaps(lightmapCount);
+	for(int i=0; i<lightmapCount; ++i)
 	{
 		std::string filename = lightmapPrefix + lexical_cast<std::string,int>(i) + ".png";
 		lightmaps[i] = PNGLoader::load_image24(filename);
@@ -114,19 +117,20 @@ try
 						polygons, tree,
 						portals,
 						leafVis,
-						lightmaps,
+						lightmaps, lightmapIndices,
 						onionPolygons, onionTree,
 						onionPortals,
 						navManager,
 						definitionsFilename,
-						objectManager);
+						objectManager,
+						binary);
 }
 catch(Exception& e) { quit_with_error(e.cause()); }
 
 void collate_unlit(const std::string& treeFilename, const std::string& portalsFilename, const std::string& visFilename,
 				   const std::string& onionTreeFilename, const std::string& onionPortalsFilename,
 				   const std::string& navFilename, const std::string& definitionsSpecifierFilename,
-				   const std::string& objectsFilename, const std::string& outputFilename)
+				   const std::string& objectsFilename, const std::string& outputFilename, bool binary)
 try
 {
 	// Load the unlit polygons and tree.
@@ -177,17 +181,39 @@ try
 						  onionPortals,
 						  navManager,
 						  definitionsFilename,
-						  objectManager);
+						  objectManager,
+						  binary);
+}
+catch(Exception& e) { quit_with_error(e.cause()); }
+
+void convert(const std::string& inputFilename, const std::string& outputFilename)
+try
+{
+	LevelFile::convert_to_binary(inputFilename, outputFilename);
 }
 catch(Exception& e) { quit_with_error(e.cause()); }
 
 int main(int argc, char *argv[])
 {
-	if(argc != 11) quit_with_usage();
 	std::vector<std::string> args(argv, argv + argc);
 
-	if(args[1] == "+L") collate_lit(args[2], args[3], args[4], args[5], args[6], args[7], args[8], args[9], args[10]);
-	else if(args[1] == "-L") collate_unlit(args[2], args[3], args[4], args[5], args[6], args[7], args[8], args[9], args[10]);
+	if(argc == 4 && args[1] == "-convert")
+	{
+		convert(args[2], args[3]);
+		return 0;
+	}
+
+	bool binary = false;
+	if(argc > 1 && args[1] == "-binary")
+	{
+		binary = true;
+		args.erase(args.begin() + 1);
+	}
+
+	if(args.size() != 11) quit_with_usage();
+
+	if(args[1] == "+L") collate_lit(args[2], args[3], args[4], args[5], args[6], args[7], args[8], args[9], args[10], binary);
+	else if(args[1] == "-L") collate_unlit(args[2], args[3], args[4], args[5], args[6], args[7], args[8], args[9], args[10], binary);
 	else quit_with_usage();
 
 	return 0;
@@ -3,6 +3,7 @@
  * Copyright Stuart Golodetz, 2008. All rights reserved.
  ***/
 
+#include <climits>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -18,6 +19,8 @@ using boost::lexical_cast;
 #include <source/io/files/TreeFile.h>
 #include <source/io/files/VisFile.h>
 #include <source/level/lighting/Lightmap.h>
+#include <source/level/lighting/LightmapAtlas.h>
+#include <source/level/lighting/LightmapCache.h>
 #include <source/level/lighting/LightmapGenerator.h>
 #include <source/util/PolygonTypes.h>
 using namespace hesp;
@@ -31,12 +34,13 @@ void quit_with_error(const std::string& error)
 
 void quit_with_usage()
 {
-	std::cout << "Usage: hlight <input tree> <input vis> <input lights> <lightmap file prefix> <output filename>" << std::endl;
+	std::cout << "Usage: hlight <input tree> <input vis> <input lights> <lightmap file prefix> <output filename> [-t<threads>] [-c<attenuation cutoff>] [-k<cache directory>] [-b<lightmap budget in KB>] [-r<radiosity convergence>] [-s<radiosity time budget in seconds>]" << std::endl;
 	exit(EXIT_FAILURE);
 }
 
 void run_generator(const std::string& treeFilename, const std::string& visFilename, const std::string& lightsFilename,
-				   const std::string& lightmapPrefix, const std::string& outputFilename)
+				   const std::string& lightmapPrefix, const std::string& outputFilename, int threadCount, double attenuationCutoff,
+				   const std::string& cacheDirectory, int lumelBudget, double radiosityConvergence, double radiosityTimeBudget)
 try		// <--- Note the "function try" syntax (this is a rarely-used C++ construct).
 {
 	// Read in the polygons and tree.
@@ -50,8 +54,11 @@ try		// <--- Note the "function try" syntax (this is a rarely-used C++ construct
 	// Read in the lights.
 	std::vector<Light> lights = LightsFile::load(lightsFilename);
 
-	// Generate the lit polygons and lightmaps.
-	LightmapGenerator lg(polygons, lights, tree, leafVis);
+	// Generate the lit polygons and lightmaps (reusing the cached contributions of any unchanged lights, choosing
+	// the lightmap resolutions adaptively if there's a lightmap budget, and adding indirect light if requested).
+	LightmapCache_Ptr cache;
+	if(cacheDirectory != "") cache.reset(new LightmapCache(cacheDirectory));
+	LightmapGenerator lg(polygons, lights, tree, leafVis, threadCount, attenuationCutoff, cache, lumelBudget, radiosityConvergence, radiosityTimeBudget);
 	lg.generate_lightmaps();
 
 	typedef std::vector<Lightmap_Ptr> LightmapVector;
@@ -59,18 +66,22 @@ try		// <--- Note the "function try" syntax (this is a rarely-used C++ construct
 	typedef std::vector<TexturedLitPolygon_Ptr> TexLitPolyVector;
 	typedef shared_ptr<const TexLitPolyVector> TexLitPolyVector_CPtr;
 
-	TexLitPolyVector_CPtr litPolygons = lg.lit_polygons();
-	LightmapVector_CPtr lightmaps = lg.lightmaps();
+	// Pack the lightmaps into atlas pages.
+	LightmapAtlas atlas(*lg.lit_polygons(), *lg.lightmaps());
+	atlas.build();
 
-	// Write the lit polygons, tree and lightmap prefix to the output file.
-	LitTreeFile::save(outputFilename, *litPolygons, tree, lightmapPrefix);
+	TexLitPolyVector_CPtr litPolygons = atlas.lit_polygons();
+	LightmapVector_CPtr pages = atlas.pages();
 
-	// Write the lightmaps out as 24-bit bitmaps.
-	int lightmapCount = static_cast<int>(lightmaps->size());
-	for(int i=0; i<lightmapCount; ++i)
+	// Write the lit polygons, tree, lightmap prefix and lightmap indices to the output file.
+	LitTreeFile::save(outputFilename, *litPolygons, tree, lightmapPrefix, atlas.lightmap_indices());
+
+	// Write the atlas pages out as 24-bit bitmaps.
+	int pageCount = static_cast<int>(pages->size());
+	for(int i=0; i<pageCount; ++i)
 	{
 		std::string lightmapFilename = lightmapPrefix + lexical_cast<std::string,int>(i) + ".png";
-		Image24_Ptr image = (*lightmaps)[i]->to_image();
+		Image24_Ptr image = (*pages)[i]->to_image();
 		PNGSaver::save_image24(lightmapFilename, image);
 	}
 }
@@ -78,8 +89,70 @@ catch(Exception& e) { quit_with_error(e.cause()); }
 
 int main(int argc, char *argv[])
 {
-	if(argc != 6) quit_with_usage();
+	if(argc < 6 || argc > 12) quit_with_usage();
 	std::vector<std::string> args(argv, argv + argc);
-	run_generator(args[1], args[2], args[3], args[4], args[5]);
+
+	int threadCount = 1;
+
+	// By default, no light contributions are skipped, however weak (-c can be used to skip those which would
+	// be below the specified intensity everywhere on a polygon, e.g. 0.002 for about half a step of an 8-bit
+	// lightmap channel).
+	double attenuationCutoff = 0.0;
+
+	std::string cacheDirectory;
+
+	// By default, there's no lightmap budget (the lightmap resolutions then depend only on the polygon sizes).
+	int lumelBudget = 0;
+
+	// By default, there's no radiosity pass (and if there is one, it runs until it converges).
+	double radiosityConvergence = 0.0;
+	double radiosityTimeBudget = 0.0;
+
+	for(int i=6; i<argc; ++i)
+	{
+		if(args[i].substr(0,2) == "-t")
+		{
+			try							{ threadCount = lexical_cast<int,std::string>(args[i].substr(2)); }
+			catch(bad_lexical_cast&)	{ quit_with_usage(); }
+			if(threadCount < 1) quit_with_usage();
+		}
+		else if(args[i].substr(0,2) == "-c")
+		{
+			try							{ attenuationCutoff = lexical_cast<double,std::string>(args[i].substr(2)); }
+			catch(bad_lexical_cast&)	{ quit_with_usage(); }
+			if(attenuationCutoff < 0) quit_with_usage();
+		}
+		else if(args[i].substr(0,2) == "-k")
+		{
+			cacheDirectory = args[i].substr(2);
+			if(cacheDirectory == "") quit_with_usage();
+		}
+		else if(args[i].substr(0,2) == "-b")
+		{
+			int budgetKB = 0;
+			try							{ budgetKB = lexical_cast<int,std::string>(args[i].substr(2)); }
+			catch(bad_lexical_cast&)	{ quit_with_usage(); }
+			if(budgetKB <= 0 || budgetKB > INT_MAX / 1024) quit_with_usage();
+
+			// The lightmap atlas pages are stored as 24-bit images, so each lumel takes up 3 bytes. (The budget
+			// covers the whole of each page, including the lightmap borders and any unused space.)
+			lumelBudget = budgetKB * 1024 / 3;
+		}
+		else if(args[i].substr(0,2) == "-r")
+		{
+			try							{ radiosityConvergence = lexical_cast<double,std::string>(args[i].substr(2)); }
+			catch(bad_lexical_cast&)	{ quit_with_usage(); }
+			if(radiosityConvergence <= 0 || radiosityConvergence >= 1) quit_with_usage();
+		}
+		else if(args[i].substr(0,2) == "-s")
+		{
+			try							{ radiosityTimeBudget = lexical_cast<double,std::string>(args[i].substr(2)); }
+			catch(bad_lexical_cast&)	{ quit_with_usage(); }
+			if(radiosityTimeBudget <= 0) quit_with_usage();
+		}
+		else quit_with_usage();
+	}
+
+	run_generator(args[1], args[2], args[3], args[4], args[5], threadCount, attenuationCutoff, cacheDirectory, lumelBudget, radiosityConvergence, radiosityTimeBudget);
 	return 0;
 }
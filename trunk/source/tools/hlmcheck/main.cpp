@@ -0,0 +1,274 @@
+/***
+ * hlmcheck: main.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <source/exceptions/Exception.h>
+#include <source/images/PixelTypes.h>
+#include <source/images/PNGLoader.h>
+#include <source/images/SimpleImage.h>
+#include <source/io/sections/LightmapsSection.h>
+#include <source/io/util/LineIO.h>
+using namespace hesp;
+
+//#################### CONSTANTS ####################
+// The maximum difference allowed between a channel of an original lightmap and the same channel after a round trip.
+// (PNG is lossless, and so is the palettised encoding for lightmaps with at most 256 colours, so those round trips
+// must be exact. The error for lightmaps with more colours is reported, but not checked.)
+const int CHANNEL_TOLERANCE = 0;
+const int MAX_PALETTE_SIZE = 256;
+
+//#################### FUNCTIONS ####################
+void quit_with_error(const std::string& error)
+{
+	std::cout << "Error: " << error << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+void quit_with_usage()
+{
+	std::cout << "Usage: hlmcheck [-level <input text level>] [<input lightmap PNG> ...]" << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+/**
+Loads the lightmaps from the Lightmaps section of a lit level stored in text form.
+
+@param filename		The name of the level file
+@return				The lightmaps
+@throws Exception	If the file could not be read, or has no Lightmaps section
+*/
+std::vector<Image24_Ptr> load_level_lightmaps(const std::string& filename)
+{
+	std::ifstream is(filename.c_str(), std::ios_base::binary);
+	if(is.fail()) throw Exception("Could not open " + filename + " for reading");
+
+	// Skip the sections before the Lightmaps section, and then rewind to the start of its header.
+	std::string line;
+	std::streampos sectionStart = is.tellg();
+	for(;;)
+	{
+		LineIO::read_line(is, line, "section header");
+		if(line == "Lightmaps") break;
+		sectionStart = is.tellg();
+	}
+	is.seekg(sectionStart);
+
+	std::vector<int> lightmapIndices;
+	return LightmapsSection::load(is, lightmapIndices);
+}
+
+/**
+Makes a set of synthetic lightmap pages of various sizes, covering flat, smoothly-varying
+and noisy lighting (the latter being the worst case for PNG).
+*/
+std::vector<Image24_Ptr> make_synthetic_pages()
+{
+	std::vector<Image24_Ptr> pages;
+	srand(0);
+	for(int size=2; size<=512; size*=2)
+	{
+		for(int pattern=0; pattern<3; ++pattern)
+		{
+			shared_ptr<SimpleImage24> page(new SimpleImage24(size, size));
+			for(int y=0; y<size; ++y)
+				for(int x=0; x<size; ++x)
+				{
+					switch(pattern)
+					{
+						case 0:		page->set(x, y, Pixel24(64, 96, 128)); break;
+						case 1:		page->set(x, y, Pixel24(x * 255 / size, y * 255 / size, (x + y) * 127 / size)); break;
+						default:	page->set(x, y, Pixel24(rand() % 256, rand() % 256, rand() % 256)); break;
+					}
+				}
+			pages.push_back(page);
+		}
+	}
+	return pages;
+}
+
+/**
+Returns the number of distinct colours in a lightmap page.
+
+@param page	The page
+@return		As stated
+*/
+int distinct_colour_count(const Image24& page)
+{
+	int pixelCount = page.width() * page.height();
+	std::vector<int> colours(pixelCount);
+	for(int j=0; j<pixelCount; ++j)
+	{
+		const Pixel24& p = page(j);
+		colours[j] = (p.r() << 16) | (p.g() << 8) | p.b();
+	}
+	std::sort(colours.begin(), colours.end());
+	return static_cast<int>(std::unique(colours.begin(), colours.end()) - colours.begin());
+}
+
+/**
+Returns the largest difference between corresponding channels of two lightmap pages, and adds
+the differences to a running total.
+
+@param lhs			The first page
+@param rhs			The second page
+@param totalError	The running total of the channel differences
+@return				The largest difference, or INT_MAX if the pages differ in size
+*/
+int max_channel_error(const Image24& lhs, const Image24& rhs, double& totalError)
+{
+	if(lhs.width() != rhs.width() || lhs.height() != rhs.height()) return INT_MAX;
+
+	int maxError = 0;
+	int pixelCount = lhs.width() * lhs.height();
+	for(int j=0; j<pixelCount; ++j)
+	{
+		const Pixel24& p = lhs(j);
+		const Pixel24& q = rhs(j);
+		int errors[] = { abs(p.r() - q.r()), abs(p.g() - q.g()), abs(p.b() - q.b()) };
+		for(int k=0; k<3; ++k)
+		{
+			maxError = std::max(maxError, errors[k]);
+			totalError += errors[k];
+		}
+	}
+	return maxError;
+}
+
+/**
+Checks that the largest channel difference between two sets of lightmap pages is within CHANNEL_TOLERANCE.
+If lossyAllowed is set, pages with more than MAX_PALETTE_SIZE colours in the first set are exempt from the
+check, and the largest and mean channel differences for them are reported separately.
+
+@param lhs			The first set of pages
+@param rhs			The second set of pages
+@param what			A description of the comparison (for reporting purposes)
+@param lossyAllowed	Whether pages with too many colours for a palette may differ
+@return				true, if the pages are within tolerance, or false otherwise
+*/
+bool check_equivalent(const std::vector<Image24_Ptr>& lhs, const std::vector<Image24_Ptr>& rhs, const std::string& what, bool lossyAllowed)
+{
+	std::cout << what << ": ";
+	if(lhs.size() != rhs.size())
+	{
+		std::cout << "page counts differ (FAILED)" << std::endl;
+		return false;
+	}
+
+	int maxError = 0, maxLossyError = 0, lossyPageCount = 0;
+	double totalError = 0, totalLossyError = 0, lossyChannelCount = 0;
+	for(size_t i=0, size=lhs.size(); i<size; ++i)
+	{
+		if(lossyAllowed && distinct_colour_count(*lhs[i]) > MAX_PALETTE_SIZE)
+		{
+			maxLossyError = std::max(maxLossyError, max_channel_error(*lhs[i], *rhs[i], totalLossyError));
+			lossyChannelCount += lhs[i]->width() * lhs[i]->height() * 3.0;
+			++lossyPageCount;
+		}
+		else maxError = std::max(maxError, max_channel_error(*lhs[i], *rhs[i], totalError));
+	}
+
+	bool ok = maxError <= CHANNEL_TOLERANCE && maxLossyError != INT_MAX;
+	if(maxError == INT_MAX || maxLossyError == INT_MAX) std::cout << "pages differ in size";
+	else std::cout << "maximum channel error " << maxError;
+	std::cout << " (" << (ok ? "ok" : "FAILED") << ')';
+	if(lossyPageCount > 0 && maxLossyError != INT_MAX)
+	{
+		std::cout << "; " << lossyPageCount << " pages with more than " << MAX_PALETTE_SIZE << " colours: maximum channel error "
+				  << maxLossyError << ", mean channel error " << totalLossyError / lossyChannelCount;
+	}
+	std::cout << std::endl;
+	return ok;
+}
+
+/**
+Saves the pages as a Lightmaps section using the specified encoding and loads them back in,
+reporting the size of the section and the time taken to load it.
+
+@param pages		The pages
+@param encoding		The encoding to use
+@param name			The name of the encoding (for reporting purposes)
+@return				The loaded pages
+@throws Exception	If the section could not be loaded, or its lightmap indices were not preserved
+*/
+std::vector<Image24_Ptr> round_trip(const std::vector<Image24_Ptr>& pages, LightmapsSection::Encoding encoding, const std::string& name)
+{
+	using namespace boost::posix_time;
+
+	int pageCount = static_cast<int>(pages.size());
+	std::vector<int> lightmapIndices(pageCount);
+	for(int i=0; i<pageCount; ++i) lightmapIndices[i] = i;
+
+	std::ostringstream os;
+	LightmapsSection::save(os, pages, lightmapIndices, encoding);
+	std::string data = os.str();
+
+	std::istringstream is(data);
+	std::vector<int> loadedIndices;
+	ptime startTime = microsec_clock::universal_time();
+	std::vector<Image24_Ptr> loadedPages = LightmapsSection::load(is, loadedIndices);
+	long loadMicroseconds = static_cast<long>((microsec_clock::universal_time() - startTime).total_microseconds());
+	if(loadedIndices != lightmapIndices) throw Exception("The lightmap indices were not preserved by the " + name + " encoding");
+
+	std::cout << name << ": " << data.size() << " bytes, loaded in " << loadMicroseconds << " microseconds" << std::endl;
+	return loadedPages;
+}
+
+int main(int argc, char *argv[])
+try
+{
+	std::vector<std::string> args(argv, argv + argc);
+
+	// Check the synthetic pages, and then any pages specified on the command line.
+	std::vector<std::vector<Image24_Ptr> > pageSets;
+	std::vector<std::string> pageSetNames;
+	pageSets.push_back(make_synthetic_pages());
+	pageSetNames.push_back("synthetic pages");
+
+	std::vector<Image24_Ptr> inputPages;
+	for(int i=1; i<argc; ++i)
+	{
+		if(args[i] == "-level" && i+1 < argc)
+		{
+			pageSets.push_back(load_level_lightmaps(args[++i]));
+			pageSetNames.push_back("lightmaps from " + args[i]);
+		}
+		else if(args[i][0] == '-') quit_with_usage();
+		else inputPages.push_back(PNGLoader::load_image24(args[i]));
+	}
+
+	if(!inputPages.empty())
+	{
+		pageSets.push_back(inputPages);
+		pageSetNames.push_back("input pages");
+	}
+
+	bool ok = true;
+	for(size_t i=0, size=pageSets.size(); i<size; ++i)
+	{
+		const std::vector<Image24_Ptr>& pages = pageSets[i];
+		std::cout << "Checking " << pages.size() << ' ' << pageSetNames[i] << "..." << std::endl;
+
+		std::vector<Image24_Ptr> pngPages = round_trip(pages, LightmapsSection::ENCODING_PNG, "PNG");
+		std::vector<Image24_Ptr> palettePages = round_trip(pages, LightmapsSection::ENCODING_PALETTE, "Palette");
+
+		ok = check_equivalent(pages, pngPages, "Original vs PNG", false) && ok;
+		ok = check_equivalent(pages, palettePages, "Original vs Palette", true) && ok;
+	}
+
+	if(!ok) quit_with_error("Some lightmaps did not survive the round trip");
+	std::cout << "All lightmaps survived the round trip" << std::endl;
+	return 0;
+}
+catch(Exception& e) { quit_with_error(e.cause()); }
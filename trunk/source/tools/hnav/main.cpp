@@ -3,12 +3,18 @@
  * Copyright Stuart Golodetz, 2009. All rights reserved.
  ***/
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include <boost/bind.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
 namespace bf = boost::filesystem;
+using boost::bad_lexical_cast;
+using boost::lexical_cast;
 
 #include <source/exceptions/Exception.h>
 #include <source/io/files/DefinitionsFile.h>
@@ -19,11 +25,13 @@ namespace bf = boost::filesystem;
 #include <source/level/bounds/Bounds.h>
 #include <source/level/bounds/BoundsManager.h>
 #include <source/level/nav/AdjacencyList.h>
-#include <source/level/nav/AdjacencyTable.h>
 #include <source/level/nav/NavDataset.h>
+#include <source/level/nav/NavLeafIndex.h>
 #include <source/level/nav/NavManager.h>
+#include <source/level/nav/NavMesh.h>
 #include <source/level/nav/NavMeshGenerator.h>
 #include <source/level/nav/PathTableGenerator.h>
+#include <source/level/trees/OnionTree.h>
 #include <source/util/PolygonTypes.h>
 using namespace hesp;
 
@@ -36,6 +44,9 @@ boost::filesystem::path determine_base_directory()
 
 }
 
+//#################### TYPEDEFS ####################
+typedef std::vector<CollisionPolygon_Ptr> ColPolyVector;
+
 //#################### FUNCTIONS ####################
 void quit_with_error(const std::string& error)
 {
@@ -45,14 +56,77 @@ void quit_with_error(const std::string& error)
 
 void quit_with_usage()
 {
-	std::cout << "Usage: hnav <input definitions specifier> <input onion tree> <output navmesh stem>" << std::endl;
+	std::cout << "Usage: hnav <input definitions specifier> <input onion tree> <output navmesh stem> [-t<threads>]" << std::endl;
 	exit(EXIT_FAILURE);
 }
 
-void run(const std::string& definitionsSpecifierFilename, const std::string& treeFilename, const std::string& outputFilename)
+/**
+Generates the navigation dataset for a single map, catching any exception so that this can safely be run on a separate thread.
+
+@param polygons				The collision polygons for the whole level
+@param tree					The onion tree for the level
+@param mapIndex				The index of the map
+@param maxHeightDifference	The maximum distance that the character can step up/down in the map
+@param threadCount			The number of threads to use when generating the path table
+@param dataset				Used to return the navigation dataset
+@param error				Used to return the cause of any exception thrown
+*/
+void generate_dataset(const ColPolyVector& polygons, const OnionTree_CPtr& tree, int mapIndex, double maxHeightDifference, int threadCount, NavDataset_Ptr& dataset, std::string& error)
+try
+{
+	// Make a copy of the polygon array in which all the polygons that aren't
+	// in this map are set to non-walkable.
+	int polyCount = static_cast<int>(polygons.size());
+	ColPolyVector mapPolygons(polyCount);
+	for(int j=0; j<polyCount; ++j)
+	{
+		mapPolygons[j].reset(new CollisionPolygon(*polygons[j]));
+		if(mapPolygons[j]->auxiliary_data().map_index() != mapIndex)
+			mapPolygons[j]->auxiliary_data().set_walkable(false);
+	}
+
+	// Generate the navigation mesh.
+	NavMeshGenerator generator(mapPolygons, maxHeightDifference);
+	NavMesh_Ptr mesh = generator.generate_mesh();
+
+	// Index the nav polygons by the leaves of the tree in which they lie.
+	mesh->set_leaf_index(NavLeafIndex_Ptr(new NavLeafIndex(polygons, tree, mesh)));
+
+	// Build the navigation graph adjacency list.
+	AdjacencyList_Ptr adjList(new AdjacencyList(mesh));
+
+	// Generate the path table.
+	PathTable_Ptr pathTable = PathTableGenerator::dijkstra(*adjList, threadCount);
+
+	dataset.reset(new NavDataset(adjList, mesh, pathTable));
+}
+catch(Exception& e) { error = e.cause(); }
+
+/**
+Generates the navigation datasets for the maps firstJob, firstJob + jobStep, etc. in the job list.
+
+@param polygons					The collision polygons for the whole level
+@param tree						The onion tree for the level
+@param mapIndices				The indices of the maps for which to generate datasets
+@param maxHeightDifferences		The maximum step up/down distances for the maps
+@param firstJob					The first job
+@param jobStep					The step between successive jobs
+@param threadCount				The number of threads to use when generating each path table
+@param datasets					Used to return the navigation datasets
+@param errors					Used to return the causes of any exceptions thrown
+*/
+void generate_datasets_worker(const ColPolyVector& polygons, const OnionTree_CPtr& tree, const std::vector<int>& mapIndices, const std::vector<double>& maxHeightDifferences,
+							  int firstJob, int jobStep, int threadCount, std::vector<NavDataset_Ptr>& datasets, std::vector<std::string>& errors)
 {
-	typedef std::vector<CollisionPolygon_Ptr> ColPolyVector;
+	int jobCount = static_cast<int>(mapIndices.size());
+	for(int i=firstJob; i<jobCount; i+=jobStep)
+	{
+		generate_dataset(polygons, tree, mapIndices[i], maxHeightDifferences[i], threadCount, datasets[i], errors[i]);
+	}
+}
 
+void run(const std::string& definitionsSpecifierFilename, const std::string& treeFilename, const std::string& outputFilename, int threadCount)
+{
 	// Read in the definitions specifier.
 	std::string definitionsFilename = DefinitionsSpecifierFile::load(definitionsSpecifierFilename);
 
@@ -70,42 +144,43 @@ void run(const std::string& definitionsSpecifierFilename, const std::string& tre
 	int mapCount = tree->map_count();
 	if(boundsCount != mapCount) throw Exception("There must be exactly one bounds per map in the onion tree");
 
-	NavManager_Ptr navManager(new NavManager);
-
-	// For each separate map.
+	// Determine the maps for which we need to generate navigation datasets (those whose bounds have their nav flag set).
+	std::vector<int> mapIndices;
+	std::vector<double> maxHeightDifferences;
 	for(int i=0; i<mapCount; ++i)
 	{
-		// Skip this map if the bounds for it has its nav flag set to false.
 		if(!boundsManager->nav_flags()[i]) continue;
+		mapIndices.push_back(i);
+		maxHeightDifferences.push_back(boundsManager->bounds(i)->height() / 2);
+	}
 
-		// Make a copy of the polygon array in which all the polygons that aren't
-		// in this map are set to non-walkable.
-		int polyCount = static_cast<int>(polygons.size());
-		ColPolyVector mapPolygons(polyCount);
-		for(int j=0; j<polyCount; ++j)
+	// Generate the datasets. The maps are independent, so they can be processed in parallel:
+	// any threads left over once each map has one are used to generate the path tables.
+	int jobCount = static_cast<int>(mapIndices.size());
+	std::vector<NavDataset_Ptr> datasets(jobCount);
+	std::vector<std::string> errors(jobCount);
+	int mapThreadCount = std::max(std::min(threadCount, jobCount), 1);
+	int pathTableThreadCount = std::max(threadCount / mapThreadCount, 1);
+	if(mapThreadCount == 1)
+	{
+		generate_datasets_worker(polygons, tree, mapIndices, maxHeightDifferences, 0, 1, pathTableThreadCount, datasets, errors);
+	}
+	else
+	{
+		boost::thread_group workers;
+		for(int i=0; i<mapThreadCount; ++i)
 		{
-			mapPolygons[j].reset(new CollisionPolygon(*polygons[j]));
-			if(mapPolygons[j]->auxiliary_data().map_index() != i)
-				mapPolygons[j]->auxiliary_data().set_walkable(false);
+			workers.create_thread(boost::bind(&generate_datasets_worker, boost::cref(polygons), boost::cref(tree), boost::cref(mapIndices), boost::cref(maxHeightDifferences),
+											  i, mapThreadCount, pathTableThreadCount, boost::ref(datasets), boost::ref(errors)));
 		}
+		workers.join_all();
+	}
 
-		// Generate the navigation mesh.
-		double maxHeightDifference = boundsManager->bounds(i)->height() / 2;
-		NavMeshGenerator generator(mapPolygons, maxHeightDifference);
-		NavMesh_Ptr mesh = generator.generate_mesh();
-
-		// Build the navigation graph adjacency list.
-		AdjacencyList_Ptr adjList(new AdjacencyList(mesh));
-
-		// Build the navigation graph adjacency table (note that this is a very inefficient
-		// representation for the sparse graph in terms of space, but it's needed for the
-		// Floyd-Warshall algorithm used when building the path table).
-		AdjacencyTable adjTable(*adjList);
-
-		// Generate the path table.
-		PathTable_Ptr pathTable = PathTableGenerator::floyd_warshall(adjTable);
-
-		navManager->set_dataset(i, NavDataset_Ptr(new NavDataset(adjList, mesh, pathTable)));
+	NavManager_Ptr navManager(new NavManager);
+	for(int i=0; i<jobCount; ++i)
+	{
+		if(!errors[i].empty()) throw Exception(errors[i]);
+		navManager->set_dataset(mapIndices[i], datasets[i]);
 	}
 
 	// Write the navigation datasets to disk.
@@ -115,9 +190,23 @@ void run(const std::string& definitionsSpecifierFilename, const std::string& tre
 int main(int argc, char *argv[])
 try
 {
-	if(argc != 4) quit_with_usage();
+	if(argc < 4 || argc > 5) quit_with_usage();
 	std::vector<std::string> args(argv, argv + argc);
-	run(args[1], args[2], args[3]);
+
+	int threadCount = 1;
+
+	for(int i=4; i<argc; ++i)
+	{
+		if(args[i].substr(0,2) == "-t")
+		{
+			try							{ threadCount = lexical_cast<int,std::string>(args[i].substr(2)); }
+			catch(bad_lexical_cast&)	{ quit_with_usage(); }
+			if(threadCount < 1) quit_with_usage();
+		}
+		else quit_with_usage();
+	}
+
+	run(args[1], args[2], args[3], threadCount);
 	return 0;
 }
 catch(Exception& e) { quit_with_error(e.cause()); }
@@ -27,13 +27,22 @@ void quit_with_error(const std::string& error)
 
 void quit_with_usage()
 {
-	std::cout << "Usage: hobsp {-r|-c} <input geom 1> <input tree 1> ... <input geom n> <input tree n> <output tree> [-w<number>]" << std::endl;
+	std::cout << "Usage: hobsp {-r|-c} <input geom 1> <input tree 1> ... <input geom n> <input tree n> <output tree> [-w<number>] [-t<threads>] [-q{exact|normal|fast}]" << std::endl;
 	exit(EXIT_FAILURE);
 }
 
+SplitQuality parse_quality(const std::string& s)
+{
+	if(s == "exact") return SQ_EXACT;
+	else if(s == "normal") return SQ_NORMAL;
+	else if(s == "fast") return SQ_FAST;
+	else quit_with_usage();
+	return SQ_EXACT;	// never reached, but keeps the compiler happy
+}
+
 template <typename Poly>
 void run_compiler(const std::vector<std::string>& geomFilenames, const std::vector<std::string>& treeFilenames,
-				  const std::string& outputFilename, double weight)
+				  const std::string& outputFilename, double weight, int threadCount, SplitQuality quality)
 {
 	typedef shared_ptr<Poly> Poly_Ptr;
 	typedef std::vector<Poly_Ptr> PolyVector;
@@ -57,7 +66,7 @@ void run_compiler(const std::vector<std::string>& geomFilenames, const std::vect
 	}
 
 	// Compile them into an onion tree.
-	OnionCompiler<Poly> compiler(maps, mapTrees, weight);
+	OnionCompiler<Poly> compiler(maps, mapTrees, weight, threadCount, quality);
 	compiler.build_tree();
 
 	// Write the output polygons and onion tree to disk.
@@ -69,13 +78,29 @@ try
 {
 	std::vector<std::string> args(argv, argv + argc);
 
-	// If an optional weight argument has been supplied, parse it and remove it to simplify further processing.
+	// If optional weight, thread count and/or quality arguments have been supplied, parse them and remove them to simplify further processing.
 	double weight = 4;
-	const std::string& lastArg = args[args.size()-1];
-	if(lastArg.length() >= 3 && lastArg.substr(0,2) == "-w")
+	int threadCount = 1;
+	SplitQuality quality = SQ_EXACT;
+	while(args.size() > 1)
 	{
-		try							{ weight = lexical_cast<double,std::string>(lastArg.substr(2)); }
-		catch(bad_lexical_cast&)	{ quit_with_usage(); }
+		const std::string lastArg = args[args.size()-1];
+		if(lastArg.length() >= 3 && lastArg.substr(0,2) == "-w")
+		{
+			try							{ weight = lexical_cast<double,std::string>(lastArg.substr(2)); }
+			catch(bad_lexical_cast&)	{ quit_with_usage(); }
+		}
+		else if(lastArg.length() >= 3 && lastArg.substr(0,2) == "-t")
+		{
+			try							{ threadCount = lexical_cast<int,std::string>(lastArg.substr(2)); }
+			catch(bad_lexical_cast&)	{ quit_with_usage(); }
+			if(threadCount < 1) quit_with_usage();
+		}
+		else if(lastArg.length() >= 3 && lastArg.substr(0,2) == "-q")
+		{
+			quality = parse_quality(lastArg.substr(2));
+		}
+		else break;
 
 		args.pop_back();
 	}
@@ -104,8 +129,8 @@ try
 		}
 	}
 
-	if(args[1] == "-r") run_compiler<TexturedPolygon>(geomFilenames, treeFilenames, outputFilename, weight);
-	else if(args[1] == "-c") run_compiler<CollisionPolygon>(geomFilenames, treeFilenames, outputFilename, weight);
+	if(args[1] == "-r") run_compiler<TexturedPolygon>(geomFilenames, treeFilenames, outputFilename, weight, threadCount, quality);
+	else if(args[1] == "-c") run_compiler<CollisionPolygon>(geomFilenames, treeFilenames, outputFilename, weight, threadCount, quality);
 	else quit_with_usage();
 
 	return 0;
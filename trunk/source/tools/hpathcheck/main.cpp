@@ -0,0 +1,182 @@
+/***
+ * hpathcheck: main.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <source/exceptions/Exception.h>
+#include <source/level/nav/AdjacencyList.h>
+#include <source/level/nav/PathTable.h>
+#include <source/level/nav/PathTableGenerator.h>
+using namespace hesp;
+
+//#################### CONSTANTS ####################
+// The thread counts with which to run the Dijkstra generator (the results must not depend on them).
+const int THREAD_COUNTS[] = { 1, 4 };
+const int THREAD_COUNT_COUNT = sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0]);
+
+//#################### FUNCTIONS ####################
+void quit_with_error(const std::string& error)
+{
+	std::cout << "Error: " << error << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+/**
+Makes a directed w x h grid graph with unit-length edges between orthogonal neighbours. Almost every pair of
+nodes is joined by several shortest paths, so the generators' tie-breaking rules are thoroughly exercised.
+*/
+AdjacencyList_Ptr make_grid_graph(int w, int h)
+{
+	AdjacencyList_Ptr adjList(new AdjacencyList(w*h));
+	for(int y=0; y<h; ++y)
+		for(int x=0; x<w; ++x)
+		{
+			int n = y*w + x;
+			if(x > 0) adjList->add_edge(n, AdjacencyList::Edge(n-1, 1.0f));
+			if(x+1 < w) adjList->add_edge(n, AdjacencyList::Edge(n+1, 1.0f));
+			if(y > 0) adjList->add_edge(n, AdjacencyList::Edge(n-w, 1.0f));
+			if(y+1 < h) adjList->add_edge(n, AdjacencyList::Edge(n+w, 1.0f));
+		}
+	return adjList;
+}
+
+/**
+Makes a random sparse directed graph whose edges have small integer lengths (including some zero-length edges),
+so that there are plenty of ties between paths. Since the graph is sparse, some nodes are unreachable from others.
+The lengths are integers so that the sums of lengths along the paths are exact, and don't depend on the order in
+which they're added up.
+*/
+AdjacencyList_Ptr make_random_graph(int size, int edgeCount)
+{
+	AdjacencyList_Ptr adjList(new AdjacencyList(size));
+	for(int i=0; i<edgeCount; ++i)
+	{
+		int from = rand() % size, to = rand() % size;
+		if(from == to) continue;
+		adjList->add_edge(from, AdjacencyList::Edge(to, (float)(rand() % 4)));
+	}
+	return adjList;
+}
+
+/**
+Makes a star graph in which a hub node is joined to each of the other nodes (in both directions) by an edge of
+unit length. The hub has more out-edges than would fit in a byte.
+*/
+AdjacencyList_Ptr make_star_graph(int size)
+{
+	AdjacencyList_Ptr adjList(new AdjacencyList(size));
+	for(int i=1; i<size; ++i)
+	{
+		adjList->add_edge(0, AdjacencyList::Edge(i, 1.0f));
+		adjList->add_edge(i, AdjacencyList::Edge(0, 1.0f));
+	}
+	return adjList;
+}
+
+bool rows_equal(const PathTable::Row& lhs, const PathTable::Row& rhs)
+{
+	return lhs.costScale == rhs.costScale && lhs.costCodes == rhs.costCodes && lhs.nextHops == rhs.nextHops;
+}
+
+/**
+Checks that the path tables generated for a graph by Dijkstra's algorithm are the same as the one generated by
+Floyd-Warshall, and reports the first difference (if any).
+
+@param adjList	The graph
+@param name		The name of the graph (for reporting purposes)
+@return			true, if the path tables are the same, or false otherwise
+*/
+bool check_graph(const AdjacencyList& adjList, const std::string& name)
+{
+	PathTable_Ptr reference = PathTableGenerator::floyd_warshall(adjList);
+
+	int size = adjList.size();
+	for(int t=0; t<THREAD_COUNT_COUNT; ++t)
+	{
+		PathTable_Ptr pathTable = PathTableGenerator::dijkstra(adjList, THREAD_COUNTS[t]);
+		for(int i=0; i<size; ++i)
+		{
+			for(int j=0; j<size; ++j)
+			{
+				if(pathTable->cost(i,j) != reference->cost(i,j) || pathTable->next_node(i,j) != reference->next_node(i,j))
+				{
+					std::cout << name << " (" << THREAD_COUNTS[t] << " thread(s)): Path " << i << " -> " << j << " differs: "
+							  << "Floyd-Warshall gives cost " << reference->cost(i,j) << " via " << reference->next_node(i,j) << ", "
+							  << "Dijkstra gives cost " << pathTable->cost(i,j) << " via " << pathTable->next_node(i,j) << std::endl;
+					return false;
+				}
+			}
+
+			if(!rows_equal(pathTable->row(pathTable->row_index(i)), reference->row(reference->row_index(i))))
+			{
+				std::cout << name << " (" << THREAD_COUNTS[t] << " thread(s)): Row " << i << " differs" << std::endl;
+				return false;
+			}
+		}
+	}
+
+	std::cout << name << ": OK" << std::endl;
+	return true;
+}
+
+/**
+Checks that the quantised costs in the path table for a w x h grid graph (see make_grid_graph) never
+overestimate the true costs (which are the Manhattan distances between the nodes).
+
+@param w	The width of the grid
+@param h	The height of the grid
+@return		true, if no costs are overestimated, or false otherwise
+*/
+bool check_grid_costs(int w, int h)
+{
+	PathTable_Ptr pathTable = PathTableGenerator::dijkstra(*make_grid_graph(w, h));
+	int size = w*h;
+	for(int i=0; i<size; ++i)
+		for(int j=0; j<size; ++j)
+		{
+			float trueCost = (float)(abs(i%w - j%w) + abs(i/w - j/w));
+			if(pathTable->cost(i,j) > trueCost)
+			{
+				std::cout << w << 'x' << h << " grid: The cost of path " << i << " -> " << j << " is overestimated: "
+						  << pathTable->cost(i,j) << " > " << trueCost << std::endl;
+				return false;
+			}
+		}
+
+	std::cout << w << 'x' << h << " grid costs: OK" << std::endl;
+	return true;
+}
+
+int main()
+try
+{
+	bool ok = true;
+
+	ok = check_graph(*make_grid_graph(1, 1), "1x1 grid") && ok;
+	ok = check_graph(*make_grid_graph(8, 1), "8x1 grid") && ok;
+	ok = check_graph(*make_grid_graph(7, 7), "7x7 grid") && ok;
+	ok = check_graph(*make_grid_graph(16, 12), "16x12 grid") && ok;
+	ok = check_graph(*make_star_graph(300), "300-node star") && ok;
+	ok = check_grid_costs(37, 23) && ok;
+
+	srand(0);
+	for(int i=0; i<50; ++i)
+	{
+		int size = 2 + rand() % 60;
+		int edgeCount = size * (1 + rand() % 4);
+		std::ostringstream oss;
+		oss << "Random graph " << i << " (" << size << " nodes, " << edgeCount << " edges)";
+		ok = check_graph(*make_random_graph(size, edgeCount), oss.str()) && ok;
+	}
+
+	if(!ok) quit_with_error("Some path tables were not generated correctly");
+	std::cout << "All path tables were generated correctly" << std::endl;
+	return 0;
+}
+catch(Exception& e) { quit_with_error(e.cause()); }
@@ -8,6 +8,10 @@
 #include <string>
 #include <vector>
 
+#include <boost/lexical_cast.hpp>
+using boost::bad_lexical_cast;
+using boost::lexical_cast;
+
 #include <source/io/files/PortalsFile.h>
 #include <source/io/files/VisFile.h>
 #include <source/level/vis/VisCalculator.h>
@@ -22,11 +26,21 @@ void quit_with_error(const std::string& error)
 
 void quit_with_usage()
 {
-	std::cout << "Usage: hvis <input filename> <output filename>" << std::endl;
+	std::cout << "Usage: hvis [-threads <number>] [-checkpoint <filename> [-interval <portals>] [-resume]] [-progress] <input filename> <output filename>" << std::endl;
 	exit(EXIT_FAILURE);
 }
 
-void run_calculator(const std::string& inputFilename, const std::string& outputFilename)
+int parse_positive_int(const std::string& s)
+{
+	int n = 0;
+	try							{ n = lexical_cast<int,std::string>(s); }
+	catch(bad_lexical_cast&)	{ quit_with_usage(); }
+	if(n < 1) quit_with_usage();
+	return n;
+}
+
+void run_calculator(const std::string& inputFilename, const std::string& outputFilename, int threadCount,
+					const std::string& checkpointFilename, int checkpointInterval, bool resume, bool showProgress)
 try
 {
 	// Read in the empty leaf count and portals.
@@ -35,7 +49,9 @@ try
 	PortalsFile::load(inputFilename, emptyLeafCount, portals);
 
 	// Run the visibility calculator.
-	VisCalculator visCalc(emptyLeafCount, portals);
+	VisCalculator visCalc(emptyLeafCount, portals, threadCount);
+	if(checkpointFilename != "") visCalc.enable_checkpointing(checkpointFilename, checkpointInterval, resume);
+	if(showProgress) visCalc.set_progress_stream(std::cout);
 	LeafVisTable_Ptr leafVis = visCalc.calculate_leaf_vis_table();
 
 	// Write the leaf visibility table to the output file.
@@ -45,8 +61,28 @@ catch(Exception& e) { quit_with_error(e.cause()); }
 
 int main(int argc, char *argv[])
 {
-	if(argc != 3) quit_with_usage();
+	if(argc < 3) quit_with_usage();
 	std::vector<std::string> args(argv, argv + argc);
-	run_calculator(args[1], args[2]);
+
+	int threadCount = 1;
+	std::string checkpointFilename;
+	int checkpointInterval = 1024;
+	bool resume = false;
+	bool showProgress = false;
+
+	// Parse the options (everything before the input and output filenames).
+	for(int i=1; i<argc-2; ++i)
+	{
+		if(args[i] == "-threads" && i+1 < argc-2)			threadCount = parse_positive_int(args[++i]);
+		else if(args[i] == "-checkpoint" && i+1 < argc-2)	checkpointFilename = args[++i];
+		else if(args[i] == "-interval" && i+1 < argc-2)		checkpointInterval = parse_positive_int(args[++i]);
+		else if(args[i] == "-resume")						resume = true;
+		else if(args[i] == "-progress")						showProgress = true;
+		else quit_with_usage();
+	}
+
+	if(resume && checkpointFilename == "") quit_with_usage();
+
+	run_calculator(args[argc-2], args[argc-1], threadCount, checkpointFilename, checkpointInterval, resume, showProgress);
 	return 0;
 }
@@ -0,0 +1,43 @@
+/***
+ * hesperus: Hasher.cpp
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#include "Hasher.h"
+
+namespace hesp {
+
+//#################### CONSTRUCTORS ####################
+Hasher::Hasher()
+:	m_hash(0xcbf29ce484222325ULL)
+{}
+
+//#################### PUBLIC METHODS ####################
+void Hasher::add(int value)
+{
+	add_bytes(&value, sizeof(value));
+}
+
+void Hasher::add(double value)
+{
+	// Make sure that 0 and -0 hash to the same thing.
+	if(value == 0) value = 0;
+	add_bytes(&value, sizeof(value));
+}
+
+void Hasher::add_bytes(const void *bytes, size_t count)
+{
+	const unsigned char *p = static_cast<const unsigned char*>(bytes);
+	for(size_t i=0; i<count; ++i)
+	{
+		m_hash ^= p[i];
+		m_hash *= 0x100000001b3ULL;
+	}
+}
+
+boost::uint64_t Hasher::hash() const
+{
+	return m_hash;
+}
+
+}
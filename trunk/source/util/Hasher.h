@@ -0,0 +1,40 @@
+/***
+ * hesperus: Hasher.h
+ * Copyright Stuart Golodetz, 2009. All rights reserved.
+ ***/
+
+#ifndef H_HESP_HASHER
+#define H_HESP_HASHER
+
+#include <cstddef>
+
+#include <boost/cstdint.hpp>
+
+namespace hesp {
+
+/**
+This class incrementally computes a 64-bit FNV-1a hash of a sequence of values. It is
+intended for building cache keys, so values are hashed by their exact bit patterns (in
+the native byte order of the machine).
+*/
+class Hasher
+{
+	//#################### PRIVATE VARIABLES ####################
+private:
+	boost::uint64_t m_hash;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	Hasher();
+
+	//#################### PUBLIC METHODS ####################
+public:
+	void add(int value);
+	void add(double value);
+	void add_bytes(const void *bytes, size_t count);
+	boost::uint64_t hash() const;
+};
+
+}
+
+#endif